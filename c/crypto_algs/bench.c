@@ -0,0 +1,274 @@
+/*******************************************************************************
+ *
+ * This program measures the big_number operations, so a change to the
+ * big_number library can be checked for speed.  For each operand size it
+ * times:
+ *
+ * - add        - big_number_add(), 2 n-bit numbers.
+ * - mul        - big_number_multiply(), 2 n-bit numbers.
+ * - square     - big_number_square(), an n-bit number.
+ * - div        - big_number_divide(), a 2n-bit number by an n-bit one.
+ * - mod        - big_number_modulus(), a 2n-bit number by an n-bit one.
+ * - mod_exp    - big_number_mod_exp(), n-bit base, exponent, and modulus.
+ * - to_dec_str - big_number_to_dec_str(), an n-bit number.
+ * - from_str   - big_number_from_str(), the decimal string of an n-bit number.
+ *
+ * Each test is warmed up, then timed as a number of samples.  A sample is a
+ * batch of operations that takes about SAMPLE_NS, so the clock doesn't get in
+ * the way of the fast ones.  The median and 99th percentile of the samples are
+ * reported, along with the fastest.
+ *
+ * The output is CSV, one line per test:
+ *
+ *   label,op,bits,batch,samples,median_ns,p99_ns,min_ns
+ *
+ * The label is the first argument (the Makefile uses the git commit), so the
+ * files from 2 runs can be joined on (op, bits) and compared.  The second
+ * argument is the number of samples (the default is 51).  Build and run it
+ * with "make bench".
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "big_number.h"
+
+/* Operand sizes to try (in bits). */
+static const int sizes[] = { 256, 512, 1024, 2048, 4096 };
+
+/* How long a sample should take, how long to warm up for, and the most time
+ * to spend on one test (in nanoseconds).  A slow test gets fewer samples, but
+ * never fewer than MIN_SAMPLES. */
+#define SAMPLE_NS   2000000ULL
+#define WARMUP_NS  50000000ULL
+#define TEST_NS  2000000000ULL
+#define MIN_SAMPLES 5
+
+/* Which operation to time. */
+typedef enum {
+	BENCH_ADD,
+	BENCH_MUL,
+	BENCH_SQUARE,
+	BENCH_DIV,
+	BENCH_MOD,
+	BENCH_MOD_EXP,
+	BENCH_TO_DEC_STR,
+	BENCH_FROM_STR
+} bench_op;
+
+static const char *op_names[] = {
+	"add", "mul", "square", "div", "mod", "mod_exp", "to_dec_str", "from_str"
+};
+
+/* The operands for one size. */
+typedef struct bench_operands {
+	big_number *a;		/* n bits. */
+	big_number *b;		/* n bits. */
+	big_number *wide;	/* 2n bits. */
+	big_number *odd;	/* n bits, odd (a modulus). */
+	big_number *out;
+	char *dec;		/* a in decimal, without the commas. */
+} bench_operands;
+
+/*******************************************************************************
+ * Return the current time in nanoseconds.
+ ******************************************************************************/
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/*******************************************************************************
+ * Set a big_number to a random number with exactly the specified number of
+ * bits (xorshift64, so every run uses the same numbers).
+ ******************************************************************************/
+static int random_bits(big_number *this, int bits, uint64_t *state)
+{
+	uint8_t buf[1024];
+	int len = (bits + 7) / 8;
+
+	int i;
+	for(i = 0; i < len; i++) {
+		uint64_t x = *state;
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		*state = x;
+		buf[i] = (uint8_t) (x >> 32);
+	}
+	buf[0] &= (uint8_t) (0xFF >> ((len * 8) - bits));
+	buf[0] |= (uint8_t) (0x80 >> ((len * 8) - bits));
+
+	return big_number_from_bytes(this, buf, len);
+}
+
+/*******************************************************************************
+ * Run one operation.
+ ******************************************************************************/
+static void run_op(bench_op op, bench_operands *o)
+{
+	switch(op) {
+	case BENCH_ADD:
+		big_number_add(o->a, o->b, o->out);
+		break;
+	case BENCH_MUL:
+		big_number_multiply(o->a, o->b, o->out);
+		break;
+	case BENCH_SQUARE:
+		big_number_square(o->a, o->out);
+		break;
+	case BENCH_DIV:
+		big_number_divide(o->wide, o->b, o->out);
+		break;
+	case BENCH_MOD:
+		big_number_modulus(o->wide, o->b, o->out);
+		break;
+	case BENCH_MOD_EXP:
+		big_number_mod_exp(o->a, o->b, o->odd, o->out);
+		break;
+	case BENCH_TO_DEC_STR:
+		big_number_to_dec_str(o->a);
+		break;
+	case BENCH_FROM_STR:
+		big_number_from_str(o->out, o->dec);
+		break;
+	}
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+/*******************************************************************************
+ * Time an operation, and write its CSV line.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (out of memory).
+ ******************************************************************************/
+static int time_op(const char *label, bench_op op, int bits, bench_operands *o, int max_samples)
+{
+	/* Warm up, and count how many operations that was. */
+	uint64_t count = 0;
+	uint64_t start = now_ns();
+	uint64_t elapsed;
+	do {
+		run_op(op, o);
+		count++;
+		elapsed = now_ns() - start;
+	} while(elapsed < WARMUP_NS);
+
+	/* The batch size and number of samples. */
+	double op_ns = (double) elapsed / count;
+	uint64_t batch = (uint64_t) (SAMPLE_NS / op_ns) + 1;
+	int samples = (int) (TEST_NS / (batch * op_ns));
+	if(samples > max_samples) {
+		samples = max_samples;
+	}
+	if(samples < MIN_SAMPLES) {
+		samples = MIN_SAMPLES;
+	}
+
+	double *ns = (double *) malloc(samples * sizeof(*ns));
+	if(ns == (double *) 0) {
+		return 1;
+	}
+
+	int i;
+	for(i = 0; i < samples; i++) {
+		start = now_ns();
+		uint64_t j;
+		for(j = 0; j < batch; j++) {
+			run_op(op, o);
+		}
+		ns[i] = (double) (now_ns() - start) / batch;
+	}
+
+	/* The p99 is the sample that 99% of them are at or below. */
+	qsort(ns, samples, sizeof(*ns), compare_double);
+	int p99 = ((samples * 99) + 99) / 100 - 1;
+	printf("%s,%s,%d,%ju,%d,%.1f,%.1f,%.1f\n", label, op_names[op], bits, batch, samples,
+	       ns[samples / 2], ns[p99], ns[0]);
+	fflush(stdout);
+
+	free(ns);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *label = (argc > 1) ? argv[1] : "local";
+	int max_samples = (argc > 2) ? atoi(argv[2]) : 51;
+	if(max_samples < MIN_SAMPLES) {
+		max_samples = MIN_SAMPLES;
+	}
+
+	bench_operands o;
+	o.a = big_number_new();
+	o.b = big_number_new();
+	o.wide = big_number_new();
+	o.odd = big_number_new();
+	o.out = big_number_new();
+	o.dec = (char *) 0;
+	if(!o.a || !o.b || !o.wide || !o.odd || !o.out) {
+		printf("Unable to allocate buffers.\n");
+		return 1;
+	}
+
+	printf("label,op,bits,batch,samples,median_ns,p99_ns,min_ns\n");
+
+	uint64_t state = 88172645463325252ULL;
+	int i;
+	for(i = 0; i < (sizeof(sizes) / sizeof(sizes[0])); i++) {
+		int bits = sizes[i];
+
+		if((random_bits(o.a, bits, &state) != 0) || (random_bits(o.b, bits, &state) != 0) ||
+		   (random_bits(o.wide, 2 * bits, &state) != 0) || (random_bits(o.odd, bits, &state) != 0)) {
+			printf("Unable to make the %d bit operands.\n", bits);
+			return 1;
+		}
+		if(big_number_modulus_u64(o.odd, 2) == 0) {
+			big_number_increment(o.odd);
+		}
+
+		/* from_str gets the digits without the commas. */
+		const char *str = big_number_to_dec_str(o.a);
+		free(o.dec);
+		o.dec = (str != (const char *) 0) ? (char *) malloc(strlen(str) + 1) : (char *) 0;
+		if(o.dec == (char *) 0) {
+			printf("Unable to allocate buffers.\n");
+			return 1;
+		}
+		char *dst = o.dec;
+		for(; *str != 0; str++) {
+			if(*str != ',') {
+				*(dst++) = *str;
+			}
+		}
+		*dst = 0;
+
+		bench_op op;
+		for(op = BENCH_ADD; op <= BENCH_FROM_STR; op++) {
+			if(time_op(label, op, bits, &o, max_samples) != 0) {
+				printf("Unable to allocate buffers.\n");
+				return 1;
+			}
+		}
+	}
+
+	free(o.dec);
+	big_number_delete(o.out);
+	big_number_delete(o.odd);
+	big_number_delete(o.wide);
+	big_number_delete(o.b);
+	big_number_delete(o.a);
+	return 0;
+}
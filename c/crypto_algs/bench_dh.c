@@ -0,0 +1,269 @@
+/*******************************************************************************
+ *
+ * This program measures key agreement: finite field Diffie-Hellman over the
+ * RFC 3526 groups (diffie_hellman.c), and elliptic curve Diffie-Hellman over
+ * X25519 and P-256 (ecdh.c).  For each one it times:
+ *
+ * - setup      - Creating the group or curve (its fixed-base table).
+ * - keygen     - Key generation in one thread.
+ * - handshakes - Complete key agreements.  N client/server pairs run at once,
+ *                each over its own socket pair.  Each handshake is 2 key
+ *                generations, 2 secrets, and a round trip on the socket.
+ *
+ * The speedup column compares handshakes with the 3072-bit group, which has
+ * the same strength as the curves (128 bits).
+ *
+ * Build and run it with "make bench_dh".  Run "./bench_dh_bin N" to use N
+ * pairs (the default is 4).
+ *
+ ******************************************************************************/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+
+#include "big_number.h"
+#include "diffie_hellman.h"
+#include "ecdh.h"
+
+/* How long to run each test for (in nanoseconds). */
+#define BENCH_NS 1000000000ULL
+
+/* One way to agree on a key.  curve_id is -1 for a Diffie-Hellman group.
+ * Exactly one of group and curve is set, once it has been created. */
+typedef struct bench_kex {
+	const char *name;
+	int operand_bits;
+	int security_bits;
+	int curve_id;
+	diffie_hellman_group *group;
+	ecdh_curve *curve;
+	double setup_ms;
+} bench_kex;
+
+/* One client/server pair.  The client counts its handshakes until the time is
+ * up, and then closes its socket.  That tells the server to stop. */
+typedef struct bench_pair {
+	const bench_kex *kex;
+	int fds[2];
+	uint64_t deadline;
+	int handshakes;
+	int errors;
+	pthread_t client;
+	pthread_t server;
+} bench_pair;
+
+/*******************************************************************************
+ * Return the current time in nanoseconds.
+ ******************************************************************************/
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/*******************************************************************************
+ * Do one handshake over a socket.  Returns 0 if success.
+ ******************************************************************************/
+static int handshake(const bench_kex *kex, int fd)
+{
+	if(kex->curve != (ecdh_curve *) 0) {
+		uint8_t secret[ECDH_SECRET_BYTES];
+		return ecdh_handshake(fd, kex->curve, secret);
+	}
+
+	big_number *secret = big_number_new();
+	int rc = (secret == (big_number *) 0) || (diffie_hellman_handshake(fd, kex->group, secret) != 0);
+	big_number_delete(secret);
+	return rc;
+}
+
+/*******************************************************************************
+ * The client side of a pair.
+ ******************************************************************************/
+static void *client_thread(void *arg)
+{
+	bench_pair *pair = (bench_pair *) arg;
+
+	while(now_ns() < pair->deadline) {
+		if(handshake(pair->kex, pair->fds[0]) != 0) {
+			pair->errors++;
+			break;
+		}
+		pair->handshakes++;
+	}
+
+	shutdown(pair->fds[0], SHUT_RDWR);
+	return (void *) 0;
+}
+
+/*******************************************************************************
+ * The server side of a pair.  Keep answering until the client goes away.
+ ******************************************************************************/
+static void *server_thread(void *arg)
+{
+	bench_pair *pair = (bench_pair *) arg;
+
+	while(handshake(pair->kex, pair->fds[1]) == 0) {
+	}
+
+	return (void *) 0;
+}
+
+/*******************************************************************************
+ * Time key generation in one thread.
+ *
+ * Output:
+ *   Key pairs per second.
+ ******************************************************************************/
+static double time_keygen(const bench_kex *kex, big_number *x, big_number *y)
+{
+	uint8_t private_key[ECDH_PRIVATE_BYTES];
+	uint8_t public_key[ECDH_MAX_PUBLIC_BYTES];
+
+	int iterations = 0;
+	uint64_t start = now_ns();
+	uint64_t elapsed;
+	do {
+		if(kex->curve != (ecdh_curve *) 0) {
+			ecdh_generate_key(kex->curve, private_key, public_key);
+		}
+		else {
+			diffie_hellman_generate_key(kex->group, x, y);
+		}
+		iterations++;
+		elapsed = now_ns() - start;
+	} while(elapsed < (BENCH_NS / 2));
+
+	return (iterations * 1e9) / elapsed;
+}
+
+/*******************************************************************************
+ * Run npairs client/server pairs at once.
+ *
+ * Output:
+ *   Handshakes per second, or -1 if something failed.
+ ******************************************************************************/
+static double time_handshakes(const bench_kex *kex, int npairs)
+{
+	bench_pair *pairs = (bench_pair *) calloc(npairs, sizeof(*pairs));
+	if(pairs == (bench_pair *) 0) {
+		return -1;
+	}
+
+	uint64_t start = now_ns();
+	int started = 0;
+	int i;
+	for(i = 0; i < npairs; i++) {
+		pairs[i].kex = kex;
+		pairs[i].deadline = start + BENCH_NS;
+		if(socketpair(AF_UNIX, SOCK_STREAM, 0, pairs[i].fds) != 0) {
+			break;
+		}
+		if(pthread_create(&pairs[i].server, NULL, server_thread, &pairs[i]) != 0) {
+			close(pairs[i].fds[0]);
+			close(pairs[i].fds[1]);
+			break;
+		}
+		if(pthread_create(&pairs[i].client, NULL, client_thread, &pairs[i]) != 0) {
+			shutdown(pairs[i].fds[0], SHUT_RDWR);
+			pthread_join(pairs[i].server, (void **) 0);
+			close(pairs[i].fds[0]);
+			close(pairs[i].fds[1]);
+			break;
+		}
+		started++;
+	}
+
+	int handshakes = 0;
+	int errors = (started != npairs);
+	for(i = 0; i < started; i++) {
+		pthread_join(pairs[i].client, (void **) 0);
+		pthread_join(pairs[i].server, (void **) 0);
+		close(pairs[i].fds[0]);
+		close(pairs[i].fds[1]);
+		handshakes += pairs[i].handshakes;
+		errors += pairs[i].errors;
+	}
+	uint64_t elapsed = now_ns() - start;
+
+	free(pairs);
+	return (errors == 0) ? ((handshakes * 1e9) / elapsed) : -1;
+}
+
+int main(int argc, char **argv)
+{
+	int npairs = (argc > 1) ? atoi(argv[1]) : 4;
+	if(npairs < 1) {
+		printf("Usage: %s [pairs]\n", argv[0]);
+		return 1;
+	}
+
+	big_number *x = big_number_new();
+	big_number *y = big_number_new();
+	if(!x || !y) {
+		printf("Unable to allocate buffers.\n");
+		return 1;
+	}
+
+	bench_kex kexes[] = {
+		{ "dh-2048", 2048, 112, -1 },
+		{ "dh-3072", 3072, 128, -1 },
+		{ "dh-4096", 4096, 140, -1 },
+		{ "x25519",   255, 128, ECDH_X25519 },
+		{ "p-256",    256, 128, ECDH_P256 }
+	};
+	int nkexes = sizeof(kexes) / sizeof(kexes[0]);
+
+	/* Time them all first, so every line can be compared with dh-3072. */
+	double keygen[sizeof(kexes) / sizeof(kexes[0])];
+	double handshakes[sizeof(kexes) / sizeof(kexes[0])];
+	double dh3072 = 1;
+
+	int i;
+	for(i = 0; i < nkexes; i++) {
+		uint64_t start = now_ns();
+		if(kexes[i].curve_id >= 0) {
+			kexes[i].curve = ecdh_curve_new((ecdh_curve_id) kexes[i].curve_id);
+		}
+		else {
+			kexes[i].group = diffie_hellman_group_new(kexes[i].operand_bits);
+		}
+		kexes[i].setup_ms = (now_ns() - start) / 1e6;
+		if((kexes[i].group == (diffie_hellman_group *) 0) && (kexes[i].curve == (ecdh_curve *) 0)) {
+			printf("Unable to create %s.\n", kexes[i].name);
+			return 1;
+		}
+
+		keygen[i] = time_keygen(&kexes[i], x, y);
+		handshakes[i] = time_handshakes(&kexes[i], npairs);
+		if(handshakes[i] < 0) {
+			printf("Handshakes failed with %s.\n", kexes[i].name);
+			return 1;
+		}
+		if(kexes[i].operand_bits == 3072) {
+			dh3072 = handshakes[i];
+		}
+	}
+
+	printf("%-8s %6s %9s %10s %12s %6s %14s %9s\n", "kex", "bits", "security", "setup_ms", "keygen/s", "pairs",
+	       "handshakes/s", "speedup");
+	for(i = 0; i < nkexes; i++) {
+		printf("%-8s %6d %9d %10.1f %12.1f %6d %14.1f %8.1fx\n", kexes[i].name, kexes[i].operand_bits,
+		       kexes[i].security_bits, kexes[i].setup_ms, keygen[i], npairs, handshakes[i], handshakes[i] / dh3072);
+	}
+
+	for(i = 0; i < nkexes; i++) {
+		ecdh_curve_delete(kexes[i].curve);
+		diffie_hellman_group_delete(kexes[i].group);
+	}
+	big_number_delete(y);
+	big_number_delete(x);
+	return 0;
+}
@@ -0,0 +1,187 @@
+/*******************************************************************************
+ *
+ * This program measures the multiplication crossover points that are used by
+ * big_number_mul.c.  For each operand size it times:
+ *
+ * - schoolbook     - The O(n^2) multiply.
+ * - karatsuba      - One level of Karatsuba, with schoolbook underneath.
+ * - karatsuba_full - Karatsuba all the way down to the current threshold.
+ * - toom3          - One level of Toom-3, with Karatsuba underneath.
+ * - toom3_full     - Toom-3 and Karatsuba at the current thresholds.
+ * - ntt            - The number-theoretic transform.
+ *
+ * The size from which Karatsuba keeps beating schoolbook is a good value for
+ * KARATSUBA_THRESHOLD.  The size from which Toom-3 keeps beating Karatsuba is
+ * a good value for TOOM3_THRESHOLD.  The size from which the NTT keeps beating
+ * toom3_full is a good value for NTT_THRESHOLD.  Build and run it with "make
+ * bench_mul".
+ *
+ * The fastest limb kernels for the CPU are used.  Run "./bench_mul_bin generic"
+ * to time the portable ones instead.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "big_number_limb.h"
+
+/* Operand sizes to try (in limbs). */
+static const int sizes[] = {
+	8, 12, 16, 20, 24, 28, 32, 40, 48, 56, 64, 80, 96,
+	112, 128, 160, 192, 224, 256, 320, 384, 512, 768, 1024,
+	1536, 2048, 3072, 4096, 6144, 8192
+};
+
+/* Never switch.  Used to force the schoolbook, Karatsuba, and Toom-3 cases. */
+#define NEVER (1 << 30)
+
+/*******************************************************************************
+ * Return the current time in nanoseconds.
+ ******************************************************************************/
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/*******************************************************************************
+ * Time one n x n multiply with the specified thresholds.  The NTT is only used
+ * if ntt is set, and then it's used for the whole multiply.  The multiply is run
+ * enough times to take about 20ms, and the best of 3 runs is reported.
+ *
+ * Output:
+ *   Nanoseconds per multiply.
+ ******************************************************************************/
+static double time_mul(limb_t *r, const limb_t *a, const limb_t *b, int n, int karatsuba, int toom3, int ntt)
+{
+	big_number_limb_set_mul_thresholds(karatsuba, toom3);
+	big_number_limb_set_ntt_threshold(ntt ? n : NEVER);
+
+	/* Figure out how many iterations fit in the time budget. */
+	int iterations = 1;
+	while(1) {
+		uint64_t start = now_ns();
+		int i;
+		for(i = 0; i < iterations; i++) {
+			big_number_limb_mul(r, a, n, b, n);
+		}
+		if((now_ns() - start) > 20000000ULL) {
+			break;
+		}
+		iterations *= 2;
+	}
+
+	double best = 0;
+	int pass;
+	for(pass = 0; pass < 3; pass++) {
+		uint64_t start = now_ns();
+		int i;
+		for(i = 0; i < iterations; i++) {
+			big_number_limb_mul(r, a, n, b, n);
+		}
+		double ns = (double) (now_ns() - start) / iterations;
+		if((pass == 0) || (ns < best)) {
+			best = ns;
+		}
+	}
+
+	return best;
+}
+
+int main(int argc, char **argv)
+{
+	int default_karatsuba, default_toom3;
+	big_number_limb_get_mul_thresholds(&default_karatsuba, &default_toom3);
+	int default_ntt = big_number_limb_get_ntt_threshold();
+
+	if((argc > 1) && (big_number_limb_kernel_select(argv[1]) != 0)) {
+		printf("Unknown or unsupported kernels: %s.\n", argv[1]);
+		return 1;
+	}
+
+	int max = sizes[(sizeof(sizes) / sizeof(sizes[0])) - 1];
+	limb_t *a = (limb_t *) malloc(max * sizeof(limb_t));
+	limb_t *b = (limb_t *) malloc(max * sizeof(limb_t));
+	limb_t *r = (limb_t *) malloc(2 * max * sizeof(limb_t));
+	if(!a || !b || !r) {
+		printf("Unable to allocate buffers.\n");
+		return 1;
+	}
+
+	srand(1);
+	int i;
+	for(i = 0; i < max; i++) {
+		a[i] = ((limb_t) rand() << 62) ^ ((limb_t) rand() << 31) ^ (limb_t) rand();
+		b[i] = ((limb_t) rand() << 62) ^ ((limb_t) rand() << 31) ^ (limb_t) rand();
+	}
+
+	printf("Kernels: %s\n", big_number_limb_kernel_name());
+	printf("Current thresholds: KARATSUBA_THRESHOLD=%d TOOM3_THRESHOLD=%d NTT_THRESHOLD=%d\n\n",
+	       default_karatsuba, default_toom3, default_ntt);
+	printf("%6s %6s %14s %14s %14s %14s %14s %14s\n", "limbs", "bits",
+	       "schoolbook_ns", "karatsuba_ns", "kara_full_ns", "toom3_ns", "toom3_full_ns", "ntt_ns");
+
+	/* A threshold is the first size after the last size where the faster
+	 * algorithm lost.  That keeps one noisy sample from skewing it. */
+	int karatsuba_found = 0;
+	int toom3_found = 0;
+	int ntt_found = 0;
+	int karatsuba_lost = 1;
+	int toom3_lost = 1;
+	int ntt_lost = 1;
+	for(i = 0; i < (sizeof(sizes) / sizeof(sizes[0])); i++) {
+		int n = sizes[i];
+
+		double school = time_mul(r, a, b, n, NEVER, NEVER, 0);
+		double kara   = time_mul(r, a, b, n, n, NEVER, 0);
+		double full   = time_mul(r, a, b, n, default_karatsuba, NEVER, 0);
+		double toom   = time_mul(r, a, b, n, default_karatsuba, n, 0);
+		double tfull  = time_mul(r, a, b, n, default_karatsuba, default_toom3, 0);
+		double ntt    = time_mul(r, a, b, n, default_karatsuba, default_toom3, 1);
+
+		printf("%6d %6d %14.0f %14.0f %14.0f %14.0f %14.0f %14.0f\n", n, n * LIMB_BITS,
+		       school, kara, full, toom, tfull, ntt);
+
+		if(kara >= school) {
+			karatsuba_lost = 1;
+		}
+		else if(karatsuba_lost) {
+			karatsuba_found = n;
+			karatsuba_lost = 0;
+		}
+
+		if(toom >= full) {
+			toom3_lost = 1;
+		}
+		else if(toom3_lost) {
+			toom3_found = n;
+			toom3_lost = 0;
+		}
+
+		if(ntt >= tfull) {
+			ntt_lost = 1;
+		}
+		else if(ntt_lost) {
+			ntt_found = n;
+			ntt_lost = 0;
+		}
+	}
+
+	big_number_limb_set_mul_thresholds(default_karatsuba, default_toom3);
+	big_number_limb_set_ntt_threshold(default_ntt);
+
+	printf("\nSuggested: KARATSUBA_THRESHOLD=%d TOOM3_THRESHOLD=%d NTT_THRESHOLD=%d\n",
+	       ((karatsuba_found != 0) && !karatsuba_lost) ? karatsuba_found : default_karatsuba,
+	       ((toom3_found != 0) && !toom3_lost) ? toom3_found : default_toom3,
+	       ((ntt_found != 0) && !ntt_lost) ? ntt_found : default_ntt);
+
+	free(r);
+	free(b);
+	free(a);
+	return 0;
+}
@@ -0,0 +1,119 @@
+/*******************************************************************************
+ *
+ * This program measures RSA private-key operations (decryption, or signing).
+ * For each key size it generates a key pair, and then times:
+ *
+ * - crt    - rsa_decrypt(), which uses the Chinese Remainder Theorem.
+ * - plain  - (c ^ d) % n with big_number_mod_exp().
+ * - verify - rsa_encrypt() with e = 65,537.
+ *
+ * Build and run it with "make bench_rsa".
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "big_number.h"
+#include "rsa.h"
+
+/* Key sizes to try (in bits). */
+static const int sizes[] = { 2048, 4096 };
+
+/* Number of threads to generate the keys with. */
+#define KEYGEN_THREADS 4
+
+/* Which operation to time. */
+typedef enum {
+	BENCH_CRT,
+	BENCH_PLAIN,
+	BENCH_VERIFY
+} bench_op;
+
+/*******************************************************************************
+ * Return the current time in nanoseconds.
+ ******************************************************************************/
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/*******************************************************************************
+ * Run one operation.
+ ******************************************************************************/
+static void run_op(bench_op op, const rsa_keypair *key, const big_number *in, big_number *out)
+{
+	switch(op) {
+	case BENCH_CRT:
+		rsa_decrypt(key, in, out);
+		break;
+	case BENCH_PLAIN:
+		big_number_mod_exp(in, rsa_keypair_d(key), rsa_keypair_n(key), out);
+		break;
+	case BENCH_VERIFY:
+		rsa_encrypt(key, in, out);
+		break;
+	}
+}
+
+/*******************************************************************************
+ * Time an operation.  It is run for at least half a second.
+ *
+ * Output:
+ *   Operations per second.
+ ******************************************************************************/
+static double time_op(bench_op op, const rsa_keypair *key, const big_number *in, big_number *out)
+{
+	int iterations = 0;
+	uint64_t start = now_ns();
+	uint64_t elapsed;
+	do {
+		run_op(op, key, in, out);
+		iterations++;
+		elapsed = now_ns() - start;
+	} while(elapsed < 500000000ULL);
+
+	return (iterations * 1e9) / elapsed;
+}
+
+int main(int argc, char **argv)
+{
+	big_number *c = big_number_new();
+	big_number *m = big_number_new();
+	if(!c || !m) {
+		printf("Unable to allocate buffers.\n");
+		return 1;
+	}
+
+	printf("%6s %12s %12s %12s %8s %12s\n", "bits", "keygen_ms", "crt_ops/s", "plain_ops/s", "speedup", "verify_ops/s");
+
+	int i;
+	for(i = 0; i < (sizeof(sizes) / sizeof(sizes[0])); i++) {
+		uint64_t start = now_ns();
+		rsa_keypair *key = rsa_generate_keypair(sizes[i], KEYGEN_THREADS);
+		double keygen_ms = (now_ns() - start) / 1e6;
+		if(key == (rsa_keypair *) 0) {
+			printf("Unable to generate a %d bit key.\n", sizes[i]);
+			return 1;
+		}
+
+		/* Any c < n will do.  Make it a full size one. */
+		big_number_subtract(rsa_keypair_n(key), big_number_2(), c);
+
+		double crt    = time_op(BENCH_CRT,    key, c, m);
+		double plain  = time_op(BENCH_PLAIN,  key, c, m);
+		double verify = time_op(BENCH_VERIFY, key, c, m);
+
+		printf("%6d %12.1f %12.1f %12.1f %7.2fx %12.1f\n", sizes[i], keygen_ms, crt, plain, crt / plain, verify);
+
+		rsa_keypair_delete(key);
+	}
+
+	big_number_delete(m);
+	big_number_delete(c);
+	return 0;
+}
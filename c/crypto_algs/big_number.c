@@ -6,6 +6,7 @@
  *
  ******************************************************************************/
 
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -32,243 +33,193 @@ struct big_number {
 
 	big_number_base *num;
 
-	char str[8192];
+	/* The string from big_number_to_dec_str().  It isn't allocated until
+	 * somebody asks for it. */
+	char *str;
+	int str_size;
 };
 
+/* This is the big_number_mont class.  It's a modulus that has been prepared
+ * for modular exponentiation.  The work is done by big_number_base_???.c. */
+struct big_number_mont {
+
+	big_number_base_mont *mont;
+};
+
+/* This is the big_number_mont_fixed class.  It's a base and modulus that have
+ * been prepared for fixed-base exponentiation. */
+struct big_number_mont_fixed {
+
+	big_number_base_mont_fixed *fixed;
+};
+
+/* This is the big_number_reducer class.  It's a modulus that has been prepared
+ * for Barrett reduction. */
+struct big_number_reducer {
+
+	big_number_base_reducer *reducer;
+};
+
+/* One thread's share of big_number_mod_exp_batch().  It raises the shared base
+ * to exps[first] ... exps[last - 1].  status is set to 1 if any of them
+ * failed. */
+typedef struct big_number_batch {
+
+	const big_number_mont_fixed *fixed;
+	const big_number * const *exps;
+	big_number **results;
+	int first;
+	int last;
+	int status;
+} big_number_batch;
+
+/* This is the scratch arena.  Each thread has one.  It's a stack of temporary
+ * big_number objects that are handed out by big_number_scratch_get() and given
+ * back in stack order by big_number_scratch_release().  The objects (and their
+ * limbs) are kept when they're given back, so once a thread has warmed up, its
+ * temporaries never go to malloc(). */
+typedef struct big_number_scratch {
+
+	big_number **stack;
+
+	/* Number of objects in the stack, and number handed out. */
+	int size;
+	int top;
+} big_number_scratch;
+
+static __thread big_number_scratch *big_number_scratch_arena = (big_number_scratch *) 0;
+
+/* Frees each thread's arena when the thread exits. */
+static pthread_key_t big_number_scratch_key;
+static pthread_once_t big_number_scratch_once = PTHREAD_ONCE_INIT;
+
 /********************************* PRIVATE API ********************************/
 
 /*******************************************************************************
- * This is a worker function.  It converts (this % 1,000) to an ASCII string.
- * It is only called from big_number_to_dec_str().
+ * Free a thread's scratch arena.  Called when the thread exits.
  *
  * Input:
- *   this - A pointer to the big_number object that contains the number.
- *   zero_fill - 1 == Prepend zeroes if the number < 100.
- *
- * Output:
- *   Returns a pointer to this->str.
+ *   arg - The big_number_scratch object.
  ******************************************************************************/
-static const char *big_number_to_dec_str_worker(big_number *this, int zero_fill)
+static void big_number_scratch_free(void *arg)
 {
-	big_number *tmp1 = big_number_new();
-	big_number *tmp2 = big_number_new();
-
-	memset(this->str, 0, sizeof(this->str));
-
-	/* Convert 1,234,567,890 to 890. */
-	big_number_modulus(this, big_number_1000(), tmp1);
-
-	/* Convert the hundreds. */
-	big_number_divide(tmp1, big_number_100(), tmp2);
-	char c = 0;
-	while(big_number_is_zero(tmp2) == 0) {
-		c++;
-		big_number_decrement(tmp2);
-	}
-	if((c > 0) || (zero_fill == 1)) {
-		if(strlen(this->str) < sizeof(this->str)) {
-			this->str[strlen(this->str)] = (c + '0');
-		}
-	}
-	big_number_modulus(tmp1, big_number_100(), tmp1);
-
-	/* Convert the tens. */
-	big_number_divide(tmp1, big_number_10(), tmp2);
-	c = 0;
-	while(big_number_is_zero(tmp2) == 0) {
-		c++;
-		big_number_decrement(tmp2);
-	}
-	if((c > 0) || (zero_fill == 1) || (strlen(this->str) > 0)) {
-		if(strlen(this->str) < sizeof(this->str)) {
-			this->str[strlen(this->str)] = (c + '0');
+	big_number_scratch *arena = (big_number_scratch *) arg;
+	if(arena != (big_number_scratch *) 0) {
+		while(arena->size > 0) {
+			big_number_delete(arena->stack[--arena->size]);
 		}
+		free(arena->stack);
+		free(arena);
 	}
-	big_number_modulus(tmp1, big_number_10(), tmp2);
-
-	/* Convert the ones. */
-	c = 0;
-	while(big_number_is_zero(tmp2) == 0) {
-		c++;
-		big_number_decrement(tmp2);
-	}
-	if(strlen(this->str) < sizeof(this->str)) {
-		this->str[strlen(this->str)] = (c + '0');
-	}
-
-	big_number_delete(tmp2);
-	big_number_delete(tmp1);
+}
 
-	return this->str;
+/*******************************************************************************
+ * Create the key that frees the scratch arenas.  Called once.
+ ******************************************************************************/
+static void big_number_scratch_init(void)
+{
+	pthread_key_create(&big_number_scratch_key, big_number_scratch_free);
 }
 
 /********************************** CONSTANTS **********************************
- * As these functions initialize themselves, they can call constants functions
- * for numbers smaller than themselves.
+ * The constants are set at compile time.  They point to the read-only
+ * big_number_base constants, so there is nothing to create, nothing to race
+ * for, and no check on every call.  They must never be written.
  ******************************************************************************/
 
+#define BIG_NUMBER_CONST(value) \
+	static const big_number big_number_const_##value = { (big_number_base *) &big_number_base_const_##value, (char *) 0, 0 }
+
+BIG_NUMBER_CONST(0);
+BIG_NUMBER_CONST(1);
+BIG_NUMBER_CONST(2);
+BIG_NUMBER_CONST(10);
+BIG_NUMBER_CONST(100);
+BIG_NUMBER_CONST(256);
+BIG_NUMBER_CONST(1000);
+
 /*******************************************************************************
- * Singleton: Return a pointer to a big_number object that contains 0.
+ * Return a pointer to a big_number object that contains 0.
  *
  * Output:
- *   Success - Returns a pointer to the big_number object.
- *   Failure - Returns 0.
+ *   Returns a pointer to the big_number object.  It is read only.
  ******************************************************************************/
 const big_number *
 big_number_0(void)
 {
-	static big_number *this = (big_number *) 0;
-	if(this == (big_number *) 0) {
-		this = big_number_new();
-	}
-	return this;
+	return &big_number_const_0;
 }
 
 /*******************************************************************************
- * Singleton: Return a pointer to a big_number object that contains 1.
+ * Return a pointer to a big_number object that contains 1.
  *
  * Output:
- *   Success - Returns a pointer to the big_number object.
- *   Failure - Returns 0.
+ *   Returns a pointer to the big_number object.  It is read only.
  ******************************************************************************/
 const big_number *
 big_number_1(void)
 {
-	static big_number *this = (big_number *) 0;
-	if(this == (big_number *) 0) {
-		if((this = big_number_new()) != (big_number *) 0) {
-			if((this->num = big_number_base_new()) != (big_number_base *) 0) {
-				big_number_base_add(this->num, big_number_base_1(), this->num);
-			}
-
-			else {
-				big_number_delete(this);	
-				this = (big_number *) 0;
-			}
-		}
-	}
-	return this;
+	return &big_number_const_1;
 }
 
 /*******************************************************************************
- * Singleton: Return a pointer to a big_number object that contains 2.
+ * Return a pointer to a big_number object that contains 2.
  *
  * Output:
- *   Success - Returns a pointer to the big_number object.
- *   Failure - Returns 0.
+ *   Returns a pointer to the big_number object.  It is read only.
  ******************************************************************************/
 const big_number *
 big_number_2(void)
 {
-	static big_number *this = (big_number *) 0;
-	if(this == (big_number *) 0) {
-		if((this = big_number_new()) != (big_number *) 0) {
-			big_number_increment(this);
-			big_number_increment(this);
-		}
-	}
-	return this;
+	return &big_number_const_2;
 }
 
 /*******************************************************************************
- * Singleton: Return a pointer to a big_number object that contains 10.
+ * Return a pointer to a big_number object that contains 10.
  *
  * Output:
- *   Success - Returns a pointer to the big_number object.
- *   Failure - Returns 0.
+ *   Returns a pointer to the big_number object.  It is read only.
  ******************************************************************************/
 const big_number *
 big_number_10(void)
 {
-	static big_number *this = (big_number *) 0;
-	if(this == (big_number *) 0) {
-		if((this = big_number_new()) != (big_number *) 0) {
-			big_number_add(big_number_2(), big_number_2(), this);
-			big_number_add(this, this, this);
-			big_number_add(this, big_number_2(), this);
-		}
-	}
-	return this;
+	return &big_number_const_10;
 }
 
 /*******************************************************************************
- * Singleton: Return a pointer to a big_number object that contains 16.
+ * Return a pointer to a big_number object that contains 100.
  *
  * Output:
- *   Success - Returns a pointer to the big_number object.
- *   Failure - Returns 0.
- ******************************************************************************/
-const big_number *
-big_number_16(void)
-{
-	static big_number *this = (big_number *) 0;
-	if(this == (big_number *) 0) {
-		if((this = big_number_new()) != (big_number *) 0) {
-			big_number_multiply(big_number_2(), big_number_2(), this); //  4
-			big_number_exponent(this, big_number_2(), this);           // 16
-		}
-	}
-	return this;
-}
-
-/*******************************************************************************
- * Singleton: Return a pointer to a big_number object that contains 100.
- *
- * Output:
- *   Success - Returns a pointer to the big_number object.
- *   Failure - Returns 0.
+ *   Returns a pointer to the big_number object.  It is read only.
  ******************************************************************************/
 const big_number *
 big_number_100(void)
 {
-	static big_number *this = (big_number *) 0;
-	if(this == (big_number *) 0) {
-		if((this = big_number_new()) != (big_number *) 0) {
-			big_number_copy(big_number_10(), this);
-			big_number_multiply(this, big_number_10(), this);
-		}
-	}
-	return this;
+	return &big_number_const_100;
 }
 
 /*******************************************************************************
- * Singleton: Return a pointer to a big_number object that contains 256.
+ * Return a pointer to a big_number object that contains 256.
  *
  * Output:
- *   Success - Returns a pointer to the big_number object.
- *   Failure - Returns 0.
+ *   Returns a pointer to the big_number object.  It is read only.
  ******************************************************************************/
 const big_number *
 big_number_256(void)
 {
-	static big_number *this = (big_number *) 0;
-	if(this == (big_number *) 0) {
-		if((this = big_number_new()) != (big_number *) 0) {
-			big_number_multiply(big_number_16(), big_number_16(), this);
-		}
-	}
-	return this;
+	return &big_number_const_256;
 }
 
 /*******************************************************************************
- * Singleton: Return a pointer to a big_number object that contains 1,000.
+ * Return a pointer to a big_number object that contains 1,000.
  *
  * Output:
- *   Success - Returns a pointer to the big_number object.
- *   Failure - Returns 0.
+ *   Returns a pointer to the big_number object.  It is read only.
  ******************************************************************************/
 const big_number *
 big_number_1000(void)
 {
-	static big_number *this = (big_number *) 0;
-	if(this == (big_number *) 0) {
-		if((this = big_number_new()) != (big_number *) 0) {
-			big_number_copy(big_number_10(), this);
-			big_number_multiply(this, big_number_10(), this);
-			big_number_multiply(this, big_number_10(), this);
-		}
-	}
-	return this;
+	return &big_number_const_1000;
 }
 
 /********************************** PUBLIC API ********************************/
@@ -286,6 +237,8 @@ big_number *big_number_new(void)
 {
 	big_number *this = (big_number *) malloc(sizeof(*this));
 	if(this != (big_number *) 0) {
+		this->str = (char *) 0;
+		this->str_size = 0;
 		if((this->num = big_number_base_new()) == (big_number_base *) 0) {
 			big_number_delete(this);
 			this = (big_number *) 0;
@@ -305,6 +258,7 @@ void big_number_delete(big_number *this)
 {
 	if(this != (big_number *) 0) {
 		big_number_base_delete(this->num);
+		free(this->str);
 		free(this);
 	}
 }
@@ -336,6 +290,140 @@ void big_number_copy(const big_number *src, big_number *dst)
 	}
 }
 
+/*******************************************************************************
+ * Load a 64-bit value into a big_number object.
+ *
+ * Input:
+ *   this  - A pointer to the object.
+ *   value - The value.
+ ******************************************************************************/
+void big_number_from_u64(big_number *this, uint64_t value)
+{
+	if(this != (big_number *) 0) {
+		big_number_base_set_u64(this->num, value);
+	}
+}
+
+/*******************************************************************************
+ * Load a big-endian string of bytes into a big_number object.  This is the
+ * format that the numbers go over the wire in.
+ *
+ * Input:
+ *   this - A pointer to the object.
+ *   buf  - The bytes.  The most significant byte comes first.
+ *   len  - Number of bytes.
+ *
+ * Output:
+ *   Success - 0.  The value is positive.
+ *   Failure - 1.  The object is unchanged.
+ ******************************************************************************/
+int big_number_from_bytes(big_number *this, const uint8_t *buf, int len)
+{
+	int rc = 1;
+
+	if(this != (big_number *) 0) {
+		rc = big_number_base_from_bytes(this->num, buf, len);
+	}
+
+	return rc;
+}
+
+/*******************************************************************************
+ * Store the magnitude of a big_number object as a big-endian string of bytes,
+ * zero filled on the left out to len bytes.
+ *
+ * Input:
+ *   this - A pointer to the object.
+ *   buf  - Receives the bytes.
+ *   len  - Size of buf.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (the value doesn't fit in len bytes).
+ ******************************************************************************/
+int big_number_to_bytes(const big_number *this, uint8_t *buf, int len)
+{
+	int rc = 1;
+
+	if(this != (big_number *) 0) {
+		rc = big_number_base_to_bytes(this->num, buf, len);
+	}
+
+	return rc;
+}
+
+/********** Scratch Methods */
+
+/*******************************************************************************
+ * Get the current top of this thread's scratch arena.  Pass it to
+ * big_number_scratch_release() to give back everything that was handed out
+ * after this call.
+ *
+ * Output:
+ *   Returns the mark.
+ ******************************************************************************/
+int big_number_scratch_mark(void)
+{
+	return (big_number_scratch_arena != (big_number_scratch *) 0) ? big_number_scratch_arena->top : 0;
+}
+
+/*******************************************************************************
+ * Get a temporary big_number object from this thread's scratch arena.  It
+ * contains 0.  Don't delete it.  Give it back with big_number_scratch_release().
+ *
+ * Output:
+ *   Success - Returns a pointer to the big_number object.
+ *   Failure - Returns 0.
+ ******************************************************************************/
+big_number *big_number_scratch_get(void)
+{
+	big_number_scratch *arena = big_number_scratch_arena;
+	if(arena == (big_number_scratch *) 0) {
+		if((arena = (big_number_scratch *) calloc(1, sizeof(*arena))) == (big_number_scratch *) 0) {
+			return (big_number *) 0;
+		}
+		pthread_once(&big_number_scratch_once, big_number_scratch_init);
+		pthread_setspecific(big_number_scratch_key, arena);
+		big_number_scratch_arena = arena;
+	}
+
+	/* Make a new object if all of them are in use. */
+	if(arena->top == arena->size) {
+		if((arena->size % 16) == 0) {
+			big_number **stack = (big_number **) realloc(arena->stack, (arena->size + 16) * sizeof(*stack));
+			if(stack == (big_number **) 0) {
+				return (big_number *) 0;
+			}
+			arena->stack = stack;
+		}
+
+		big_number *this = big_number_new();
+		if(this == (big_number *) 0) {
+			return (big_number *) 0;
+		}
+		arena->stack[arena->size++] = this;
+	}
+
+	big_number *this = arena->stack[arena->top++];
+	big_number_base_set_u64(this->num, 0);
+	return this;
+}
+
+/*******************************************************************************
+ * Give back the temporary big_number objects that were handed out after a call
+ * to big_number_scratch_mark().
+ *
+ * Input:
+ *   mark - The value that big_number_scratch_mark() returned.
+ ******************************************************************************/
+void big_number_scratch_release(int mark)
+{
+	big_number_scratch *arena = big_number_scratch_arena;
+	if((arena != (big_number_scratch *) 0) && (mark >= 0) && (mark < arena->top)) {
+		arena->top = mark;
+	}
+}
+
 /********** Math Operations */
 
 /*******************************************************************************
@@ -368,6 +456,34 @@ void big_number_subtract(const big_number *minuend, const big_number *subtrahend
 	}
 }
 
+/*******************************************************************************
+ * Add a big_number object to another one, in place.  this += addend.
+ *
+ * Input:
+ *   this   - The object to add to.
+ *   addend - The value to add.
+ ******************************************************************************/
+void big_number_add_to(big_number *this, const big_number *addend)
+{
+	if((this != (big_number *) 0) && (addend != (big_number *) 0)) {
+		big_number_base_add_to(this->num, addend->num);
+	}
+}
+
+/*******************************************************************************
+ * Subtract a big_number object from another one, in place.  this -= subtrahend.
+ *
+ * Input:
+ *   this       - The object to subtract from.
+ *   subtrahend - The value to subtract.
+ ******************************************************************************/
+void big_number_sub_from(big_number *this, const big_number *subtrahend)
+{
+	if((this != (big_number *) 0) && (subtrahend != (big_number *) 0)) {
+		big_number_base_sub_from(this->num, subtrahend->num);
+	}
+}
+
 /*******************************************************************************
  * Multiply 2 big_number objects.
  *
@@ -379,7 +495,47 @@ void big_number_subtract(const big_number *minuend, const big_number *subtrahend
 void big_number_multiply(const big_number *factor1, const big_number *factor2, big_number *product)
 {
 	if((factor1 != (big_number *) 0) && (factor2 != (big_number *) 0) && (product != (big_number *) 0)) {
-		big_number_base_multiply(factor1->num, factor2->num, product->num);
+		/* (x * x) is a square.  That's about half the work. */
+		if(factor1 == factor2) {
+			big_number_base_square(factor1->num, product->num);
+		}
+		else {
+			big_number_base_multiply(factor1->num, factor2->num, product->num);
+		}
+	}
+}
+
+/*******************************************************************************
+ * Multiply 2 big_number objects, with a caller-supplied temporary.  When the
+ * product is one of the factors (x = x * y, or x = x * x), the result is built
+ * in scratch and swapped into product, instead of in a new allocation.  A
+ * scratch object from big_number_scratch_get() is a good choice.
+ *
+ * Input:
+ *   factor1 - One of the factors.
+ *   factor2 - One of the factors.
+ *   product - A pointer to the object that will receive the result.
+ *   scratch - Scratch space.  Its value is destroyed.
+ ******************************************************************************/
+void big_number_mul_into(const big_number *factor1, const big_number *factor2, big_number *product, big_number *scratch)
+{
+	if((factor1 != (big_number *) 0) && (factor2 != (big_number *) 0) && (product != (big_number *) 0)) {
+		big_number_base_mul_into(factor1->num, factor2->num, product->num,
+		                         (scratch != (big_number *) 0) ? scratch->num : (big_number_base *) 0);
+	}
+}
+
+/*******************************************************************************
+ * Square a big_number object.
+ *
+ * Input:
+ *   this   - The value to square.
+ *   result - A pointer to the object that will receive the result.
+ ******************************************************************************/
+void big_number_square(const big_number *this, big_number *result)
+{
+	if((this != (big_number *) 0) && (result != (big_number *) 0)) {
+		big_number_base_square(this->num, result->num);
 	}
 }
 
@@ -440,14 +596,43 @@ void big_number_modulus(const big_number *this, const big_number *modulus, big_n
 	}
 }
 
+/*******************************************************************************
+ * Calculate the remainder of a big_number object divided by a 64-bit value.
+ * The sign of the object is ignored.
+ *
+ * Input:
+ *   this    - The object to perform the modulus against.
+ *   modulus - The modulus.
+ *
+ * Output:
+ *   Returns (|this| % modulus).  Returns 0 if modulus is 0.
+ ******************************************************************************/
+uint64_t big_number_modulus_u64(const big_number *this, uint64_t modulus)
+{
+	uint64_t rc = 0;
+
+	if(this != (big_number *) 0) {
+		rc = big_number_base_modulus_u64(this->num, modulus);
+	}
+
+	return rc;
+}
+
 /*******************************************************************************
  * Perform an exponentiation operation.  The operation is done as follows:
  * result = base ^^ exp.
  *
+ * This is the sliding window method.  Precompute the odd powers of the base,
+ * (base ^ 1), (base ^ 3), ... (base ^ ((2 ^ window) - 1)).  Then walk the bits
+ * of the exponent from the top down.  Square the result for every bit, and
+ * multiply in one of the odd powers for each window of bits that ends in a 1.
+ * That's one multiply per window, instead of one multiply per set bit.
+ *
  * Input:
  *   base - The base of the exponentiation.
  *   exp  - The exponent.
- *   res  - A pointer to the big_number object that receives the result.
+ *   res  - A pointer to the big_number object that receives the result.  It is
+ *          left alone if the scratch space can't be allocated.
  ******************************************************************************/
 void big_number_exponent(const big_number *base, const big_number *exp, big_number *result)
 {
@@ -458,30 +643,465 @@ void big_number_exponent(const big_number *base, const big_number *exp, big_numb
 			return;
 		}
 
-		/* 1. Make local copies of the base and exponent.
-		 * 2. Start with res = 0.
-		 */
-		big_number *b1   = big_number_new();
-		big_number_copy(base, b1);
-		big_number *b   = big_number_new();
-		big_number_copy(base, b);
-		big_number *e   = big_number_new();
-		big_number_copy(exp,  e);
-		big_number_reset(result);
-
-		while(big_number_is_zero(e) == 0) {
-			if(big_number_modulus_is_zero(e, big_number_2()) == 0) {
-				big_number_add(result, b, result);
+		/* Make a local copy of the exponent, in case it is the same
+		 * object as result. */
+		int mark = big_number_scratch_mark();
+		big_number *e = big_number_scratch_get();
+		if(e == (big_number *) 0) {
+			big_number_scratch_release(mark);
+			return;
+		}
+		big_number_copy(exp, e);
+		int bits = big_number_base_bit_length(e->num);
+
+		/* Pick the window size.  Each bit of window doubles the size of
+		 * the table, so short exponents use small windows. */
+		int window = big_number_base_window_bits(bits);
+		int entries = 1 << (window - 1);
+
+		/* Build the table of odd powers.  table[i] = (base ^ ((2 * i) + 1)). */
+		big_number *table[32];
+		big_number *base_sq = big_number_scratch_get();
+		big_number *t = big_number_scratch_get();
+		int failed = (base_sq == (big_number *) 0) || (t == (big_number *) 0);
+		int i;
+		for(i = 0; i < entries; i++) {
+			table[i] = big_number_scratch_get();
+			failed |= (table[i] == (big_number *) 0);
+		}
+		if(failed) {
+			big_number_scratch_release(mark);
+			return;
+		}
+		big_number_copy(base, table[0]);
+		if(entries > 1) {
+			big_number_square(table[0], base_sq);
+		}
+		for(i = 1; i < entries; i++) {
+			big_number_multiply(table[i - 1], base_sq, table[i]);
+		}
+
+		/* The top bit is always set, so the first window loads result. */
+		int started = 0;
+		int bit = bits - 1;
+		while(bit >= 0) {
+			if(big_number_base_test_bit(e->num, bit) == 0) {
+				big_number_mul_into(result, result, result, t);
+				bit--;
+				continue;
+			}
+
+			/* Find the bottom of the window.  It must be a 1 bit. */
+			int low = (bit >= window) ? (bit - window + 1) : 0;
+			while(big_number_base_test_bit(e->num, low) == 0) {
+				low++;
+			}
+
+			int value = 0;
+			for(i = bit; i >= low; i--) {
+				value = (value << 1) | big_number_base_test_bit(e->num, i);
+			}
+
+			if(started == 0) {
+				big_number_copy(table[value >> 1], result);
+				started = 1;
+			}
+			else {
+				for(i = bit; i >= low; i--) {
+					big_number_mul_into(result, result, result, t);
+				}
+				big_number_mul_into(result, table[value >> 1], result, t);
+			}
+
+			bit = low - 1;
+		}
+
+		big_number_scratch_release(mark);
+	}
+}
+
+/********** Modular Exponentiation Methods */
+
+/*******************************************************************************
+ * Create a big_number_mont object.  All of the setup for the modulus is done
+ * here, so a caller that does a lot of exponentiations with the same modulus
+ * (e.g. an RSA key) only pays for it once.
+ *
+ * Input:
+ *   modulus - The modulus.  It must not be zero.
+ *
+ * Output:
+ *   Success - Returns a pointer to the big_number_mont object.
+ *   Failure - Returns 0.
+ ******************************************************************************/
+big_number_mont *big_number_mont_new(const big_number *modulus)
+{
+	big_number_mont *this = (big_number_mont *) 0;
+
+	if(modulus != (big_number *) 0) {
+		this = (big_number_mont *) malloc(sizeof(*this));
+		if(this != (big_number_mont *) 0) {
+			if((this->mont = big_number_base_mont_new(modulus->num)) == (big_number_base_mont *) 0) {
+				big_number_mont_delete(this);
+				this = (big_number_mont *) 0;
+			}
+		}
+	}
+
+	return this;
+}
+
+/*******************************************************************************
+ * Destroy a big_number_mont object that was created by big_number_mont_new().
+ *
+ * Input:
+ *   this - A pointer to the object.
+ ******************************************************************************/
+void big_number_mont_delete(big_number_mont *this)
+{
+	if(this != (big_number_mont *) 0) {
+		big_number_base_mont_delete(this->mont);
+		free(this);
+	}
+}
+
+/*******************************************************************************
+ * Perform a modular exponentiation with a prepared modulus.  The operation is
+ * done as follows: result = (base ^^ exp) % modulus.
+ *
+ * Input:
+ *   this   - The modulus, from big_number_mont_new().
+ *   base   - The base of the exponentiation.
+ *   exp    - The exponent.  It must not be negative.
+ *   result - A pointer to the big_number object that receives the result.
+ ******************************************************************************/
+void big_number_mont_exp(const big_number_mont *this, const big_number *base, const big_number *exp, big_number *result)
+{
+	if((this != (big_number_mont *) 0) && (base != (big_number *) 0) && (exp != (big_number *) 0) && (result != (big_number *) 0)) {
+		big_number_base_mont_exp(this->mont, base->num, exp->num, result->num);
+	}
+}
+
+/*******************************************************************************
+ * Create a big_number_mont_fixed object.  It precomputes the powers of a base,
+ * so that a caller that raises the same base to a lot of different exponents
+ * (e.g. a Diffie-Hellman generator) only pays for them once.
+ *
+ * Input:
+ *   mont     - The modulus, from big_number_mont_new().  It must not be
+ *              deleted before this object.
+ *   base     - The base.
+ *   exp_bits - The length of the exponents that will be used, in bits.  The
+ *              table is sized for them.  Longer exponents still work, but
+ *              they're slower.  0 means as long as the modulus.
+ *
+ * Output:
+ *   Success - Returns a pointer to the big_number_mont_fixed object.
+ *   Failure - Returns 0.
+ ******************************************************************************/
+big_number_mont_fixed *big_number_mont_fixed_new(const big_number_mont *mont, const big_number *base, int exp_bits)
+{
+	big_number_mont_fixed *this = (big_number_mont_fixed *) 0;
+
+	if((mont != (big_number_mont *) 0) && (base != (big_number *) 0)) {
+		this = (big_number_mont_fixed *) malloc(sizeof(*this));
+		if(this != (big_number_mont_fixed *) 0) {
+			if((this->fixed = big_number_base_mont_fixed_new(mont->mont, base->num, exp_bits)) == (big_number_base_mont_fixed *) 0) {
+				big_number_mont_fixed_delete(this);
+				this = (big_number_mont_fixed *) 0;
 			}
+		}
+	}
+
+	return this;
+}
+
+/*******************************************************************************
+ * Destroy a big_number_mont_fixed object that was created by
+ * big_number_mont_fixed_new().
+ *
+ * Input:
+ *   this - A pointer to the object.
+ ******************************************************************************/
+void big_number_mont_fixed_delete(big_number_mont_fixed *this)
+{
+	if(this != (big_number_mont_fixed *) 0) {
+		big_number_base_mont_fixed_delete(this->fixed);
+		free(this);
+	}
+}
+
+/*******************************************************************************
+ * Perform a modular exponentiation with a prepared base and modulus.  The
+ * operation is done as follows: result = (base ^^ exp) % modulus.
+ *
+ * Input:
+ *   this   - The base and modulus, from big_number_mont_fixed_new().
+ *   exp    - The exponent.  It must not be negative.
+ *   result - A pointer to the big_number object that receives the result.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (bad arguments, or out of memory).
+ ******************************************************************************/
+int big_number_mont_fixed_exp(const big_number_mont_fixed *this, const big_number *exp, big_number *result)
+{
+	if((this == (big_number_mont_fixed *) 0) || (exp == (big_number *) 0) || (result == (big_number *) 0)) {
+		return 1;
+	}
+
+	return big_number_base_mont_fixed_exp(this->fixed, exp->num, result->num);
+}
 
-			big_number_multiply(b, b1, b);
-			big_number_divide(e, big_number_2(), e);
+/*******************************************************************************
+ * Perform a modular exponentiation.  The operation is done as follows:
+ * result = (base ^^ exp) % modulus.
+ *
+ * Unlike big_number_exponent() followed by big_number_modulus(), the values
+ * never get bigger than the modulus.  Use big_number_mont_new() and
+ * big_number_mont_exp() instead if the same modulus is used more than once.
+ *
+ * Input:
+ *   base    - The base of the exponentiation.
+ *   exp     - The exponent.  It must not be negative.
+ *   modulus - The modulus.  It must not be zero.
+ *   result  - A pointer to the big_number object that receives the result.
+ ******************************************************************************/
+void big_number_mod_exp(const big_number *base, const big_number *exp, const big_number *modulus, big_number *result)
+{
+	big_number_mont *mont = big_number_mont_new(modulus);
+	if(mont != (big_number_mont *) 0) {
+		big_number_mont_exp(mont, base, exp, result);
+		big_number_mont_delete(mont);
+	}
+}
+
+/*******************************************************************************
+ * A big_number_mod_exp_batch() thread.  Do one share of the batch.
+ *
+ * Input:
+ *   arg - The big_number_batch object.  Its status is set to 0 if the whole
+ *         share worked, or 1 if any of it failed.
+ *
+ * Output:
+ *   Returns 0.
+ ******************************************************************************/
+static void *big_number_batch_thread(void *arg)
+{
+	big_number_batch *batch = (big_number_batch *) arg;
+
+	batch->status = 0;
+	int i;
+	for(i = batch->first; i < batch->last; i++) {
+		if(big_number_mont_fixed_exp(batch->fixed, batch->exps[i], batch->results[i]) != 0) {
+			batch->status = 1;
+		}
+	}
+
+	return (void *) 0;
+}
+
+/*******************************************************************************
+ * Perform a batch of modular exponentiations that share a base and a modulus.
+ * The operation is done as follows: results[i] = (base ^^ exps[i]) % modulus.
+ *
+ * This is for a Diffie-Hellman server that computes (g ^^ x) % p for a lot of
+ * private values x.  The modulus and the table of powers of the base are
+ * prepared once for the whole batch (see big_number_mont_fixed_new()), and the
+ * batch is split evenly over the threads.  The prepared objects are only read,
+ * so the threads don't share anything else.
+ *
+ * Input:
+ *   base     - The base of the exponentiation.
+ *   exps     - The exponents.  They must not be negative.
+ *   modulus  - The modulus.  It must not be zero.
+ *   results  - The big_number objects that receive the results.  results[i]
+ *              may be the same object as exps[i], but no others.
+ *   count    - Number of exponents.
+ *   nthreads - Number of threads to use.  1 does the whole batch in the
+ *              calling thread.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (out of memory, or the modulus is zero).  Every thread is
+ *             joined first, but some of the results may not have been set.
+ ******************************************************************************/
+int big_number_mod_exp_batch(const big_number *base, const big_number * const *exps, const big_number *modulus,
+                             big_number **results, int count, int nthreads)
+{
+	if((base == (big_number *) 0) || (exps == (const big_number * const *) 0) || (modulus == (big_number *) 0) ||
+	   (results == (big_number **) 0) || (count < 0) || (nthreads < 1)) {
+		return 1;
+	}
+
+	if(nthreads > count) {
+		nthreads = (count > 0) ? count : 1;
+	}
+
+	/* Size the table for the longest exponent. */
+	int exp_bits = 0;
+	int i;
+	for(i = 0; i < count; i++) {
+		int bits = big_number_bit_length(exps[i]);
+		if(exp_bits < bits) {
+			exp_bits = bits;
+		}
+	}
+
+	big_number_mont *mont = big_number_mont_new(modulus);
+	big_number_mont_fixed *fixed = big_number_mont_fixed_new(mont, base, exp_bits);
+	big_number_batch *batches = (big_number_batch *) malloc(nthreads * sizeof(*batches));
+	pthread_t *threads = (pthread_t *) malloc(nthreads * sizeof(*threads));
+
+	int rc = 1;
+	if((fixed != (big_number_mont_fixed *) 0) && (batches != (big_number_batch *) 0) && (threads != (pthread_t *) 0)) {
+		for(i = 0; i < nthreads; i++) {
+			batches[i].fixed = fixed;
+			batches[i].exps = exps;
+			batches[i].results = results;
+			batches[i].first = (int) (((int64_t) count * i) / nthreads);
+			batches[i].last = (int) (((int64_t) count * (i + 1)) / nthreads);
+			batches[i].status = 1;
+		}
+
+		/* The calling thread does the first share.  If a thread can't be
+		 * started, the calling thread does its share too. */
+		int *started = (int *) calloc(nthreads, sizeof(int));
+		if(started != (int *) 0) {
+			for(i = 1; i < nthreads; i++) {
+				started[i] = (pthread_create(&threads[i], NULL, big_number_batch_thread, &batches[i]) == 0);
+			}
+			for(i = 0; i < nthreads; i++) {
+				if(started[i] == 0) {
+					big_number_batch_thread(&batches[i]);
+				}
+			}
+			for(i = 1; i < nthreads; i++) {
+				if(started[i] != 0) {
+					pthread_join(threads[i], (void **) 0);
+				}
+			}
+			free(started);
+
+			rc = 0;
+			for(i = 0; i < nthreads; i++) {
+				rc |= batches[i].status;
+			}
+		}
+	}
+
+	free(threads);
+	free(batches);
+	big_number_mont_fixed_delete(fixed);
+	big_number_mont_delete(mont);
+	return rc;
+}
+
+/********** Barrett Reduction Methods */
+
+/*******************************************************************************
+ * Create a big_number_reducer object.  It is for code that reduces a lot of
+ * values by the same modulus, but doesn't keep them in Montgomery form (see
+ * big_number_mont_new()).
+ *
+ * Input:
+ *   modulus - The modulus.  It must not be zero.
+ *
+ * Output:
+ *   Success - Returns a pointer to the big_number_reducer object.
+ *   Failure - Returns 0.
+ ******************************************************************************/
+big_number_reducer *big_number_reducer_new(const big_number *modulus)
+{
+	big_number_reducer *this = (big_number_reducer *) 0;
+
+	if(modulus != (big_number *) 0) {
+		this = (big_number_reducer *) malloc(sizeof(*this));
+		if(this != (big_number_reducer *) 0) {
+			if((this->reducer = big_number_base_reducer_new(modulus->num)) == (big_number_base_reducer *) 0) {
+				big_number_reducer_delete(this);
+				this = (big_number_reducer *) 0;
+			}
 		}
+	}
+
+	return this;
+}
+
+/*******************************************************************************
+ * Destroy a big_number_reducer object that was created by
+ * big_number_reducer_new().
+ *
+ * Input:
+ *   this - A pointer to the object.
+ ******************************************************************************/
+void big_number_reducer_delete(big_number_reducer *this)
+{
+	if(this != (big_number_reducer *) 0) {
+		big_number_base_reducer_delete(this->reducer);
+		free(this);
+	}
+}
+
+/*******************************************************************************
+ * Reduce a value by a prepared modulus.  The operation is done as follows:
+ * result = x % modulus.  The result is the same as big_number_modulus(), but
+ * it's done with 2 multiplies instead of a division as long as x is less than
+ * the square of the modulus (e.g. the product of 2 reduced values).
+ *
+ * Input:
+ *   this   - The modulus, from big_number_reducer_new().
+ *   x      - The value to reduce.
+ *   result - A pointer to the big_number object that receives the result.
+ ******************************************************************************/
+void big_number_reduce(const big_number_reducer *this, const big_number *x, big_number *result)
+{
+	if((this != (big_number_reducer *) 0) && (x != (big_number *) 0) && (result != (big_number *) 0)) {
+		big_number_base_reduce(this->reducer, x->num, result->num);
+	}
+}
+
+/********** GCD Methods */
+
+/*******************************************************************************
+ * Calculate the greatest common divisor of 2 numbers.  The signs are ignored,
+ * and the result is never negative.
+ *
+ * Input:
+ *   a      - Value 1.
+ *   b      - Value 2.
+ *   result - A pointer to the big_number object that receives the result.
+ ******************************************************************************/
+void big_number_gcd(const big_number *a, const big_number *b, big_number *result)
+{
+	if((a != (big_number *) 0) && (b != (big_number *) 0) && (result != (big_number *) 0)) {
+		big_number_base_gcd(a->num, b->num, result->num);
+	}
+}
 
-		big_number_delete(e);
-		big_number_delete(b);
-		big_number_delete(b1);
+/*******************************************************************************
+ * Calculate a modular inverse.  Find result such that
+ * (this * result) % modulus = 1.
+ *
+ * Input:
+ *   this    - The value to invert.
+ *   modulus - The modulus.
+ *   result  - A pointer to the big_number object that receives the result.
+ *             It's in the range [0, modulus).
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (this and modulus aren't relatively prime).
+ ******************************************************************************/
+int big_number_mod_inverse(const big_number *this, const big_number *modulus, big_number *result)
+{
+	int rc = 1;
+
+	if((this != (big_number *) 0) && (modulus != (big_number *) 0) && (result != (big_number *) 0)) {
+		rc = big_number_base_mod_inverse(this->num, modulus->num, result->num);
 	}
+
+	return rc;
 }
 
 /********** Comparison Methods */
@@ -503,13 +1123,13 @@ int big_number_modulus_is_zero(const big_number *this, const big_number *modulus
 {
 	int rc = -1;
 	if((this != (big_number *) 0) && (modulus != (big_number *) 0)) {
-		big_number *tmp = big_number_new();
+		int mark = big_number_scratch_mark();
+		big_number *tmp = big_number_scratch_get();
 		if(tmp != 0) {
 			big_number_modulus(this, modulus, tmp);
 			rc = big_number_is_zero(tmp);
-
-			big_number_delete(tmp);
 		}
+		big_number_scratch_release(mark);
 	}
 
 	return rc;
@@ -583,11 +1203,86 @@ int big_number_is_negative(const big_number *this)
 	return retcode;
 }
 
+/********** Bit Methods */
+
+/*******************************************************************************
+ * Return the number of bits in the magnitude of a big_number object.
+ *
+ * Input:
+ *   this - The object to check.
+ *
+ * Output:
+ *   The position of the highest set bit + 1.  Returns 0 if the value is zero.
+ ******************************************************************************/
+int big_number_bit_length(const big_number *this)
+{
+	int rc = 0;
+
+	if(this != (big_number *) 0) {
+		rc = big_number_base_bit_length(this->num);
+	}
+
+	return rc;
+}
+
+/*******************************************************************************
+ * Check one bit in the magnitude of a big_number object.
+ *
+ * Input:
+ *   this - The object to check.
+ *   bit  - The bit number.  Bit 0 is the least significant bit.
+ *
+ * Output:
+ *   Returns 1 if the bit is set.
+ *   Returns 0 if the bit is clear.
+ ******************************************************************************/
+int big_number_test_bit(const big_number *this, int bit)
+{
+	int rc = 0;
+
+	if(this != (big_number *) 0) {
+		rc = big_number_base_test_bit(this->num, bit);
+	}
+
+	return rc;
+}
+
+/*******************************************************************************
+ * Shift a big_number object left.  result = this * (2 ^ bits).
+ *
+ * Input:
+ *   this   - The object to shift.
+ *   bits   - The number of bits to shift.
+ *   result - A pointer to the big_number object that receives the result.
+ ******************************************************************************/
+void big_number_shift_left(const big_number *this, int bits, big_number *result)
+{
+	if((this != (big_number *) 0) && (result != (big_number *) 0)) {
+		big_number_base_shift_left(this->num, bits, result->num);
+	}
+}
+
+/*******************************************************************************
+ * Shift a big_number object right.  result = this / (2 ^ bits), rounded toward
+ * zero.
+ *
+ * Input:
+ *   this   - The object to shift.
+ *   bits   - The number of bits to shift.
+ *   result - A pointer to the big_number object that receives the result.
+ ******************************************************************************/
+void big_number_shift_right(const big_number *this, int bits, big_number *result)
+{
+	if((this != (big_number *) 0) && (result != (big_number *) 0)) {
+		big_number_base_shift_right(this->num, bits, result->num);
+	}
+}
+
 /********** Diagnostic Methods */
 
 /*******************************************************************************
- * This function is used by test code.  It allows a test function to convert a
- * string ("123456") to a big_number.
+ * Convert a string to a big_number.  Decimal ("-123456") and hex ("0x1E240")
+ * are accepted, with an optional sign.
  *
  * Input:
  *   this - The object to store the value in.
@@ -595,67 +1290,68 @@ int big_number_is_negative(const big_number *this)
  *
  * Output:
  *   Success - 0.
- *   Failure - 1.
+ *   Failure - 1 (including an invalid string).
  ******************************************************************************/
 int big_number_from_str(big_number *this, const char *str)
 {
 	int rc = 1;
 	if((this != (big_number *) 0) && (str != (const char *) 0)) {
-		big_number *tmp = big_number_new();
-
-		if(tmp != (big_number *) 0) {
-			/* Walk through the string and convert to a big_number. */
-			big_number_reset(this);
-			while(*str) {
-				/* Build a big_number that equals the next digit. */
-				char c = *(str++) - 0x30;
-				big_number_reset(tmp);
-				while(c--) {
-					big_number_increment(tmp);
-				}
-
-				/* Multiply by 10, then add the digit. */
-				big_number_multiply(this, big_number_10(), this);
-				big_number_add(this, tmp, this);
-			}
-
-			big_number_delete(tmp);
-			rc = 0;
-		}
+		rc = big_number_base_from_str(this->num, str);
 	}
 
 	return rc;
 }
 
 /*******************************************************************************
- * Produce an ASCII decimal string from a big_number object.
+ * Produce an ASCII decimal string from a big_number object.  The digits are
+ * grouped by thousands ("-1,234,567").  The string belongs to the object, and
+ * is good until the next call or until the object is deleted.
  *
  * Input:
  *   this - The big_number object to convert.
  *
  * Output:
  *   Returns a pointer to the ASCII string.
- *   Returns 0 if an error occurs.
+ *   Returns 0 if an error occurs (out of memory).
  ******************************************************************************/
 const char *big_number_to_dec_str(big_number *this)
 {
 	const char *rc = (const char *) 0;
 	if(this != (big_number *) 0) {
-		/* Chop the number down by the thousands. */
-		if(big_number_compare(this, big_number_1000()) >= 0) {
-			big_number *tmp = big_number_new();
-			big_number_divide(this, big_number_1000(), tmp);
-			snprintf(this->str, sizeof(this->str), "%s,", big_number_to_dec_str(tmp));
-
-			big_number_modulus(this, big_number_1000(), tmp);
-			strncat(this->str, big_number_to_dec_str_worker(tmp, 1), (sizeof(this->str) - strlen(this->str)));
-			big_number_delete(tmp);
-		}
-		else {
-			strncpy(this->str, big_number_to_dec_str_worker(this, 0), sizeof(this->str));
+		/* Room for the sign, the digits, the commas, and the 0. */
+		int digits = ((big_number_bit_length(this) * 1234) / 4096) + 1;
+		int commas = (digits / 3) + 1;
+		int size = commas + digits + 2;
+		if(this->str_size < size) {
+			char *str = (char *) realloc(this->str, size);
+			if(str == (char *) 0) {
+				return rc;
+			}
+			this->str = str;
+			this->str_size = size;
 		}
 
-		rc = this->str;
+		/* Let the base class put the digits at the end of the buffer,
+		 * then slide them down and add the commas.  The commas never
+		 * catch up to the digits. */
+		if(big_number_base_to_dec_str(this->num, this->str + commas, size - commas) == 0) {
+			const char *src = this->str + commas;
+			char *dst = this->str;
+			if(*src == '-') {
+				*(dst++) = *(src++);
+			}
+
+			int len = strlen(src);
+			while(*src) {
+				*(dst++) = *(src++);
+				len--;
+				if((len > 0) && ((len % 3) == 0)) {
+					*(dst++) = ',';
+				}
+			}
+			*dst = 0;
+			rc = this->str;
+		}
 	}
 
 	return rc;
@@ -711,10 +1407,32 @@ int big_number_test(void)
 		if(test_obj2 == (big_number *) 0) { break; }
 
 		/* Test _from_str(). */
+		if(big_number_from_str(test_obj1, "-0x1E240") != 0) { break; }
+		if(strcmp(big_number_to_dec_str(test_obj1), "-123,456") != 0) { break; }
+		if(big_number_from_str(test_obj1, "12a") == 0) { break; }
+
+		/* Test _from_bytes() and _to_bytes().  Leading zero bytes are
+		 * fine going in, and the output is zero filled.  123,456 doesn't
+		 * fit in 2 bytes. */
+		{
+			const uint8_t in[] = { 0x00, 0x01, 0xE2, 0x40 };
+			uint8_t out[5];
+			if(big_number_from_bytes(test_obj1, in, sizeof(in)) != 0) { break; }
+			if(strcmp(big_number_to_dec_str(test_obj1), "123,456") != 0) { break; }
+			if(big_number_to_bytes(test_obj1, out, sizeof(out)) != 0) { break; }
+			if((out[0] != 0) || (memcmp(out + 1, in, sizeof(in)) != 0)) { break; }
+			if(big_number_to_bytes(test_obj1, out, 2) == 0) { break; }
+		}
+
 		if(big_number_from_str(test_obj1, "123") != 0) { break; }
 
 		/* Test _to_dec_str(). */
 		if(strcmp(big_number_to_dec_str(test_obj1), "123") != 0) { break; }
+		big_number_subtract(big_number_0(), big_number_1000(), test_obj2);
+		big_number_multiply(test_obj2, big_number_1000(), test_obj2);
+		if(strcmp(big_number_to_dec_str(test_obj2), "-1,000,000") != 0) { break; }
+		big_number_reset(test_obj2);
+		if(strcmp(big_number_to_dec_str(test_obj2), "0") != 0) { break; }
 
 		/* test _to_hex_str(). */
 		if(strcmp(big_number_to_hex_str(test_obj1, 0), "+7B") != 0) { break; }
@@ -726,6 +1444,7 @@ int big_number_test(void)
 		 * - _is_zero()
 		 * - _add()
 		 * - _multiply()
+		 * - _square()
 		 * - _exponent()
 		 * - _compare()
 		 */
@@ -774,6 +1493,132 @@ int big_number_test(void)
 		big_number_add(test_obj1, test_obj1, test_obj1);
 		if(big_number_compare(test_obj1, big_number_10()) != 0) { break; }
 
+		/* Test _exponent() and _square() a bit more.  (3 ^ 5) = 243, and
+		 * ((2 ^ 10) ^ 2) = 1,048,576. */
+		big_number_from_str(test_obj2, "3");
+		big_number_from_str(test_obj1, "5");
+		big_number_exponent(test_obj2, test_obj1, test_obj1);
+		if(strcmp(big_number_to_dec_str(test_obj1), "243") != 0) { break; }
+		big_number_from_str(test_obj1, "10");
+		big_number_exponent(big_number_2(), test_obj1, test_obj1);
+		big_number_square(test_obj1, test_obj2);
+		if(strcmp(big_number_to_dec_str(test_obj2), "1,048,576") != 0) { break; }
+		big_number_multiply(test_obj1, test_obj1, test_obj1);
+		if(big_number_compare(test_obj1, test_obj2) != 0) { break; }
+
+		/* Test _mod_exp().  (4 ^ 13) % 497 = 445 (odd modulus), and
+		 * (2 ^ 13) % 1000 = 192 (even modulus). */
+		big_number_from_str(test_obj1, "4");
+		big_number_from_str(test_obj2, "13");
+		big_number *mod = big_number_new();
+		big_number_from_str(mod, "497");
+		big_number_mod_exp(test_obj1, test_obj2, mod, test_obj1);
+		big_number_delete(mod);
+		if(strcmp(big_number_to_dec_str(test_obj1), "445") != 0) { break; }
+		big_number_mod_exp(big_number_2(), test_obj2, big_number_1000(), test_obj1);
+		if(strcmp(big_number_to_dec_str(test_obj1), "192") != 0) { break; }
+
+		/* Test _mont_new() and _mont_exp().  Reuse one modulus, and check
+		 * against _exponent() and _modulus(). */
+		big_number_from_str(test_obj2, "1000003");
+		big_number_mont *mont = big_number_mont_new(test_obj2);
+		if(mont == (big_number_mont *) 0) { break; }
+		big_number *base = big_number_new();
+		big_number *exp = big_number_new();
+		big_number_add(big_number_1000(), big_number_256(), base);   // 1,256
+		big_number_copy(big_number_1(), exp);
+		for(i = 1; i <= 5; i++) {
+			big_number_exponent(base, exp, test_obj1);
+			big_number_modulus(test_obj1, test_obj2, test_obj1);
+			big_number_mont_exp(mont, base, exp, base);
+			if(big_number_compare(base, test_obj1) != 0) { break; }
+			big_number_add(big_number_1000(), big_number_256(), base);
+			big_number_increment(exp);
+		}
+		big_number_delete(exp);
+		big_number_delete(base);
+		if(i <= 5) {
+			big_number_mont_delete(mont);
+			break;
+		}
+
+		/* Test _mont_fixed_new() and _mont_fixed_exp().  (2 ^ 100) and
+		 * (2 ^ 1000) % 1,000,003. */
+		big_number_mont_fixed *fixed = big_number_mont_fixed_new(mont, big_number_2(), 0);
+		big_number_mont_fixed_exp(fixed, big_number_100(), test_obj1);
+		big_number_mod_exp(big_number_2(), big_number_100(), test_obj2, test_obj2);
+		i = big_number_compare(test_obj1, test_obj2);
+		big_number_mont_fixed_exp(fixed, big_number_1000(), test_obj1);
+		big_number_mont_fixed_delete(fixed);
+		big_number_mont_delete(mont);
+		if((i != 0) || (strcmp(big_number_to_dec_str(test_obj1), "510,646") != 0)) { break; }
+
+		/* Test _mod_exp_batch().  Raise 2 to 0 ... 24 mod 1,000,003 with
+		 * 4 threads, in place, and check against _mod_exp(). */
+		{
+			big_number *exps[25];
+			for(i = 0; i < 25; i++) {
+				exps[i] = big_number_new();
+				big_number_from_u64(exps[i], (uint64_t) (i * i * i * 977));
+			}
+			big_number_from_str(test_obj2, "1000003");
+			int failed = big_number_mod_exp_batch(big_number_2(), (const big_number * const *) exps, test_obj2,
+			                                      exps, 25, 4);
+			failed |= (big_number_mod_exp_batch(big_number_2(), (const big_number * const *) exps,
+			                                    big_number_0(), exps, 25, 4) != 1);
+			for(i = 0; i < 25; i++) {
+				big_number_from_u64(test_obj1, (uint64_t) (i * i * i * 977));
+				big_number_mod_exp(big_number_2(), test_obj1, test_obj2, test_obj1);
+				failed |= (big_number_compare(test_obj1, exps[i]) != 0);
+				big_number_delete(exps[i]);
+			}
+
+			/* A share that fails (here, with a negative exponent) fails
+			 * the whole batch, even though the other share worked. */
+			exps[0] = big_number_new();
+			exps[1] = big_number_new();
+			big_number_from_u64(exps[0], 7);
+			big_number_subtract(big_number_0(), big_number_1(), exps[1]);
+			failed |= (big_number_mod_exp_batch(big_number_2(), (const big_number * const *) exps, test_obj2,
+			                                    exps, 2, 2) != 1);
+			big_number_delete(exps[1]);
+			big_number_delete(exps[0]);
+			if(failed != 0) { break; }
+		}
+
+		/* Test _reducer_new() and _reduce().  (1,256 ^ 2) % 1,000,003 =
+		 * 577,533.  Then a value with no reduction to do. */
+		big_number_from_str(test_obj2, "1000003");
+		big_number_reducer *reducer = big_number_reducer_new(test_obj2);
+		if(reducer == (big_number_reducer *) 0) { break; }
+		big_number_add(big_number_1000(), big_number_256(), test_obj1);
+		big_number_square(test_obj1, test_obj1);
+		big_number_reduce(reducer, test_obj1, test_obj1);
+		i = strcmp(big_number_to_dec_str(test_obj1), "577,533");
+		big_number_reduce(reducer, big_number_1000(), test_obj1);
+		big_number_reducer_delete(reducer);
+		if((i != 0) || (big_number_compare(test_obj1, big_number_1000()) != 0)) { break; }
+
+		/* Test _gcd() and _mod_inverse().  gcd(1,071, 462) = 21.  The
+		 * inverse of 17 mod 3,120 is 2,753 (even modulus), and the inverse
+		 * of -3 mod 7 is 2 (odd modulus).  6 has no inverse mod 9. */
+		big_number_from_str(test_obj1, "1071");
+		big_number_from_str(test_obj2, "462");
+		big_number_gcd(test_obj1, test_obj2, test_obj1);
+		if(strcmp(big_number_to_dec_str(test_obj1), "21") != 0) { break; }
+		big_number_from_str(test_obj1, "17");
+		big_number_from_str(test_obj2, "3120");
+		if(big_number_mod_inverse(test_obj1, test_obj2, test_obj1) != 0) { break; }
+		if(strcmp(big_number_to_dec_str(test_obj1), "2,753") != 0) { break; }
+		big_number_from_str(test_obj1, "3");
+		big_number_subtract(big_number_0(), test_obj1, test_obj1);
+		big_number_from_str(test_obj2, "7");
+		if(big_number_mod_inverse(test_obj1, test_obj2, test_obj1) != 0) { break; }
+		if(big_number_compare(test_obj1, big_number_2()) != 0) { break; }
+		big_number_from_str(test_obj1, "6");
+		big_number_from_str(test_obj2, "9");
+		if(big_number_mod_inverse(test_obj1, test_obj2, test_obj1) != 1) { break; }
+
 		/* Test _modulus_is_zero(). */
 		if(big_number_modulus_is_zero(big_number_256(), big_number_10()) != 0) { break; }
 		if(big_number_modulus_is_zero(big_number_256(), big_number_2()) != 1) { break; }
@@ -790,6 +1635,31 @@ int big_number_test(void)
 		big_number_modulus(test_obj1, big_number_2(), test_obj2);
 		if(big_number_is_zero(test_obj2) != 1) { break; }
 
+		/* Test the scratch arena.  Temporaries come back zeroed, and in
+		 * stack order. */
+		int mark = big_number_scratch_mark();
+		big_number *tmp1 = big_number_scratch_get();
+		big_number_copy(big_number_1000(), tmp1);
+		big_number *tmp2 = big_number_scratch_get();
+		big_number_scratch_release(mark + 1);
+		i = (big_number_scratch_get() == tmp2);
+		big_number_scratch_release(mark);
+		if((i == 0) || (big_number_scratch_get() != tmp1) || (big_number_is_zero(tmp1) != 1)) { break; }
+		big_number_scratch_release(mark);
+		if(big_number_scratch_mark() != mark) { break; }
+
+		/* Test a string that's longer than the old 8,192 byte buffer.
+		 * 10 ^ 7,000 is 7,001 digits and 2,333 commas.  The simulated
+		 * big_number library can't hold it. */
+		big_number_reset(test_obj1);
+		big_number_shift_left(big_number_1(), 64, test_obj1);
+		if(big_number_is_zero(test_obj1) == 0) {
+			big_number_from_u64(test_obj2, 7000);
+			big_number_exponent(big_number_10(), test_obj2, test_obj1);
+			const char *str = big_number_to_dec_str(test_obj1);
+			if((str == (const char *) 0) || (strlen(str) != 9334) || (strncmp(str, "10,000,", 7) != 0)) { break; }
+		}
+
 		/* Complete.  Pass. */
 		rc = 0;
 
@@ -6,10 +6,21 @@
  *
  ******************************************************************************/
 
+#include <stdint.h>
+
 /******************************* CLASS DEFINITION *****************************/
 
 typedef struct big_number big_number;
 
+/* A modulus that has been prepared for modular exponentiation. */
+typedef struct big_number_mont big_number_mont;
+
+/* A base and modulus that have been prepared for fixed-base exponentiation. */
+typedef struct big_number_mont_fixed big_number_mont_fixed;
+
+/* A modulus that has been prepared for Barrett reduction. */
+typedef struct big_number_reducer big_number_reducer;
+
 /********************************** CONSTANTS *********************************/
 
 const big_number *big_number_0(void);
@@ -38,14 +49,36 @@ void big_number_reset(big_number *this);
 
 void big_number_copy(const big_number *src, big_number *dst);
 
+void big_number_from_u64(big_number *this, uint64_t value);
+
+int big_number_from_bytes(big_number *this, const uint8_t *buf, int len);
+
+int big_number_to_bytes(const big_number *this, uint8_t *buf, int len);
+
+/********** Scratch Methods */
+
+int big_number_scratch_mark(void);
+
+big_number *big_number_scratch_get(void);
+
+void big_number_scratch_release(int mark);
+
 /********** Math Operations */
 
 void big_number_add(const big_number *addend1, const big_number *addend2, big_number *sum);
 
 void big_number_subtract(const big_number *minuend, const big_number *subtrahend, big_number *difference);
 
+void big_number_add_to(big_number *this, const big_number *addend);
+
+void big_number_sub_from(big_number *this, const big_number *subtrahend);
+
 void big_number_multiply(const big_number *factor1, const big_number *factor2, big_number *product);
 
+void big_number_mul_into(const big_number *factor1, const big_number *factor2, big_number *product, big_number *scratch);
+
+void big_number_square(const big_number *this, big_number *result);
+
 void big_number_divide(const big_number *dividend, const big_number *divisor, big_number *quotient);
 
 void big_number_increment(big_number *this);
@@ -54,8 +87,43 @@ void big_number_decrement(big_number *this);
 
 void big_number_modulus(const big_number *this, const big_number *modulus, big_number *result);
 
+uint64_t big_number_modulus_u64(const big_number *this, uint64_t modulus);
+
 void big_number_exponent(const big_number *base, const big_number *exp, big_number *result);
 
+/********** Modular Exponentiation Methods */
+
+big_number_mont *big_number_mont_new(const big_number *modulus);
+
+void big_number_mont_delete(big_number_mont *this);
+
+void big_number_mont_exp(const big_number_mont *this, const big_number *base, const big_number *exp, big_number *result);
+
+big_number_mont_fixed *big_number_mont_fixed_new(const big_number_mont *mont, const big_number *base, int exp_bits);
+
+void big_number_mont_fixed_delete(big_number_mont_fixed *this);
+
+int big_number_mont_fixed_exp(const big_number_mont_fixed *this, const big_number *exp, big_number *result);
+
+void big_number_mod_exp(const big_number *base, const big_number *exp, const big_number *modulus, big_number *result);
+
+int big_number_mod_exp_batch(const big_number *base, const big_number * const *exps, const big_number *modulus,
+                             big_number **results, int count, int nthreads);
+
+/********** Barrett Reduction Methods */
+
+big_number_reducer *big_number_reducer_new(const big_number *modulus);
+
+void big_number_reducer_delete(big_number_reducer *this);
+
+void big_number_reduce(const big_number_reducer *this, const big_number *x, big_number *result);
+
+/********** GCD Methods */
+
+void big_number_gcd(const big_number *a, const big_number *b, big_number *result);
+
+int big_number_mod_inverse(const big_number *this, const big_number *modulus, big_number *result);
+
 /********** Comparison Methods */
 
 int big_number_modulus_is_zero(const big_number *this, const big_number *modulus);
@@ -66,6 +134,16 @@ int big_number_is_zero(const big_number *this);
 
 int big_number_is_negative(const big_number *this);
 
+/********** Bit Methods */
+
+int big_number_bit_length(const big_number *this);
+
+int big_number_test_bit(const big_number *this, int bit);
+
+void big_number_shift_left(const big_number *this, int bits, big_number *result);
+
+void big_number_shift_right(const big_number *this, int bits, big_number *result);
+
 /********** Diagnostic Methods */
 
 int big_number_from_str(big_number *this, const char *str);
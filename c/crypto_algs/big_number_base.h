@@ -11,12 +11,33 @@
  *
  ******************************************************************************/
 
+#include <stdint.h>
+
 /******************************* CLASS DEFINITION *****************************/
 
 typedef struct big_number_base big_number_base;
 
+/* A modulus that has been prepared for modular exponentiation. */
+typedef struct big_number_base_mont big_number_base_mont;
+
+/* A base and modulus that have been prepared for fixed-base exponentiation. */
+typedef struct big_number_base_mont_fixed big_number_base_mont_fixed;
+
+/* A modulus that has been prepared for Barrett reduction. */
+typedef struct big_number_base_reducer big_number_base_reducer;
+
 /********************************** CONSTANTS *********************************/
 
+/* The small constants.  They're set at compile time, and they must never be
+ * written.  big_number.c builds its own constants on top of them. */
+extern const big_number_base big_number_base_const_0;
+extern const big_number_base big_number_base_const_1;
+extern const big_number_base big_number_base_const_2;
+extern const big_number_base big_number_base_const_10;
+extern const big_number_base big_number_base_const_100;
+extern const big_number_base big_number_base_const_256;
+extern const big_number_base big_number_base_const_1000;
+
 const big_number_base *big_number_base_1(void);
 
 /********************************** PUBLIC API ********************************/
@@ -29,28 +50,90 @@ void big_number_base_delete(big_number_base *this);
 
 void big_number_base_copy(const big_number_base *src, big_number_base *dst);
 
+void big_number_base_set_u64(big_number_base *this, uint64_t value);
+
+int big_number_base_from_bytes(big_number_base *this, const uint8_t *buf, int len);
+
+int big_number_base_to_bytes(const big_number_base *this, uint8_t *buf, int len);
+
 /********** Math Operations */
 
 void big_number_base_add(const big_number_base *addend1, const big_number_base *addend2, big_number_base *sum);
 
 void big_number_base_subtract(const big_number_base *minuend, const big_number_base *subtrahend, big_number_base *difference);
 
+void big_number_base_add_to(big_number_base *this, const big_number_base *addend);
+
+void big_number_base_sub_from(big_number_base *this, const big_number_base *subtrahend);
+
 void big_number_base_multiply(const big_number_base *factor1, const big_number_base *factor2, big_number_base *product);
 
+void big_number_base_mul_into(const big_number_base *factor1, const big_number_base *factor2,
+                              big_number_base *product, big_number_base *scratch);
+
+void big_number_base_square(const big_number_base *this, big_number_base *result);
+
 void big_number_base_divide(const big_number_base *dividend, const big_number_base *divisor, big_number_base *quotient);
 
 void big_number_base_modulus(const big_number_base *this, const big_number_base *modulus, big_number_base *result);
 
+uint64_t big_number_base_modulus_u64(const big_number_base *this, uint64_t modulus);
+
+/********** Modular Exponentiation Methods */
+
+int big_number_base_window_bits(int bits);
+
+big_number_base_mont *big_number_base_mont_new(const big_number_base *modulus);
+
+void big_number_base_mont_delete(big_number_base_mont *this);
+
+void big_number_base_mont_exp(const big_number_base_mont *this, const big_number_base *base, const big_number_base *exp, big_number_base *result);
+
+big_number_base_mont_fixed *big_number_base_mont_fixed_new(const big_number_base_mont *mont, const big_number_base *base,
+                                                           int exp_bits);
+
+void big_number_base_mont_fixed_delete(big_number_base_mont_fixed *this);
+
+int big_number_base_mont_fixed_exp(const big_number_base_mont_fixed *this, const big_number_base *exp, big_number_base *result);
+
+/********** Barrett Reduction Methods */
+
+big_number_base_reducer *big_number_base_reducer_new(const big_number_base *modulus);
+
+void big_number_base_reducer_delete(big_number_base_reducer *this);
+
+void big_number_base_reduce(const big_number_base_reducer *this, const big_number_base *x, big_number_base *result);
+
+/********** GCD Methods */
+
+void big_number_base_gcd(const big_number_base *a, const big_number_base *b, big_number_base *result);
+
+int big_number_base_mod_inverse(const big_number_base *this, const big_number_base *modulus, big_number_base *result);
+
 /********** Comparison Methods */
 
 int big_number_base_compare(const big_number_base *a, const big_number_base *b);
 
 int big_number_base_is_negative(const big_number_base *this);
 
+/********** Bit Methods */
+
+void big_number_base_shift_left(const big_number_base *this, int bits, big_number_base *result);
+
+void big_number_base_shift_right(const big_number_base *this, int bits, big_number_base *result);
+
+int big_number_base_bit_length(const big_number_base *this);
+
+int big_number_base_test_bit(const big_number_base *this, int bit);
+
 /********** Diagnostic Methods */
 
 const char *big_number_base_to_hex_str(const big_number_base *this, int zero_fill);
 
+int big_number_base_to_dec_str(const big_number_base *this, char *str, int size);
+
+int big_number_base_from_str(big_number_base *this, const char *str);
+
 /********** Test Methods */
 
 int big_number_base_test(void);
@@ -2,8 +2,13 @@
  *
  * This module provides the primitives required by the big_number class.
  *
+ * The magnitude of a number is stored as a variable length array of 64-bit
+ * limbs (see big_number_limb.h).  The array grows as needed, so the size of a
+ * number is only limited by memory.  The sign is stored separately.
+ *
  ******************************************************************************/
 
+#include <ctype.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,6 +16,7 @@
 #include <unistd.h>
 
 #include "big_number_base.h"
+#include "big_number_limb.h"
 
 /*******************************************************************************
  ******************************* CLASS DEFINITION ******************************
@@ -19,7 +25,66 @@
 /* This is the big_number_base class. */
 struct big_number_base {
 	int negative;
-	uint8_t num[8];
+
+	/* Number of limbs in use.  There are never any leading zero limbs, so
+	 * zero has a size of 0. */
+	int size;
+
+	/* Number of limbs allocated in num[]. */
+	int capacity;
+
+	/* The magnitude.  Least significant limb first. */
+	limb_t *num;
+};
+
+/* This is the big_number_base_mont class.  It holds everything about a
+ * modulus that can be calculated once and reused for every exponentiation. */
+struct big_number_base_mont {
+	/* The modulus.  Always positive. */
+	big_number_base *modulus;
+
+	/* Montgomery form only works with an odd modulus.  An even modulus
+	 * falls back to multiply and divide. */
+	int odd;
+
+	/* -(1 / N) mod 2^64.  Only valid if odd == 1. */
+	limb_t ninv;
+
+	/* (R^2 % N), where R = 2^(64 * modulus->size).  Zero filled out to
+	 * modulus->size limbs.  Only valid if odd == 1. */
+	limb_t *r2;
+};
+
+/* This is the big_number_base_mont_fixed class.  It holds the powers of one
+ * base, so that they can be reused for every exponentiation of that base. */
+struct big_number_base_mont_fixed {
+	const big_number_base_mont *mont;
+
+	/* The base, reduced into the range [0, modulus). */
+	big_number_base *base;
+
+	/* The window size, and the odd powers of the base in Montgomery form.
+	 * The table is only used if the modulus is odd. */
+	int window;
+	limb_t *table;
+
+	/* The comb table, for exponents up to (teeth * spacing) bits long.
+	 * Entry i is the product of (base ^ (2 ^ (j * spacing))) for every bit
+	 * j that is set in i, in Montgomery form.  Only used if the modulus is
+	 * odd. */
+	int teeth;
+	int spacing;
+	limb_t *comb;
+};
+
+/* This is the big_number_base_reducer class.  It holds a modulus and its
+ * Barrett constant. */
+struct big_number_base_reducer {
+	/* The modulus.  Always positive. */
+	big_number_base *modulus;
+
+	/* (B^(2k) / modulus), where B = 2^64 and k = modulus->size. */
+	big_number_base *mu;
 };
 
 /********************************** CONSTANTS **********************************
@@ -27,46 +92,261 @@ struct big_number_base {
  * so making them public is a small risk.
  ******************************************************************************/
 
+/* The values of the constants.  They're set at compile time and never written,
+ * so they sit in read-only storage and any number of threads can use them. */
+static const limb_t big_number_base_const_limbs[] = { 0, 1, 2, 10, 100, 256, 1000 };
+
+#define BIG_NUMBER_BASE_CONST(value, index)                                  \
+	const big_number_base big_number_base_const_##value = {                  \
+		0, ((value) != 0), 1, (limb_t *) &big_number_base_const_limbs[index] \
+	}
+
+BIG_NUMBER_BASE_CONST(0, 0);
+BIG_NUMBER_BASE_CONST(1, 1);
+BIG_NUMBER_BASE_CONST(2, 2);
+BIG_NUMBER_BASE_CONST(10, 3);
+BIG_NUMBER_BASE_CONST(100, 4);
+BIG_NUMBER_BASE_CONST(256, 5);
+BIG_NUMBER_BASE_CONST(1000, 6);
+
+#ifdef TEST
 /*******************************************************************************
- * Singleton: Return a pointer to a big_number_base object that contains 1.
+ * Return a pointer to a big_number_base object that contains 0.
  *
  * Output:
- *   Success - Returns a pointer to the big_number object.  The object is
- *   treated as a read only object.
- *   Failure - Returns 0.
+ *   Returns a pointer to the big_number object.  It is read only.
  ******************************************************************************/
 static const big_number_base *big_number_base_0(void)
 {
-	static big_number_base *this = (big_number_base *) 0;
-	if(this == (big_number_base *) 0) {
-		this = big_number_base_new();
-	}
-	return this;
+	return &big_number_base_const_0;
 }
+#endif /* TEST */
 
 /*******************************************************************************
- * Singleton: Return a pointer to a big_number_base object that contains 1.
+ * Return a pointer to a big_number_base object that contains 1.
  *
  * Output:
- *   Success - Returns a pointer to the big_number object.  The object is
- *   treated as a read only object.
- *   Failure - Returns 0.
+ *   Returns a pointer to the big_number object.  It is read only.
  ******************************************************************************/
 const big_number_base *big_number_base_1(void)
 {
-	static big_number_base *this = (big_number_base *) 0;
-	if(this == (big_number_base *) 0) {
-		if((this = big_number_base_new()) != (big_number_base *) 0) {
-			this->num[0] = 1;
+	return &big_number_base_const_1;
+}
+
+/********************************* PRIVATE API ********************************/
+
+/* Number of limbs that big_number_base_new() allocates up front.  Enough for
+ * most of the small numbers that the tests use. */
+#define BIG_NUMBER_BASE_INITIAL_LIMBS (4)
+
+/* Decimal conversion is done 19 digits (one limb) at a time.  Values up to
+ * DEC_BASECASE_LIMBS long are converted by dividing by 10^19 over and over. */
+#define DEC_CHUNK (10000000000000000000ULL)
+#define DEC_CHUNK_DIGITS (19)
+#define DEC_BASECASE_LIMBS (20)
+
+/*******************************************************************************
+ * Make sure a big_number_base object has room for at least "limbs" limbs.  The
+ * current value is preserved.
+ *
+ * Input:
+ *   this  - The object to grow.
+ *   limbs - The number of limbs required.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (out of memory).  The object is unchanged.
+ ******************************************************************************/
+static int big_number_base_grow(big_number_base *this, int limbs)
+{
+	if(this->capacity < limbs) {
+		/* Grow geometrically so that a number that creeps up one limb
+		 * at a time doesn't realloc() every time. */
+		int capacity = this->capacity * 2;
+		if(capacity < limbs) {
+			capacity = limbs;
+		}
+
+		limb_t *num = (limb_t *) realloc(this->num, capacity * sizeof(limb_t));
+		if(num == (limb_t *) 0) {
+			return 1;
 		}
+
+		this->num = num;
+		this->capacity = capacity;
 	}
-	return this;
+
+	return 0;
 }
 
-/********************************* PRIVATE API ********************************/
+/*******************************************************************************
+ * Strip the leading zero limbs from a big_number_base object.  Zero is always
+ * stored as a positive number.
+ *
+ * Input:
+ *   this - The object to normalize.
+ ******************************************************************************/
+static void big_number_base_normalize(big_number_base *this)
+{
+	this->size = big_number_limb_normalized_size(this->num, this->size);
+	if(this->size == 0) {
+		this->negative = 0;
+	}
+}
+
+/*******************************************************************************
+ * Add or subtract the magnitudes of 2 big_number_base objects, and give the
+ * result the correct sign.  This is the worker for both add() and subtract().
+ *
+ * Input:
+ *   a     - Value 1.
+ *   a_neg - 1 == Treat a as negative.
+ *   b     - Value 2.
+ *   b_neg - 1 == Treat b as negative.
+ *   r     - The object that receives (a + b).  It may be the same object as
+ *           a and/or b.
+ ******************************************************************************/
+static void big_number_base_add_signed(const big_number_base *a, int a_neg,
+                                       const big_number_base *b, int b_neg,
+                                       big_number_base *r)
+{
+	/* Arrange them so that |a| >= |b|. */
+	int cmp = big_number_limb_cmp(a->num, a->size, b->num, b->size);
+	if(cmp < 0) {
+		const big_number_base *t = a; a = b; b = t;
+		int t_neg = a_neg; a_neg = b_neg; b_neg = t_neg;
+	}
+
+	int an = a->size;
+	int bn = b->size;
+
+	if(big_number_base_grow(r, an + 1) != 0) {
+		return;
+	}
+
+	/* Same signs.  Add the magnitudes and keep the sign. */
+	if(a_neg == b_neg) {
+		r->num[an] = big_number_limb_add(r->num, a->num, an, b->num, bn);
+		r->size = an + 1;
+	}
+
+	/* Different signs.  Subtract the smaller magnitude from the larger one.
+	 * The result takes the sign of the larger one. */
+	else {
+		big_number_limb_sub(r->num, a->num, an, b->num, bn);
+		r->size = an;
+	}
+
+	r->negative = a_neg;
+	big_number_base_normalize(r);
+}
+
+/*******************************************************************************
+ * Multiply 2 limb arrays of any length.  r = a * b.  This just puts the longer
+ * one first, the way big_number_limb_mul() wants it.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (out of memory).
+ ******************************************************************************/
+static int big_number_base_limb_mul(limb_t *r, const limb_t *a, int an, const limb_t *b, int bn)
+{
+	if((an == 0) || (bn == 0)) {
+		memset(r, 0, (an + bn) * sizeof(limb_t));
+		return 0;
+	}
+
+	return (an >= bn) ? big_number_limb_mul(r, a, an, b, bn) : big_number_limb_mul(r, b, bn, a, an);
+}
+
+/*******************************************************************************
+ * Swap the values (and the limb arrays) of 2 big_number_base objects.  It's
+ * how a result that was built in a temporary object gets handed over without
+ * copying it.
+ *
+ * Input:
+ *   a, b - The objects.
+ ******************************************************************************/
+static void big_number_base_swap(big_number_base *a, big_number_base *b)
+{
+	big_number_base t = *a;
+	*a = *b;
+	*b = t;
+}
+
+/*******************************************************************************
+ * Multiply 2 big_number_base objects, straight into the product.
+ *
+ * Input:
+ *   factor1 - One of the factors.
+ *   factor2 - One of the factors.
+ *   product - Receives the result.  It must not be the same object as
+ *             factor1 or factor2.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (out of memory).
+ ******************************************************************************/
+static int big_number_base_mul_to(const big_number_base *factor1, const big_number_base *factor2, big_number_base *product)
+{
+	int an = factor1->size;
+	int bn = factor2->size;
+
+	/* Anything times zero is zero. */
+	if((an == 0) || (bn == 0)) {
+		product->size = 0;
+		product->negative = 0;
+		return 0;
+	}
+
+	if((big_number_base_grow(product, an + bn) != 0) ||
+	   (big_number_base_limb_mul(product->num, factor1->num, an, factor2->num, bn) != 0)) {
+		return 1;
+	}
+
+	product->size = an + bn;
+	product->negative = factor1->negative ^ factor2->negative;
+	big_number_base_normalize(product);
+	return 0;
+}
+
+/*******************************************************************************
+ * Square a big_number_base object, straight into the result.
+ *
+ * Input:
+ *   this   - The value to square.
+ *   result - Receives the result.  It must not be the same object as this.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (out of memory).
+ ******************************************************************************/
+static int big_number_base_sqr_to(const big_number_base *this, big_number_base *result)
+{
+	int n = this->size;
+
+	/* Zero squared is zero. */
+	if(n == 0) {
+		result->size = 0;
+		result->negative = 0;
+		return 0;
+	}
+
+	if((big_number_base_grow(result, 2 * n) != 0) || (big_number_limb_sqr(result->num, this->num, n) != 0)) {
+		return 1;
+	}
+
+	/* A square is never negative. */
+	result->size = 2 * n;
+	result->negative = 0;
+	big_number_base_normalize(result);
+	return 0;
+}
 
 /*******************************************************************************
- * Divide 2 big_number_base objects.  Return quotient and/or remainder.
+ * Divide 2 big_number_base objects.  Return quotient and/or remainder.  The
+ * quotient is truncated toward zero, and the remainder takes the sign of the
+ * dividend (the same way the C "/" and "%" operators work).
  *
  * Input:
  *   dividend  - Value 1.
@@ -84,58 +364,54 @@ big_number_base_div_mod(const big_number_base *dividend,
                         big_number_base *remainder)
 {
 	if((dividend != (big_number_base *) 0) && (divisor != (big_number_base *) 0)) {
-		//printf("dividend     = %s\n", big_number_base_to_hex_str(dividend, 0));
-		//printf("divisor      = %s\n", big_number_base_to_hex_str(divisor, 0));
-
-		big_number_base rem;
-		big_number_base_copy(dividend, &rem);
-
-		big_number_base d2;
-		big_number_base_copy(divisor, &d2);
-
-		big_number_base q;
-		big_number_base_copy(big_number_base_0(), &q);
-
-		int shift_count = 0;
-		while(d2.num[sizeof(d2.num) - 1] == 0) {
-			int x;
-			for(x = (sizeof(d2.num) - 1); x > 0; x--) {
-				d2.num[x] = d2.num[x - 1];
-			}
-			d2.num[0] = 0;
-			shift_count++;
+		/* Can't divide by zero. */
+		if(divisor->size == 0) {
+			return;
 		}
 
-		int digit;
-		for(digit = 0; (digit < sizeof(d2.num)) && (d2.num[digit] == 0); digit++);
-
-		//printf("divisor_mod  = %s.  Shifted %d times.  digit = %d\n", big_number_base_to_hex_str(&d2, 0), shift_count, digit);
-
-		while(shift_count >= 0) {
-			while(big_number_base_compare(&rem, &d2) >= 0) {
-				big_number_base_subtract(&rem, &d2, &rem);
-				q.num[digit]++;
-			}
+		int an = dividend->size;
+		int dn = divisor->size;
+		int q_neg = dividend->negative ^ divisor->negative;
+		int r_neg = dividend->negative;
 
-			/* Shift the number one byte to the right. */
-			int x;
-			for(x = 1; x < sizeof(d2.num); x++) {
-				d2.num[x - 1] = d2.num[x];
-			}
-			d2.num[sizeof(d2.num) - 1] = 0;
+		/* If the dividend is smaller than the divisor, the quotient is
+		 * 0 and the remainder is the dividend. */
+		int qn = (an >= dn) ? (an - dn + 1) : 1;
 
-			digit--;
-			shift_count--;
+		/* One allocation for the quotient, the remainder and the
+		 * scratch space for the long division. */
+		limb_t *q = (limb_t *) calloc(qn + dn + (an + dn + 1), sizeof(limb_t));
+		if(q == (limb_t *) 0) {
+			return;
 		}
+		limb_t *rem = q + qn;
+		limb_t *scratch = rem + dn;
 
-		//printf("quotient = %s.  Remainder = %s.\n", big_number_base_to_hex_str(&q, 0), big_number_base_to_hex_str(&rem, 0));
+		if(an >= dn) {
+			big_number_limb_divrem(q, rem, dividend->num, an, divisor->num, dn, scratch);
+		}
+		else {
+			memcpy(rem, dividend->num, an * sizeof(limb_t));
+		}
 
 		if(quotient != (big_number_base *) 0) {
-			big_number_base_copy(&q, quotient);
+			if(big_number_base_grow(quotient, qn) == 0) {
+				memcpy(quotient->num, q, qn * sizeof(limb_t));
+				quotient->size = qn;
+				quotient->negative = q_neg;
+				big_number_base_normalize(quotient);
+			}
 		}
 		if(remainder != (big_number_base *) 0) {
-			big_number_base_copy(&rem, remainder);
+			if(big_number_base_grow(remainder, dn) == 0) {
+				memcpy(remainder->num, rem, dn * sizeof(limb_t));
+				remainder->size = dn;
+				remainder->negative = r_neg;
+				big_number_base_normalize(remainder);
+			}
 		}
+
+		free(q);
 	}
 }
 
@@ -154,7 +430,13 @@ big_number_base *big_number_base_new(void)
 	if(this != (big_number_base *) 0)
 	{
 		this->negative = 0;
-		memset(this->num, 0, sizeof(this->num));
+		this->size = 0;
+		this->capacity = BIG_NUMBER_BASE_INITIAL_LIMBS;
+		this->num = (limb_t *) calloc(this->capacity, sizeof(limb_t));
+		if(this->num == (limb_t *) 0) {
+			free(this);
+			this = (big_number_base *) 0;
+		}
 	}
 	return this;
 }
@@ -168,6 +450,7 @@ big_number_base *big_number_base_new(void)
 void big_number_base_delete(big_number_base *this)
 {
 	if(this != (big_number_base *) 0) {
+		free(this->num);
 		free(this);
 	}
 }
@@ -181,10 +464,95 @@ void big_number_base_delete(big_number_base *this)
  ******************************************************************************/
 void big_number_base_copy(const big_number_base *src, big_number_base *dst)
 {
-	if((src != (big_number_base *) 0) && (dst != (big_number_base *) 0)) {
-		dst->negative = src->negative;
-		memcpy(dst->num, src->num, sizeof(dst->num));
+	if((src != (big_number_base *) 0) && (dst != (big_number_base *) 0) && (src != dst)) {
+		if(big_number_base_grow(dst, src->size) == 0) {
+			dst->negative = src->negative;
+			dst->size = src->size;
+			memcpy(dst->num, src->num, src->size * sizeof(limb_t));
+		}
+	}
+}
+
+/*******************************************************************************
+ * Load a 64-bit value into a big_number_base object.
+ *
+ * Input:
+ *   this  - A pointer to the object.
+ *   value - The value.
+ ******************************************************************************/
+void big_number_base_set_u64(big_number_base *this, uint64_t value)
+{
+	if(this != (big_number_base *) 0) {
+		/* big_number_base_new() always allocates at least 1 limb. */
+		this->num[0] = value;
+		this->size = 1;
+		this->negative = 0;
+		big_number_base_normalize(this);
+	}
+}
+
+/*******************************************************************************
+ * Load a big-endian string of bytes into a big_number_base object.  The result
+ * is positive.
+ *
+ * Input:
+ *   this - A pointer to the object.
+ *   buf  - The bytes.  The most significant byte comes first.
+ *   len  - Number of bytes.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (bad arguments, or out of memory).  The object is unchanged.
+ ******************************************************************************/
+int big_number_base_from_bytes(big_number_base *this, const uint8_t *buf, int len)
+{
+	if((this == (big_number_base *) 0) || (len < 0) || ((buf == (const uint8_t *) 0) && (len > 0))) {
+		return 1;
+	}
+
+	int limbs = (len + 7) / 8;
+	if(big_number_base_grow(this, limbs) != 0) {
+		return 1;
+	}
+	memset(this->num, 0, limbs * sizeof(limb_t));
+
+	int i;
+	for(i = 0; i < len; i++) {
+		this->num[i / 8] |= ((limb_t) buf[len - 1 - i]) << ((i % 8) * 8);
+	}
+
+	this->size = limbs;
+	this->negative = 0;
+	big_number_base_normalize(this);
+	return 0;
+}
+
+/*******************************************************************************
+ * Store the magnitude of a big_number_base object as a big-endian string of
+ * bytes.  It is zero filled on the left out to len bytes.
+ *
+ * Input:
+ *   this - A pointer to the object.
+ *   buf  - Receives the bytes.
+ *   len  - Size of buf.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (the value doesn't fit in len bytes).
+ ******************************************************************************/
+int big_number_base_to_bytes(const big_number_base *this, uint8_t *buf, int len)
+{
+	if((this == (big_number_base *) 0) || (buf == (uint8_t *) 0) ||
+	   (len < ((big_number_base_bit_length(this) + 7) / 8))) {
+		return 1;
+	}
+
+	int i;
+	for(i = 0; i < len; i++) {
+		buf[len - 1 - i] = ((i / 8) < this->size) ? (uint8_t) (this->num[i / 8] >> ((i % 8) * 8)) : 0;
 	}
+
+	return 0;
 }
 
 /********** Math Operations */
@@ -200,68 +568,7 @@ void big_number_base_copy(const big_number_base *src, big_number_base *dst)
 void big_number_base_add(const big_number_base *addend1, const big_number_base *addend2, big_number_base *sum)
 {
 	if((addend1 != (big_number_base *) 0) && (addend2 != (big_number_base *) 0) && (sum != (big_number_base *) 0)) {
-		/* Make copies of the addends.  So if (sum == addend[12]), then
-		 * we won't overwrite the addend as we're working. */
-		big_number_base a1, a2;
-		big_number_base_copy(addend1, &a1);
-		big_number_base_copy(addend2, &a2);
-
-		/* Clear the result before we start. */
-		big_number_base_copy(big_number_base_0(), sum);
-
-		/* Check to see if we're working with a mixture of positive and
-		 * negative numbers.  If we are, then we want to solve the
-		 * problem by doing subtraction. */
-		int a1_neg = big_number_base_is_negative(&a1);
-		int a2_neg = big_number_base_is_negative(&a2);
-		if(a1_neg != a2_neg) {
-			/* If |neg_num| > |pos_num|, sum is negative.
-			 * If |pos_num| > |neg_num|, sum is positive. */
-			if(a1_neg) {
-				a1.negative = 0;
-				if(big_number_base_compare(&a1, &a2) > 0) {
-					big_number_base_subtract(&a1, &a2, sum);
-					sum->negative = 1;
-				}
-				else
-				{
-					big_number_base_subtract(&a2, &a1, sum);
-					sum->negative = 0;
-				}
-			}
-			else {
-				a2.negative = 0;
-				if(big_number_base_compare(&a1, &a2) > 0) {
-					big_number_base_subtract(&a1, &a2, sum);
-					sum->negative = 0;
-				}
-				else
-				{
-					big_number_base_subtract(&a2, &a1, sum);
-					sum->negative = 1;
-				}
-			}
-		}
-
-		else {
-
-			/* Both numbers are either positive or negative.  So
-			 * it's just a matter of simple addition of their
-			 * absolute values, and then setting the sign. */
-			sum->negative = (a1_neg == 1) ? 1 : 0;
-
-			int i;
-			for(i = 0; i < sizeof(a1.num); i++) {
-				/* Calculate the value and check for carry. */
-				uint8_t value = (uint8_t) ((sum->num[i] + a1.num[i] + a2.num[i]) & 0xFF);
-				uint8_t carry = (uint8_t) ((sum->num[i] + a1.num[i] + a2.num[i]) >> 8);
-
-				sum->num[i] = value;
-				if((carry > 0) && ((i + i) < sizeof(a1.num))) {
-					sum->num[i + 1] += 1;
-				}
-			}
-		}
+		big_number_base_add_signed(addend1, addend1->negative, addend2, addend2->negative, sum);
 	}
 }
 
@@ -276,81 +583,37 @@ void big_number_base_add(const big_number_base *addend1, const big_number_base *
 void big_number_base_subtract(const big_number_base *minuend, const big_number_base *subtrahend, big_number_base *difference)
 {
 	if((minuend != (big_number_base *) 0) && (subtrahend != (big_number_base *) 0) && (difference != (big_number_base *) 0)) {
-		int m_neg = big_number_base_is_negative(minuend);
-		int s_neg = big_number_base_is_negative(subtrahend);
-
-		/* neg_num - pos_num = Addition.  Difference is negative. */
-		if((m_neg == 1) && (s_neg == 0)) {
-			big_number_base_add(minuend, subtrahend, difference);
-			difference->negative = 1;
-		}
-
-		/* pos_num - neg_num = Addition.  Difference is positive. */
-		if((m_neg == 0) && (s_neg == 1)) {
-			big_number_base_add(minuend, subtrahend, difference);
-			difference->negative = 0;
-		}
-
-		/* neg_num - neg_num = Subtraction.
-		 * pos_num - pos_num = Subtraction. */
-		else {
-
-			/* Make a copy of the minuend and subtrahend.  We might
-			 * need to modify them as we work our way through the
-			 * number (if we have to borrow). */
-			big_number_base min_tmp, sub_tmp;
-			big_number_base_copy(minuend,    &min_tmp);
-			big_number_base_copy(subtrahend, &sub_tmp);
-
-			/* Clear the result before we start. */
-			big_number_base_copy(big_number_base_0(), difference);
-
-			/* Arrange them so that |v1| >= |v2|. */
-			big_number_base *v1, *v2;
-			min_tmp.negative = sub_tmp.negative = 0;
-			if(big_number_base_compare(&min_tmp, &sub_tmp) < 0) {
-				v1 = &sub_tmp;
-				v2 = &min_tmp;
-				difference->negative = 1;
-			}
-			else {
-				v1 = &min_tmp;
-				v2 = &sub_tmp;
-				difference->negative = 0;
-			}
-
-			/* Now subtract (v1 - v2). */
-			int i;
-			for(i = 0; i < sizeof(v1->num); i++) {
-				uint16_t val1 = v1->num[i];
-				uint16_t val2 = v2->num[i];
-
-				/* Check to see if we need to borrow. */
-				if(val2 > val1) {
-					int x;
-					for(x = (i + 1); x < sizeof(v1->num); x++) {
-						v1->num[x] -= 1;
-						if(v1->num[x] != 0xFF) {
-							val1 += 0x100;
-							break;
-						}
-					}
-					if(val1 >= val2) {
-						difference->num[i] = val1 - val2;
-					}
+		/* (m - s) is the same as (m + (-s)). */
+		big_number_base_add_signed(minuend, minuend->negative, subtrahend, !subtrahend->negative, difference);
+	}
+}
 
-					/* We couldn't borrow.  Give up. */
-					else {
-						break;
-					}
-				}
+/*******************************************************************************
+ * Add a big_number_base object to another one, in place.  this += addend.
+ *
+ * Input:
+ *   this   - The object to add to.
+ *   addend - The value to add.  It may be the same object as this.
+ ******************************************************************************/
+void big_number_base_add_to(big_number_base *this, const big_number_base *addend)
+{
+	if((this != (big_number_base *) 0) && (addend != (big_number_base *) 0)) {
+		big_number_base_add_signed(this, this->negative, addend, addend->negative, this);
+	}
+}
 
-				/* No need to borrow.  Straight subtraction. */
-				else {
-					difference->num[i] = val1 - val2;
-				}
-			}
-		}
+/*******************************************************************************
+ * Subtract a big_number_base object from another one, in place.
+ * this -= subtrahend.
+ *
+ * Input:
+ *   this       - The object to subtract from.
+ *   subtrahend - The value to subtract.  It may be the same object as this.
+ ******************************************************************************/
+void big_number_base_sub_from(big_number_base *this, const big_number_base *subtrahend)
+{
+	if((this != (big_number_base *) 0) && (subtrahend != (big_number_base *) 0)) {
+		big_number_base_add_signed(this, this->negative, subtrahend, !subtrahend->negative, this);
 	}
 }
 
@@ -365,72 +628,1121 @@ void big_number_base_subtract(const big_number_base *minuend, const big_number_b
 void big_number_base_multiply(const big_number_base *factor1, const big_number_base *factor2, big_number_base *product)
 {
 	if((factor1 != (big_number_base *) 0) && (factor2 != (big_number_base *) 0) && (product != (big_number_base *) 0)) {
-		/* Use a temp product, in case product == factor1 or factor2. */
-		big_number_base tmp_product;
-		big_number_base_copy(big_number_base_0(), &tmp_product);
-
-		int x;
-		for(x = 0; x < sizeof(factor1->num); x++) {
-			/* Results for one pass go into here. */
-			big_number_base loop_prod;
-			big_number_base_copy(big_number_base_0(), &loop_prod);
-
-			/* Overflows for one pass go into here. */
-			big_number_base loop_ovfl;
-			big_number_base_copy(big_number_base_0(), &loop_ovfl);
-
-			int y;
-			for(y = 0; y < sizeof(factor1->num); y++) {
-				if((factor1->num[x] > 0) && (factor2->num[y] > 0)) {
-					uint16_t res = factor1->num[x] * factor2->num[y];
-
-					if((x + y) < sizeof(loop_prod.num)) {
-						loop_prod.num[x + y] = (uint8_t) ((res >> 0) & 0xFF);
-
-						if((x + y + 1) < sizeof(loop_ovfl.num)) {
-							loop_ovfl.num[x + y + 1] = (uint8_t) ((res >> 8) & 0xFF);
-						}
-					}
-				}
-			}
+		/* (x * x) is a square.  That's about half the work. */
+		if(factor1 == factor2) {
+			big_number_base_square(factor1, product);
+		}
 
-			/* Add to the running total. */
-			big_number_base_add(&tmp_product, &loop_prod, &tmp_product);
-			big_number_base_add(&tmp_product, &loop_ovfl, &tmp_product);
+		/* If product is one of the factors, build the result on the side
+		 * and swap it in. */
+		else if(((product == factor1) || (product == factor2)) && (factor1->size != 0) && (factor2->size != 0)) {
+			big_number_base tmp = { 0, 0, 0, (limb_t *) 0 };
+			if(big_number_base_mul_to(factor1, factor2, &tmp) == 0) {
+				big_number_base_swap(product, &tmp);
+			}
+			free(tmp.num);
 		}
 
-		/* Copy our internal product to the caller's product. */
-		big_number_base_copy(&tmp_product, product);
+		else {
+			big_number_base_mul_to(factor1, factor2, product);
+		}
 	}
 }
 
 /*******************************************************************************
- * Divide 2 big_number_base objects.
+ * Multiply 2 big_number_base objects, using a caller-supplied object for the
+ * temporary product.  It's the same as big_number_base_multiply(), but when
+ * product is one of the factors, the result is built in scratch and the limb
+ * arrays are swapped, so nothing is allocated once scratch is big enough.
  *
  * Input:
- *   dividend  - Value 1.
- *   divisor   - Value 2.
- *   quotient  - A pointer to the object that will receive the result.
+ *   factor1 - One of the factors.
+ *   factor2 - One of the factors.
+ *   product - Receives the result.  It may be the same object as factor1
+ *             and/or factor2.
+ *   scratch - Scratch space.  Its value is destroyed.  It must not be the
+ *             same object as any of the others.
  ******************************************************************************/
-void big_number_base_divide(const big_number_base *dividend, const big_number_base *divisor, big_number_base *quotient)
+void big_number_base_mul_into(const big_number_base *factor1, const big_number_base *factor2,
+                              big_number_base *product, big_number_base *scratch)
 {
-	big_number_base_div_mod(dividend, divisor, quotient, 0);
+	if((factor1 != (big_number_base *) 0) && (factor2 != (big_number_base *) 0) && (product != (big_number_base *) 0)) {
+		if((scratch == (big_number_base *) 0) || (scratch == factor1) || (scratch == factor2) || (scratch == product) ||
+		   ((product != factor1) && (product != factor2))) {
+			big_number_base_multiply(factor1, factor2, product);
+		}
+		else {
+			int failed = (factor1 == factor2) ? big_number_base_sqr_to(factor1, scratch) :
+			                                    big_number_base_mul_to(factor1, factor2, scratch);
+			if(failed == 0) {
+				big_number_base_swap(product, scratch);
+			}
+		}
+	}
 }
 
 /*******************************************************************************
- * Perform a modulus operation on a big_number_base object.  The operation is
- * done as: result = this % modulus.
+ * Square a big_number_base object.
  *
  * Input:
- *   this    - The object to perform the modulus against.
- *   modulus - The modulus.
- *   result  - A pointer to the big_number object that receives the result.
+ *   this   - The value to square.
+ *   result - A pointer to the object that will receive the result.  It may be
+ *            the same object as this.
  ******************************************************************************/
-void big_number_base_modulus(const big_number_base *this, const big_number_base *modulus, big_number_base *result)
+void big_number_base_square(const big_number_base *this, big_number_base *result)
+{
+	if((this != (big_number_base *) 0) && (result != (big_number_base *) 0)) {
+		/* If result is this, build the result on the side and swap it
+		 * in. */
+		if((result == this) && (this->size != 0)) {
+			big_number_base tmp = { 0, 0, 0, (limb_t *) 0 };
+			if(big_number_base_sqr_to(this, &tmp) == 0) {
+				big_number_base_swap(result, &tmp);
+			}
+			free(tmp.num);
+		}
+		else {
+			big_number_base_sqr_to(this, result);
+		}
+	}
+}
+
+/*******************************************************************************
+ * Divide 2 big_number_base objects.
+ *
+ * Input:
+ *   dividend  - Value 1.
+ *   divisor   - Value 2.
+ *   quotient  - A pointer to the object that will receive the result.
+ ******************************************************************************/
+void big_number_base_divide(const big_number_base *dividend, const big_number_base *divisor, big_number_base *quotient)
+{
+	big_number_base_div_mod(dividend, divisor, quotient, 0);
+}
+
+/*******************************************************************************
+ * Perform a modulus operation on a big_number_base object.  The operation is
+ * done as: result = this % modulus.
+ *
+ * Input:
+ *   this    - The object to perform the modulus against.
+ *   modulus - The modulus.
+ *   result  - A pointer to the big_number object that receives the result.
+ ******************************************************************************/
+void big_number_base_modulus(const big_number_base *this, const big_number_base *modulus, big_number_base *result)
 {
 	big_number_base_div_mod(this, modulus, 0, result);
 }
 
+/*******************************************************************************
+ * Calculate the remainder of a big_number_base object divided by a 64-bit
+ * value.  The sign of the object is ignored.  This doesn't allocate anything,
+ * so it's a cheap way to check for small factors.
+ *
+ * Input:
+ *   this    - The object to perform the modulus against.
+ *   modulus - The modulus.
+ *
+ * Output:
+ *   Returns (|this| % modulus).  Returns 0 if modulus is 0.
+ ******************************************************************************/
+uint64_t big_number_base_modulus_u64(const big_number_base *this, uint64_t modulus)
+{
+	uint64_t rc = 0;
+
+	if((this != (big_number_base *) 0) && (modulus != 0)) {
+		rc = big_number_limb_mod_1(this->num, this->size, modulus);
+	}
+
+	return rc;
+}
+
+/********** Modular Exponentiation Methods */
+
+/*******************************************************************************
+ * Pick the sliding window size for an exponent.  A bigger window means fewer
+ * multiplies in the main loop, but a bigger table of powers to build up front.
+ * Both the Montgomery path and big_number_exponent() use this.
+ *
+ * Input:
+ *   bits - The number of bits in the exponent.
+ *
+ * Output:
+ *   The window size (1 - 6).
+ ******************************************************************************/
+int big_number_base_window_bits(int bits)
+{
+	if(bits > 671) { return 6; }
+	if(bits > 239) { return 5; }
+	if(bits >  79) { return 4; }
+	if(bits >  23) { return 3; }
+	return 1;
+}
+
+/*******************************************************************************
+ * Create a big_number_base_mont object.  This does all of the setup for a
+ * modulus, so that any number of exponentiations can be done with it.
+ *
+ * Input:
+ *   modulus - The modulus.  The sign is ignored.
+ *
+ * Output:
+ *   Success - Returns a pointer to the big_number_base_mont object.
+ *   Failure - Returns 0 (out of memory, or the modulus is zero).
+ ******************************************************************************/
+big_number_base_mont *big_number_base_mont_new(const big_number_base *modulus)
+{
+	big_number_base_mont *this = (big_number_base_mont *) 0;
+
+	if((modulus != (big_number_base *) 0) && (modulus->size > 0)) {
+		this = (big_number_base_mont *) calloc(1, sizeof(*this));
+	}
+
+	do {
+		if(this == (big_number_base_mont *) 0) { break; }
+
+		this->modulus = big_number_base_new();
+		if(this->modulus == (big_number_base *) 0) { break; }
+		big_number_base_copy(modulus, this->modulus);
+		this->modulus->negative = 0;
+
+		int n = modulus->size;
+		this->odd = (int) (modulus->num[0] & 1);
+		if(this->odd == 0) {
+			return this;
+		}
+
+		this->ninv = big_number_limb_mont_inverse(modulus->num[0]);
+
+		/* R^2 = 2^(128 * n).  Build it and reduce it.  This is the
+		 * only division that an exponentiation needs. */
+		big_number_base *r2 = big_number_base_new();
+		if((r2 == (big_number_base *) 0) || (big_number_base_grow(r2, (2 * n) + 1) != 0)) {
+			big_number_base_delete(r2);
+			break;
+		}
+		memset(r2->num, 0, ((2 * n) + 1) * sizeof(limb_t));
+		r2->num[2 * n] = 1;
+		r2->size = (2 * n) + 1;
+		big_number_base_modulus(r2, this->modulus, r2);
+
+		this->r2 = (limb_t *) calloc(n, sizeof(limb_t));
+		if(this->r2 != (limb_t *) 0) {
+			memcpy(this->r2, r2->num, r2->size * sizeof(limb_t));
+		}
+		big_number_base_delete(r2);
+		if(this->r2 == (limb_t *) 0) { break; }
+
+		return this;
+
+	} while(0);
+
+	big_number_base_mont_delete(this);
+	return (big_number_base_mont *) 0;
+}
+
+/*******************************************************************************
+ * Destroy a big_number_base_mont object that was created by
+ * big_number_base_mont_new().
+ *
+ * Input:
+ *   this - A pointer to the object.
+ ******************************************************************************/
+void big_number_base_mont_delete(big_number_base_mont *this)
+{
+	if(this != (big_number_base_mont *) 0) {
+		free(this->r2);
+		big_number_base_delete(this->modulus);
+		free(this);
+	}
+}
+
+/*******************************************************************************
+ * Reduce a value into the range [0, modulus).
+ *
+ * Input:
+ *   this   - The modulus.
+ *   value  - The value to reduce.  It may be negative.
+ *   result - Receives the result.
+ ******************************************************************************/
+static void big_number_base_mont_reduce(const big_number_base_mont *this, const big_number_base *value,
+                                        big_number_base *result)
+{
+	big_number_base_modulus(value, this->modulus, result);
+	if(result->negative == 1) {
+		big_number_base_add(result, this->modulus, result);
+	}
+}
+
+/*******************************************************************************
+ * Build the table of odd powers that the sliding window method uses.  The
+ * table holds (b ^ 1), (b ^ 3), (b ^ 5), ... (b ^ ((2 ^ window) - 1)), all in
+ * Montgomery form.
+ *
+ * Input:
+ *   this   - The modulus.  It must be odd.
+ *   b      - The base.  0 <= b < modulus.
+ *   window - The window size.
+ *
+ * Output:
+ *   Success - Returns the table.  (2 ^ (window - 1)) entries of n limbs each.
+ *             The caller must free() it.
+ *   Failure - Returns 0.
+ ******************************************************************************/
+static limb_t *big_number_base_mont_table_new(const big_number_base_mont *this, const big_number_base *b, int window)
+{
+	int n = this->modulus->size;
+	const limb_t *m = this->modulus->num;
+	int entries = 1 << (window - 1);
+
+	limb_t *table = (limb_t *) calloc(entries * n, sizeof(limb_t));
+	limb_t *b2    = (limb_t *) malloc(n * sizeof(limb_t));
+	limb_t *t     = (limb_t *) malloc((2 * n) * sizeof(limb_t));
+
+	int failed = (!table || !b2 || !t);
+	if(failed == 0) {
+		/* Convert the base into Montgomery form. */
+		memcpy(table, b->num, b->size * sizeof(limb_t));
+		failed |= big_number_limb_mont_mul(table, table, this->r2, m, n, this->ninv, t);
+
+		/* Each entry is the previous entry times (b ^ 2). */
+		if(entries > 1) {
+			failed |= big_number_limb_mont_sqr(b2, table, m, n, this->ninv, t);
+		}
+
+		int i;
+		for(i = 1; (i < entries) && (failed == 0); i++) {
+			failed |= big_number_limb_mont_mul(table + (i * n), table + ((i - 1) * n), b2, m, n, this->ninv, t);
+		}
+	}
+
+	free(t);
+	free(b2);
+	if(failed != 0) {
+		free(table);
+		table = (limb_t *) 0;
+	}
+
+	return table;
+}
+
+/*******************************************************************************
+ * The sliding window method.  Walk the bits of the exponent from the top down.
+ * A run of zero bits costs one square per bit.  Otherwise take the longest
+ * window (up to "window" bits) that ends in a 1 bit.  Its value is odd, so the
+ * power is in the table, and it costs one square per bit plus one multiply.
+ *
+ * Input:
+ *   this   - The modulus.  It must be odd.
+ *   table  - The odd powers of the base, from big_number_base_mont_table_new().
+ *   window - The window size that the table was built for.
+ *   exp    - The exponent.  Greater than 0.
+ *   result - Receives the result.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (out of memory).
+ ******************************************************************************/
+static int big_number_base_mont_exp_table(const big_number_base_mont *this, const limb_t *table, int window,
+                                          const big_number_base *exp, big_number_base *result)
+{
+	int n = this->modulus->size;
+	const limb_t *m = this->modulus->num;
+
+	limb_t *t = (limb_t *) malloc((2 * n) * sizeof(limb_t));
+	limb_t *x = (limb_t *) malloc(n * sizeof(limb_t));
+
+	int failed = (!t || !x);
+	int started = 0;
+
+	int bit = big_number_base_bit_length(exp) - 1;
+	while((bit >= 0) && (failed == 0)) {
+		if(big_number_base_test_bit(exp, bit) == 0) {
+			failed |= big_number_limb_mont_sqr(x, x, m, n, this->ninv, t);
+			bit--;
+			continue;
+		}
+
+		/* Find the bottom of the window.  It must be a 1 bit. */
+		int low = bit - window + 1;
+		if(low < 0) {
+			low = 0;
+		}
+		while(big_number_base_test_bit(exp, low) == 0) {
+			low++;
+		}
+
+		int value = 0;
+		int i;
+		for(i = bit; i >= low; i--) {
+			value = (value << 1) | big_number_base_test_bit(exp, i);
+		}
+
+		/* The top bit of exp is always set, so the first window just
+		 * loads its power. */
+		if(started == 0) {
+			memcpy(x, table + ((value >> 1) * n), n * sizeof(limb_t));
+			started = 1;
+		}
+		else {
+			for(i = bit; i >= low; i--) {
+				failed |= big_number_limb_mont_sqr(x, x, m, n, this->ninv, t);
+			}
+			failed |= big_number_limb_mont_mul(x, x, table + ((value >> 1) * n), m, n, this->ninv, t);
+		}
+
+		bit = low - 1;
+	}
+
+	if(failed == 0) {
+		/* Convert the result out of Montgomery form. */
+		memcpy(t, x, n * sizeof(limb_t));
+		memset(t + n, 0, n * sizeof(limb_t));
+		big_number_limb_redc(x, t, m, n, this->ninv);
+
+		failed = big_number_base_grow(result, n);
+		if(failed == 0) {
+			memcpy(result->num, x, n * sizeof(limb_t));
+			result->size = n;
+			result->negative = 0;
+			big_number_base_normalize(result);
+		}
+	}
+
+	free(x);
+	free(t);
+	return (failed != 0);
+}
+
+/*******************************************************************************
+ * Pick the number of teeth for a fixed-base comb.  Each extra tooth doubles the
+ * size of the table, but cuts the number of squares in each exponentiation.
+ *
+ * Input:
+ *   bits - The number of bits in the longest exponent.
+ *
+ * Output:
+ *   The number of teeth (4 - 8).
+ ******************************************************************************/
+static int big_number_base_mont_comb_teeth(int bits)
+{
+	if(bits > 1024) { return 8; }
+	if(bits >  256) { return 6; }
+	return 4;
+}
+
+/*******************************************************************************
+ * Build the table for the fixed-base comb method (Lim and Lee).  Think of the
+ * exponent as a grid of bits with teeth rows and spacing columns, where row j
+ * holds bits (j * spacing) to ((j + 1) * spacing - 1).  Let
+ * G[j] = b ^ (2 ^ (j * spacing)).  Entry i of the table is the product of G[j]
+ * for every bit j that is set in i.  Entry 0 is 1.  Everything is in
+ * Montgomery form.
+ *
+ * Input:
+ *   this    - The modulus.  It must be odd.
+ *   b       - The base.  0 <= b < modulus.
+ *   teeth   - The number of rows.
+ *   spacing - The number of columns.
+ *
+ * Output:
+ *   Success - Returns the table.  (2 ^ teeth) entries of n limbs each.  The
+ *             caller must free() it.
+ *   Failure - Returns 0.
+ ******************************************************************************/
+static limb_t *big_number_base_mont_comb_new(const big_number_base_mont *this, const big_number_base *b,
+                                             int teeth, int spacing)
+{
+	int n = this->modulus->size;
+	const limb_t *m = this->modulus->num;
+	int entries = 1 << teeth;
+
+	limb_t *comb = (limb_t *) malloc((entries * n) * sizeof(limb_t));
+	limb_t *g    = (limb_t *) calloc(n, sizeof(limb_t));
+	limb_t *t    = (limb_t *) malloc((2 * n) * sizeof(limb_t));
+
+	int failed = (!comb || !g || !t);
+	if(failed == 0) {
+		/* 1 in Montgomery form is (R % N) = REDC(R^2 % N). */
+		memcpy(t, this->r2, n * sizeof(limb_t));
+		memset(t + n, 0, n * sizeof(limb_t));
+		big_number_limb_redc(comb, t, m, n, this->ninv);
+
+		/* G[0] is the base in Montgomery form. */
+		memcpy(g, b->num, b->size * sizeof(limb_t));
+		failed |= big_number_limb_mont_mul(g, g, this->r2, m, n, this->ninv, t);
+
+		/* The entries from (2 ^ j) to (2 ^ (j + 1) - 1) are the ones below
+		 * them times G[j]. */
+		int i, j;
+		for(j = 0; (j < teeth) && (failed == 0); j++) {
+			if(j > 0) {
+				for(i = 0; i < spacing; i++) {
+					failed |= big_number_limb_mont_sqr(g, g, m, n, this->ninv, t);
+				}
+			}
+
+			int top = 1 << j;
+			memcpy(comb + (top * n), g, n * sizeof(limb_t));
+			for(i = 1; i < top; i++) {
+				failed |= big_number_limb_mont_mul(comb + ((top + i) * n), comb + (i * n), g, m, n, this->ninv, t);
+			}
+		}
+	}
+
+	free(t);
+	free(g);
+	if(failed != 0) {
+		free(comb);
+		comb = (limb_t *) 0;
+	}
+
+	return comb;
+}
+
+/*******************************************************************************
+ * The fixed-base comb method.  Walk the columns of the exponent from the left.
+ * Each column costs one square and at most one multiply, so an exponent of
+ * (teeth * spacing) bits only needs (spacing - 1) squares.  The sliding window
+ * method needs one square per bit.
+ *
+ * Input:
+ *   this    - The modulus.  It must be odd.
+ *   comb    - The table, from big_number_base_mont_comb_new().
+ *   teeth   - The number of rows that the table was built for.
+ *   spacing - The number of columns that the table was built for.
+ *   exp     - The exponent.  Greater than 0, and no more than
+ *             (teeth * spacing) bits long.
+ *   result  - Receives the result.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (out of memory).
+ ******************************************************************************/
+static int big_number_base_mont_exp_comb(const big_number_base_mont *this, const limb_t *comb, int teeth,
+                                         int spacing, const big_number_base *exp, big_number_base *result)
+{
+	int n = this->modulus->size;
+	const limb_t *m = this->modulus->num;
+
+	limb_t *t = (limb_t *) malloc((2 * n) * sizeof(limb_t));
+	limb_t *x = (limb_t *) malloc(n * sizeof(limb_t));
+
+	int failed = (!t || !x);
+	int started = 0;
+
+	int column;
+	for(column = spacing - 1; (column >= 0) && (failed == 0); column--) {
+		if(started == 1) {
+			failed |= big_number_limb_mont_sqr(x, x, m, n, this->ninv, t);
+		}
+
+		int index = 0;
+		int j;
+		for(j = teeth - 1; j >= 0; j--) {
+			index = (index << 1) | big_number_base_test_bit(exp, (j * spacing) + column);
+		}
+
+		if(index == 0) {
+			continue;
+		}
+		if(started == 0) {
+			memcpy(x, comb + (index * n), n * sizeof(limb_t));
+			started = 1;
+		}
+		else {
+			failed |= big_number_limb_mont_mul(x, x, comb + (index * n), m, n, this->ninv, t);
+		}
+	}
+
+	if(failed == 0) {
+		/* Convert the result out of Montgomery form. */
+		memcpy(t, x, n * sizeof(limb_t));
+		memset(t + n, 0, n * sizeof(limb_t));
+		big_number_limb_redc(x, t, m, n, this->ninv);
+
+		failed = big_number_base_grow(result, n);
+		if(failed == 0) {
+			memcpy(result->num, x, n * sizeof(limb_t));
+			result->size = n;
+			result->negative = 0;
+			big_number_base_normalize(result);
+		}
+	}
+
+	free(x);
+	free(t);
+	return (failed != 0);
+}
+
+/*******************************************************************************
+ * Modular exponentiation with an even modulus.  This is the left-to-right
+ * binary method, with a division after every multiply.
+ *
+ * Input:
+ *   this   - The modulus.
+ *   base   - The base.  0 <= base < modulus.
+ *   exp    - The exponent.  Greater than 0.
+ *   result - Receives the result.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (out of memory).
+ ******************************************************************************/
+static int big_number_base_mont_exp_even(const big_number_base_mont *this, const big_number_base *base,
+                                         const big_number_base *exp, big_number_base *result)
+{
+	big_number_base *acc = big_number_base_new();
+	if(acc == (big_number_base *) 0) {
+		return 1;
+	}
+
+	big_number_base_copy(base, acc);
+
+	int bit;
+	for(bit = (big_number_base_bit_length(exp) - 2); bit >= 0; bit--) {
+		big_number_base_square(acc, acc);
+		big_number_base_modulus(acc, this->modulus, acc);
+
+		if(big_number_base_test_bit(exp, bit) == 1) {
+			big_number_base_multiply(acc, base, acc);
+			big_number_base_modulus(acc, this->modulus, acc);
+		}
+	}
+
+	big_number_base_copy(acc, result);
+	big_number_base_delete(acc);
+	return 0;
+}
+
+/*******************************************************************************
+ * Modular exponentiation.  result = (base ^^ exp) % modulus.
+ *
+ * An odd modulus uses Montgomery multiplication, so there are no divisions in
+ * the loop.  The odd powers of the base are converted into Montgomery form up
+ * front, the sliding window method is done entirely in Montgomery form, and
+ * the result is converted back with one REDC.
+ *
+ * Input:
+ *   this   - The modulus, from big_number_base_mont_new().
+ *   base   - The base.  It may be negative, and it may be larger than the
+ *            modulus.
+ *   exp    - The exponent.  It must not be negative.
+ *   result - Receives the result (0 <= result < modulus).  It may be the same
+ *            object as base and/or exp.
+ ******************************************************************************/
+void big_number_base_mont_exp(const big_number_base_mont *this, const big_number_base *base,
+                              const big_number_base *exp, big_number_base *result)
+{
+	if((this == (big_number_base_mont *) 0) || (base == (big_number_base *) 0) ||
+	   (exp == (big_number_base *) 0) || (result == (big_number_base *) 0) || (exp->negative == 1)) {
+		return;
+	}
+
+	big_number_base *b = big_number_base_new();
+	if(b == (big_number_base *) 0) {
+		return;
+	}
+	big_number_base_mont_reduce(this, base, b);
+
+	/* Special cases.  (x ^ 0) equals 1, and everything mod 1 is 0. */
+	if(exp->size == 0) {
+		big_number_base_modulus(big_number_base_1(), this->modulus, result);
+	}
+	else if(this->odd == 0) {
+		big_number_base_mont_exp_even(this, b, exp, result);
+	}
+	else {
+		int window = big_number_base_window_bits(big_number_base_bit_length(exp));
+		limb_t *table = big_number_base_mont_table_new(this, b, window);
+		if(table != (limb_t *) 0) {
+			big_number_base_mont_exp_table(this, table, window, exp, result);
+			free(table);
+		}
+	}
+
+	big_number_base_delete(b);
+}
+
+/*******************************************************************************
+ * Create a big_number_base_mont_fixed object.  It holds the table of powers of
+ * a base, so that any number of exponentiations of the same base (e.g. a
+ * Diffie-Hellman generator) can skip building it.
+ *
+ * Exponents up to exp_bits long use a comb table (see
+ * big_number_base_mont_comb_new()).  Longer ones fall back to the sliding
+ * window table.
+ *
+ * Input:
+ *   mont     - The modulus.  It must not be deleted before this object.
+ *   base     - The base.  It may be negative, and it may be larger than the
+ *              modulus.
+ *   exp_bits - The longest exponent that the comb table is for.  0 means as
+ *              long as the modulus.
+ *
+ * Output:
+ *   Success - Returns a pointer to the big_number_base_mont_fixed object.
+ *   Failure - Returns 0.
+ ******************************************************************************/
+big_number_base_mont_fixed *big_number_base_mont_fixed_new(const big_number_base_mont *mont, const big_number_base *base,
+                                                           int exp_bits)
+{
+	big_number_base_mont_fixed *this = (big_number_base_mont_fixed *) 0;
+
+	if((mont != (big_number_base_mont *) 0) && (base != (big_number_base *) 0)) {
+		this = (big_number_base_mont_fixed *) calloc(1, sizeof(*this));
+	}
+
+	do {
+		if(this == (big_number_base_mont_fixed *) 0) { break; }
+
+		this->mont = mont;
+		this->base = big_number_base_new();
+		if(this->base == (big_number_base *) 0) { break; }
+		big_number_base_mont_reduce(mont, base, this->base);
+
+		/* An even modulus doesn't use a table. */
+		if(mont->odd == 1) {
+			this->window = big_number_base_window_bits(big_number_base_bit_length(mont->modulus));
+			this->table = big_number_base_mont_table_new(mont, this->base, this->window);
+			if(this->table == (limb_t *) 0) { break; }
+
+			int bits = (exp_bits > 0) ? exp_bits : big_number_base_bit_length(mont->modulus);
+			this->teeth = big_number_base_mont_comb_teeth(bits);
+			this->spacing = (bits + this->teeth - 1) / this->teeth;
+			this->comb = big_number_base_mont_comb_new(mont, this->base, this->teeth, this->spacing);
+			if(this->comb == (limb_t *) 0) { break; }
+		}
+
+		return this;
+
+	} while(0);
+
+	big_number_base_mont_fixed_delete(this);
+	return (big_number_base_mont_fixed *) 0;
+}
+
+/*******************************************************************************
+ * Destroy a big_number_base_mont_fixed object that was created by
+ * big_number_base_mont_fixed_new().
+ *
+ * Input:
+ *   this - A pointer to the object.
+ ******************************************************************************/
+void big_number_base_mont_fixed_delete(big_number_base_mont_fixed *this)
+{
+	if(this != (big_number_base_mont_fixed *) 0) {
+		free(this->comb);
+		free(this->table);
+		big_number_base_delete(this->base);
+		free(this);
+	}
+}
+
+/*******************************************************************************
+ * Fixed-base modular exponentiation.  result = (base ^^ exp) % modulus, where
+ * base and modulus come from big_number_base_mont_fixed_new().
+ *
+ * Input:
+ *   this   - The base and modulus.
+ *   exp    - The exponent.  It must not be negative.
+ *   result - Receives the result (0 <= result < modulus).  It may be the same
+ *            object as exp.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (bad arguments, or out of memory).
+ ******************************************************************************/
+int big_number_base_mont_fixed_exp(const big_number_base_mont_fixed *this, const big_number_base *exp,
+                                   big_number_base *result)
+{
+	if((this == (big_number_base_mont_fixed *) 0) || (exp == (big_number_base *) 0) ||
+	   (result == (big_number_base *) 0) || (exp->negative == 1)) {
+		return 1;
+	}
+
+	if(exp->size == 0) {
+		big_number_base_modulus(big_number_base_1(), this->mont->modulus, result);
+		return 0;
+	}
+	else if(this->mont->odd == 0) {
+		return big_number_base_mont_exp_even(this->mont, this->base, exp, result);
+	}
+	else if(big_number_base_bit_length(exp) <= (this->teeth * this->spacing)) {
+		return big_number_base_mont_exp_comb(this->mont, this->comb, this->teeth, this->spacing, exp, result);
+	}
+	else {
+		return big_number_base_mont_exp_table(this->mont, this->table, this->window, exp, result);
+	}
+}
+
+/********** Barrett Reduction Methods */
+
+/*******************************************************************************
+ * Create a big_number_base_reducer object.  It holds the Barrett constant for
+ * a modulus, so that the same modulus can be used over and over again without
+ * dividing.
+ *
+ * For a modulus m that is k limbs long, the constant is mu = (B^(2k) / m),
+ * where B = 2^64.  That's the only division.
+ *
+ * Input:
+ *   modulus - The modulus.  The sign is ignored.
+ *
+ * Output:
+ *   Success - Returns a pointer to the big_number_base_reducer object.
+ *   Failure - Returns 0 (out of memory, or the modulus is zero).
+ ******************************************************************************/
+big_number_base_reducer *big_number_base_reducer_new(const big_number_base *modulus)
+{
+	big_number_base_reducer *this = (big_number_base_reducer *) 0;
+
+	if((modulus != (big_number_base *) 0) && (modulus->size > 0)) {
+		this = (big_number_base_reducer *) calloc(1, sizeof(*this));
+	}
+
+	do {
+		if(this == (big_number_base_reducer *) 0) { break; }
+
+		this->modulus = big_number_base_new();
+		this->mu = big_number_base_new();
+		if((this->modulus == (big_number_base *) 0) || (this->mu == (big_number_base *) 0)) { break; }
+
+		big_number_base_copy(modulus, this->modulus);
+		this->modulus->negative = 0;
+		int k = modulus->size;
+
+		/* mu = B^(2k) / m. */
+		if(big_number_base_grow(this->mu, (2 * k) + 1) != 0) { break; }
+		memset(this->mu->num, 0, ((2 * k) + 1) * sizeof(limb_t));
+		this->mu->num[2 * k] = 1;
+		this->mu->size = (2 * k) + 1;
+		big_number_base_divide(this->mu, this->modulus, this->mu);
+
+		return this;
+
+	} while(0);
+
+	big_number_base_reducer_delete(this);
+	return (big_number_base_reducer *) 0;
+}
+
+/*******************************************************************************
+ * Destroy a big_number_base_reducer object that was created by
+ * big_number_base_reducer_new().
+ *
+ * Input:
+ *   this - A pointer to the object.
+ ******************************************************************************/
+void big_number_base_reducer_delete(big_number_base_reducer *this)
+{
+	if(this != (big_number_base_reducer *) 0) {
+		big_number_base_delete(this->mu);
+		big_number_base_delete(this->modulus);
+		free(this);
+	}
+}
+
+/*******************************************************************************
+ * Barrett reduction.  result = x % modulus.  The result is the same as
+ * big_number_base_modulus() (including the sign), but it is done with 2
+ * multiplies instead of a division (Handbook of Applied Cryptography, 14.42):
+ *
+ *   q = ((x / B^(k-1)) * mu) / B^(k+1)
+ *   r = x - (q * m)
+ *
+ * q is never more than 2 smaller than the real quotient, so r is fixed up with
+ * at most 2 subtracts.  Only the low (k + 1) limbs of r are needed.
+ *
+ * Input:
+ *   this   - The modulus, from big_number_base_reducer_new().
+ *   x      - The value to reduce.  Values with more than twice as many limbs
+ *            as the modulus fall back to big_number_base_modulus().
+ *   result - Receives the result.  It may be the same object as x.
+ ******************************************************************************/
+void big_number_base_reduce(const big_number_base_reducer *this, const big_number_base *x, big_number_base *result)
+{
+	if((this == (big_number_base_reducer *) 0) || (x == (big_number_base *) 0) || (result == (big_number_base *) 0)) {
+		return;
+	}
+
+	const big_number_base *m = this->modulus;
+	const big_number_base *mu = this->mu;
+	int k = m->size;
+	int xn = x->size;
+
+	/* Too big for Barrett. */
+	if(xn > (2 * k)) {
+		big_number_base_modulus(x, m, result);
+		return;
+	}
+
+	/* Shorter than the modulus.  Nothing to do. */
+	if(xn < k) {
+		big_number_base_copy(x, result);
+		return;
+	}
+
+	int q1n = xn - (k - 1);
+	int q2n = q1n + mu->size;
+	int q3n = (q2n > (k + 1)) ? (q2n - (k + 1)) : 0;
+
+	limb_t *q2 = (limb_t *) malloc((q2n + (q3n + k) + (k + 1)) * sizeof(limb_t));
+	if(q2 == (limb_t *) 0) {
+		return;
+	}
+	limb_t *qm = q2 + q2n;
+	limb_t *r  = qm + (q3n + k);
+
+	/* q = ((x / B^(k-1)) * mu) / B^(k+1).  Then q * m. */
+	int failed = big_number_base_limb_mul(q2, x->num + (k - 1), q1n, mu->num, mu->size);
+	if(failed == 0) {
+		failed = big_number_base_limb_mul(qm, q2 + (k + 1), q3n, m->num, k);
+	}
+
+	if(failed == 0) {
+		/* r = (x - (q * m)) mod B^(k+1).  The borrow is meaningless,
+		 * because the real difference is never negative. */
+		memset(r, 0, (k + 1) * sizeof(limb_t));
+		memcpy(r, x->num, ((xn < (k + 1)) ? xn : (k + 1)) * sizeof(limb_t));
+		if((q3n + k) >= (k + 1)) {
+			big_number_limb_sub_n(r, r, qm, k + 1);
+		}
+		else {
+			big_number_limb_sub(r, r, k + 1, qm, q3n + k);
+		}
+
+		while(big_number_limb_cmp(r, k + 1, m->num, k) >= 0) {
+			big_number_limb_sub(r, r, k + 1, m->num, k);
+		}
+
+		if(big_number_base_grow(result, k + 1) == 0) {
+			result->negative = x->negative;
+			memcpy(result->num, r, (k + 1) * sizeof(limb_t));
+			result->size = k + 1;
+			big_number_base_normalize(result);
+		}
+	}
+
+	free(q2);
+}
+
+/********** GCD Methods */
+
+/*******************************************************************************
+ * Copy the magnitude of a number into a limb array with the trailing zero
+ * bits shifted out, so the copy is odd.
+ *
+ * Input:
+ *   this - The number.  Must not be zero.
+ *   r    - Receives the odd part.  this->size limbs.  The caller zero fills
+ *          anything past that.
+ *
+ * Output:
+ *   Returns the number of bits that were shifted out.
+ ******************************************************************************/
+static int big_number_base_odd_part(const big_number_base *this, limb_t *r)
+{
+	int limbs = 0;
+	while(this->num[limbs] == 0) {
+		limbs++;
+	}
+	int count = __builtin_ctzll(this->num[limbs]);
+	int n = this->size - limbs;
+
+	if(count != 0) {
+		big_number_limb_rshift(r, this->num + limbs, n, count);
+	}
+	else {
+		memcpy(r, this->num + limbs, n * sizeof(limb_t));
+	}
+
+	return (limbs * LIMB_BITS) + count;
+}
+
+/*******************************************************************************
+ * Calculate the greatest common divisor of 2 numbers.  The signs are ignored,
+ * and the result is never negative.  gcd(x, 0) = |x|.
+ *
+ * Input:
+ *   a      - Value 1.
+ *   b      - Value 2.
+ *   result - Receives the GCD.  It may be the same object as a and/or b.
+ ******************************************************************************/
+void big_number_base_gcd(const big_number_base *a, const big_number_base *b, big_number_base *result)
+{
+	if((a == (big_number_base *) 0) || (b == (big_number_base *) 0) || (result == (big_number_base *) 0)) {
+		return;
+	}
+
+	if((a->size == 0) || (b->size == 0)) {
+		big_number_base_copy((a->size == 0) ? b : a, result);
+		result->negative = 0;
+		return;
+	}
+
+	/* The binary GCD costs about the same for (small, big) as it does for
+	 * (big, big).  So if one is shorter, start with one Euclid step:
+	 * gcd(big, small) = gcd(small, big % small). */
+	if(a->size != b->size) {
+		const big_number_base *small = (a->size < b->size) ? a : b;
+		big_number_base *r = big_number_base_new();
+		big_number_base *s = big_number_base_new();
+		if((r != (big_number_base *) 0) && (s != (big_number_base *) 0)) {
+			big_number_base_copy(small, s);
+			big_number_base_modulus((small == a) ? b : a, s, r);
+			if(r->size == 0) {
+				big_number_base_copy(s, result);
+				result->negative = 0;
+			}
+			else {
+				big_number_base_gcd(s, r, result);
+			}
+		}
+		big_number_base_delete(s);
+		big_number_base_delete(r);
+		return;
+	}
+
+	/* gcd(a, b) = gcd(odd part of a, odd part of b) * 2^(common twos). */
+	int n = (a->size > b->size) ? a->size : b->size;
+	limb_t *x = (limb_t *) calloc(n + n + (5 * (n + 1)), sizeof(limb_t));
+	if(x == (limb_t *) 0) {
+		return;
+	}
+	limb_t *y = x + n;
+	limb_t *scratch = y + n;
+
+	int a_twos = big_number_base_odd_part(a, x);
+	int b_twos = big_number_base_odd_part(b, y);
+
+	if(big_number_base_grow(result, n) == 0) {
+		big_number_limb_gcd_odd(result->num, x, y, n, scratch);
+		result->size = n;
+		result->negative = 0;
+		big_number_base_normalize(result);
+		big_number_base_shift_left(result, (a_twos < b_twos) ? a_twos : b_twos, result);
+	}
+
+	free(x);
+}
+
+/*******************************************************************************
+ * Modular inverse for an odd modulus.  This is the worker for
+ * big_number_base_mod_inverse().
+ *
+ * Input:
+ *   a      - The value to invert.  0 <= a < m.
+ *   m      - The modulus.  Must be odd.
+ *   result - Receives (1 / a) % m.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (no inverse, or out of memory).
+ ******************************************************************************/
+static int big_number_base_mod_inverse_odd(const big_number_base *a, const big_number_base *m, big_number_base *result)
+{
+	int n = m->size;
+	limb_t *x = (limb_t *) calloc(n + (7 * (n + 1)), sizeof(limb_t));
+	if(x == (limb_t *) 0) {
+		return 1;
+	}
+	limb_t *scratch = x + n;
+
+	memcpy(x, a->num, a->size * sizeof(limb_t));
+
+	int rc = 1;
+	if(big_number_base_grow(result, n) == 0) {
+		rc = big_number_limb_mod_inverse(result->num, x, m->num, n, scratch);
+		result->size = (rc == 0) ? n : 0;
+		result->negative = 0;
+		big_number_base_normalize(result);
+	}
+
+	free(x);
+	return rc;
+}
+
+/*******************************************************************************
+ * Calculate a modular inverse.  Find result such that
+ * (this * result) % modulus = 1.
+ *
+ * The binary GCD needs an odd modulus.  If the modulus is even, then this has
+ * to be odd (or there's no inverse), so the roles get swapped.  Let
+ * y = (1 / modulus) % this.  Then (modulus * (this - y)) + 1 is a multiple of
+ * this, and dividing it by this gives the inverse.
+ *
+ * Input:
+ *   this    - The value to invert.  It may be negative.
+ *   modulus - The modulus.  The sign is ignored.
+ *   result  - Receives the inverse, in the range [0, |modulus|).  It may be
+ *             the same object as this or modulus.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (gcd(this, modulus) != 1, modulus == 0, or out of memory).
+ ******************************************************************************/
+int big_number_base_mod_inverse(const big_number_base *this, const big_number_base *modulus, big_number_base *result)
+{
+	if((this == (big_number_base *) 0) || (modulus == (big_number_base *) 0) ||
+	   (result == (big_number_base *) 0) || (modulus->size == 0)) {
+		return 1;
+	}
+
+	int rc = 1;
+
+	big_number_base *m = big_number_base_new();
+	big_number_base *a = big_number_base_new();
+	big_number_base *y = big_number_base_new();
+
+	do {
+		if(!m || !a || !y) { break; }
+
+		/* a = this % m, in [0, m). */
+		big_number_base_copy(modulus, m);
+		m->negative = 0;
+		big_number_base_modulus(this, m, a);
+		if(a->negative == 1) {
+			big_number_base_add(a, m, a);
+		}
+
+		/* Everything is 0 mod 1. */
+		if(big_number_base_compare(m, big_number_base_1()) == 0) {
+			big_number_base_set_u64(result, 0);
+			rc = 0;
+		}
+
+		else if((m->num[0] & 1) == 1) {
+			rc = big_number_base_mod_inverse_odd(a, m, result);
+		}
+
+		/* Even modulus.  a has to be odd. */
+		else if((a->size != 0) && ((a->num[0] & 1) == 1)) {
+			if(big_number_base_compare(a, big_number_base_1()) == 0) {
+				big_number_base_set_u64(result, 1);
+				rc = 0;
+				break;
+			}
+
+			big_number_base_modulus(m, a, y);
+			if(big_number_base_mod_inverse_odd(y, a, y) != 0) {
+				break;
+			}
+			big_number_base_subtract(a, y, y);
+			big_number_base_multiply(y, m, y);
+			big_number_base_add(y, big_number_base_1(), y);
+			big_number_base_divide(y, a, result);
+			rc = 0;
+		}
+
+	} while(0);
+
+	big_number_base_delete(y);
+	big_number_base_delete(a);
+	big_number_base_delete(m);
+	return rc;
+}
+
 /********** Comparison Methods */
 
 /*******************************************************************************
@@ -438,78 +1750,191 @@ void big_number_base_modulus(const big_number_base *this, const big_number_base
  * same.
  *
  * Input:
- *   a - Value 1.
- *   b - Value 2.
+ *   a - Value 1.
+ *   b - Value 2.
+ *
+ * Output:
+ *   Returns <0 if (a < b).
+ *   Returns  0 if (a == b).
+ *   Returns >0 if (a > b).
+ ******************************************************************************/
+int big_number_base_compare(const big_number_base *a, const big_number_base *b)
+{
+	int rc = 2;
+
+	if((a != (big_number_base *) 0) && (b != (big_number_base *) 0)) {
+
+		/* Perform simple positive vs negative checks. */
+		int a_neg = big_number_base_is_negative(a);
+		int b_neg = big_number_base_is_negative(b);
+		if((a_neg == 1) && (b_neg == 0)) {
+			rc = -1;
+		}
+		else if((a_neg == 0) && (b_neg == 1)) {
+			rc = 1;
+		}
+
+		/* Same sign.  Compare the magnitudes.  If both are negative,
+		 * the larger magnitude is the smaller number. */
+		else {
+			rc = big_number_limb_cmp(a->num, a->size, b->num, b->size);
+			if(a_neg == 1) {
+				rc = -rc;
+			}
+		}
+	}
+
+	return rc;
+}
+
+/*******************************************************************************
+ * Check to see if a number is negative.
+ * same.
+ *
+ * Input:
+ *   this - The object to check.
+ *
+ * Output:
+ *   Returns  1 if it is negative.
+ *   Returns  0 if it is positive.
+ *   Returns -1 if an error occurs.
+ ******************************************************************************/
+int big_number_base_is_negative(const big_number_base *this)
+{
+	int retcode = -1;
+
+	if(this != (big_number_base *) 0) {
+		retcode = this->negative == 1;
+	}
+
+	return retcode;
+}
+
+/********** Bit Methods */
+
+/*******************************************************************************
+ * Shift the magnitude of a big_number_base object left.  The sign is kept.
+ * result = this * (2 ^ bits).
+ *
+ * Input:
+ *   this   - The object to shift.
+ *   bits   - The number of bits to shift.  Must be >= 0.
+ *   result - Receives the result.  It may be the same object as this.
+ ******************************************************************************/
+void big_number_base_shift_left(const big_number_base *this, int bits, big_number_base *result)
+{
+	if((this != (big_number_base *) 0) && (result != (big_number_base *) 0) && (bits >= 0)) {
+		int n = this->size;
+		int limbs = bits / LIMB_BITS;
+		int count = bits % LIMB_BITS;
+		int negative = this->negative;
+
+		if(big_number_base_grow(result, n + limbs + 1) != 0) {
+			return;
+		}
+
+		/* If result is this, the grow may have moved this->num.  The
+		 * shift moves the limbs up, so do it from the top down. */
+		if(count != 0) {
+			result->num[n + limbs] = big_number_limb_lshift(result->num + limbs, this->num, n, count);
+		}
+		else {
+			memmove(result->num + limbs, this->num, n * sizeof(limb_t));
+			result->num[n + limbs] = 0;
+		}
+		memset(result->num, 0, limbs * sizeof(limb_t));
+
+		result->size = n + limbs + 1;
+		result->negative = negative;
+		big_number_base_normalize(result);
+	}
+}
+
+/*******************************************************************************
+ * Shift the magnitude of a big_number_base object right.  The sign is kept,
+ * so a negative number is rounded toward zero (the same as dividing by
+ * (2 ^ bits)).
+ *
+ * Input:
+ *   this   - The object to shift.
+ *   bits   - The number of bits to shift.  Must be >= 0.
+ *   result - Receives the result.  It may be the same object as this.
+ ******************************************************************************/
+void big_number_base_shift_right(const big_number_base *this, int bits, big_number_base *result)
+{
+	if((this != (big_number_base *) 0) && (result != (big_number_base *) 0) && (bits >= 0)) {
+		int limbs = bits / LIMB_BITS;
+		int count = bits % LIMB_BITS;
+		int n = this->size - limbs;
+		int negative = this->negative;
+
+		/* Everything got shifted out. */
+		if(n <= 0) {
+			result->size = 0;
+			result->negative = 0;
+			return;
+		}
+
+		if(big_number_base_grow(result, n) != 0) {
+			return;
+		}
+
+		/* The shift moves the limbs down, so do it from the bottom up. */
+		if(count != 0) {
+			big_number_limb_rshift(result->num, this->num + limbs, n, count);
+		}
+		else {
+			memmove(result->num, this->num + limbs, n * sizeof(limb_t));
+		}
+
+		result->size = n;
+		result->negative = negative;
+		big_number_base_normalize(result);
+	}
+}
+
+/*******************************************************************************
+ * Return the number of bits in the magnitude of a big_number_base object.  The
+ * sign is ignored.
+ *
+ * Input:
+ *   this - The object to check.
  *
  * Output:
- *   Returns <0 if (a < b).
- *   Returns  0 if (a == b).
- *   Returns >0 if (a > b).
+ *   The position of the highest set bit + 1.  Returns 0 if the value is zero.
  ******************************************************************************/
-int big_number_base_compare(const big_number_base *a, const big_number_base *b)
+int big_number_base_bit_length(const big_number_base *this)
 {
-	int rc = 2;
-
-	if((a != (big_number_base *) 0) && (b != (big_number_base *) 0)) {
-
-		do {
-			//printf("%s(): Compare %s and %s\n", __func__, big_number_base_to_hex_str(a, 0), big_number_base_to_hex_str(b, 0));
-
-			/* Perform simple positive vs negative checks. */
-			int a_neg = big_number_base_is_negative(a);
-			int b_neg = big_number_base_is_negative(b);
-			int both_neg = ((a_neg == 1) && (b_neg == 1)) ? 1 : 0;
-			if((a_neg == 1) && (b_neg == 0)) {
-				rc = -1;
-				break;
-			}
-			else if((a_neg == 0) && (b_neg == 1)) {
-				rc = 1;
-				break;
-			}
+	int bits = 0;
 
-			/* Assume they're equal. */
-			rc = 0;
-
-			int index = sizeof(a->num);
-			for(index = (sizeof(a->num) - 1); (index >= 0) && (rc == 0); index--) {
-
-				if(a->num[index] < b->num[index]) {
-					rc = both_neg ? 1 : -1;
-				}
-
-				else if(a->num[index] > b->num[index]) {
-					rc = both_neg ? -1 : 1;
-				}
-
-			} while((index > 0) && (rc == 0));
-		} while(0);
+	if((this != (big_number_base *) 0) && (this->size > 0)) {
+		bits = (this->size * LIMB_BITS) - __builtin_clzll(this->num[this->size - 1]);
 	}
 
-	return rc;
+	return bits;
 }
 
 /*******************************************************************************
- * Check to see if a number is negative.
- * same.
+ * Check one bit in the magnitude of a big_number_base object.  The sign is
+ * ignored.
  *
  * Input:
  *   this - The object to check.
+ *   bit  - The bit number.  Bit 0 is the least significant bit.
  *
  * Output:
- *   Returns  1 if it is negative.
- *   Returns  0 if it is positive.
- *   Returns -1 if an error occurs.
+ *   Returns 1 if the bit is set.
+ *   Returns 0 if the bit is clear.
  ******************************************************************************/
-int big_number_base_is_negative(const big_number_base *this)
+int big_number_base_test_bit(const big_number_base *this, int bit)
 {
-	int retcode = -1;
+	int rc = 0;
 
-	if(this != (big_number_base *) 0) {
-		retcode = this->negative == 1;
+	if((this != (big_number_base *) 0) && (bit >= 0) && ((bit / LIMB_BITS) < this->size)) {
+		rc = (this->num[bit / LIMB_BITS] >> (bit % LIMB_BITS)) & 1;
 	}
 
-	return retcode;
+	return rc;
 }
 
 /********** Diagnostic Methods */
@@ -530,31 +1955,53 @@ int big_number_base_is_negative(const big_number_base *this)
 const char *
 big_number_base_to_hex_str(const big_number_base *this, int zero_fill)
 {
-	static char strings[5][1024];
-	static int  strings_index = 0;
+	static const char hex_digits[] = "0123456789ABCDEF";
 
-	char *str = strings[strings_index];
+	/* The strings grow to fit the largest number that has been displayed. */
+	static char *strings[5];
+	static int   strings_size[5];
+	static int   strings_index = 0;
 
+	int index = strings_index;
 	if(++strings_index == 5) {
 		strings_index = 0;
 	}
 
+	/* Sign, plus "XX:" for each byte, plus the terminator. */
+	int num_bytes = this->size * sizeof(limb_t);
+	int need = 1 + (num_bytes * 3) + 1;
+	if(need < 4) {
+		need = 4;
+	}
+	if(strings_size[index] < need) {
+		char *s = (char *) realloc(strings[index], need);
+		if(s == (char *) 0) {
+			return "";
+		}
+		strings[index] = s;
+		strings_size[index] = need;
+	}
+	char *str = strings[index];
+
 	/* Display the sign. */
-	strcpy(str, big_number_base_is_negative(this) ? "-" : "+");
+	char *str_tmp = str;
+	*(str_tmp++) = big_number_base_is_negative(this) ? '-' : '+';
 
 	/* If the number is not zero, create the string now. */
 	int i;
-	char *str_tmp = str + strlen(str);
-	for(i = (sizeof(this->num) - 1); i >= 0; i--) {
+	for(i = (num_bytes - 1); i >= 0; i--) {
+		uint8_t byte = (uint8_t) (this->num[i / sizeof(limb_t)] >> ((i % sizeof(limb_t)) * 8));
+
 		/* The caller can ask to skip leading zeroes. */
-		if((strlen(str) > 1) || (this->num[i] != 0) || (zero_fill == 1)) {
-			sprintf(str_tmp, "%02X", this->num[i]);
+		if((str_tmp > (str + 1)) || (byte != 0) || (zero_fill == 1)) {
+			*(str_tmp++) = hex_digits[byte >> 4];
+			*(str_tmp++) = hex_digits[byte & 0x0F];
 			if(i > 0) {
-				strcat(str_tmp, ":");
+				*(str_tmp++) = ':';
 			}
-			str_tmp += strlen(str_tmp);
 		}
 	}
+	*str_tmp = 0;
 
 	/* If it's zero, then the string will be empty.  Set it to "00". */
 	if(strlen(str) == 1) {
@@ -564,9 +2011,435 @@ big_number_base_to_hex_str(const big_number_base *this, int zero_fill)
 	return str;
 }
 
+/*******************************************************************************
+ * Write a value as exactly digits decimal digits, with leading zeroes.  The
+ * digits are made 2 at a time from a table.
+ *
+ * Input:
+ *   out    - Receives the digits.  No terminator is added.
+ *   value  - The value.  It must be less than 10^digits.
+ *   digits - Number of digits to write.
+ ******************************************************************************/
+static void big_number_base_dec_u64(char *out, uint64_t value, int digits)
+{
+	static const char pairs[] =
+		"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+		"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+		"8081828384858687888990919293949596979899";
+
+	char *p = out + digits;
+	while(p >= (out + 2)) {
+		const char *pair = pairs + ((value % 100) * 2);
+		value /= 100;
+		*(--p) = pair[1];
+		*(--p) = pair[0];
+	}
+	if(p > out) {
+		*(--p) = '0' + (value % 10);
+	}
+}
+
+/*******************************************************************************
+ * Calculate the powers of 10^19 that decimal conversion splits numbers with:
+ * pow[k] = 10^(19 * 2^k).  They go up to about half the size of the number.
+ *
+ * Input:
+ *   pow   - Receives the powers.  Room for 32.  The caller frees them.
+ *   pown  - Receives the number of limbs in each power.
+ *   limbs - Number of limbs in the number that will be converted.
+ *
+ * Output:
+ *   Success - The number of powers (at least 1).
+ *   Failure - -1 (out of memory).  Nothing is left to free.
+ ******************************************************************************/
+static int big_number_base_dec_powers(limb_t **pow, int *pown, int limbs)
+{
+	int npow = 0;
+	while(npow < 32) {
+		if((npow > 0) && ((2 * pown[npow - 1]) > (limbs + 1))) {
+			break;
+		}
+
+		int n = (npow == 0) ? 1 : (2 * pown[npow - 1]);
+		if((pow[npow] = (limb_t *) malloc(n * sizeof(limb_t))) == (limb_t *) 0) {
+			npow = -npow - 1;
+			break;
+		}
+		if(npow == 0) {
+			pow[npow][0] = DEC_CHUNK;
+		}
+		else if(big_number_limb_sqr(pow[npow], pow[npow - 1], pown[npow - 1]) != 0) {
+			free(pow[npow]);
+			npow = -npow - 1;
+			break;
+		}
+		pown[npow] = big_number_limb_normalized_size(pow[npow], n);
+		npow++;
+	}
+
+	/* Out of memory.  Free the ones that were made. */
+	if(npow < 0) {
+		npow = -npow - 1;
+		while(npow > 0) {
+			free(pow[--npow]);
+		}
+		return -1;
+	}
+
+	return npow;
+}
+
+/*******************************************************************************
+ * Convert a small value to decimal.  Divide by 10^19 over and over, and write
+ * the remainders from the right.
+ *
+ * Input:
+ *   out    - Receives the digits.
+ *   digits - Number of digits to write.  a must be less than 10^digits.
+ *   a      - The value.  It is destroyed.
+ *   n      - Number of limbs in a.
+ ******************************************************************************/
+static void big_number_base_dec_basecase(char *out, int digits, limb_t *a, int n)
+{
+	while(digits > 0) {
+		n = big_number_limb_normalized_size(a, n);
+		limb_t chunk = big_number_limb_divrem_1(a, a, n, DEC_CHUNK);
+		int count = (digits < DEC_CHUNK_DIGITS) ? digits : DEC_CHUNK_DIGITS;
+		digits -= count;
+		big_number_base_dec_u64(out + digits, chunk, count);
+	}
+}
+
+/*******************************************************************************
+ * Convert a value to decimal, divide and conquer.  Split the value into a high
+ * and a low half with one division by a power of 10^19, and convert the halves
+ * separately.
+ *
+ * Input:
+ *   out    - Receives the digits.
+ *   digits - Number of digits to write.  a must be less than 10^digits.
+ *   a      - The value.
+ *   n      - Number of limbs in a.
+ *   pow    - pow[k] = 10^(19 * 2^k).
+ *   pown   - Number of limbs in each pow[k].
+ *   npow   - Number of entries in pow[].
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (out of memory).
+ ******************************************************************************/
+static int big_number_base_dec_recurse(char *out, int digits, const limb_t *a, int n,
+                                       limb_t **pow, const int *pown, int npow)
+{
+	n = big_number_limb_normalized_size(a, n);
+
+	/* Split at the biggest power that is about half the size of a. */
+	int k = npow - 1;
+	while((k >= 0) && ((2 * pown[k]) > (n + 1))) {
+		k--;
+	}
+
+	if((n < DEC_BASECASE_LIMBS) || (k < 0)) {
+		limb_t *t = (limb_t *) malloc((n + 1) * sizeof(limb_t));
+		if(t == (limb_t *) 0) {
+			return 1;
+		}
+		memcpy(t, a, n * sizeof(limb_t));
+		big_number_base_dec_basecase(out, digits, t, n);
+		free(t);
+		return 0;
+	}
+
+	int dn = pown[k];
+	int qn = n - dn + 1;
+	limb_t *q = (limb_t *) malloc((qn + dn + (n + dn + 1)) * sizeof(limb_t));
+	if(q == (limb_t *) 0) {
+		return 1;
+	}
+	limb_t *r = q + qn;
+	big_number_limb_divrem(q, r, a, n, pow[k], dn, r + dn);
+
+	int low = DEC_CHUNK_DIGITS << k;
+	int rc = big_number_base_dec_recurse(out, digits - low, q, qn, pow, pown, npow);
+	if(rc == 0) {
+		rc = big_number_base_dec_recurse(out + digits - low, low, r, dn, pow, pown, npow);
+	}
+
+	free(q);
+	return rc;
+}
+
+/*******************************************************************************
+ * Convert a big_number_base object to a decimal string, like "-12345".
+ *
+ * Input:
+ *   this - The object to convert.
+ *   str  - Receives the string.
+ *   size - Size of str.  (bit_length * 0.302) + 3 is always enough.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (str is too small, or out of memory).
+ ******************************************************************************/
+int big_number_base_to_dec_str(const big_number_base *this, char *str, int size)
+{
+	if((this == (big_number_base *) 0) || (str == (char *) 0)) {
+		return 1;
+	}
+
+	/* An upper limit on the number of digits.  log10(2) < 1,234 / 4,096. */
+	int digits = ((big_number_base_bit_length(this) * 1234) / 4096) + 1;
+	if(size < (digits + 2)) {
+		return 1;
+	}
+
+	limb_t *pow[32];
+	int pown[32];
+	int npow = big_number_base_dec_powers(pow, pown, this->size);
+	int rc = (npow < 0);
+
+	char *out = str;
+	if(this->negative == 1) {
+		*(out++) = '-';
+	}
+
+	if(rc == 0) {
+		rc = big_number_base_dec_recurse(out, digits, this->num, this->size, pow, pown, npow);
+	}
+
+	while(npow > 0) {
+		free(pow[--npow]);
+	}
+
+	if(rc == 0) {
+		/* Strip the leading zeroes, but leave one if the value is 0. */
+		int skip = 0;
+		while((skip < (digits - 1)) && (out[skip] == '0')) {
+			skip++;
+		}
+		memmove(out, out + skip, digits - skip);
+		out[digits - skip] = 0;
+	}
+
+	return rc;
+}
+
+/*******************************************************************************
+ * Convert a short run of decimal digits (up to 19) to a limb.
+ *
+ * Input:
+ *   str - The digits.
+ *   len - Number of digits.
+ *
+ * Output:
+ *   Returns the value.
+ ******************************************************************************/
+static limb_t big_number_base_dec_parse_u64(const char *str, int len)
+{
+	limb_t value = 0;
+	while(len-- > 0) {
+		value = (value * 10) + (limb_t) (*(str++) - '0');
+	}
+	return value;
+}
+
+/*******************************************************************************
+ * Convert a string of decimal digits to limbs, divide and conquer.  Short
+ * strings are read 19 digits at a time, with one multiply-add per chunk:
+ *
+ *   r = (r * 10^19) + chunk
+ *
+ * Long strings are split into a high and a low part, where the low part is
+ * (19 * 2^k) digits long, and put back together with one multiply:
+ *
+ *   r = (high * 10^(19 * 2^k)) + low
+ *
+ * Input:
+ *   r    - Receives the value.  (len / 19) + 1 limbs.
+ *   str  - The digits.  They must all be '0' - '9'.
+ *   len  - Number of digits.
+ *   pow  - pow[k] = 10^(19 * 2^k).
+ *   pown - Number of limbs in each pow[k].
+ *   npow - Number of entries in pow[].
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (out of memory).
+ ******************************************************************************/
+static int big_number_base_dec_parse(limb_t *r, const char *str, int len,
+                                     limb_t **pow, const int *pown, int npow)
+{
+	int rn = (len / DEC_CHUNK_DIGITS) + 1;
+
+	/* Split at the biggest power that leaves some digits on top. */
+	int k = npow - 1;
+	while((k >= 0) && ((DEC_CHUNK_DIGITS << k) >= len)) {
+		k--;
+	}
+
+	if((len <= (DEC_CHUNK_DIGITS * DEC_BASECASE_LIMBS)) || (k < 0)) {
+		/* The first chunk takes the odd digits, so the rest are full. */
+		int count = len % DEC_CHUNK_DIGITS;
+		if(count == 0) {
+			count = DEC_CHUNK_DIGITS;
+		}
+
+		int n = 0;
+		memset(r, 0, rn * sizeof(limb_t));
+		while(len > 0) {
+			r[n] = big_number_limb_mul_1(r, r, n, DEC_CHUNK);
+			n++;
+			big_number_limb_add_1(r, r, n, big_number_base_dec_parse_u64(str, count));
+			str += count;
+			len -= count;
+			count = DEC_CHUNK_DIGITS;
+		}
+		return 0;
+	}
+
+	int low = DEC_CHUNK_DIGITS << k;
+	int hn = ((len - low) / DEC_CHUNK_DIGITS) + 1;
+	int ln = (low / DEC_CHUNK_DIGITS) + 1;
+	limb_t *h = (limb_t *) malloc((hn + ln + (hn + pown[k])) * sizeof(limb_t));
+	if(h == (limb_t *) 0) {
+		return 1;
+	}
+	limb_t *l = h + hn;
+	limb_t *p = l + ln;
+
+	int rc = big_number_base_dec_parse(h, str, len - low, pow, pown, npow);
+	if(rc == 0) {
+		rc = big_number_base_dec_parse(l, str + len - low, low, pow, pown, npow);
+	}
+	if(rc == 0) {
+		int pn = big_number_limb_normalized_size(h, hn);
+		rc = big_number_base_limb_mul(p, h, pn, pow[k], pown[k]);
+		pn = big_number_limb_normalized_size(p, pn + pown[k]);
+
+		/* Both parts are less than 10^len, so they fit in r. */
+		memset(r, 0, rn * sizeof(limb_t));
+		memcpy(r, p, pn * sizeof(limb_t));
+		big_number_limb_add(r, r, rn, l, big_number_limb_normalized_size(l, ln));
+	}
+
+	free(h);
+	return rc;
+}
+
+/*******************************************************************************
+ * Convert a string to a big_number_base object.  The string is an optional
+ * sign ('+' or '-') followed by decimal digits ("-12345"), or by "0x" and hex
+ * digits ("0x1F").
+ *
+ * Input:
+ *   this - The object that receives the value.
+ *   str  - The string to convert.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (an empty or invalid string, or out of memory).  The value of
+ *             this is undefined.
+ ******************************************************************************/
+int big_number_base_from_str(big_number_base *this, const char *str)
+{
+	if((this == (big_number_base *) 0) || (str == (const char *) 0)) {
+		return 1;
+	}
+
+	int negative = 0;
+	if((*str == '-') || (*str == '+')) {
+		negative = (*(str++) == '-');
+	}
+
+	int hex = 0;
+	if((str[0] == '0') && ((str[1] == 'x') || (str[1] == 'X'))) {
+		hex = 1;
+		str += 2;
+	}
+
+	/* Check the digits before touching the object. */
+	int len = 0;
+	while(str[len] != 0) {
+		if(hex ? (isxdigit((unsigned char) str[len]) == 0) : ((str[len] < '0') || (str[len] > '9'))) {
+			return 1;
+		}
+		len++;
+	}
+	if(len == 0) {
+		return 1;
+	}
+
+	int rc = 0;
+	if(hex) {
+		/* 16 digits per limb, filled from the least significant end. */
+		int n = (len + 15) / 16;
+		if(big_number_base_grow(this, n) != 0) {
+			return 1;
+		}
+
+		int i;
+		for(i = 0; i < n; i++) {
+			int end = len - (i * 16);
+			int start = (end > 16) ? (end - 16) : 0;
+			limb_t value = 0;
+			while(start < end) {
+				char c = str[start++];
+				int digit = (c <= '9') ? (c - '0') : ((c | 0x20) - 'a' + 10);
+				value = (value << 4) | (limb_t) digit;
+			}
+			this->num[i] = value;
+		}
+		this->size = n;
+	}
+	else {
+		int n = (len / DEC_CHUNK_DIGITS) + 1;
+		if(big_number_base_grow(this, n) != 0) {
+			return 1;
+		}
+
+		limb_t *pow[32];
+		int pown[32];
+		int npow = 0;
+		if(len > (DEC_CHUNK_DIGITS * DEC_BASECASE_LIMBS)) {
+			npow = big_number_base_dec_powers(pow, pown, n);
+			rc = (npow < 0);
+		}
+
+		if(rc == 0) {
+			rc = big_number_base_dec_parse(this->num, str, len, pow, pown, npow);
+		}
+
+		while(npow > 0) {
+			free(pow[--npow]);
+		}
+		this->size = (rc == 0) ? n : 0;
+	}
+
+	this->negative = negative;
+	big_number_base_normalize(this);
+
+	return rc;
+}
+
 /********** Test Methods */
 
 #ifdef TEST
+/*******************************************************************************
+ * Load a small value into a big_number_base object.  Only used by the tests.
+ *
+ * Input:
+ *   this     - The object to load.
+ *   value    - The magnitude.
+ *   negative - 1 == Make the number negative.
+ ******************************************************************************/
+static void big_number_base_test_set(big_number_base *this, uint64_t value, int negative)
+{
+	this->num[0] = value;
+	this->size = 1;
+	this->negative = negative;
+	big_number_base_normalize(this);
+}
+
 /*******************************************************************************
  * Run the big_number_base tests.
  *
@@ -580,102 +2453,413 @@ int big_number_base_test(void)
 
 	printf("%s(): Starting:\n", __func__);
 
+	/* Starting values for some of the tests. */
+	big_number_base *num1 = big_number_base_new();
+	big_number_base *num2 = big_number_base_new();
+	big_number_base *num3 = big_number_base_new();
+	big_number_base *cmp  = big_number_base_new();
+
 	do {
-		/* Test new() and delete(). */
-		big_number_base *obj = big_number_base_new();
-		if(obj == (big_number_base *) 0) { break; }
-		big_number_base_delete(obj);
-
-		/* Starting values for some of the tests. */
-		big_number_base num1 = { // 63,736
-			.num[0] = 0xF8,
-			.num[1] = 0xF8
-		};
-		big_number_base num2 = { //  8,725
-			.num[0] = 0x15,
-			.num[1] = 0x22
-		};
-		big_number_base num3;
+		if(!num1 || !num2 || !num3 || !cmp) { break; }
+
+		big_number_base_test_set(num1, 63736, 0);
+		big_number_base_test_set(num2,  8725, 0);
 
 		/* Addition test. */
 		{
 			/* Expected result (72,461). */
-			big_number_base add_test_cmp = { .num[0] = 0x0D, .num[1] = 0x1B, .num[2] = 0x01 };
+			big_number_base_test_set(cmp, 72461, 0);
 
 			/* Clear the result and run the test. */
-			big_number_base_copy(big_number_base_0(), &num3);
-			big_number_base_add(&num1, &num2, &num3);
-			if(big_number_base_compare(&num3, &add_test_cmp) != 0) { break; }
+			big_number_base_copy(big_number_base_0(), num3);
+			big_number_base_add(num1, num2, num3);
+			if(big_number_base_compare(num3, cmp) != 0) { break; }
 		}
 
 		/* Subtraction test #1. */
 		{
 			/* Expected result (63,736). */
-			big_number_base sub_test_cmp = { .num[0] = 0xF8, .num[1] = 0xF8 };
+			big_number_base_test_set(cmp, 63736, 0);
 
 			/* Clear the result and run the test. */
-			big_number_base_copy(big_number_base_0(), &num1);
-			big_number_base_subtract(&num3, &num2, &num1);
-			if(big_number_base_compare(&num1, &sub_test_cmp) != 0) { break; }
+			big_number_base_copy(big_number_base_0(), num1);
+			big_number_base_subtract(num3, num2, num1);
+			if(big_number_base_compare(num1, cmp) != 0) { break; }
 		}
 
 		/* Subtraction test #2. */
 		{
 			/* Expected result (-5). */
-			big_number_base sub_test_val1 = { .num[0] = 0x02, .negative = 0 };
-			big_number_base sub_test_val2 = { .num[0] = 0x07, .negative = 0 };
-			big_number_base sub_test_res;
-			big_number_base sub_test_cmp =  { .num[0] = 0x05, .negative = 1 };
+			big_number_base *val1 = big_number_base_new();
+			big_number_base *val2 = big_number_base_new();
+			big_number_base *res  = big_number_base_new();
+			big_number_base_test_set(val1, 2, 0);
+			big_number_base_test_set(val2, 7, 0);
+			big_number_base_test_set(cmp,  5, 1);
 
 			/* Clear the result and run the test. */
-			big_number_base_copy(big_number_base_0(), &sub_test_res);
-			big_number_base_subtract(&sub_test_val1, &sub_test_val2, &sub_test_res);
-			if(big_number_base_compare(&sub_test_res, &sub_test_cmp) != 0) { break; }
+			big_number_base_copy(big_number_base_0(), res);
+			big_number_base_subtract(val1, val2, res);
+			int result = big_number_base_compare(res, cmp);
+
+			big_number_base_delete(res);
+			big_number_base_delete(val2);
+			big_number_base_delete(val1);
+			if(result != 0) { break; }
 		}
 
 		/* Multiplication test. */
 		{
 			/* Expected result (556,096,600). */
-			big_number_base mul_test_cmp = { .num[0] = 0x58, .num[1] = 0x5C, .num[2] = 0x25, .num[3] = 0x21 };
-	
+			big_number_base_test_set(cmp, 556096600, 0);
+
 			/* Clear the result and run the test. */
-			big_number_base_copy(big_number_base_0(), &num3);
-			big_number_base_multiply(&num1, &num2, &num3);
-			if(big_number_base_compare(&num3, &mul_test_cmp) != 0) { break; }
+			big_number_base_copy(big_number_base_0(), num3);
+			big_number_base_multiply(num1, num2, num3);
+			if(big_number_base_compare(num3, cmp) != 0) { break; }
 		}
 
 		/* Division test. */
 		{
 			/* Expected result (63,736). */
-			big_number_base div_test_cmp = { .num[0] = 0xF8, .num[1] = 0xF8 };
+			big_number_base_test_set(cmp, 63736, 0);
 
 			/* Clear the result and run the test. */
-			big_number_base_copy(big_number_base_0(), &num1);
-			big_number_base_divide(&num3, &num2, &num1);
-			if(big_number_base_compare(&num1, &div_test_cmp) != 0) { break; }
+			big_number_base_copy(big_number_base_0(), num1);
+			big_number_base_divide(num3, num2, num1);
+			if(big_number_base_compare(num1, cmp) != 0) { break; }
 		}
 
 		/* Modulus test. */
 		{
 			/* 137 % 19 = 4. */
-			big_number_base mod_test_val1 = { .num[0] = 0x89 }; // 137
-			big_number_base mod_test_val2 = { .num[0] = 0x13 }; //  19
-			big_number_base mod_test_cmp  = { .num[0] = 0x04 }; //   4
+			big_number_base_test_set(num1, 137, 0);
+			big_number_base_test_set(num2,  19, 0);
+			big_number_base_test_set(cmp,    4, 0);
 
 			/* Clear the result and run the test. */
-			big_number_base mod_cmpult;
-			big_number_base_copy(big_number_base_0(), &mod_cmpult);
-			big_number_base_modulus(&mod_test_val1, &mod_test_val2, &mod_cmpult);
-			if(big_number_base_compare(&mod_cmpult, &mod_test_cmp) != 0) { break; }
+			big_number_base_copy(big_number_base_0(), num3);
+			big_number_base_modulus(num1, num2, num3);
+			if(big_number_base_compare(num3, cmp) != 0) { break; }
+		}
+
+		/* Multi-limb test.  (2^64 - 1)^2 = (2^128 - 2^65 + 1), and then
+		 * divide it back down again. */
+		{
+			big_number_base_test_set(num1, UINT64_MAX, 0);
+			big_number_base_multiply(num1, num1, num2);
+			if(strcmp(big_number_base_to_hex_str(num2, 0),
+			          "+FF:FF:FF:FF:FF:FF:FF:FE:00:00:00:00:00:00:00:01") != 0) { break; }
+
+			big_number_base_add(num2, num1, num3);
+			big_number_base_add(num3, big_number_base_1(), num3);  // 2^128 - 2^64
+			big_number_base_divide(num3, num1, num3);              // 2^64
+			if(strcmp(big_number_base_to_hex_str(num3, 0),
+			          "+01:00:00:00:00:00:00:00:00") != 0) { break; }
+
+			big_number_base_modulus(num2, num3, num3);             // 1
+			if(big_number_base_compare(num3, big_number_base_1()) != 0) { break; }
+		}
+
+		/* Long division test.  This one needs the rare "add back" step
+		 * in Algorithm D, because the first quotient limb estimate is
+		 * still 1 too big after it has been refined. */
+		{
+			static const limb_t a[] = { 1, 0, 0x7FFFFFFFFFFFFFFFULL, 0xFFFFFFFFFFFFFFFEULL };
+			static const limb_t d[] = { 0xFFFFFFFFFFFFFFFEULL, 0x7FFFFFFFFFFFFFFFULL, 0xFFFFFFFFFFFFFFFEULL };
+			if(big_number_base_grow(num1, 4) != 0) { break; }
+			if(big_number_base_grow(num2, 3) != 0) { break; }
+			memcpy(num1->num, a, sizeof(a));
+			memcpy(num2->num, d, sizeof(d));
+			num1->size = 4;
+			num2->size = 3;
+			num1->negative = num2->negative = 0;
+
+			big_number_base_divide(num1, num2, num3);
+			if(strcmp(big_number_base_to_hex_str(num3, 0),
+			          "+FF:FF:FF:FF:FF:FF:FF:FF") != 0) { break; }
+			big_number_base_modulus(num1, num2, num3);
+			if(strcmp(big_number_base_to_hex_str(num3, 0),
+			          "+FF:FF:FF:FF:FF:FF:FF:FD:80:00:00:00:00:00:00:01:FF:FF:FF:FF:FF:FF:FF:FF") != 0) { break; }
+		}
+
+		/* Barrett reduction test.  Reduce values of every length from 0
+		 * limbs up to past the Barrett limit (2k limbs), and compare them
+		 * to a plain modulus. */
+		{
+			big_number_base_reducer *reducer = (big_number_base_reducer *) 0;
+			uint64_t seed = 88172645463325252ULL;
+			int k, xn, failed = 0;
+			for(k = 1; (k <= 4) && (failed == 0); k++) {
+				for(xn = 0; (xn <= ((2 * k) + 1)) && (failed == 0); xn++) {
+					/* Random modulus and value.  Some of the value's limbs are all
+					 * ones, to push the quotient estimate to its limits. */
+					int i;
+					if((big_number_base_grow(num2, k) != 0) || (big_number_base_grow(num1, xn) != 0)) { failed = 1; break; }
+					for(i = 0; i < (k + xn); i++) {
+						seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+						limb_t limb = ((seed % 3) == 0) ? UINT64_MAX : seed;
+						if(i < k) { num2->num[i] = limb; } else { num1->num[i - k] = limb; }
+					}
+					num2->size = k;
+					num1->size = xn;
+					num1->negative = xn & 1;
+					num2->negative = 0;
+					big_number_base_normalize(num1);
+					big_number_base_normalize(num2);
+
+					big_number_base_reducer_delete(reducer);
+					if((reducer = big_number_base_reducer_new(num2)) == (big_number_base_reducer *) 0) { failed = 1; break; }
+					big_number_base_modulus(num1, num2, cmp);
+					big_number_base_reduce(reducer, num1, num1);
+					failed = (big_number_base_compare(num1, cmp) != 0);
+				}
+			}
+			big_number_base_reducer_delete(reducer);
+			if(failed != 0) { break; }
+		}
+
+		/* GCD test.  gcd(2^128 - 1, -(2^96 - 1)) = 2^32 - 1. */
+		{
+			big_number_base_test_set(num1, UINT64_MAX, 0);
+			big_number_base_add(num1, big_number_base_1(), num2);      // 2^64
+			big_number_base_shift_left(num2, 64, num3);                // 2^128
+			big_number_base_subtract(num3, big_number_base_1(), num1); // 2^128 - 1
+			big_number_base_shift_left(num2, 32, num3);                // 2^96
+			big_number_base_subtract(big_number_base_1(), num3, num2); // -(2^96 - 1)
+			big_number_base_gcd(num1, num2, num3);
+			big_number_base_test_set(cmp, 0xFFFFFFFFULL, 0);
+			if(big_number_base_compare(num3, cmp) != 0) { break; }
+		}
+
+		/* Modular inverse test.  Random values of every length up to 4
+		 * limbs, with odd and even moduli.  Either (a * inverse) % m is 1,
+		 * or a and m share a factor. */
+		{
+			uint64_t seed = 2463534242ULL;
+			int k, an, failed = 0;
+			for(k = 1; (k <= 4) && (failed == 0); k++) {
+				for(an = 1; (an <= (k + 1)) && (failed == 0); an++) {
+					int i;
+					if((big_number_base_grow(num2, k) != 0) || (big_number_base_grow(num1, an) != 0)) { failed = 1; break; }
+					for(i = 0; i < (k + an); i++) {
+						seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+						if(i < k) { num2->num[i] = seed; } else { num1->num[i - k] = seed; }
+					}
+					num2->size = k;
+					num1->size = an;
+					num1->negative = an & 1;
+					num2->negative = 0;
+					big_number_base_normalize(num1);
+					big_number_base_normalize(num2);
+
+					if(big_number_base_mod_inverse(num1, num2, num3) == 0) {
+						big_number_base_multiply(num1, num3, num3);
+						big_number_base_modulus(num3, num2, num3);
+						if(num3->negative == 1) {
+							big_number_base_add(num3, num2, num3);
+						}
+						failed = (big_number_base_compare(num3, big_number_base_1()) != 0);
+					}
+					else {
+						big_number_base_gcd(num1, num2, num3);
+						failed = (big_number_base_compare(num3, big_number_base_1()) == 0);
+					}
+				}
+			}
+			if(failed != 0) { break; }
+		}
+
+		/* Decimal test.  10^760 is long enough to be split up.  Check
+		 * 10^760 - 1 (all nines) and -(10^760), both ways. */
+		{
+			char str[800];
+			int i;
+			big_number_base_test_set(num1, 1, 0);
+			big_number_base_test_set(num2, DEC_CHUNK, 0);
+			for(i = 0; i < 40; i++) {
+				big_number_base_multiply(num1, num2, num1);
+			}
+			big_number_base_subtract(num1, big_number_base_1(), num3);
+			if(big_number_base_to_dec_str(num3, str, sizeof(str)) != 0) { break; }
+			i = 0;
+			while((i < 760) && (str[i] == '9')) {
+				i++;
+			}
+			if((i != 760) || (str[760] != 0)) { break; }
+			if(big_number_base_from_str(num2, str) != 0) { break; }
+			if(big_number_base_compare(num2, num3) != 0) { break; }
+
+			big_number_base_subtract(big_number_base_0(), num1, num3);
+			if(big_number_base_to_dec_str(num3, str, sizeof(str)) != 0) { break; }
+			i = 2;
+			while((i < 762) && (str[i] == '0')) {
+				i++;
+			}
+			if((str[0] != '-') || (str[1] != '1') || (i != 762) || (str[762] != 0)) { break; }
+			if(big_number_base_from_str(num2, str) != 0) { break; }
+			if(big_number_base_compare(num2, num3) != 0) { break; }
+
+			/* Too small a buffer fails. */
+			if(big_number_base_to_dec_str(num3, str, 100) == 0) { break; }
+
+			/* Hex input, across a limb boundary. */
+			if(big_number_base_from_str(num2, "-0x1fedcba9876543210") != 0) { break; }
+			if(strcmp(big_number_base_to_hex_str(num2, 0), "-01:FE:DC:BA:98:76:54:32:10") != 0) { break; }
+
+			/* Bad strings. */
+			if(big_number_base_from_str(num2, "") == 0) { break; }
+			if(big_number_base_from_str(num2, "-") == 0) { break; }
+			if(big_number_base_from_str(num2, "0x") == 0) { break; }
+			if(big_number_base_from_str(num2, "12a") == 0) { break; }
+			if(big_number_base_from_str(num2, "0x12g") == 0) { break; }
+		}
+
+		/* In-place tests.  x = 2^64 - 1.  (x += x) = 2^65 - 2, then
+		 * (x *= -3) and (x *= x) in place must match the copying
+		 * versions.  (x -= x) = 0. */
+		{
+			big_number_base_test_set(num1, UINT64_MAX, 0);
+			big_number_base_add_to(num1, num1);
+			if(strcmp(big_number_base_to_hex_str(num1, 0), "+01:FF:FF:FF:FF:FF:FF:FF:FE") != 0) { break; }
+			big_number_base_test_set(num2, 3, 1);
+			big_number_base_mul_into(num1, num2, num1, num3);
+			if(strcmp(big_number_base_to_hex_str(num1, 0), "-05:FF:FF:FF:FF:FF:FF:FF:FA") != 0) { break; }
+			big_number_base_square(num1, cmp);
+			big_number_base_mul_into(num1, num1, num1, num3);
+			if(big_number_base_compare(num1, cmp) != 0) { break; }
+			big_number_base_sub_from(num1, num1);
+			if(num1->size != 0) { break; }
+			big_number_base_mul_into(num1, num2, num1, num3);
+			big_number_base_set_u64(num1, 5);
+			big_number_base_sub_from(num1, num2);
+			if(big_number_base_compare(num1, num2) <= 0) { break; }
 		}
 
+		/* Square test.  (-(2^64 - 1))^2 = (2^128 - 2^65 + 1). */
+		{
+			big_number_base_test_set(num1, UINT64_MAX, 1);
+			big_number_base_square(num1, num1);
+			if(strcmp(big_number_base_to_hex_str(num1, 0),
+			          "+FF:FF:FF:FF:FF:FF:FF:FE:00:00:00:00:00:00:00:01") != 0) { break; }
+		}
+
+		/* Bit tests. */
+		{
+			if(big_number_base_bit_length(num1) != 128) { break; }
+			if(big_number_base_test_bit(num1, 0) != 1) { break; }
+			if(big_number_base_test_bit(num1, 1) != 0) { break; }
+			if(big_number_base_test_bit(num1, 127) != 1) { break; }
+			if(big_number_base_test_bit(num1, 128) != 0) { break; }
+			if(big_number_base_bit_length(big_number_base_0()) != 0) { break; }
+		}
+
+		/* Modular exponentiation tests.  An odd modulus uses Montgomery
+		 * form, and an even modulus doesn't. */
+		{
+			big_number_base_mont *mont;
+
+			/* (4 ^ 13) % 497 = 445. */
+			big_number_base_test_set(num1,   4, 0);
+			big_number_base_test_set(num2,  13, 0);
+			big_number_base_test_set(num3, 497, 0);
+			big_number_base_test_set(cmp,  445, 0);
+			if((mont = big_number_base_mont_new(num3)) == (big_number_base_mont *) 0) { break; }
+			big_number_base_mont_exp(mont, num1, num2, num1);
+			big_number_base_mont_delete(mont);
+			if(big_number_base_compare(num1, cmp) != 0) { break; }
+
+			/* (7 ^ 77) % 1000 = 207. */
+			big_number_base_test_set(num1,    7, 0);
+			big_number_base_test_set(num2,   77, 0);
+			big_number_base_test_set(num3, 1000, 0);
+			big_number_base_test_set(cmp,   207, 0);
+			if((mont = big_number_base_mont_new(num3)) == (big_number_base_mont *) 0) { break; }
+			big_number_base_mont_exp(mont, num1, num2, num1);
+			big_number_base_mont_delete(mont);
+			if(big_number_base_compare(num1, cmp) != 0) { break; }
+
+			/* ((-2) ^ 3) % 7 = 6. */
+			big_number_base_test_set(num1, 2, 1);
+			big_number_base_test_set(num2, 3, 0);
+			big_number_base_test_set(num3, 7, 0);
+			big_number_base_test_set(cmp,  6, 0);
+			if((mont = big_number_base_mont_new(num3)) == (big_number_base_mont *) 0) { break; }
+			big_number_base_mont_exp(mont, num1, num2, num1);
+			big_number_base_mont_delete(mont);
+			if(big_number_base_compare(num1, cmp) != 0) { break; }
+
+			/* A 2 limb modulus.  ((2^64 - 1) ^ 65537) % (2^127 - 1). */
+			big_number_base_test_set(num1, UINT64_MAX, 0);
+			big_number_base_add(num1, big_number_base_1(), num2);     // 2^64
+			big_number_base_test_set(num3, 1ULL << 63, 0);
+			big_number_base_multiply(num3, num2, num3);               // 2^127
+			big_number_base_subtract(num3, big_number_base_1(), num3); // 2^127 - 1
+			big_number_base_test_set(num2, 65537, 0);
+			if((mont = big_number_base_mont_new(num3)) == (big_number_base_mont *) 0) { break; }
+			big_number_base_mont_exp(mont, num1, num2, num1);
+			big_number_base_mont_delete(mont);
+			if(strcmp(big_number_base_to_hex_str(num1, 0),
+			          "+62:EB:34:A1:E5:D0:60:00:1C:0C:39:49:BE:93:D0:15") != 0) { break; }
+
+			/* Fixed-base.  Raise the same base to a few exponents, and
+			 * compare against the plain version. */
+			big_number_base_mont_fixed *fixed = (big_number_base_mont_fixed *) 0;
+			int i;
+			mont = big_number_base_mont_new(num3);
+			big_number_base_test_set(num1, 3, 0);
+			if(mont != (big_number_base_mont *) 0) {
+				fixed = big_number_base_mont_fixed_new(mont, num1, 0);
+			}
+			for(i = 0; (fixed != (big_number_base_mont_fixed *) 0) && (i < 4); i++) {
+				big_number_base_test_set(num2, (i == 3) ? UINT64_MAX : (1ULL << (i * 20)) + 5, 0);
+				big_number_base_mont_exp(mont, num1, num2, cmp);
+				big_number_base_mont_fixed_exp(fixed, num2, num2);
+				if(big_number_base_compare(num2, cmp) != 0) { break; }
+			}
+			big_number_base_mont_fixed_delete(fixed);
+			big_number_base_mont_delete(mont);
+			if(i != 4) { break; }
+
+			/* (3 ^ (2^64 - 1)) % (2^127 - 1). */
+			if(strcmp(big_number_base_to_hex_str(cmp, 0),
+			          "+29:AA:59:84:9A:B8:61:37:99:12:3B:CA:FD:6D:67:03") != 0) { break; }
+
+			/* An exponent longer than the comb table (3 limbs) falls back
+			 * to the sliding window. */
+			mont = big_number_base_mont_new(num3);
+			fixed = (big_number_base_mont_fixed *) 0;
+			if(mont != (big_number_base_mont *) 0) {
+				fixed = big_number_base_mont_fixed_new(mont, num1, 0);
+			}
+			big_number_base_test_set(num2, UINT64_MAX, 0);
+			big_number_base_square(num2, cmp);
+			big_number_base_multiply(cmp, num2, num2);
+			big_number_base_mont_exp(mont, num1, num2, cmp);
+			big_number_base_mont_fixed_exp(fixed, num2, num2);
+			i = (fixed == (big_number_base_mont_fixed *) 0) || (big_number_base_compare(num2, cmp) != 0);
+			big_number_base_mont_fixed_delete(fixed);
+			big_number_base_mont_delete(mont);
+			if(i != 0) { break; }
+		}
+
+		/* Check the kernels against each other, then run the
+		 * multiplication engine through all of its algorithms. */
+		if(big_number_kernel_test() != 0) { break; }
+		if(big_number_mul_test() != 0) { break; }
+		if(big_number_ntt_test() != 0) { break; }
+
 		/* Complete.  Pass. */
 		rc = 0;
 
 	} while(0);
 
+	big_number_base_delete(cmp);
+	big_number_base_delete(num3);
+	big_number_base_delete(num2);
+	big_number_base_delete(num1);
+
 	printf("%s(): %s.\n", __func__, (rc == 0) ? "PASS" : "FAIL");
 	return rc;
 }
 #endif /* TEST */
-
@@ -5,6 +5,7 @@
  *
  ******************************************************************************/
 
+#include <ctype.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -21,20 +22,35 @@ struct big_number_base {
 	int64_t num;
 };
 
+/* This is the big_number_base_mont class. */
+struct big_number_base_mont {
+	int64_t modulus;
+};
+
+/* This is the big_number_base_reducer class. */
+struct big_number_base_reducer {
+	big_number_base modulus;
+};
+
+/* This is the big_number_base_mont_fixed class. */
+struct big_number_base_mont_fixed {
+	const big_number_base_mont *mont;
+	big_number_base base;
+};
+
 /********************************** CONSTANTS *********************************/
 
-/*******************************************************************************
- * Singleton: Return a pointer to a big_number_base object that contains 1.
- ******************************************************************************/
+const big_number_base big_number_base_const_0    = {    0 };
+const big_number_base big_number_base_const_1    = {    1 };
+const big_number_base big_number_base_const_2    = {    2 };
+const big_number_base big_number_base_const_10   = {   10 };
+const big_number_base big_number_base_const_100  = {  100 };
+const big_number_base big_number_base_const_256  = {  256 };
+const big_number_base big_number_base_const_1000 = { 1000 };
+
 const big_number_base *big_number_base_1(void)
 {
-	static big_number_base *this = (big_number_base *) 0;
-	if(this == (big_number_base *) 0) {
-		if((this = big_number_base_new()) != (big_number_base *) 0) {
-			this->num = 1;
-		}
-	}
-	return this;
+	return &big_number_base_const_1;
 }
 
 /********************************** PUBLIC API ********************************/
@@ -63,6 +79,52 @@ void big_number_base_copy(const big_number_base *src, big_number_base *dst)
 	}
 }
 
+void big_number_base_set_u64(big_number_base *this, uint64_t value)
+{
+	if(this != (big_number_base *) 0) {
+		this->num = (int64_t) value;
+	}
+}
+
+int big_number_base_from_bytes(big_number_base *this, const uint8_t *buf, int len)
+{
+	if((this == (big_number_base *) 0) || (len < 0) || ((buf == (const uint8_t *) 0) && (len > 0))) {
+		return 1;
+	}
+
+	/* Leading zero bytes are fine, but the value has to fit in 63 bits. */
+	uint64_t value = 0;
+	int i;
+	for(i = 0; i < len; i++) {
+		if((value >> 55) != 0) {
+			return 1;
+		}
+		value = (value << 8) | buf[i];
+	}
+	if((value >> 63) != 0) {
+		return 1;
+	}
+
+	this->num = (int64_t) value;
+	return 0;
+}
+
+int big_number_base_to_bytes(const big_number_base *this, uint8_t *buf, int len)
+{
+	if((this == (big_number_base *) 0) || (buf == (uint8_t *) 0) || (len < 0)) {
+		return 1;
+	}
+
+	uint64_t value = (this->num < 0) ? -(uint64_t) this->num : (uint64_t) this->num;
+	int i;
+	for(i = len - 1; i >= 0; i--) {
+		buf[i] = (uint8_t) value;
+		value >>= 8;
+	}
+
+	return (value != 0);
+}
+
 /********** Math Operations */
 
 void big_number_base_add(const big_number_base *addend1, const big_number_base *addend2, big_number_base *sum)
@@ -79,6 +141,16 @@ void big_number_base_subtract(const big_number_base *minuend, const big_number_b
 	}
 }
 
+void big_number_base_add_to(big_number_base *this, const big_number_base *addend)
+{
+	big_number_base_add(this, addend, this);
+}
+
+void big_number_base_sub_from(big_number_base *this, const big_number_base *subtrahend)
+{
+	big_number_base_subtract(this, subtrahend, this);
+}
+
 void big_number_base_multiply(const big_number_base *factor1, const big_number_base *factor2, big_number_base *product)
 {
 	if((factor1 != (big_number_base *) 0) && (factor2 != (big_number_base *) 0) && (product != (big_number_base *) 0)) {
@@ -86,6 +158,19 @@ void big_number_base_multiply(const big_number_base *factor1, const big_number_b
 	}
 }
 
+void big_number_base_mul_into(const big_number_base *factor1, const big_number_base *factor2,
+                              big_number_base *product, big_number_base *scratch)
+{
+	big_number_base_multiply(factor1, factor2, product);
+}
+
+void big_number_base_square(const big_number_base *this, big_number_base *result)
+{
+	if((this != (big_number_base *) 0) && (result != (big_number_base *) 0)) {
+		result->num = this->num * this->num;
+	}
+}
+
 void big_number_base_divide(const big_number_base *dividend, const big_number_base *divisor, big_number_base *quotient)
 {
 	if((dividend != (big_number_base *) 0) && (divisor != (big_number_base *) 0) && (quotient != (big_number_base *) 0)) {
@@ -100,6 +185,184 @@ void big_number_base_modulus(const big_number_base *this, const big_number_base
 	}
 }
 
+uint64_t big_number_base_modulus_u64(const big_number_base *this, uint64_t modulus)
+{
+	uint64_t rc = 0;
+
+	if((this != (big_number_base *) 0) && (modulus != 0)) {
+		uint64_t magnitude = (this->num < 0) ? -this->num : this->num;
+		rc = magnitude % modulus;
+	}
+
+	return rc;
+}
+
+/********** Modular Exponentiation Methods */
+
+/* The exponents are at most 64 bits, so a window of 1 (square and multiply) is
+ * plenty. */
+int big_number_base_window_bits(int bits)
+{
+	return 1;
+}
+
+big_number_base_mont *big_number_base_mont_new(const big_number_base *modulus)
+{
+	big_number_base_mont *this = (big_number_base_mont *) 0;
+
+	if((modulus != (big_number_base *) 0) && (modulus->num != 0)) {
+		this = (big_number_base_mont *) malloc(sizeof(*this));
+		if(this != (big_number_base_mont *) 0) {
+			this->modulus = (modulus->num < 0) ? -modulus->num : modulus->num;
+		}
+	}
+
+	return this;
+}
+
+void big_number_base_mont_delete(big_number_base_mont *this)
+{
+	if(this != (big_number_base_mont *) 0) {
+		free(this);
+	}
+}
+
+void big_number_base_mont_exp(const big_number_base_mont *this, const big_number_base *base,
+                              const big_number_base *exp, big_number_base *result)
+{
+	if((this != (big_number_base_mont *) 0) && (base != (big_number_base *) 0) &&
+	   (exp != (big_number_base *) 0) && (result != (big_number_base *) 0) && (exp->num >= 0)) {
+		/* The products are done in 128 bits, so they can't overflow. */
+		uint64_t m = this->modulus;
+		int64_t b = base->num % this->modulus;
+		uint64_t x = (b < 0) ? (b + this->modulus) : b;
+		uint64_t e = exp->num;
+		uint64_t r = 1 % m;
+
+		while(e != 0) {
+			if(e & 1) {
+				r = ((unsigned __int128) r * x) % m;
+			}
+			x = ((unsigned __int128) x * x) % m;
+			e >>= 1;
+		}
+
+		result->num = r;
+	}
+}
+
+big_number_base_mont_fixed *big_number_base_mont_fixed_new(const big_number_base_mont *mont, const big_number_base *base,
+                                                           int exp_bits)
+{
+	big_number_base_mont_fixed *this = (big_number_base_mont_fixed *) 0;
+
+	if((mont != (big_number_base_mont *) 0) && (base != (big_number_base *) 0)) {
+		this = (big_number_base_mont_fixed *) malloc(sizeof(*this));
+		if(this != (big_number_base_mont_fixed *) 0) {
+			this->mont = mont;
+			this->base.num = base->num;
+		}
+	}
+
+	return this;
+}
+
+void big_number_base_mont_fixed_delete(big_number_base_mont_fixed *this)
+{
+	if(this != (big_number_base_mont_fixed *) 0) {
+		free(this);
+	}
+}
+
+int big_number_base_mont_fixed_exp(const big_number_base_mont_fixed *this, const big_number_base *exp, big_number_base *result)
+{
+	if((this == (big_number_base_mont_fixed *) 0) || (exp == (big_number_base *) 0) ||
+	   (result == (big_number_base *) 0) || (exp->num < 0)) {
+		return 1;
+	}
+
+	big_number_base_mont_exp(this->mont, &this->base, exp, result);
+	return 0;
+}
+
+/********** Barrett Reduction Methods */
+
+big_number_base_reducer *big_number_base_reducer_new(const big_number_base *modulus)
+{
+	big_number_base_reducer *this = (big_number_base_reducer *) 0;
+
+	if((modulus != (big_number_base *) 0) && (modulus->num != 0)) {
+		this = (big_number_base_reducer *) malloc(sizeof(*this));
+		if(this != (big_number_base_reducer *) 0) {
+			this->modulus.num = (modulus->num < 0) ? -modulus->num : modulus->num;
+		}
+	}
+
+	return this;
+}
+
+void big_number_base_reducer_delete(big_number_base_reducer *this)
+{
+	if(this != (big_number_base_reducer *) 0) {
+		free(this);
+	}
+}
+
+void big_number_base_reduce(const big_number_base_reducer *this, const big_number_base *x, big_number_base *result)
+{
+	if(this != (big_number_base_reducer *) 0) {
+		big_number_base_modulus(x, &this->modulus, result);
+	}
+}
+
+/********** GCD Methods */
+
+void big_number_base_gcd(const big_number_base *a, const big_number_base *b, big_number_base *result)
+{
+	if((a != (big_number_base *) 0) && (b != (big_number_base *) 0) && (result != (big_number_base *) 0)) {
+		uint64_t x = (a->num < 0) ? -a->num : a->num;
+		uint64_t y = (b->num < 0) ? -b->num : b->num;
+		while(y != 0) {
+			uint64_t t = x % y;
+			x = y;
+			y = t;
+		}
+		result->num = x;
+	}
+}
+
+int big_number_base_mod_inverse(const big_number_base *this, const big_number_base *modulus, big_number_base *result)
+{
+	int rc = 1;
+
+	if((this != (big_number_base *) 0) && (modulus != (big_number_base *) 0) &&
+	   (result != (big_number_base *) 0) && (modulus->num != 0)) {
+		/* Extended Euclid.  The products are done in 128 bits, so they
+		 * can't overflow. */
+		int64_t m = (modulus->num < 0) ? -modulus->num : modulus->num;
+		int64_t a = this->num % m;
+		if(a < 0) {
+			a += m;
+		}
+
+		__int128 old_r = a, r = m, old_s = 1, s = 0;
+		while(r != 0) {
+			__int128 q = old_r / r;
+			__int128 t;
+			t = old_r - (q * r); old_r = r; r = t;
+			t = old_s - (q * s); old_s = s; s = t;
+		}
+
+		if((old_r == 1) || (m == 1)) {
+			old_s %= m;
+			result->num = (int64_t) ((old_s < 0) ? (old_s + m) : old_s);
+			rc = 0;
+		}
+	}
+
+	return rc;
+}
+
 /********** Comparison Methods */
 
 int big_number_base_compare(const big_number_base *a, const big_number_base *b)
@@ -144,6 +407,49 @@ int big_number_base_is_negative(const big_number_base *this)
 	return retcode;
 }
 
+/********** Bit Methods */
+
+void big_number_base_shift_left(const big_number_base *this, int bits, big_number_base *result)
+{
+	if((this != (big_number_base *) 0) && (result != (big_number_base *) 0) && (bits >= 0) && (bits < 64)) {
+		result->num = this->num * (((int64_t) 1) << bits);
+	}
+}
+
+void big_number_base_shift_right(const big_number_base *this, int bits, big_number_base *result)
+{
+	if((this != (big_number_base *) 0) && (result != (big_number_base *) 0) && (bits >= 0)) {
+		result->num = (bits < 63) ? (this->num / (((int64_t) 1) << bits)) : 0;
+	}
+}
+
+int big_number_base_bit_length(const big_number_base *this)
+{
+	int bits = 0;
+
+	if(this != (big_number_base *) 0) {
+		uint64_t magnitude = (this->num < 0) ? -this->num : this->num;
+		while(magnitude != 0) {
+			bits++;
+			magnitude >>= 1;
+		}
+	}
+
+	return bits;
+}
+
+int big_number_base_test_bit(const big_number_base *this, int bit)
+{
+	int rc = 0;
+
+	if((this != (big_number_base *) 0) && (bit >= 0) && (bit < 64)) {
+		uint64_t magnitude = (this->num < 0) ? -this->num : this->num;
+		rc = (magnitude >> bit) & 1;
+	}
+
+	return rc;
+}
+
 /*******************************************************************************
  * Returns a string that contains the contents of a big_number_base object.
  *
@@ -188,6 +494,59 @@ big_number_base_to_hex_str(const big_number_base *this, int zero_fill)
 	return str;
 }
 
+int big_number_base_to_dec_str(const big_number_base *this, char *str, int size)
+{
+	int rc = 1;
+
+	if((this != (big_number_base *) 0) && (str != (char *) 0)) {
+		rc = (snprintf(str, size, "%jd", (intmax_t) this->num) >= size);
+	}
+
+	return rc;
+}
+
+
+int big_number_base_from_str(big_number_base *this, const char *str)
+{
+	if((this == (big_number_base *) 0) || (str == (const char *) 0)) {
+		return 1;
+	}
+
+	int negative = 0;
+	if((*str == '-') || (*str == '+')) {
+		negative = (*(str++) == '-');
+	}
+
+	int base = 10;
+	if((str[0] == '0') && ((str[1] == 'x') || (str[1] == 'X'))) {
+		base = 16;
+		str += 2;
+	}
+
+	if(*str == 0) {
+		return 1;
+	}
+
+	int64_t value = 0;
+	while(*str) {
+		char c = *(str++);
+		int digit;
+		if((c >= '0') && (c <= '9')) {
+			digit = c - '0';
+		}
+		else if((base == 16) && (isxdigit((unsigned char) c) != 0)) {
+			digit = (c | 0x20) - 'a' + 10;
+		}
+		else {
+			return 1;
+		}
+		value = (value * base) + digit;
+	}
+
+	this->num = negative ? -value : value;
+	return 0;
+}
+
 #ifdef TEST
 /********** Test Methods */
 
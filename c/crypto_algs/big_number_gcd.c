@@ -0,0 +1,298 @@
+/*******************************************************************************
+ *
+ * This module calculates GCDs and modular inverses on limb arrays for
+ * big_number_base_full.c.
+ *
+ * It's the binary GCD.  With b odd, repeat:
+ *
+ *   if a is even:  a = a / 2
+ *   else:          if a < b, swap a and b.  a = (a - b) / 2
+ *
+ * until a is 0.  Then b is the GCD.  Carrying u and v along (a = u * y and
+ * b = v * y, mod m) turns it into a modular inverse.  There's no division,
+ * only shifts and subtracts, and each step removes at least one bit, so it
+ * takes at most (2 * bits) steps.
+ *
+ * Doing each step on the whole number would cost a pass over every limb per
+ * bit.  Instead, the steps are done in batches of 31, Lehmer style (see
+ * "Optimized Binary GCD for Modular Inversion", T. Pornin, 2020).  The batch
+ * is run on a 64-bit approximation of a and b: the low 31 bits, which decide
+ * the parity of every step exactly, and the top 33 bits, which decide the
+ * comparisons (almost always correctly).  The batch is recorded in a 2x2
+ * matrix of small factors, and then applied to the full a, b, u, and v in one
+ * pass:
+ *
+ *   a' = (f0 * a + g0 * b) / 2^31      u' = (f0 * u + g0 * v) / 2^31
+ *   b' = (f1 * a + g1 * b) / 2^31      v' = (f1 * u + g1 * v) / 2^31
+ *
+ * If a comparison was wrong, a' or b' comes out negative.  It's just negated.
+ * The divisions of u and v are mod m, done with one Montgomery step.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "big_number_limb.h"
+
+/* Number of steps per batch. */
+#define GCD_BATCH 31
+
+/********************************* PRIVATE API ********************************/
+
+/*******************************************************************************
+ * Get a 64-bit approximation of a for one batch.
+ *
+ * Input:
+ *   a    - The number.  n limbs.
+ *   n    - Number of limbs.
+ *   bits - Bit length of the larger of a and b.
+ *
+ * Output:
+ *   a itself if bits <= 64.  Otherwise the low 31 bits of a, with bits
+ *   (bits - 33) to (bits - 1) of a on top of them.
+ ******************************************************************************/
+static uint64_t gcd_approx(const limb_t *a, int n, int bits)
+{
+	if(bits <= LIMB_BITS) {
+		return a[0];
+	}
+
+	int pos = bits - 33;
+	int limb = pos / LIMB_BITS;
+	int shift = pos % LIMB_BITS;
+	uint64_t top = a[limb] >> shift;
+	if((shift != 0) && ((limb + 1) < n)) {
+		top |= a[limb + 1] << (LIMB_BITS - shift);
+	}
+	top &= (((uint64_t) 1) << 33) - 1;
+
+	return (top << GCD_BATCH) | (a[0] & ((((uint64_t) 1) << GCD_BATCH) - 1));
+}
+
+/*******************************************************************************
+ * r = (a * f + b * g) / 2^31.  The division must be exact.
+ *
+ * Input:
+ *   r    - Receives the magnitude of the result.  n limbs.
+ *   a, b - The numbers.  n limbs.
+ *   f, g - The factors.  |f|, |g| <= 2^31.
+ *   n    - Number of limbs.  The magnitude of the result must fit.
+ *
+ * Output:
+ *   Returns 1 if the result was negative, 0 if not.
+ ******************************************************************************/
+static int gcd_combine(limb_t *r, const limb_t *a, const limb_t *b, int64_t f, int64_t g, int n)
+{
+	/* The low bits that get shifted off are zero, so shift as we go. */
+	__int128 carry = 0;
+	limb_t prev = 0;
+	int i;
+	for(i = 0; i < n; i++) {
+		carry += ((__int128) a[i] * f) + ((__int128) b[i] * g);
+		limb_t limb = (limb_t) carry;
+		carry >>= LIMB_BITS;
+		if(i > 0) {
+			r[i - 1] = (prev >> GCD_BATCH) | (limb << (LIMB_BITS - GCD_BATCH));
+		}
+		prev = limb;
+	}
+	limb_t top = (limb_t) carry;
+	r[n - 1] = (prev >> GCD_BATCH) | (top << (LIMB_BITS - GCD_BATCH));
+
+	/* Two's complement negate. */
+	int negative = ((int64_t) top < 0);
+	if(negative) {
+		limb_t c = 1;
+		for(i = 0; i < n; i++) {
+			r[i] = ~r[i] + c;
+			c = (c != 0) && (r[i] == 0);
+		}
+	}
+
+	return negative;
+}
+
+/*******************************************************************************
+ * r = ((u * f + v * g) / 2^31) % m.
+ *
+ * Input:
+ *   r    - Receives the result.  n limbs, in [0, m).
+ *   u, v - The numbers.  n limbs, in [0, m).
+ *   f, g - The factors.  |f|, |g| <= 2^31.
+ *   m    - The modulus.  n limbs.  Must be odd.
+ *   minv - big_number_limb_mont_inverse(m[0]).
+ *   n    - Number of limbs.
+ *   t    - Scratch space.  n + 1 limbs.
+ ******************************************************************************/
+static void gcd_combine_mod(limb_t *r, const limb_t *u, const limb_t *v, int64_t f, int64_t g,
+                            const limb_t *m, limb_t minv, int n, limb_t *t)
+{
+	/* Add q * m to make the low 31 bits zero.  q < 2^31. */
+	limb_t low = (u[0] * (limb_t) f) + (v[0] * (limb_t) g);
+	int64_t q = (int64_t) ((low * minv) & ((((limb_t) 1) << GCD_BATCH) - 1));
+
+	__int128 carry = 0;
+	limb_t prev = 0;
+	int i;
+	for(i = 0; i < n; i++) {
+		carry += ((__int128) u[i] * f) + ((__int128) v[i] * g) + ((__int128) m[i] * q);
+		limb_t limb = (limb_t) carry;
+		carry >>= LIMB_BITS;
+		if(i > 0) {
+			t[i - 1] = (prev >> GCD_BATCH) | (limb << (LIMB_BITS - GCD_BATCH));
+		}
+		prev = limb;
+	}
+	limb_t top = (limb_t) carry;
+	t[n - 1] = (prev >> GCD_BATCH) | (top << (LIMB_BITS - GCD_BATCH));
+	t[n] = (limb_t) ((int64_t) top >> GCD_BATCH);
+
+	/* The result is in (-2m, 3m).  Bring it into [0, m). */
+	while((int64_t) t[n] < 0) {
+		t[n] += big_number_limb_add_n(t, t, m, n);
+	}
+	while((t[n] != 0) || (big_number_limb_cmp(t, n, m, n) >= 0)) {
+		t[n] -= big_number_limb_sub_n(t, t, m, n);
+	}
+
+	memcpy(r, t, n * sizeof(limb_t));
+}
+
+/*******************************************************************************
+ * Run the binary GCD until a is 0.  See the top of this file.
+ *
+ * Input:
+ *   a, b - The numbers.  n limbs each.  b must be odd.  On return, a is 0 and
+ *          b is the GCD.
+ *   u, v - 0 for a plain GCD.  Otherwise the inverse trackers.  On return, v
+ *          is (1 / y) % m if the GCD is 1.
+ *   m    - The modulus (only used if u != 0).  Must be odd.
+ *   n    - Number of limbs.
+ *   t    - Scratch space.  3 * (n + 1) limbs.
+ ******************************************************************************/
+static void gcd_run(limb_t *a, limb_t *b, limb_t *u, limb_t *v, const limb_t *m, int n, limb_t *t)
+{
+	limb_t *ta = t;
+	limb_t *tb = t + (n + 1);
+	limb_t *tm = t + (2 * (n + 1));
+	limb_t minv = (u != (limb_t *) 0) ? big_number_limb_mont_inverse(m[0]) : 0;
+
+	while(1) {
+		int an = big_number_limb_normalized_size(a, n);
+		if(an == 0) {
+			break;
+		}
+		int bn = big_number_limb_normalized_size(b, n);
+
+		/* Bit length of the larger one. */
+		int size = (an > bn) ? an : bn;
+		limb_t top = a[size - 1] | b[size - 1];
+		int bits = (size * LIMB_BITS) - __builtin_clzll(top);
+
+		/* Run a batch on the approximations. */
+		uint64_t xa = gcd_approx(a, n, bits);
+		uint64_t xb = gcd_approx(b, n, bits);
+		int64_t f0 = 1, g0 = 0, f1 = 0, g1 = 1;
+		int i;
+		for(i = 0; i < GCD_BATCH; i++) {
+			if((xa & 1) != 0) {
+				if(xa < xb) {
+					uint64_t x = xa; xa = xb; xb = x;
+					int64_t s;
+					s = f0; f0 = f1; f1 = s;
+					s = g0; g0 = g1; g1 = s;
+				}
+				xa -= xb;
+				f0 -= f1;
+				g0 -= g1;
+			}
+			xa >>= 1;
+			f1 <<= 1;
+			g1 <<= 1;
+		}
+
+		/* Apply it to the real numbers. */
+		int a_negative = gcd_combine(ta, a, b, f0, g0, n);
+		int b_negative = gcd_combine(tb, a, b, f1, g1, n);
+		memcpy(a, ta, n * sizeof(limb_t));
+		memcpy(b, tb, n * sizeof(limb_t));
+		if(a_negative) {
+			f0 = -f0;
+			g0 = -g0;
+		}
+		if(b_negative) {
+			f1 = -f1;
+			g1 = -g1;
+		}
+
+		if(u != (limb_t *) 0) {
+			gcd_combine_mod(ta, u, v, f0, g0, m, minv, n, tm);
+			gcd_combine_mod(tb, u, v, f1, g1, m, minv, n, tm);
+			memcpy(u, ta, n * sizeof(limb_t));
+			memcpy(v, tb, n * sizeof(limb_t));
+		}
+	}
+}
+
+/********************************** PUBLIC API ********************************/
+
+/*******************************************************************************
+ * Greatest common divisor.  r = gcd(a, b).
+ *
+ * Input:
+ *   r       - Receives the GCD.  n limbs.
+ *   a       - Value 1.  n limbs.
+ *   b       - Value 2.  n limbs.  Must be odd.
+ *   n       - Number of limbs.
+ *   scratch - Scratch space.  5 * (n + 1) limbs.
+ ******************************************************************************/
+void big_number_limb_gcd_odd(limb_t *r, const limb_t *a, const limb_t *b, int n, limb_t *scratch)
+{
+	limb_t *x = scratch;
+	limb_t *y = scratch + (n + 1);
+
+	memcpy(x, a, n * sizeof(limb_t));
+	memcpy(y, b, n * sizeof(limb_t));
+	gcd_run(x, y, (limb_t *) 0, (limb_t *) 0, (limb_t *) 0, n, scratch + (2 * (n + 1)));
+	memcpy(r, y, n * sizeof(limb_t));
+}
+
+/*******************************************************************************
+ * Modular inverse.  r = (1 / a) % m.
+ *
+ * Input:
+ *   r       - Receives the inverse.  n limbs.
+ *   a       - The value to invert.  n limbs, less than m.
+ *   m       - The modulus.  n limbs.  Must be odd.
+ *   n       - Number of limbs.
+ *   scratch - Scratch space.  7 * (n + 1) limbs.
+ *
+ * Output:
+ *   Returns 0 if the inverse exists.
+ *   Returns 1 if it doesn't (gcd(a, m) != 1).
+ ******************************************************************************/
+int big_number_limb_mod_inverse(limb_t *r, const limb_t *a, const limb_t *m, int n, limb_t *scratch)
+{
+	limb_t *x = scratch;
+	limb_t *y = scratch + (n + 1);
+	limb_t *u = scratch + (2 * (n + 1));
+	limb_t *v = scratch + (3 * (n + 1));
+
+	memcpy(x, a, n * sizeof(limb_t));
+	memcpy(y, m, n * sizeof(limb_t));
+	memset(u, 0, n * sizeof(limb_t));
+	memset(v, 0, n * sizeof(limb_t));
+	u[0] = 1;
+	gcd_run(x, y, u, v, m, n, scratch + (4 * (n + 1)));
+
+	/* The GCD has to be 1. */
+	if((y[0] != 1) || (big_number_limb_normalized_size(y, n) != 1)) {
+		return 1;
+	}
+
+	memcpy(r, v, n * sizeof(limb_t));
+	return 0;
+}
@@ -0,0 +1,529 @@
+/*******************************************************************************
+ *
+ * This module holds the innermost limb loops for big_number_base_full.c: add_n,
+ * sub_n, mul_1, and addmul_1.  Almost all of the time in a multiply, a square,
+ * or a Montgomery reduction is spent in them.
+ *
+ * There is more than one version of each loop, and the fastest one that the
+ * CPU can run is picked at startup with __builtin_cpu_supports():
+ *
+ * - generic - Portable C.  The carries are done with unsigned __int128.
+ *
+ * - adx     - x86-64 with BMI2 and ADX (Broadwell and later).  MULX multiplies
+ *             without touching the flags, and ADCX and ADOX are adds that only
+ *             use CF and OF respectively.  That lets addmul_1 run 2 carry
+ *             chains at once: the low half of each product is added to r with
+ *             ADCX, and the high half of the previous product is added with
+ *             ADOX.  add_n and sub_n are unrolled ADC and SBB loops.
+ *
+ * The asm loops do 4 limbs per pass.  They count with LEA and test with JRCXZ,
+ * which leave the flags alone, so the carries stay in the flags from one pass
+ * to the next.  The last (n % 4) limbs are done in C.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "big_number_limb.h"
+
+/******************************* CLASS DEFINITION *****************************/
+
+/* One version of the kernels. */
+typedef struct big_number_kernel {
+
+	const char *name;
+
+	/* Returns 1 if this CPU can run it. */
+	int (*supported)(void);
+
+	limb_t (*add_n)(limb_t *r, const limb_t *a, const limb_t *b, int n);
+	limb_t (*sub_n)(limb_t *r, const limb_t *a, const limb_t *b, int n);
+	limb_t (*mul_1)(limb_t *r, const limb_t *a, int n, limb_t b);
+	limb_t (*addmul_1)(limb_t *r, const limb_t *a, int n, limb_t b);
+} big_number_kernel;
+
+/********************************* PRIVATE API ********************************/
+
+/********** Generic Kernels */
+
+static int big_number_kernel_generic_supported(void)
+{
+	return 1;
+}
+
+static limb_t big_number_kernel_generic_add_n(limb_t *r, const limb_t *a, const limb_t *b, int n)
+{
+	limb_t carry = 0;
+
+	int i;
+	for(i = 0; i < n; i++) {
+		dlimb_t t = (dlimb_t) a[i] + b[i] + carry;
+		r[i] = (limb_t) t;
+		carry = (limb_t) (t >> LIMB_BITS);
+	}
+
+	return carry;
+}
+
+static limb_t big_number_kernel_generic_sub_n(limb_t *r, const limb_t *a, const limb_t *b, int n)
+{
+	limb_t borrow = 0;
+
+	int i;
+	for(i = 0; i < n; i++) {
+		dlimb_t t = (dlimb_t) a[i] - b[i] - borrow;
+		r[i] = (limb_t) t;
+		borrow = (limb_t) (t >> LIMB_BITS) & 1;
+	}
+
+	return borrow;
+}
+
+static limb_t big_number_kernel_generic_mul_1(limb_t *r, const limb_t *a, int n, limb_t b)
+{
+	limb_t carry = 0;
+
+	int i;
+	for(i = 0; i < n; i++) {
+		dlimb_t t = (dlimb_t) a[i] * b + carry;
+		r[i] = (limb_t) t;
+		carry = (limb_t) (t >> LIMB_BITS);
+	}
+
+	return carry;
+}
+
+static limb_t big_number_kernel_generic_addmul_1(limb_t *r, const limb_t *a, int n, limb_t b)
+{
+	limb_t carry = 0;
+
+	int i;
+	for(i = 0; i < n; i++) {
+		dlimb_t t = (dlimb_t) a[i] * b + r[i] + carry;
+		r[i] = (limb_t) t;
+		carry = (limb_t) (t >> LIMB_BITS);
+	}
+
+	return carry;
+}
+
+/********** ADX Kernels */
+
+#if defined(__x86_64__)
+static int big_number_kernel_adx_supported(void)
+{
+	__builtin_cpu_init();
+	return (__builtin_cpu_supports("bmi2") != 0) && (__builtin_cpu_supports("adx") != 0);
+}
+
+static limb_t big_number_kernel_adx_add_n(limb_t *r, const limb_t *a, const limb_t *b, int n)
+{
+	limb_t carry = 0;
+
+	long passes = n / 4;
+	if(passes > 0) {
+		limb_t *rp = r;
+		const limb_t *ap = a;
+		const limb_t *bp = b;
+		limb_t t0, t1;
+		__asm__ volatile(
+			"xorl    %k[t0], %k[t0]\n\t"
+			"1:\n\t"
+			"movq    0(%[ap]), %[t0]\n\t"
+			"adcq    0(%[bp]), %[t0]\n\t"
+			"movq    %[t0], 0(%[rp])\n\t"
+			"movq    8(%[ap]), %[t1]\n\t"
+			"adcq    8(%[bp]), %[t1]\n\t"
+			"movq    %[t1], 8(%[rp])\n\t"
+			"movq    16(%[ap]), %[t0]\n\t"
+			"adcq    16(%[bp]), %[t0]\n\t"
+			"movq    %[t0], 16(%[rp])\n\t"
+			"movq    24(%[ap]), %[t1]\n\t"
+			"adcq    24(%[bp]), %[t1]\n\t"
+			"movq    %[t1], 24(%[rp])\n\t"
+			"leaq    32(%[ap]), %[ap]\n\t"
+			"leaq    32(%[bp]), %[bp]\n\t"
+			"leaq    32(%[rp]), %[rp]\n\t"
+			"leaq    -1(%[passes]), %[passes]\n\t"
+			"jrcxz   2f\n\t"
+			"jmp     1b\n\t"
+			"2:\n\t"
+			"movl    $0, %k[t0]\n\t"
+			"adcq    $0, %[t0]\n\t"
+			: [rp] "+r" (rp), [ap] "+r" (ap), [bp] "+r" (bp), [passes] "+c" (passes),
+			  [t0] "=&r" (t0), [t1] "=&r" (t1)
+			:
+			: "cc", "memory");
+		carry = t0;
+	}
+
+	int i;
+	for(i = n & ~3; i < n; i++) {
+		dlimb_t t = (dlimb_t) a[i] + b[i] + carry;
+		r[i] = (limb_t) t;
+		carry = (limb_t) (t >> LIMB_BITS);
+	}
+
+	return carry;
+}
+
+static limb_t big_number_kernel_adx_sub_n(limb_t *r, const limb_t *a, const limb_t *b, int n)
+{
+	limb_t borrow = 0;
+
+	long passes = n / 4;
+	if(passes > 0) {
+		limb_t *rp = r;
+		const limb_t *ap = a;
+		const limb_t *bp = b;
+		limb_t t0, t1;
+		__asm__ volatile(
+			"xorl    %k[t0], %k[t0]\n\t"
+			"1:\n\t"
+			"movq    0(%[ap]), %[t0]\n\t"
+			"sbbq    0(%[bp]), %[t0]\n\t"
+			"movq    %[t0], 0(%[rp])\n\t"
+			"movq    8(%[ap]), %[t1]\n\t"
+			"sbbq    8(%[bp]), %[t1]\n\t"
+			"movq    %[t1], 8(%[rp])\n\t"
+			"movq    16(%[ap]), %[t0]\n\t"
+			"sbbq    16(%[bp]), %[t0]\n\t"
+			"movq    %[t0], 16(%[rp])\n\t"
+			"movq    24(%[ap]), %[t1]\n\t"
+			"sbbq    24(%[bp]), %[t1]\n\t"
+			"movq    %[t1], 24(%[rp])\n\t"
+			"leaq    32(%[ap]), %[ap]\n\t"
+			"leaq    32(%[bp]), %[bp]\n\t"
+			"leaq    32(%[rp]), %[rp]\n\t"
+			"leaq    -1(%[passes]), %[passes]\n\t"
+			"jrcxz   2f\n\t"
+			"jmp     1b\n\t"
+			"2:\n\t"
+			"movl    $0, %k[t0]\n\t"
+			"adcq    $0, %[t0]\n\t"
+			: [rp] "+r" (rp), [ap] "+r" (ap), [bp] "+r" (bp), [passes] "+c" (passes),
+			  [t0] "=&r" (t0), [t1] "=&r" (t1)
+			:
+			: "cc", "memory");
+		borrow = t0;
+	}
+
+	int i;
+	for(i = n & ~3; i < n; i++) {
+		dlimb_t t = (dlimb_t) a[i] - b[i] - borrow;
+		r[i] = (limb_t) t;
+		borrow = (limb_t) (t >> LIMB_BITS) & 1;
+	}
+
+	return borrow;
+}
+
+static limb_t big_number_kernel_adx_mul_1(limb_t *r, const limb_t *a, int n, limb_t b)
+{
+	limb_t carry = 0;
+
+	long passes = n / 4;
+	if(passes > 0) {
+		limb_t *rp = r;
+		const limb_t *ap = a;
+		limb_t l0, l1, h0;
+		__asm__ volatile(
+			"xorl    %k[l0], %k[l0]\n\t"
+			"1:\n\t"
+			"mulxq   0(%[ap]), %[l0], %[h0]\n\t"
+			"adcxq   %[hi], %[l0]\n\t"
+			"movq    %[l0], 0(%[rp])\n\t"
+			"mulxq   8(%[ap]), %[l1], %[hi]\n\t"
+			"adcxq   %[h0], %[l1]\n\t"
+			"movq    %[l1], 8(%[rp])\n\t"
+			"mulxq   16(%[ap]), %[l0], %[h0]\n\t"
+			"adcxq   %[hi], %[l0]\n\t"
+			"movq    %[l0], 16(%[rp])\n\t"
+			"mulxq   24(%[ap]), %[l1], %[hi]\n\t"
+			"adcxq   %[h0], %[l1]\n\t"
+			"movq    %[l1], 24(%[rp])\n\t"
+			"leaq    32(%[ap]), %[ap]\n\t"
+			"leaq    32(%[rp]), %[rp]\n\t"
+			"leaq    -1(%[passes]), %[passes]\n\t"
+			"jrcxz   2f\n\t"
+			"jmp     1b\n\t"
+			"2:\n\t"
+			"movl    $0, %k[l0]\n\t"
+			"adcxq   %[l0], %[hi]\n\t"
+			: [rp] "+r" (rp), [ap] "+r" (ap), [passes] "+c" (passes), [hi] "+r" (carry),
+			  [l0] "=&r" (l0), [l1] "=&r" (l1), [h0] "=&r" (h0)
+			: "d" (b)
+			: "cc", "memory");
+	}
+
+	int i;
+	for(i = n & ~3; i < n; i++) {
+		dlimb_t t = (dlimb_t) a[i] * b + carry;
+		r[i] = (limb_t) t;
+		carry = (limb_t) (t >> LIMB_BITS);
+	}
+
+	return carry;
+}
+
+static limb_t big_number_kernel_adx_addmul_1(limb_t *r, const limb_t *a, int n, limb_t b)
+{
+	limb_t carry = 0;
+
+	long passes = n / 4;
+	if(passes > 0) {
+		limb_t *rp = r;
+		const limb_t *ap = a;
+		limb_t l0, l1, h0;
+		__asm__ volatile(
+			"xorl    %k[l0], %k[l0]\n\t"
+			"1:\n\t"
+			"mulxq   0(%[ap]), %[l0], %[h0]\n\t"
+			"adcxq   0(%[rp]), %[l0]\n\t"
+			"adoxq   %[hi], %[l0]\n\t"
+			"movq    %[l0], 0(%[rp])\n\t"
+			"mulxq   8(%[ap]), %[l1], %[hi]\n\t"
+			"adcxq   8(%[rp]), %[l1]\n\t"
+			"adoxq   %[h0], %[l1]\n\t"
+			"movq    %[l1], 8(%[rp])\n\t"
+			"mulxq   16(%[ap]), %[l0], %[h0]\n\t"
+			"adcxq   16(%[rp]), %[l0]\n\t"
+			"adoxq   %[hi], %[l0]\n\t"
+			"movq    %[l0], 16(%[rp])\n\t"
+			"mulxq   24(%[ap]), %[l1], %[hi]\n\t"
+			"adcxq   24(%[rp]), %[l1]\n\t"
+			"adoxq   %[h0], %[l1]\n\t"
+			"movq    %[l1], 24(%[rp])\n\t"
+			"leaq    32(%[ap]), %[ap]\n\t"
+			"leaq    32(%[rp]), %[rp]\n\t"
+			"leaq    -1(%[passes]), %[passes]\n\t"
+			"jrcxz   2f\n\t"
+			"jmp     1b\n\t"
+			"2:\n\t"
+			"movl    $0, %k[l0]\n\t"
+			"adcxq   %[l0], %[hi]\n\t"
+			"adoxq   %[l0], %[hi]\n\t"
+			: [rp] "+r" (rp), [ap] "+r" (ap), [passes] "+c" (passes), [hi] "+r" (carry),
+			  [l0] "=&r" (l0), [l1] "=&r" (l1), [h0] "=&r" (h0)
+			: "d" (b)
+			: "cc", "memory");
+	}
+
+	int i;
+	for(i = n & ~3; i < n; i++) {
+		dlimb_t t = (dlimb_t) a[i] * b + r[i] + carry;
+		r[i] = (limb_t) t;
+		carry = (limb_t) (t >> LIMB_BITS);
+	}
+
+	return carry;
+}
+#endif /* __x86_64__ */
+
+/* All of the versions, slowest first. */
+static const big_number_kernel kernels[] = {
+	{ "generic", big_number_kernel_generic_supported,
+	  big_number_kernel_generic_add_n, big_number_kernel_generic_sub_n,
+	  big_number_kernel_generic_mul_1, big_number_kernel_generic_addmul_1 },
+#if defined(__x86_64__)
+	{ "adx", big_number_kernel_adx_supported,
+	  big_number_kernel_adx_add_n, big_number_kernel_adx_sub_n,
+	  big_number_kernel_adx_mul_1, big_number_kernel_adx_addmul_1 },
+#endif
+};
+
+#define KERNEL_COUNT ((int) (sizeof(kernels) / sizeof(kernels[0])))
+
+/* The version in use. */
+static const big_number_kernel *kernel = &kernels[0];
+
+/*******************************************************************************
+ * Pick the fastest kernels when the program starts.
+ ******************************************************************************/
+__attribute__((constructor)) static void big_number_kernel_init(void)
+{
+	big_number_limb_kernel_select((const char *) 0);
+}
+
+/********************************** PUBLIC API ********************************/
+
+/*******************************************************************************
+ * r = a + b, where a and b are both n limbs long.  r may be the same array as
+ * a and/or b.
+ *
+ * Output:
+ *   Returns the carry out of the top limb (0 or 1).
+ ******************************************************************************/
+limb_t big_number_limb_add_n(limb_t *r, const limb_t *a, const limb_t *b, int n)
+{
+	return kernel->add_n(r, a, b, n);
+}
+
+/*******************************************************************************
+ * r = a - b, where a and b are both n limbs long.  r may be the same array as
+ * a and/or b.
+ *
+ * Output:
+ *   Returns the borrow out of the top limb (0 or 1).
+ ******************************************************************************/
+limb_t big_number_limb_sub_n(limb_t *r, const limb_t *a, const limb_t *b, int n)
+{
+	return kernel->sub_n(r, a, b, n);
+}
+
+/*******************************************************************************
+ * r = a * b, where a is n limbs long and b is a single limb.  r may be the same
+ * array as a.
+ *
+ * Output:
+ *   Returns the limb that carries out of the top of r.
+ ******************************************************************************/
+limb_t big_number_limb_mul_1(limb_t *r, const limb_t *a, int n, limb_t b)
+{
+	return kernel->mul_1(r, a, n, b);
+}
+
+/*******************************************************************************
+ * r += a * b, where r and a are n limbs long and b is a single limb.
+ *
+ * Output:
+ *   Returns the limb that carries out of the top of r.
+ ******************************************************************************/
+limb_t big_number_limb_addmul_1(limb_t *r, const limb_t *a, int n, limb_t b)
+{
+	return kernel->addmul_1(r, a, n, b);
+}
+
+/*******************************************************************************
+ * Pick the kernels to use.  Normally the fastest ones are picked at startup,
+ * so this is only needed to compare them.
+ *
+ * Input:
+ *   name - The name of the kernels ("generic", "adx").  0 picks the fastest
+ *          ones that this CPU can run.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (no such kernels, or this CPU can't run them).  The kernels
+ *             in use don't change.
+ ******************************************************************************/
+int big_number_limb_kernel_select(const char *name)
+{
+	int i;
+	for(i = KERNEL_COUNT - 1; i >= 0; i--) {
+		if(((name == (const char *) 0) || (strcmp(name, kernels[i].name) == 0)) && (kernels[i].supported() == 1)) {
+			kernel = &kernels[i];
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*******************************************************************************
+ * Get the name of the kernels in use.
+ *
+ * Output:
+ *   Returns the name.
+ ******************************************************************************/
+const char *big_number_limb_kernel_name(void)
+{
+	return kernel->name;
+}
+
+/********** Test Methods */
+
+#ifdef TEST
+/*******************************************************************************
+ * Fill a limb array with pseudo-random bits.  Every so often, make the limbs
+ * all ones so that the carries get a workout.
+ ******************************************************************************/
+static void big_number_kernel_test_fill(limb_t *a, int n)
+{
+	int all_ones = ((rand() % 4) == 0);
+
+	int i;
+	for(i = 0; i < n; i++) {
+		a[i] = ((limb_t) rand() << 62) ^ ((limb_t) rand() << 31) ^ (limb_t) rand();
+		if(all_ones) {
+			a[i] = UINT64_MAX;
+		}
+	}
+}
+
+/*******************************************************************************
+ * Run the kernel tests.  Check every version that this CPU can run against the
+ * generic one, on random inputs of every length up to 40 limbs.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1.
+ ******************************************************************************/
+int big_number_kernel_test(void)
+{
+	int rc = 0;
+
+	printf("%s(): Starting\n", __func__);
+
+	enum { MAX_LIMBS = 40 };
+	limb_t a[MAX_LIMBS], b[MAX_LIMBS], r1[MAX_LIMBS], r2[MAX_LIMBS];
+
+	srand(2);
+
+	const big_number_kernel *g = &kernels[0];
+	int k;
+	for(k = 1; (k < KERNEL_COUNT) && (rc == 0); k++) {
+		const big_number_kernel *x = &kernels[k];
+		if(x->supported() == 0) {
+			printf("%s(): Skipping %s.  Not supported.\n", __func__, x->name);
+			continue;
+		}
+
+		int n, pass;
+		for(n = 0; (n <= MAX_LIMBS) && (rc == 0); n++) {
+			for(pass = 0; (pass < 8) && (rc == 0); pass++) {
+				limb_t m;
+				big_number_kernel_test_fill(a, n);
+				big_number_kernel_test_fill(b, n);
+				big_number_kernel_test_fill(&m, 1);
+
+				limb_t c1 = g->add_n(r1, a, b, n);
+				limb_t c2 = x->add_n(r2, a, b, n);
+				int failed = (c1 != c2) || (memcmp(r1, r2, n * sizeof(limb_t)) != 0);
+
+				c1 = g->sub_n(r1, a, b, n);
+				c2 = x->sub_n(r2, a, b, n);
+				failed |= (c1 != c2) || (memcmp(r1, r2, n * sizeof(limb_t)) != 0);
+
+				c1 = g->mul_1(r1, a, n, m);
+				c2 = x->mul_1(r2, a, n, m);
+				failed |= (c1 != c2) || (memcmp(r1, r2, n * sizeof(limb_t)) != 0);
+
+				memcpy(r1, b, n * sizeof(limb_t));
+				memcpy(r2, b, n * sizeof(limb_t));
+				c1 = g->addmul_1(r1, a, n, m);
+				c2 = x->addmul_1(r2, a, n, m);
+				failed |= (c1 != c2) || (memcmp(r1, r2, n * sizeof(limb_t)) != 0);
+
+				/* In place.  r = r + b, and r = r * m. */
+				memcpy(r1, a, n * sizeof(limb_t));
+				memcpy(r2, a, n * sizeof(limb_t));
+				c1 = g->add_n(r1, r1, b, n) + g->mul_1(r1, r1, n, m);
+				c2 = x->add_n(r2, r2, b, n) + x->mul_1(r2, r2, n, m);
+				failed |= (c1 != c2) || (memcmp(r1, r2, n * sizeof(limb_t)) != 0);
+
+				if(failed != 0) {
+					printf("%s(): Mismatch: %s, %d limbs.\n", __func__, x->name, n);
+					rc = 1;
+				}
+			}
+		}
+	}
+
+	printf("%s(): %s.\n", __func__, (rc == 0) ? "PASS" : "FAIL");
+	return rc;
+}
+#endif /* TEST */
@@ -0,0 +1,377 @@
+/*******************************************************************************
+ *
+ * This module provides the limb primitives used by big_number_base_full.c.
+ * Each function works on raw arrays of 64-bit limbs (least significant limb
+ * first).  The carries are done with unsigned __int128, so the compiler is
+ * free to turn them into add-with-carry and widening multiply instructions.
+ *
+ * The innermost loops (add_n, sub_n, mul_1, and addmul_1) are in
+ * big_number_kernel.c, which picks the fastest version for the CPU.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "big_number_limb.h"
+
+/********************************** PUBLIC API ********************************/
+
+/********** Comparison Methods */
+
+/*******************************************************************************
+ * Compare 2 limb arrays.  Leading zero limbs are allowed in either array.
+ *
+ * Input:
+ *   a  - Value 1.
+ *   an - Number of limbs in a.
+ *   b  - Value 2.
+ *   bn - Number of limbs in b.
+ *
+ * Output:
+ *   Returns <0 if (a < b).
+ *   Returns  0 if (a == b).
+ *   Returns >0 if (a > b).
+ ******************************************************************************/
+int big_number_limb_cmp(const limb_t *a, int an, const limb_t *b, int bn)
+{
+	an = big_number_limb_normalized_size(a, an);
+	bn = big_number_limb_normalized_size(b, bn);
+
+	if(an != bn) {
+		return (an < bn) ? -1 : 1;
+	}
+
+	int i;
+	for(i = (an - 1); i >= 0; i--) {
+		if(a[i] != b[i]) {
+			return (a[i] < b[i]) ? -1 : 1;
+		}
+	}
+
+	return 0;
+}
+
+/*******************************************************************************
+ * Return the number of limbs in a limb array, not counting leading zeroes.
+ *
+ * Input:
+ *   a - The limb array.
+ *   n - Number of limbs in a.
+ *
+ * Output:
+ *   The number of significant limbs.  0 if the value is zero.
+ ******************************************************************************/
+int big_number_limb_normalized_size(const limb_t *a, int n)
+{
+	while((n > 0) && (a[n - 1] == 0)) {
+		n--;
+	}
+	return n;
+}
+
+/********** Math Operations */
+
+/*******************************************************************************
+ * r = a + b, where (an >= bn).  r must have room for an limbs.  r may be the
+ * same array as a.
+ *
+ * Output:
+ *   Returns the carry out of the top limb (0 or 1).
+ ******************************************************************************/
+limb_t big_number_limb_add(limb_t *r, const limb_t *a, int an, const limb_t *b, int bn)
+{
+	limb_t carry = big_number_limb_add_n(r, a, b, bn);
+	return big_number_limb_add_1(r + bn, a + bn, an - bn, carry);
+}
+
+/*******************************************************************************
+ * r = a + b, where a is n limbs long and b is a single limb.  r may be the same
+ * array as a.
+ *
+ * Output:
+ *   Returns the carry out of the top limb (0 or 1).
+ ******************************************************************************/
+limb_t big_number_limb_add_1(limb_t *r, const limb_t *a, int n, limb_t b)
+{
+	int i;
+	for(i = 0; i < n; i++) {
+		limb_t t = a[i] + b;
+		b = (t < b);
+		r[i] = t;
+
+		/* Once the carry is gone, the rest is a straight copy. */
+		if(b == 0) {
+			if(r != a) {
+				memcpy(r + i + 1, a + i + 1, (n - i - 1) * sizeof(limb_t));
+			}
+			break;
+		}
+	}
+
+	return b;
+}
+
+/*******************************************************************************
+ * r = a - b, where (an >= bn).  r must have room for an limbs.  r may be the
+ * same array as a.
+ *
+ * Output:
+ *   Returns the borrow out of the top limb (0 or 1).
+ ******************************************************************************/
+limb_t big_number_limb_sub(limb_t *r, const limb_t *a, int an, const limb_t *b, int bn)
+{
+	limb_t borrow = big_number_limb_sub_n(r, a, b, bn);
+	return big_number_limb_sub_1(r + bn, a + bn, an - bn, borrow);
+}
+
+/*******************************************************************************
+ * r = a - b, where a is n limbs long and b is a single limb.  r may be the same
+ * array as a.
+ *
+ * Output:
+ *   Returns the borrow out of the top limb (0 or 1).
+ ******************************************************************************/
+limb_t big_number_limb_sub_1(limb_t *r, const limb_t *a, int n, limb_t b)
+{
+	int i;
+	for(i = 0; i < n; i++) {
+		limb_t t = a[i] - b;
+		b = (a[i] < b);
+		r[i] = t;
+
+		/* Once the borrow is gone, the rest is a straight copy. */
+		if(b == 0) {
+			if(r != a) {
+				memcpy(r + i + 1, a + i + 1, (n - i - 1) * sizeof(limb_t));
+			}
+			break;
+		}
+	}
+
+	return b;
+}
+
+/*******************************************************************************
+ * r -= a * b, where r and a are n limbs long and b is a single limb.
+ *
+ * Output:
+ *   Returns the limb that borrows out of the top of r.
+ ******************************************************************************/
+limb_t big_number_limb_submul_1(limb_t *r, const limb_t *a, int n, limb_t b)
+{
+	limb_t borrow = 0;
+
+	int i;
+	for(i = 0; i < n; i++) {
+		dlimb_t p = (dlimb_t) a[i] * b + borrow;
+		limb_t lo = (limb_t) p;
+		borrow = (limb_t) (p >> LIMB_BITS) + (r[i] < lo);
+		r[i] -= lo;
+	}
+
+	return borrow;
+}
+
+/*******************************************************************************
+ * Schoolbook multiplication.  r = a * b.  r must have room for (an + bn) limbs,
+ * and it must not overlap a or b.  an and bn must both be > 0.
+ ******************************************************************************/
+void big_number_limb_mul_basecase(limb_t *r, const limb_t *a, int an, const limb_t *b, int bn)
+{
+	r[an] = big_number_limb_mul_1(r, a, an, b[0]);
+
+	int i;
+	for(i = 1; i < bn; i++) {
+		r[an + i] = big_number_limb_addmul_1(r + i, a, an, b[i]);
+	}
+}
+
+/*******************************************************************************
+ * Divide a limb array by a single limb.  q = a / d.
+ *
+ * Input:
+ *   q - Receives the quotient.  n limbs.  It may be the same array as a.
+ *   a - The dividend.  n limbs.
+ *   n - Number of limbs in a.
+ *   d - The divisor.  It must not be 0.
+ *
+ * Output:
+ *   Returns the remainder (a % d).
+ ******************************************************************************/
+limb_t big_number_limb_divrem_1(limb_t *q, const limb_t *a, int n, limb_t d)
+{
+	limb_t rem = 0;
+
+	int i;
+	for(i = (n - 1); i >= 0; i--) {
+		dlimb_t num = ((dlimb_t) rem << LIMB_BITS) | a[i];
+		q[i] = (limb_t) (num / d);
+		rem = (limb_t) (num % d);
+	}
+
+	return rem;
+}
+
+/*******************************************************************************
+ * Calculate the remainder of a limb array divided by a single limb.
+ *
+ * Input:
+ *   a - The dividend.  n limbs.
+ *   n - Number of limbs in a.
+ *   d - The divisor.  It must not be 0.
+ *
+ * Output:
+ *   Returns (a % d).
+ ******************************************************************************/
+limb_t big_number_limb_mod_1(const limb_t *a, int n, limb_t d)
+{
+	limb_t rem = 0;
+
+	int i;
+	for(i = (n - 1); i >= 0; i--) {
+		dlimb_t num = ((dlimb_t) rem << LIMB_BITS) | a[i];
+		rem = (limb_t) (num % d);
+	}
+
+	return rem;
+}
+
+/*******************************************************************************
+ * Long division (Knuth, TAOCP Vol 2, 4.3.1, Algorithm D).  q = a / d and
+ * r = a % d.
+ *
+ * The divisor is shifted left until its top bit is set.  With a normalized
+ * divisor, dividing the top 2 limbs of the running remainder by the top limb
+ * of the divisor gives a quotient limb that is at most 2 too big.  Checking it
+ * against the second limb of the divisor almost always fixes that, and the
+ * rare leftover case is caught by the borrow out of the multiply-subtract.
+ * So each quotient limb costs one pass over the divisor, no matter what the
+ * value of the limb is.
+ *
+ * Input:
+ *   q       - Receives the quotient.  (an - dn + 1) limbs.
+ *   r       - Receives the remainder.  dn limbs.
+ *   a       - The dividend.  an limbs.
+ *   an      - Number of limbs in a.  It must be >= dn.
+ *   d       - The divisor.  dn limbs.  The top limb must not be 0.
+ *   dn      - Number of limbs in d.
+ *   scratch - Scratch space.  (an + dn + 1) limbs.
+ *
+ *   q and r must not overlap each other, a, d or scratch.
+ ******************************************************************************/
+void big_number_limb_divrem(limb_t *q, limb_t *r, const limb_t *a, int an,
+                            const limb_t *d, int dn, limb_t *scratch)
+{
+	/* Single limb divisors have a much simpler loop. */
+	if(dn == 1) {
+		r[0] = big_number_limb_divrem_1(q, a, an, d[0]);
+		return;
+	}
+
+	/* Normalize.  Shift both values left so that the top bit of the
+	 * divisor is set.  u gets an extra limb for the bits that fall off. */
+	limb_t *v = scratch;
+	limb_t *u = scratch + dn;
+	int shift = __builtin_clzll(d[dn - 1]);
+	if(shift != 0) {
+		big_number_limb_lshift(v, d, dn, shift);
+		u[an] = big_number_limb_lshift(u, a, an, shift);
+	}
+	else {
+		memcpy(v, d, dn * sizeof(limb_t));
+		memcpy(u, a, an * sizeof(limb_t));
+		u[an] = 0;
+	}
+
+	limb_t v1 = v[dn - 1];
+	limb_t v2 = v[dn - 2];
+
+	int j;
+	for(j = (an - dn); j >= 0; j--) {
+		/* Estimate the quotient limb from the top 2 limbs of u. */
+		dlimb_t num  = ((dlimb_t) u[j + dn] << LIMB_BITS) | u[j + dn - 1];
+		dlimb_t qhat = num / v1;
+		dlimb_t rhat = num % v1;
+
+		/* Refine it with the next limb of the divisor. */
+		while((qhat >> LIMB_BITS) ||
+		      ((qhat * v2) > ((rhat << LIMB_BITS) | u[j + dn - 2]))) {
+			qhat--;
+			rhat += v1;
+			if(rhat >> LIMB_BITS) {
+				break;
+			}
+		}
+
+		/* u -= qhat * v.  If that went negative, qhat was still 1 too
+		 * big.  Add one v back. */
+		limb_t borrow = big_number_limb_submul_1(u + j, v, dn, (limb_t) qhat);
+		limb_t top = u[j + dn];
+		u[j + dn] = top - borrow;
+		if(top < borrow) {
+			qhat--;
+			u[j + dn] += big_number_limb_add_n(u + j, u + j, v, dn);
+		}
+
+		q[j] = (limb_t) qhat;
+	}
+
+	/* The remainder is what's left of u, shifted back down. */
+	if(shift != 0) {
+		big_number_limb_rshift(r, u, dn, shift);
+	}
+	else {
+		memcpy(r, u, dn * sizeof(limb_t));
+	}
+}
+
+/********** Shift Operations */
+
+/*******************************************************************************
+ * r = a << count, where (0 < count < LIMB_BITS).  r may be the same array as a.
+ *
+ * Output:
+ *   Returns the bits that were shifted out of the top limb.
+ ******************************************************************************/
+limb_t big_number_limb_lshift(limb_t *r, const limb_t *a, int n, int count)
+{
+	limb_t out = 0;
+
+	if(n > 0) {
+		out = a[n - 1] >> (LIMB_BITS - count);
+
+		int i;
+		for(i = (n - 1); i > 0; i--) {
+			r[i] = (a[i] << count) | (a[i - 1] >> (LIMB_BITS - count));
+		}
+		r[0] = a[0] << count;
+	}
+
+	return out;
+}
+
+/*******************************************************************************
+ * r = a >> count, where (0 < count < LIMB_BITS).  r may be the same array as a.
+ *
+ * Output:
+ *   Returns the bits that were shifted out of the bottom limb, left justified.
+ ******************************************************************************/
+limb_t big_number_limb_rshift(limb_t *r, const limb_t *a, int n, int count)
+{
+	limb_t out = 0;
+
+	if(n > 0) {
+		out = a[0] << (LIMB_BITS - count);
+
+		int i;
+		for(i = 0; i < (n - 1); i++) {
+			r[i] = (a[i] >> count) | (a[i + 1] << (LIMB_BITS - count));
+		}
+		r[n - 1] = a[n - 1] >> count;
+	}
+
+	return out;
+}
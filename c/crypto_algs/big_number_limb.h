@@ -0,0 +1,134 @@
+#pragma once
+
+/*******************************************************************************
+ *
+ * Internal definition of the limb layer.  These are the primitives that
+ * big_number_base_full.c uses to do math on arrays of limbs.  They are spread
+ * over several files.  The sections below name the file they live in, and the
+ * ones that don't are in big_number_limb.c:
+ *
+ * - big_number_limb.c   - Comparison, add/sub, the schoolbook multiply,
+ *                         division, and shifts.
+ * - big_number_kernel.c - add_n, sub_n, mul_1 and addmul_1, with a version
+ *                         for each CPU, picked at startup.
+ * - big_number_mul.c    - Karatsuba and Toom-3 multiplication and squaring.
+ * - big_number_ntt.c    - NTT multiplication.
+ * - big_number_mont.c   - Montgomery arithmetic.
+ * - big_number_gcd.c    - GCD and modular inverse.
+ *
+ * A limb is one 64-bit "digit" of a big number.  Limb arrays are stored with
+ * the least significant limb first.  None of these functions care about signs.
+ * That's the job of the caller.  The multiply and square functions (and the
+ * Montgomery ones that call them) allocate scratch memory for the bigger
+ * algorithms, and return non-zero if they can't.  None of the others allocate.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+
+/********************************** DATA TYPES ********************************/
+
+typedef uint64_t limb_t;
+
+typedef unsigned __int128 dlimb_t;
+
+#define LIMB_BITS (64)
+
+/********************************** PUBLIC API ********************************/
+
+/********** Comparison Methods */
+
+int big_number_limb_cmp(const limb_t *a, int an, const limb_t *b, int bn);
+
+int big_number_limb_normalized_size(const limb_t *a, int n);
+
+/********** Kernels (big_number_kernel.c) */
+
+limb_t big_number_limb_add_n(limb_t *r, const limb_t *a, const limb_t *b, int n);
+
+limb_t big_number_limb_sub_n(limb_t *r, const limb_t *a, const limb_t *b, int n);
+
+limb_t big_number_limb_mul_1(limb_t *r, const limb_t *a, int n, limb_t b);
+
+limb_t big_number_limb_addmul_1(limb_t *r, const limb_t *a, int n, limb_t b);
+
+int big_number_limb_kernel_select(const char *name);
+
+const char *big_number_limb_kernel_name(void);
+
+/********** Math Operations */
+
+limb_t big_number_limb_add(limb_t *r, const limb_t *a, int an, const limb_t *b, int bn);
+
+limb_t big_number_limb_add_1(limb_t *r, const limb_t *a, int n, limb_t b);
+
+limb_t big_number_limb_sub(limb_t *r, const limb_t *a, int an, const limb_t *b, int bn);
+
+limb_t big_number_limb_sub_1(limb_t *r, const limb_t *a, int n, limb_t b);
+
+limb_t big_number_limb_submul_1(limb_t *r, const limb_t *a, int n, limb_t b);
+
+void big_number_limb_mul_basecase(limb_t *r, const limb_t *a, int an, const limb_t *b, int bn);
+
+limb_t big_number_limb_divrem_1(limb_t *q, const limb_t *a, int n, limb_t d);
+
+limb_t big_number_limb_mod_1(const limb_t *a, int n, limb_t d);
+
+void big_number_limb_divrem(limb_t *q, limb_t *r, const limb_t *a, int an,
+                            const limb_t *d, int dn, limb_t *scratch);
+
+/********** Multiplication Engine (big_number_mul.c) */
+
+int big_number_limb_mul(limb_t *r, const limb_t *a, int an, const limb_t *b, int bn);
+
+/* The threshold setters are single-threaded tuning and test hooks.  Don't call
+ * them while other threads are multiplying. */
+void big_number_limb_set_mul_thresholds(int karatsuba, int toom3);
+
+void big_number_limb_get_mul_thresholds(int *karatsuba, int *toom3);
+
+void big_number_limb_set_ntt_threshold(int ntt);
+
+int big_number_limb_get_ntt_threshold(void);
+
+void big_number_limb_sqr_basecase(limb_t *r, const limb_t *a, int n);
+
+int big_number_limb_sqr(limb_t *r, const limb_t *a, int n);
+
+/********** NTT Multiplication (big_number_ntt.c) */
+
+int big_number_limb_mul_ntt(limb_t *r, const limb_t *a, int an, const limb_t *b, int bn);
+
+int big_number_limb_sqr_ntt(limb_t *r, const limb_t *a, int n);
+
+/********** Montgomery Arithmetic (big_number_mont.c) */
+
+limb_t big_number_limb_mont_inverse(limb_t n0);
+
+void big_number_limb_redc(limb_t *r, limb_t *t, const limb_t *n, int nn, limb_t ninv);
+
+int big_number_limb_mont_mul(limb_t *r, const limb_t *a, const limb_t *b,
+                             const limb_t *n, int nn, limb_t ninv, limb_t *t);
+
+int big_number_limb_mont_sqr(limb_t *r, const limb_t *a,
+                             const limb_t *n, int nn, limb_t ninv, limb_t *t);
+
+/********** GCD and Modular Inverse (big_number_gcd.c) */
+
+void big_number_limb_gcd_odd(limb_t *r, const limb_t *a, const limb_t *b, int n, limb_t *scratch);
+
+int big_number_limb_mod_inverse(limb_t *r, const limb_t *a, const limb_t *m, int n, limb_t *scratch);
+
+/********** Shift Operations */
+
+limb_t big_number_limb_lshift(limb_t *r, const limb_t *a, int n, int count);
+
+limb_t big_number_limb_rshift(limb_t *r, const limb_t *a, int n, int count);
+
+/********** Test Methods */
+
+int big_number_kernel_test(void);
+
+int big_number_mul_test(void);
+
+int big_number_ntt_test(void);
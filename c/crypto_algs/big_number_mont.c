@@ -0,0 +1,133 @@
+/*******************************************************************************
+ *
+ * This module does Montgomery arithmetic on limb arrays for
+ * big_number_base_full.c.
+ *
+ * Montgomery form replaces the expensive "% N" after every multiply with a
+ * reduction (REDC) that only needs multiplies and adds.  For an odd modulus N
+ * that is n limbs long, let R = 2^(64 * n).  A value x is stored as
+ * (x * R) % N.  Multiplying 2 stored values and running REDC on the product
+ * gives the stored form of the product:
+ *
+ *   REDC((x * R) * (y * R)) = (x * y * R) % N
+ *
+ * The multiply itself is done by the multiplication engine in big_number_mul.c,
+ * so large moduli get Karatsuba and Toom-3 for free.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "big_number_limb.h"
+
+/********************************** PUBLIC API ********************************/
+
+/*******************************************************************************
+ * Calculate the Montgomery constant for a modulus.
+ *
+ * Input:
+ *   n0 - The least significant limb of the modulus.  It must be odd.
+ *
+ * Output:
+ *   Returns -(1 / n0) mod 2^64.
+ ******************************************************************************/
+limb_t big_number_limb_mont_inverse(limb_t n0)
+{
+	/* Newton's iteration.  n0 is its own inverse mod 8, and each step
+	 * doubles the number of correct bits (3, 6, 12, 24, 48, 96). */
+	limb_t inv = n0;
+	int i;
+	for(i = 0; i < 5; i++) {
+		inv *= 2 - (n0 * inv);
+	}
+
+	return -inv;
+}
+
+/*******************************************************************************
+ * Montgomery reduction.  r = (t / R) % N.
+ *
+ * Input:
+ *   r    - Receives the result.  It must have room for nn limbs.
+ *   t    - The value to reduce.  It is 2 * nn limbs long, and it must be less
+ *          than (N * R).  It is destroyed.
+ *   n    - The modulus.
+ *   nn   - Number of limbs in the modulus.
+ *   ninv - big_number_limb_mont_inverse(n[0]).
+ ******************************************************************************/
+void big_number_limb_redc(limb_t *r, limb_t *t, const limb_t *n, int nn, limb_t ninv)
+{
+	/* Clear one limb at a time off the bottom of t by adding a multiple of
+	 * N.  The carries out of the top of t are collected in carry. */
+	limb_t carry = 0;
+
+	int i;
+	for(i = 0; i < nn; i++) {
+		limb_t m = t[i] * ninv;
+		limb_t c = big_number_limb_addmul_1(t + i, n, nn, m);
+
+		dlimb_t s = (dlimb_t) t[i + nn] + c + carry;
+		t[i + nn] = (limb_t) s;
+		carry = (limb_t) (s >> LIMB_BITS);
+	}
+
+	/* The result is less than 2N.  One subtract brings it into range. */
+	if((carry != 0) || (big_number_limb_cmp(t + nn, nn, n, nn) >= 0)) {
+		big_number_limb_sub_n(r, t + nn, n, nn);
+	}
+	else {
+		memcpy(r, t + nn, nn * sizeof(limb_t));
+	}
+}
+
+/*******************************************************************************
+ * Montgomery multiplication.  r = (a * b / R) % N.
+ *
+ * Input:
+ *   r    - Receives the result.  It must have room for nn limbs.  It may be the
+ *          same array as a and/or b.
+ *   a    - Value 1.  nn limbs, less than N.
+ *   b    - Value 2.  nn limbs, less than N.
+ *   n    - The modulus.
+ *   nn   - Number of limbs in the modulus.
+ *   ninv - big_number_limb_mont_inverse(n[0]).
+ *   t    - Scratch space.  2 * nn limbs.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (out of memory).
+ ******************************************************************************/
+int big_number_limb_mont_mul(limb_t *r, const limb_t *a, const limb_t *b,
+                             const limb_t *n, int nn, limb_t ninv, limb_t *t)
+{
+	if(big_number_limb_mul(t, a, nn, b, nn) != 0) {
+		return 1;
+	}
+
+	big_number_limb_redc(r, t, n, nn, ninv);
+	return 0;
+}
+
+/*******************************************************************************
+ * Montgomery squaring.  r = (a * a / R) % N.
+ *
+ * Input:
+ *   Same as big_number_limb_mont_mul(), with b == a.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (out of memory).
+ ******************************************************************************/
+int big_number_limb_mont_sqr(limb_t *r, const limb_t *a,
+                             const limb_t *n, int nn, limb_t ninv, limb_t *t)
+{
+	if(big_number_limb_sqr(t, a, nn) != 0) {
+		return 1;
+	}
+
+	big_number_limb_redc(r, t, n, nn, ninv);
+	return 0;
+}
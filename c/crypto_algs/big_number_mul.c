@@ -0,0 +1,733 @@
+/*******************************************************************************
+ *
+ * This module multiplies limb arrays for big_number_base_full.c.  It picks the
+ * algorithm based on the length of the operands:
+ *
+ * - Schoolbook.  O(n^2).  Fastest for small numbers.
+ *
+ * - Karatsuba.  O(n^1.58).  Splits each operand in 2 and does 3 half-size
+ *   multiplies instead of 4.
+ *
+ * - Toom-3.  O(n^1.46).  Splits each operand in 3 and does 5 third-size
+ *   multiplies instead of 9.
+ *
+ * - NTT.  O(n log n).  A number-theoretic transform (big_number_ntt.c), for
+ *   numbers of many thousands of limbs.
+ *
+ * Squaring gets its own version of each algorithm.  A square only has to
+ * compute each cross product once, so it does about half the work.
+ *
+ * The crossover points are tunable.  The defaults can be changed at build time
+ * (make KARATSUBA_THRESHOLD=x TOOM3_THRESHOLD=y NTT_THRESHOLD=z), and they can
+ * be changed at run time with big_number_limb_set_mul_thresholds() and
+ * big_number_limb_set_ntt_threshold().  bench_mul.c measures them.
+ *
+ * The run-time setters are tuning and test hooks, and they are not thread-safe.
+ * The thresholds are plain globals that every multiply reads without a lock,
+ * so only change them while no other thread is multiplying (in particular, not
+ * during multithreaded RSA key generation or big_number_mod_exp_batch()).
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "big_number_limb.h"
+
+/* Operands with fewer limbs than this use the schoolbook multiply. */
+#ifndef BIG_NUMBER_KARATSUBA_THRESHOLD
+#define BIG_NUMBER_KARATSUBA_THRESHOLD (32)
+#endif
+
+/* Operands with at least this many limbs use Toom-3. */
+#ifndef BIG_NUMBER_TOOM3_THRESHOLD
+#define BIG_NUMBER_TOOM3_THRESHOLD (128)
+#endif
+
+/* Operands with at least this many limbs use the NTT.  For a multiply, that's
+ * the length of the shorter one. */
+#ifndef BIG_NUMBER_NTT_THRESHOLD
+#define BIG_NUMBER_NTT_THRESHOLD (8192)
+#endif
+
+/* The smallest thresholds that the algorithms can handle. */
+#define KARATSUBA_MIN (2)
+#define TOOM3_MIN     (9)
+#define NTT_MIN       (1)
+
+/* The current thresholds.  See the top of this file before changing them. */
+static int karatsuba_threshold = BIG_NUMBER_KARATSUBA_THRESHOLD;
+static int toom3_threshold     = BIG_NUMBER_TOOM3_THRESHOLD;
+static int ntt_threshold       = BIG_NUMBER_NTT_THRESHOLD;
+
+/********************************* PRIVATE API ********************************/
+
+static void big_number_limb_mul_n(limb_t *r, const limb_t *a, const limb_t *b, int n, limb_t *scratch);
+
+static void big_number_limb_sqr_n(limb_t *r, const limb_t *a, int n, limb_t *scratch);
+
+/*******************************************************************************
+ * Calculate the number of scratch limbs that big_number_limb_mul_n() needs to
+ * multiply 2 n-limb numbers.  This mirrors the recursion in the multiply.
+ ******************************************************************************/
+static int big_number_limb_mul_n_itch(int n)
+{
+	if(n < karatsuba_threshold) {
+		return 0;
+	}
+	else if(n < toom3_threshold) {
+		int l = (n + 1) / 2;
+		return (6 * l) + 1 + big_number_limb_mul_n_itch(l);
+	}
+	else {
+		int k = (n + 2) / 3;
+		return (14 * (k + 1)) + big_number_limb_mul_n_itch(k + 1);
+	}
+}
+
+/*******************************************************************************
+ * d = |x - y|, where (xn >= yn).  d must have room for xn limbs.
+ *
+ * Output:
+ *   Returns 0 if (x >= y).
+ *   Returns 1 if (x < y).
+ ******************************************************************************/
+static int big_number_limb_abs_diff(limb_t *d, const limb_t *x, int xn, const limb_t *y, int yn)
+{
+	if(big_number_limb_cmp(x, xn, y, yn) >= 0) {
+		big_number_limb_sub(d, x, xn, y, yn);
+		return 0;
+	}
+
+	/* x < y, so the top (xn - yn) limbs of x must be zero. */
+	big_number_limb_sub_n(d, y, x, yn);
+	memset(d + yn, 0, (xn - yn) * sizeof(limb_t));
+	return 1;
+}
+
+/*******************************************************************************
+ * r += c << (off limbs).  r is rn limbs long.  The sum must fit in r.
+ ******************************************************************************/
+static void big_number_limb_add_at(limb_t *r, int rn, int off, const limb_t *c, int cn)
+{
+	cn = big_number_limb_normalized_size(c, cn);
+	if(cn > 0) {
+		big_number_limb_add(r + off, r + off, rn - off, c, cn);
+	}
+}
+
+/*******************************************************************************
+ * Finish up a Karatsuba multiply or square.  On entry, z0 is in the bottom 2l
+ * limbs of r, and z2 is in the top 2h limbs of r.  The middle term
+ * (z0 + z2 -/+ zm) is built in t (2l + 1 limbs) and added in at limb l.
+ ******************************************************************************/
+static void big_number_limb_karatsuba_finish(limb_t *r, int n, const limb_t *zm, limb_t *t, int subtract)
+{
+	int l = (n + 1) / 2;
+	int h = n - l;
+
+	/* t = z0 + z2. */
+	memcpy(t, r, (2 * l) * sizeof(limb_t));
+	t[2 * l] = big_number_limb_add(t, t, 2 * l, r + (2 * l), 2 * h);
+
+	if(subtract) {
+		big_number_limb_sub(t, t, (2 * l) + 1, zm, 2 * l);
+	}
+	else {
+		big_number_limb_add(t, t, (2 * l) + 1, zm, 2 * l);
+	}
+
+	big_number_limb_add_at(r, 2 * n, l, t, (2 * l) + 1);
+}
+
+/*******************************************************************************
+ * Karatsuba multiplication of 2 n-limb numbers.  r must have room for 2n limbs.
+ *
+ * Split a = a0 + (a1 * B^l) and b = b0 + (b1 * B^l).  Then:
+ *   z0 = a0 * b0
+ *   z2 = a1 * b1
+ *   zm = |a0 - a1| * |b0 - b1|
+ *   a * b = z0 + ((z0 + z2 -/+ zm) * B^l) + (z2 * B^2l)
+ * Working with |a0 - a1| instead of (a0 + a1) keeps every value the same size
+ * as the halves.
+ ******************************************************************************/
+static void big_number_limb_mul_karatsuba(limb_t *r, const limb_t *a, const limb_t *b, int n, limb_t *scratch)
+{
+	int l = (n + 1) / 2;
+	int h = n - l;
+
+	limb_t *da   = scratch;
+	limb_t *db   = da + l;
+	limb_t *zm   = db + l;
+	limb_t *t    = zm + (2 * l);
+	limb_t *next = t + (2 * l) + 1;
+
+	int sa = big_number_limb_abs_diff(da, a, l, a + l, h);
+	int sb = big_number_limb_abs_diff(db, b, l, b + l, h);
+
+	big_number_limb_mul_n(r,           a,     b,     l, next);
+	big_number_limb_mul_n(r + (2 * l), a + l, b + l, h, next);
+	big_number_limb_mul_n(zm,          da,    db,    l, next);
+
+	/* If the differences had the same sign, zm = (a0 - a1)(b0 - b1), and it
+	 * gets subtracted.  Otherwise it gets added. */
+	big_number_limb_karatsuba_finish(r, n, zm, t, (sa == sb));
+}
+
+/*******************************************************************************
+ * Karatsuba squaring of an n-limb number.  r must have room for 2n limbs.  The
+ * same as the multiply, except that all 3 of the half-size products are
+ * squares, and zm = (a0 - a1)^2 always gets subtracted.
+ ******************************************************************************/
+static void big_number_limb_sqr_karatsuba(limb_t *r, const limb_t *a, int n, limb_t *scratch)
+{
+	int l = (n + 1) / 2;
+	int h = n - l;
+
+	limb_t *da   = scratch;
+	limb_t *zm   = da + (2 * l);
+	limb_t *t    = zm + (2 * l);
+	limb_t *next = t + (2 * l) + 1;
+
+	big_number_limb_abs_diff(da, a, l, a + l, h);
+
+	big_number_limb_sqr_n(r,           a,     l, next);
+	big_number_limb_sqr_n(r + (2 * l), a + l, h, next);
+	big_number_limb_sqr_n(zm,          da,    l, next);
+
+	big_number_limb_karatsuba_finish(r, n, zm, t, 1);
+}
+
+/*******************************************************************************
+ * Evaluate the Toom-3 polynomial (x0 + x1*X + x2*X^2) at 1, -1 and 2.  x0 and x1
+ * are k limbs long.  x2 is k2 limbs long.  Each result is k+1 limbs long.
+ *
+ * Output:
+ *   Returns 1 if the value at -1 is negative (pm1 holds the magnitude).
+ ******************************************************************************/
+static int big_number_limb_toom3_eval(limb_t *p1, limb_t *pm1, limb_t *p2, const limb_t *x, int k, int k2)
+{
+	const limb_t *x0 = x;
+	const limb_t *x1 = x + k;
+	const limb_t *x2 = x + (2 * k);
+	int negative;
+
+	/* p1 = x0 + x2. */
+	p1[k] = big_number_limb_add(p1, x0, k, x2, k2);
+
+	/* pm1 = |x0 + x2 - x1|. */
+	if(big_number_limb_cmp(p1, k + 1, x1, k) >= 0) {
+		big_number_limb_sub(pm1, p1, k + 1, x1, k);
+		negative = 0;
+	}
+	else {
+		big_number_limb_sub_n(pm1, x1, p1, k);
+		pm1[k] = 0;
+		negative = 1;
+	}
+
+	/* p1 = x0 + x1 + x2. */
+	big_number_limb_add(p1, p1, k + 1, x1, k);
+
+	/* p2 = x0 + 2*x1 + 4*x2 = (((2 * x2) + x1) * 2) + x0. */
+	p2[k2] = big_number_limb_lshift(p2, x2, k2, 1);
+	memset(p2 + k2 + 1, 0, (k - k2) * sizeof(limb_t));
+	big_number_limb_add(p2, p2, k + 1, x1, k);
+	big_number_limb_lshift(p2, p2, k + 1, 1);
+	big_number_limb_add(p2, p2, k + 1, x0, k);
+
+	return negative;
+}
+
+/*******************************************************************************
+ * r = a / 3, where a is a multiple of 3.  Multiplies by the inverse of 3 mod
+ * 2^64 instead of dividing.  r may be the same array as a.
+ ******************************************************************************/
+static void big_number_limb_divexact_3(limb_t *r, const limb_t *a, int n)
+{
+	const limb_t inverse_3 = 0xAAAAAAAAAAAAAAABULL;
+	limb_t borrow = 0;
+
+	int i;
+	for(i = 0; i < n; i++) {
+		limb_t x = a[i];
+		limb_t s = x - borrow;
+		borrow = (s > x);
+
+		limb_t q = s * inverse_3;
+		r[i] = q;
+
+		/* (3 * q) spills 0, 1 or 2 into the next limb. */
+		borrow += (q > 0x5555555555555555ULL) + (q > 0xAAAAAAAAAAAAAAAAULL);
+	}
+}
+
+/*******************************************************************************
+ * Finish up a Toom-3 multiply or square.  Solve for the 5 coefficients of the
+ * product polynomial c(X), and add them together.
+ *   c0 = v0
+ *   c4 = vinf
+ *   c1 + c3 = (v1 - vm1) / 2
+ *   c2      = ((v1 + vm1) / 2) - c0 - c4
+ *   c1 + 4*c3 = (v2 - c0 - 4*c2 - 16*c4) / 2
+ * Only vm1 can be negative.  Every other intermediate value is positive.
+ *
+ * On entry, c0 is in the bottom 2k limbs of r and c4 is in the top 2*k2 limbs
+ * of r.  v1, vm1, v2 and t are each (2k + 2) limbs long.  negative == 1 if
+ * vm1 holds the magnitude of a negative value.
+ ******************************************************************************/
+static void big_number_limb_toom3_finish(limb_t *r, int n, limb_t *v1, limb_t *vm1, limb_t *v2, limb_t *t, int negative)
+{
+	int k  = (n + 2) / 3;
+	int k2 = n - (2 * k);
+	int m  = (2 * k) + 2;
+
+	const limb_t *c0 = r;
+	const limb_t *c4 = r + (4 * k);
+
+	/* t = (v1 - vm1) = 2 * (c1 + c3).  v1 = (v1 + vm1) = 2 * (c0 + c2 + c4). */
+	if(negative == 0) {
+		big_number_limb_sub_n(t,  v1, vm1, m);
+		big_number_limb_add_n(v1, v1, vm1, m);
+	}
+	else {
+		big_number_limb_add_n(t,  v1, vm1, m);
+		big_number_limb_sub_n(v1, v1, vm1, m);
+	}
+	big_number_limb_rshift(t,  t,  m, 1);
+	big_number_limb_rshift(v1, v1, m, 1);
+
+	/* v1 = c2. */
+	big_number_limb_sub(v1, v1, m, c0, 2 * k);
+	big_number_limb_sub(v1, v1, m, c4, 2 * k2);
+
+	/* v2 = (v2 - c0 - 16*c4 - 4*c2) / 2 = c1 + 4*c3.  vm1 is free now, so
+	 * use it to hold the shifted values. */
+	big_number_limb_sub(v2, v2, m, c0, 2 * k);
+	vm1[2 * k2] = big_number_limb_lshift(vm1, c4, 2 * k2, 4);
+	big_number_limb_sub(v2, v2, m, vm1, (2 * k2) + 1);
+	big_number_limb_lshift(vm1, v1, m, 2);
+	big_number_limb_sub_n(v2, v2, vm1, m);
+	big_number_limb_rshift(v2, v2, m, 1);
+
+	/* v2 = c3.  t = c1. */
+	big_number_limb_sub_n(v2, v2, t, m);
+	big_number_limb_divexact_3(v2, v2, m);
+	big_number_limb_sub_n(t, t, v2, m);
+
+	/* Put it all together.  c0 and c4 are already in place, so clear the
+	 * gap between them, and then add c1, c2 and c3 in at their offsets. */
+	memset(r + (2 * k), 0, (2 * k) * sizeof(limb_t));
+	big_number_limb_add_at(r, 2 * n, k,       t,  m);
+	big_number_limb_add_at(r, 2 * n, 2 * k,   v1, m);
+	big_number_limb_add_at(r, 2 * n, 3 * k,   v2, m);
+}
+
+/*******************************************************************************
+ * Toom-3 multiplication of 2 n-limb numbers.  r must have room for 2n limbs.
+ *
+ * Split each operand into 3 pieces of k limbs (the top piece may be shorter),
+ * and treat them as the polynomials a(X) and b(X).  Their product c(X) has 5
+ * coefficients.  Evaluate at 0, 1, -1, 2 and infinity, multiply the 5 pairs
+ * of values, and then solve for the coefficients.
+ ******************************************************************************/
+static void big_number_limb_mul_toom3(limb_t *r, const limb_t *a, const limb_t *b, int n, limb_t *scratch)
+{
+	int k  = (n + 2) / 3;
+	int k2 = n - (2 * k);
+	int m  = (2 * k) + 2;
+
+	limb_t *p1   = scratch;
+	limb_t *q1   = p1  + (k + 1);
+	limb_t *pm1  = q1  + (k + 1);
+	limb_t *qm1  = pm1 + (k + 1);
+	limb_t *p2   = qm1 + (k + 1);
+	limb_t *q2   = p2  + (k + 1);
+	limb_t *v1   = q2  + (k + 1);
+	limb_t *vm1  = v1  + m;
+	limb_t *v2   = vm1 + m;
+	limb_t *t    = v2  + m;
+	limb_t *next = t   + m;
+
+	int negative = big_number_limb_toom3_eval(p1, pm1, p2, a, k, k2);
+	negative    ^= big_number_limb_toom3_eval(q1, qm1, q2, b, k, k2);
+
+	/* c0 and c4 go straight into their final spots in r. */
+	big_number_limb_mul_n(r,           a,           b,           k,  next);
+	big_number_limb_mul_n(r + (4 * k), a + (2 * k), b + (2 * k), k2, next);
+
+	big_number_limb_mul_n(v1,  p1,  q1,  k + 1, next);
+	big_number_limb_mul_n(vm1, pm1, qm1, k + 1, next);
+	big_number_limb_mul_n(v2,  p2,  q2,  k + 1, next);
+
+	big_number_limb_toom3_finish(r, n, v1, vm1, v2, t, negative);
+}
+
+/*******************************************************************************
+ * Multiply 2 n-limb numbers.  Pick the algorithm based on n.  r must have room
+ * for 2n limbs, and it must not overlap a or b.
+ ******************************************************************************/
+static void big_number_limb_mul_n(limb_t *r, const limb_t *a, const limb_t *b, int n, limb_t *scratch)
+{
+	if(n < karatsuba_threshold) {
+		big_number_limb_mul_basecase(r, a, n, b, n);
+	}
+	else if(n < toom3_threshold) {
+		big_number_limb_mul_karatsuba(r, a, b, n, scratch);
+	}
+	else {
+		big_number_limb_mul_toom3(r, a, b, n, scratch);
+	}
+}
+
+/*******************************************************************************
+ * Toom-3 squaring of an n-limb number.  r must have room for 2n limbs.  Only
+ * one operand needs to be evaluated, and the value at -1 squares to a positive
+ * number.
+ ******************************************************************************/
+static void big_number_limb_sqr_toom3(limb_t *r, const limb_t *a, int n, limb_t *scratch)
+{
+	int k  = (n + 2) / 3;
+	int k2 = n - (2 * k);
+	int m  = (2 * k) + 2;
+
+	limb_t *p1   = scratch;
+	limb_t *pm1  = p1  + (k + 1);
+	limb_t *p2   = pm1 + (k + 1);
+	limb_t *v1   = p2  + (k + 1);
+	limb_t *vm1  = v1  + m;
+	limb_t *v2   = vm1 + m;
+	limb_t *t    = v2  + m;
+	limb_t *next = t   + m;
+
+	big_number_limb_toom3_eval(p1, pm1, p2, a, k, k2);
+
+	/* c0 and c4 go straight into their final spots in r. */
+	big_number_limb_sqr_n(r,           a,           k,  next);
+	big_number_limb_sqr_n(r + (4 * k), a + (2 * k), k2, next);
+
+	big_number_limb_sqr_n(v1,  p1,  k + 1, next);
+	big_number_limb_sqr_n(vm1, pm1, k + 1, next);
+	big_number_limb_sqr_n(v2,  p2,  k + 1, next);
+
+	big_number_limb_toom3_finish(r, n, v1, vm1, v2, t, 0);
+}
+
+/*******************************************************************************
+ * Square an n-limb number.  Pick the algorithm based on n.  r must have room
+ * for 2n limbs, and it must not overlap a.
+ ******************************************************************************/
+static void big_number_limb_sqr_n(limb_t *r, const limb_t *a, int n, limb_t *scratch)
+{
+	if(n < karatsuba_threshold) {
+		big_number_limb_sqr_basecase(r, a, n);
+	}
+	else if(n < toom3_threshold) {
+		big_number_limb_sqr_karatsuba(r, a, n, scratch);
+	}
+	else {
+		big_number_limb_sqr_toom3(r, a, n, scratch);
+	}
+}
+
+/********************************** PUBLIC API ********************************/
+
+/*******************************************************************************
+ * Multiply 2 limb arrays.  r = a * b.
+ *
+ * Input:
+ *   r  - Receives the product.  Must have room for (an + bn) limbs, and it
+ *        must not overlap a or b.
+ *   a  - The longer factor.
+ *   an - Number of limbs in a.
+ *   b  - The shorter factor.
+ *   bn - Number of limbs in b.  (an >= bn > 0).
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (out of memory for the scratch space).
+ ******************************************************************************/
+int big_number_limb_mul(limb_t *r, const limb_t *a, int an, const limb_t *b, int bn)
+{
+	/* Small numbers don't need any scratch space. */
+	if(bn < karatsuba_threshold) {
+		big_number_limb_mul_basecase(r, a, an, b, bn);
+		return 0;
+	}
+
+	/* Huge ones don't get split up at all. */
+	if(bn >= ntt_threshold) {
+		return big_number_limb_mul_ntt(r, a, an, b, bn);
+	}
+
+	/* Unbalanced operands need a spot to hold each partial product. */
+	int partial = (an == bn) ? 0 : (2 * bn);
+	limb_t *scratch = (limb_t *) malloc((big_number_limb_mul_n_itch(bn) + partial) * sizeof(limb_t));
+	if(scratch == (limb_t *) 0) {
+		return 1;
+	}
+
+	if(an == bn) {
+		big_number_limb_mul_n(r, a, b, bn, scratch);
+	}
+
+	/* Chop a into pieces that are as long as b, multiply each piece by b,
+	 * and add the partial products into place. */
+	else {
+		limb_t *prod = scratch;
+		limb_t *next = prod + partial;
+
+		big_number_limb_mul_n(r, a, b, bn, next);
+		memset(r + (2 * bn), 0, (an - bn) * sizeof(limb_t));
+
+		int off;
+		for(off = bn; off < an; off += bn) {
+			int len = an - off;
+			if(len >= bn) {
+				big_number_limb_mul_n(prod, a + off, b, bn, next);
+				len = bn;
+			}
+			else if(big_number_limb_mul(prod, b, bn, a + off, len) != 0) {
+				free(scratch);
+				return 1;
+			}
+			big_number_limb_add(r + off, r + off, an + bn - off, prod, len + bn);
+		}
+	}
+
+	free(scratch);
+	return 0;
+}
+
+/*******************************************************************************
+ * Schoolbook squaring.  r = a * a.  r must have room for 2n limbs, and it must
+ * not overlap a.  n must be > 0.
+ *
+ * Each cross product (a[i] * a[j], i < j) shows up twice in the square.  So
+ * add up the cross products once, double the total, and then add in the
+ * squares of the individual limbs (the diagonal).
+ ******************************************************************************/
+void big_number_limb_sqr_basecase(limb_t *r, const limb_t *a, int n)
+{
+	/* Cross products.  Row i is (a[i] * a[i+1..n-1]), at limb (2i + 1). */
+	r[0] = 0;
+	r[n] = big_number_limb_mul_1(r + 1, a + 1, n - 1, a[0]);
+
+	int i;
+	for(i = 1; i < (n - 1); i++) {
+		r[n + i] = big_number_limb_addmul_1(r + (2 * i) + 1, a + i + 1, n - i - 1, a[i]);
+	}
+	r[(2 * n) - 1] = 0;
+
+	/* Double them. */
+	big_number_limb_lshift(r, r, 2 * n, 1);
+
+	/* Add the diagonal. */
+	limb_t carry = 0;
+	for(i = 0; i < n; i++) {
+		dlimb_t sq = (dlimb_t) a[i] * a[i];
+
+		dlimb_t t = (dlimb_t) r[2 * i] + (limb_t) sq + carry;
+		r[2 * i] = (limb_t) t;
+		carry = (limb_t) (t >> LIMB_BITS);
+
+		t = (dlimb_t) r[(2 * i) + 1] + (limb_t) (sq >> LIMB_BITS) + carry;
+		r[(2 * i) + 1] = (limb_t) t;
+		carry = (limb_t) (t >> LIMB_BITS);
+	}
+}
+
+/*******************************************************************************
+ * Square a limb array.  r = a * a.
+ *
+ * Input:
+ *   r - Receives the square.  Must have room for 2n limbs, and it must not
+ *       overlap a.
+ *   a - The number to square.
+ *   n - Number of limbs in a.  (n > 0).
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (out of memory for the scratch space).
+ ******************************************************************************/
+int big_number_limb_sqr(limb_t *r, const limb_t *a, int n)
+{
+	/* Small numbers don't need any scratch space. */
+	if(n < karatsuba_threshold) {
+		big_number_limb_sqr_basecase(r, a, n);
+		return 0;
+	}
+
+	if(n >= ntt_threshold) {
+		return big_number_limb_sqr_ntt(r, a, n);
+	}
+
+	limb_t *scratch = (limb_t *) malloc(big_number_limb_mul_n_itch(n) * sizeof(limb_t));
+	if(scratch == (limb_t *) 0) {
+		return 1;
+	}
+
+	big_number_limb_sqr_n(r, a, n, scratch);
+
+	free(scratch);
+	return 0;
+}
+
+/*******************************************************************************
+ * Change the multiplication crossover points.  This is a tuning and test hook.
+ * It must not be called while other threads are multiplying.
+ *
+ * Input:
+ *   karatsuba - Operands with fewer limbs than this use the schoolbook method.
+ *   toom3     - Operands with at least this many limbs use Toom-3.
+ ******************************************************************************/
+void big_number_limb_set_mul_thresholds(int karatsuba, int toom3)
+{
+	karatsuba_threshold = (karatsuba < KARATSUBA_MIN) ? KARATSUBA_MIN : karatsuba;
+	toom3_threshold     = (toom3     < TOOM3_MIN)     ? TOOM3_MIN     : toom3;
+}
+
+/*******************************************************************************
+ * Read the multiplication crossover points.
+ *
+ * Input:
+ *   karatsuba - Receives the Karatsuba threshold.
+ *   toom3     - Receives the Toom-3 threshold.
+ ******************************************************************************/
+void big_number_limb_get_mul_thresholds(int *karatsuba, int *toom3)
+{
+	*karatsuba = karatsuba_threshold;
+	*toom3     = toom3_threshold;
+}
+
+/*******************************************************************************
+ * Change the NTT crossover point.  This is a tuning and test hook.  It must not
+ * be called while other threads are multiplying.
+ *
+ * Input:
+ *   ntt - Operands with at least this many limbs use the NTT.
+ ******************************************************************************/
+void big_number_limb_set_ntt_threshold(int ntt)
+{
+	ntt_threshold = (ntt < NTT_MIN) ? NTT_MIN : ntt;
+}
+
+/*******************************************************************************
+ * Read the NTT crossover point.
+ *
+ * Output:
+ *   Returns the NTT threshold.
+ ******************************************************************************/
+int big_number_limb_get_ntt_threshold(void)
+{
+	return ntt_threshold;
+}
+
+/********** Test Methods */
+
+#ifdef TEST
+/*******************************************************************************
+ * Fill a limb array with pseudo-random bits.  Every so often, make the limbs
+ * all ones so that the carries get a workout.
+ ******************************************************************************/
+static void big_number_mul_test_fill(limb_t *a, int n)
+{
+	int all_ones = ((rand() % 8) == 0);
+
+	int i;
+	for(i = 0; i < n; i++) {
+		a[i] = ((limb_t) rand() << 62) ^ ((limb_t) rand() << 31) ^ (limb_t) rand();
+		if(all_ones) {
+			a[i] = UINT64_MAX;
+		}
+	}
+}
+
+/*******************************************************************************
+ * Run the multiplication tests.  Force each algorithm in turn, and compare the
+ * results (products and squares) against the schoolbook multiply.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1.
+ ******************************************************************************/
+int big_number_mul_test(void)
+{
+	int rc = 0;
+
+	printf("%s(): Starting\n", __func__);
+
+	int saved_karatsuba, saved_toom3;
+	big_number_limb_get_mul_thresholds(&saved_karatsuba, &saved_toom3);
+
+	/* Karatsuba only, then Toom-3 on top of Karatsuba. */
+	static const int settings[][2] = { { 2, 1 << 30 }, { 4, 9 }, { 16, 27 } };
+	static const int sizes[][2] = {
+		{ 2, 2 }, { 3, 3 }, { 9, 9 }, { 10, 10 }, { 11, 11 }, { 31, 31 },
+		{ 64, 64 }, { 100, 100 }, { 97, 31 }, { 130, 9 }, { 200, 199 }
+	};
+
+	srand(1);
+
+	int s;
+	for(s = 0; (s < (sizeof(settings) / sizeof(settings[0]))) && (rc == 0); s++) {
+		int i;
+		for(i = 0; (i < (sizeof(sizes) / sizeof(sizes[0]))) && (rc == 0); i++) {
+			int an = sizes[i][0];
+			int bn = sizes[i][1];
+
+			limb_t *a    = (limb_t *) malloc(an * sizeof(limb_t));
+			limb_t *b    = (limb_t *) malloc(bn * sizeof(limb_t));
+			limb_t *r    = (limb_t *) malloc((an + bn) * sizeof(limb_t));
+			limb_t *cmp  = (limb_t *) malloc((2 * an) * sizeof(limb_t));
+			if(!a || !b || !r || !cmp) {
+				rc = 1;
+			}
+			else {
+				big_number_mul_test_fill(a, an);
+				big_number_mul_test_fill(b, bn);
+
+				big_number_limb_mul_basecase(cmp, a, an, b, bn);
+
+				big_number_limb_set_mul_thresholds(settings[s][0], settings[s][1]);
+				if(big_number_limb_mul(r, a, an, b, bn) != 0) {
+					rc = 1;
+				}
+				big_number_limb_set_mul_thresholds(saved_karatsuba, saved_toom3);
+
+				if(memcmp(r, cmp, (an + bn) * sizeof(limb_t)) != 0) {
+					printf("%s(): Mismatch: %d x %d limbs (thresholds %d/%d).\n", __func__,
+					       an, bn, settings[s][0], settings[s][1]);
+					rc = 1;
+				}
+
+				/* Now square a, and compare it to (a * a). */
+				big_number_limb_mul_basecase(cmp, a, an, a, an);
+
+				big_number_limb_set_mul_thresholds(settings[s][0], settings[s][1]);
+				r = (limb_t *) realloc(r, (2 * an) * sizeof(limb_t));
+				if((r == (limb_t *) 0) || (big_number_limb_sqr(r, a, an) != 0)) {
+					rc = 1;
+				}
+				big_number_limb_set_mul_thresholds(saved_karatsuba, saved_toom3);
+
+				if((rc == 0) && (memcmp(r, cmp, (2 * an) * sizeof(limb_t)) != 0)) {
+					printf("%s(): Square mismatch: %d limbs (thresholds %d/%d).\n", __func__,
+					       an, settings[s][0], settings[s][1]);
+					rc = 1;
+				}
+			}
+
+			free(cmp);
+			free(r);
+			free(b);
+			free(a);
+		}
+	}
+
+	printf("%s(): %s.\n", __func__, (rc == 0) ? "PASS" : "FAIL");
+	return rc;
+}
+#endif /* TEST */
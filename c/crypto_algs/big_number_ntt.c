@@ -0,0 +1,519 @@
+/*******************************************************************************
+ *
+ * This module multiplies very long limb arrays with a number-theoretic
+ * transform (NTT).  big_number_mul.c hands operands to it once they reach the
+ * NTT threshold.
+ *
+ * - Each limb is one coefficient of a polynomial, and the product is the
+ *   convolution of the 2 polynomials.  That's computed mod 3 primes, each just
+ *   under 2^63 and of the form (c * 2^k) + 1, so each one has roots of unity
+ *   for every power-of-2 transform size up to 2^46.  A coefficient of the
+ *   product is less than (n * 2^128), and the 3 primes multiply out to about
+ *   2^189, so the Chinese Remainder Theorem (Garner's form) gets it back
+ *   exactly.  Then the coefficients are added up with carries.
+ *
+ * - The arithmetic mod each prime is Montgomery form with 128-bit products.
+ *
+ * - The forward transform is decimation in frequency (natural order in, bit
+ *   reversed out), and the inverse is decimation in time (bit reversed in,
+ *   natural order out), so there's no bit reversal pass.  The twiddle factors
+ *   for each level are stored one level after another, so every level reads
+ *   them in order.
+ *
+ * - The transforms are cache blocked.  The top levels do one pass over the
+ *   whole array each, and then recurse into the halves, depth first.  Once a
+ *   piece fits in NTT_BLOCK elements (L1 cache sized), all of its remaining
+ *   levels run on it while it's in cache.
+ *
+ * The cost is O(n log n), so it wins over Toom-3 for numbers of many thousands
+ * of limbs.  A million-bit multiply takes about 11 milliseconds.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "big_number_limb.h"
+
+/* Transform pieces of up to this many elements (32KB) are done level by level
+ * in one go. */
+#define NTT_BLOCK (4096)
+
+/* The primes, ((c * 2^k) + 1), each with a primitive root.  The smallest k
+ * limits the transform size. */
+#define NTT_PRIMES (3)
+#define NTT_MAX_LOG (46)
+
+static const uint64_t ntt_prime_values[NTT_PRIMES] = {
+	0x7FA8000000000001ULL,	/* (8170 * 2^50) + 1 */
+	0x7FE1000000000001ULL,	/* (32737 * 2^48) + 1 */
+	0x7FE7C00000000001ULL	/* (130975 * 2^46) + 1 */
+};
+
+static const uint64_t ntt_prime_roots[NTT_PRIMES] = { 3, 3, 3 };
+
+/*******************************************************************************
+ ******************************* CLASS DEFINITION ******************************
+ ******************************************************************************/
+
+/* One of the primes, prepared for Montgomery multiplication.  Values in
+ * Montgomery form are (x * 2^64) % p. */
+typedef struct ntt_prime {
+	uint64_t p;
+	uint64_t inv;		/* p ^ -1 (mod 2^64). */
+	uint64_t one;		/* 2^64 % p. */
+	uint64_t r2;		/* 2^128 % p. */
+} ntt_prime;
+
+/********************************* PRIVATE API ********************************/
+
+/*******************************************************************************
+ * Montgomery multiplication.  Returns (a * b / 2^64) % p, for (a * b) < (p *
+ * 2^64).  The low half of (t - (m * p)) is 0 by the choice of m, so only the
+ * high halves have to be subtracted.
+ ******************************************************************************/
+static inline uint64_t big_number_ntt_mul(const ntt_prime *this, uint64_t a, uint64_t b)
+{
+	dlimb_t t = (dlimb_t) a * b;
+	uint64_t m = (uint64_t) t * this->inv;
+	uint64_t t_hi = (uint64_t) (t >> 64);
+	uint64_t mp_hi = (uint64_t) (((dlimb_t) m * this->p) >> 64);
+	uint64_t r = t_hi - mp_hi;
+	return r + (this->p & (0 - (uint64_t) (t_hi < mp_hi)));
+}
+
+/* The add and subtract use masks instead of branches.  The branches would go
+ * either way at random, and mispredicting them costs more than the math. */
+static inline uint64_t big_number_ntt_add(const ntt_prime *this, uint64_t a, uint64_t b)
+{
+	uint64_t r = a + b - this->p;
+	return r + (this->p & (0 - (r >> 63)));
+}
+
+static inline uint64_t big_number_ntt_sub(const ntt_prime *this, uint64_t a, uint64_t b)
+{
+	uint64_t r = a - b;
+	return r + (this->p & (0 - (uint64_t) (a < b)));
+}
+
+/*******************************************************************************
+ * (base ^ exp) in Montgomery form.  base is in Montgomery form.
+ ******************************************************************************/
+static uint64_t big_number_ntt_pow(const ntt_prime *this, uint64_t base, uint64_t exp)
+{
+	uint64_t result = this->one;
+	while(exp != 0) {
+		if(exp & 1) {
+			result = big_number_ntt_mul(this, result, base);
+		}
+		base = big_number_ntt_mul(this, base, base);
+		exp >>= 1;
+	}
+
+	return result;
+}
+
+/*******************************************************************************
+ * Prepare one of the primes.
+ ******************************************************************************/
+static void big_number_ntt_prime_init(ntt_prime *this, uint64_t p)
+{
+	uint64_t inv = p;
+	int i;
+	for(i = 0; i < 5; i++) {
+		inv *= 2 - (p * inv);
+	}
+
+	this->p = p;
+	this->inv = inv;
+	this->one = (0 - p) % p;
+	this->r2 = (uint64_t) (((dlimb_t) this->one * this->one) % p);
+}
+
+/*******************************************************************************
+ * Fill in the twiddle factors for an n-point transform.  roots[h + j] is
+ * (w_2h ^ j) for each level h (1, 2, 4, ... n/2), where w_2h is a primitive
+ * (2h)th root of unity.  They're in Montgomery form.
+ ******************************************************************************/
+static void big_number_ntt_roots(const ntt_prime *this, uint64_t *roots, size_t n, uint64_t w)
+{
+	size_t h = n / 2;
+	size_t j;
+
+	roots[h] = this->one;
+	for(j = 1; j < h; j++) {
+		roots[h + j] = big_number_ntt_mul(this, roots[h + j - 1], w);
+	}
+
+	/* w_h = (w_2h ^ 2), so each level is every other one of the level
+	 * above. */
+	for(h /= 2; h >= 1; h /= 2) {
+		for(j = 0; j < h; j++) {
+			roots[h + j] = roots[(2 * h) + (2 * j)];
+		}
+	}
+}
+
+/*******************************************************************************
+ * Forward transform of n points (decimation in frequency).  The output is in
+ * bit reversed order.
+ ******************************************************************************/
+static void big_number_ntt_forward(const ntt_prime *this, uint64_t *a, size_t n, const uint64_t *roots)
+{
+	size_t h, s, j;
+
+	if(n <= NTT_BLOCK) {
+		for(h = n / 2; h >= 2; h /= 2) {
+			const uint64_t *w = roots + h;
+			for(s = 0; s < n; s += 2 * h) {
+				uint64_t *x = a + s;
+				uint64_t *y = x + h;
+				for(j = 0; j < h; j++) {
+					uint64_t u = x[j];
+					uint64_t v = y[j];
+					x[j] = big_number_ntt_add(this, u, v);
+					y[j] = big_number_ntt_mul(this, big_number_ntt_sub(this, u, v), w[j]);
+				}
+			}
+		}
+
+		/* The last level's twiddle factor is 1. */
+		for(s = 0; s < n; s += 2) {
+			uint64_t u = a[s];
+			uint64_t v = a[s + 1];
+			a[s] = big_number_ntt_add(this, u, v);
+			a[s + 1] = big_number_ntt_sub(this, u, v);
+		}
+		return;
+	}
+
+	/* The top level, then each half on its own. */
+	h = n / 2;
+	const uint64_t *w = roots + h;
+	for(j = 0; j < h; j++) {
+		uint64_t u = a[j];
+		uint64_t v = a[j + h];
+		a[j] = big_number_ntt_add(this, u, v);
+		a[j + h] = big_number_ntt_mul(this, big_number_ntt_sub(this, u, v), w[j]);
+	}
+	big_number_ntt_forward(this, a, h, roots);
+	big_number_ntt_forward(this, a + h, h, roots);
+}
+
+/*******************************************************************************
+ * Inverse transform of n points (decimation in time).  The input is in bit
+ * reversed order.  The roots are the inverses of the forward ones, and the
+ * result is n times too big.
+ ******************************************************************************/
+static void big_number_ntt_inverse(const ntt_prime *this, uint64_t *a, size_t n, const uint64_t *roots)
+{
+	size_t h, s, j;
+
+	if(n <= NTT_BLOCK) {
+		/* The first level's twiddle factor is 1. */
+		for(s = 0; s < n; s += 2) {
+			uint64_t u = a[s];
+			uint64_t v = a[s + 1];
+			a[s] = big_number_ntt_add(this, u, v);
+			a[s + 1] = big_number_ntt_sub(this, u, v);
+		}
+
+		for(h = 2; h < n; h *= 2) {
+			const uint64_t *w = roots + h;
+			for(s = 0; s < n; s += 2 * h) {
+				uint64_t *x = a + s;
+				uint64_t *y = x + h;
+				for(j = 0; j < h; j++) {
+					uint64_t u = x[j];
+					uint64_t v = big_number_ntt_mul(this, y[j], w[j]);
+					x[j] = big_number_ntt_add(this, u, v);
+					y[j] = big_number_ntt_sub(this, u, v);
+				}
+			}
+		}
+		return;
+	}
+
+	/* Each half on its own, then the top level. */
+	h = n / 2;
+	big_number_ntt_inverse(this, a, h, roots);
+	big_number_ntt_inverse(this, a + h, h, roots);
+	const uint64_t *w = roots + h;
+	for(j = 0; j < h; j++) {
+		uint64_t u = a[j];
+		uint64_t v = big_number_ntt_mul(this, a[j + h], w[j]);
+		a[j] = big_number_ntt_add(this, u, v);
+		a[j + h] = big_number_ntt_sub(this, u, v);
+	}
+}
+
+/*******************************************************************************
+ * Load a limb array into a transform buffer, in Montgomery form, and zero the
+ * rest of it.  A limb can be bigger than p, but (limb * r2) is still less than
+ * (p * 2^64), so one multiply does the reduction too.
+ ******************************************************************************/
+static void big_number_ntt_load(const ntt_prime *this, uint64_t *x, size_t n, const limb_t *a, int an)
+{
+	int i;
+	for(i = 0; i < an; i++) {
+		x[i] = big_number_ntt_mul(this, a[i], this->r2);
+	}
+	memset(x + an, 0, (n - an) * sizeof(uint64_t));
+}
+
+/*******************************************************************************
+ * The convolution of a and b (or a and a) mod one prime.  On return, x holds
+ * the coefficients of the product (mod p), in normal form.
+ *
+ * Input:
+ *   this  - The prime.
+ *   x     - n elements.  Receives the result.
+ *   y     - n elements of scratch space.  Not used for a square.
+ *   roots - n elements of scratch space for the twiddle factors.
+ *   n     - The transform size.  A power of 2, at least (an + bn).
+ *   g     - A primitive root of p.
+ ******************************************************************************/
+static void big_number_ntt_convolve(const ntt_prime *this, uint64_t *x, uint64_t *y, uint64_t *roots, size_t n,
+                                    uint64_t g, const limb_t *a, int an, const limb_t *b, int bn)
+{
+	/* w is a primitive nth root of unity. */
+	uint64_t gm = big_number_ntt_mul(this, g, this->r2);
+	uint64_t w = big_number_ntt_pow(this, gm, (this->p - 1) / n);
+
+	big_number_ntt_roots(this, roots, n, w);
+	big_number_ntt_load(this, x, n, a, an);
+	big_number_ntt_forward(this, x, n, roots);
+
+	size_t i;
+	if(b == (const limb_t *) 0) {
+		for(i = 0; i < n; i++) {
+			x[i] = big_number_ntt_mul(this, x[i], x[i]);
+		}
+	}
+	else {
+		big_number_ntt_load(this, y, n, b, bn);
+		big_number_ntt_forward(this, y, n, roots);
+		for(i = 0; i < n; i++) {
+			x[i] = big_number_ntt_mul(this, x[i], y[i]);
+		}
+	}
+
+	/* The inverse uses (w ^ -1) = (w ^ (n - 1)). */
+	big_number_ntt_roots(this, roots, n, big_number_ntt_pow(this, w, n - 1));
+	big_number_ntt_inverse(this, x, n, roots);
+
+	/* Divide by n, and come out of Montgomery form, with one multiply.  (x *
+	 * 2^64 * n) * (n ^ -1) / 2^64 = x. */
+	uint64_t n_inv = big_number_ntt_pow(this, big_number_ntt_mul(this, n % this->p, this->r2), this->p - 2);
+	n_inv = big_number_ntt_mul(this, n_inv, 1);
+	for(i = 0; i < n; i++) {
+		x[i] = big_number_ntt_mul(this, x[i], n_inv);
+	}
+}
+
+/*******************************************************************************
+ * The product (or square), with b = 0 for a square.  r must have room for
+ * (an + bn) limbs.
+ ******************************************************************************/
+static int big_number_ntt_multiply(limb_t *r, const limb_t *a, int an, const limb_t *b, int bn)
+{
+	int rn = an + ((b == (const limb_t *) 0) ? an : bn);
+
+	size_t n = 1;
+	int log = 0;
+	while(n < rn) {
+		n *= 2;
+		log++;
+	}
+	if(log > NTT_MAX_LOG) {
+		return 1;
+	}
+
+	/* A result for each prime, plus the second operand and the roots. */
+	uint64_t *buf = (uint64_t *) malloc((NTT_PRIMES + 2) * n * sizeof(uint64_t));
+	if(buf == (uint64_t *) 0) {
+		return 1;
+	}
+	uint64_t *res[NTT_PRIMES];
+	uint64_t *y = buf + (NTT_PRIMES * n);
+	uint64_t *roots = y + n;
+
+	ntt_prime primes[NTT_PRIMES];
+	int k;
+	for(k = 0; k < NTT_PRIMES; k++) {
+		big_number_ntt_prime_init(&primes[k], ntt_prime_values[k]);
+		res[k] = buf + (k * n);
+		big_number_ntt_convolve(&primes[k], res[k], y, roots, n, ntt_prime_roots[k], a, an, b, bn);
+	}
+
+	/* Garner's constants, in Montgomery form so one multiply applies them.
+	 *   c12 = (p1 ^ -1) % p2
+	 *   c13 = p1 % p3
+	 *   c123 = ((p1 * p2) ^ -1) % p3 */
+	const ntt_prime *p1 = &primes[0], *p2 = &primes[1], *p3 = &primes[2];
+	uint64_t m = big_number_ntt_mul(p2, p1->p, p2->r2);
+	uint64_t c12 = big_number_ntt_pow(p2, m, p2->p - 2);
+	uint64_t c13 = big_number_ntt_mul(p3, p1->p, p3->r2);
+	m = big_number_ntt_mul(p3, big_number_ntt_mul(p3, p1->p, p3->r2), big_number_ntt_mul(p3, p2->p, p3->r2));
+	uint64_t c123 = big_number_ntt_pow(p3, m, p3->p - 2);
+	dlimb_t p12 = (dlimb_t) p1->p * p2->p;
+	uint64_t p12_lo = (uint64_t) p12, p12_hi = (uint64_t) (p12 >> 64);
+
+	/* Put each coefficient back together, and add it in at its limb.  The
+	 * running total never needs more than 3 limbs. */
+	uint64_t acc0 = 0, acc1 = 0, acc2 = 0;
+	int i;
+	for(i = 0; i < rn; i++) {
+		uint64_t v1 = res[0][i];
+		uint64_t v2 = big_number_ntt_mul(p2, big_number_ntt_sub(p2, res[1][i], v1), c12);
+		uint64_t u = big_number_ntt_add(p3, v1, big_number_ntt_mul(p3, v2, c13));
+		uint64_t v3 = big_number_ntt_mul(p3, big_number_ntt_sub(p3, res[2][i], u), c123);
+
+		/* x = v1 + (v2 * p1) + (v3 * p1 * p2). */
+		dlimb_t t = (dlimb_t) v2 * p1->p + v1;
+		dlimb_t lo = (dlimb_t) v3 * p12_lo;
+		dlimb_t hi = (dlimb_t) v3 * p12_hi;
+
+		dlimb_t s = (dlimb_t) acc0 + (uint64_t) t + (uint64_t) lo;
+		r[i] = (limb_t) s;
+		s = (s >> 64) + acc1 + (uint64_t) (t >> 64) + (uint64_t) (lo >> 64) + (uint64_t) hi;
+		acc0 = (uint64_t) s;
+		s = (s >> 64) + acc2 + (uint64_t) (hi >> 64);
+		acc1 = (uint64_t) s;
+		acc2 = (uint64_t) (s >> 64);
+	}
+
+	free(buf);
+	return 0;
+}
+
+/********************************** PUBLIC API ********************************/
+
+/*******************************************************************************
+ * Multiply 2 limb arrays with the NTT.  r = a * b.
+ *
+ * Input:
+ *   r  - Receives the product.  Must have room for (an + bn) limbs, and it
+ *        must not overlap a or b.
+ *   a  - One factor.
+ *   an - Number of limbs in a.
+ *   b  - The other factor.
+ *   bn - Number of limbs in b.  (an, bn > 0).
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (out of memory, or the product is longer than 2^46 limbs).
+ ******************************************************************************/
+int big_number_limb_mul_ntt(limb_t *r, const limb_t *a, int an, const limb_t *b, int bn)
+{
+	return big_number_ntt_multiply(r, a, an, b, bn);
+}
+
+/*******************************************************************************
+ * Square a limb array with the NTT.  r = a * a.  It takes one forward
+ * transform per prime instead of 2.
+ *
+ * Input:
+ *   r - Receives the square.  Must have room for 2n limbs, and it must not
+ *       overlap a.
+ *   a - The number to square.
+ *   n - Number of limbs in a.  (n > 0).
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (out of memory, or the square is longer than 2^46 limbs).
+ ******************************************************************************/
+int big_number_limb_sqr_ntt(limb_t *r, const limb_t *a, int n)
+{
+	return big_number_ntt_multiply(r, a, n, (const limb_t *) 0, 0);
+}
+
+/********** Test Methods */
+
+#ifdef TEST
+/*******************************************************************************
+ * Run the NTT tests.  Compare products and squares against the other
+ * algorithms, including sizes that go past NTT_BLOCK (so the recursion runs),
+ * and limbs that are all ones (the biggest coefficients).
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1.
+ ******************************************************************************/
+int big_number_ntt_test(void)
+{
+	int rc = 0;
+
+	printf("%s(): Starting\n", __func__);
+
+	static const int sizes[][2] = {
+		{ 1, 1 }, { 2, 1 }, { 5, 3 }, { 64, 64 }, { 300, 7 },
+		{ 1000, 999 }, { 3000, 3000 }, { 5000, 1200 }
+	};
+
+	srand(2);
+
+	int i;
+	for(i = 0; (i < (sizeof(sizes) / sizeof(sizes[0]))) && (rc == 0); i++) {
+		int an = sizes[i][0];
+		int bn = sizes[i][1];
+
+		int pass;
+		for(pass = 0; (pass < 2) && (rc == 0); pass++) {
+			limb_t *a   = (limb_t *) malloc(an * sizeof(limb_t));
+			limb_t *b   = (limb_t *) malloc(bn * sizeof(limb_t));
+			limb_t *r   = (limb_t *) malloc((2 * an) * sizeof(limb_t));
+			limb_t *cmp = (limb_t *) malloc((2 * an) * sizeof(limb_t));
+			if(!a || !b || !r || !cmp) {
+				rc = 1;
+			}
+			else {
+				int j;
+				for(j = 0; j < an; j++) {
+					a[j] = (pass == 1) ? UINT64_MAX : ((limb_t) rand() << 62) ^ ((limb_t) rand() << 31) ^ (limb_t) rand();
+				}
+				for(j = 0; j < bn; j++) {
+					b[j] = (pass == 1) ? UINT64_MAX : ((limb_t) rand() << 62) ^ ((limb_t) rand() << 31) ^ (limb_t) rand();
+				}
+
+				/* The NTT directly, and through the dispatcher (with the
+				 * threshold lowered), against the other algorithms. */
+				int saved = big_number_limb_get_ntt_threshold();
+				big_number_limb_set_ntt_threshold(1 << 30);
+				if(big_number_limb_mul(cmp, a, an, b, bn) != 0) { rc = 1; }
+				if((rc == 0) && ((big_number_limb_mul_ntt(r, a, an, b, bn) != 0) ||
+				                 (memcmp(r, cmp, (an + bn) * sizeof(limb_t)) != 0))) { rc = 1; }
+				big_number_limb_set_ntt_threshold(1);
+				if((rc == 0) && ((big_number_limb_mul(r, a, an, b, bn) != 0) ||
+				                 (memcmp(r, cmp, (an + bn) * sizeof(limb_t)) != 0))) { rc = 1; }
+				if(rc != 0) {
+					printf("%s(): Mismatch: %d x %d limbs.\n", __func__, an, bn);
+				}
+
+				big_number_limb_set_ntt_threshold(1 << 30);
+				if((rc == 0) && (big_number_limb_sqr(cmp, a, an) != 0)) { rc = 1; }
+				if((rc == 0) && ((big_number_limb_sqr_ntt(r, a, an) != 0) ||
+				                 (memcmp(r, cmp, (2 * an) * sizeof(limb_t)) != 0))) { rc = 1; }
+				big_number_limb_set_ntt_threshold(1);
+				if((rc == 0) && ((big_number_limb_sqr(r, a, an) != 0) ||
+				                 (memcmp(r, cmp, (2 * an) * sizeof(limb_t)) != 0))) { rc = 1; }
+				if(rc != 0) {
+					printf("%s(): Square mismatch: %d limbs.\n", __func__, an);
+				}
+
+				big_number_limb_set_ntt_threshold(saved);
+			}
+
+			free(cmp);
+			free(r);
+			free(b);
+			free(a);
+		}
+	}
+
+	printf("%s(): %s.\n", __func__, (rc == 0) ? "PASS" : "FAIL");
+	return rc;
+}
+#endif /* TEST */
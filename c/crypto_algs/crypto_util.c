@@ -0,0 +1,95 @@
+/*******************************************************************************
+ *
+ * This module holds the small helpers that the key generation and key
+ * agreement modules share.
+ *
+ ******************************************************************************/
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include "crypto_util.h"
+
+/********************************** PUBLIC API ********************************/
+
+/*******************************************************************************
+ * Fill a buffer with random bytes from /dev/urandom.
+ *
+ * Input:
+ *   buf - The buffer.
+ *   len - Number of bytes.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1.
+ ******************************************************************************/
+int crypto_util_random_bytes(void *buf, size_t len)
+{
+	int rc = 1;
+
+	int fd = open("/dev/urandom", O_RDONLY);
+	if(fd >= 0) {
+		uint8_t *p = (uint8_t *) buf;
+		while(len > 0) {
+			ssize_t got = read(fd, p, len);
+			if(got <= 0) {
+				break;
+			}
+			p += got;
+			len -= got;
+		}
+		rc = (len != 0);
+		close(fd);
+	}
+
+	return rc;
+}
+
+/*******************************************************************************
+ * Read exactly len bytes from a socket.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (error, or the other side closed the socket).
+ ******************************************************************************/
+int crypto_util_read_full(int fd, void *buf, size_t len)
+{
+	uint8_t *p = (uint8_t *) buf;
+	while(len > 0) {
+		ssize_t got = read(fd, p, len);
+		if(got <= 0) {
+			return 1;
+		}
+		p += got;
+		len -= got;
+	}
+
+	return 0;
+}
+
+/*******************************************************************************
+ * Write exactly len bytes to a socket.  If the other side has gone away, this
+ * fails instead of raising SIGPIPE.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1.
+ ******************************************************************************/
+int crypto_util_write_full(int fd, const void *buf, size_t len)
+{
+	const uint8_t *p = (const uint8_t *) buf;
+	while(len > 0) {
+		ssize_t put = send(fd, p, len, MSG_NOSIGNAL);
+		if(put <= 0) {
+			return 1;
+		}
+		p += put;
+		len -= put;
+	}
+
+	return 0;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+/*******************************************************************************
+ *
+ * External definition of crypto_util.c.
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+
+/*******************************************************************************
+ * Fill a buffer with random bytes from /dev/urandom.  Returns 0 if success.
+ ******************************************************************************/
+int crypto_util_random_bytes(void *buf, size_t len);
+
+/*******************************************************************************
+ * Read or write exactly len bytes on a socket.  A write fails instead of
+ * raising SIGPIPE if the other side has gone away.  Both return 0 if success.
+ ******************************************************************************/
+int crypto_util_read_full(int fd, void *buf, size_t len);
+int crypto_util_write_full(int fd, const void *buf, size_t len);
@@ -1,11 +1,26 @@
 /*******************************************************************************
  *
- * This module negotiates a Diffie Hellman exchange between 2 threads.
+ * This module does Diffie-Hellman key agreement over the MODP groups from
+ * RFC 3526 (2048, 3072, and 4096 bits).  All of them use the generator 2.
+ *
+ * Each side picks a random private exponent x, and sends its public value
+ * (g ^ x) % p to the other side.  Then each side raises the other side's public
+ * value to its own x.  Both sides end up with the same secret,
+ * (g ^ (x1 * x2)) % p.
+ *
+ * The private exponents are shorter than p.  RFC 3526 gives the exponent size
+ * that matches the strength of each group, and using the top of its range
+ * costs a fraction of a full-length exponent.  A group holds p prepared for
+ * Montgomery exponentiation, and a fixed-base table for g that is sized for
+ * the private exponents.  A group is read-only once it has been created, so
+ * any number of threads can share one.
+ *
+ * Public values go over the wire as a 4-byte length (most significant byte
+ * first), followed by the value.  The value is big-endian and is zero filled
+ * out to the size of p, so the length is always the size of p in bytes.
  *
  ******************************************************************************/
 
-#include <errno.h>
-#include <netdb.h>
 #include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -13,244 +28,518 @@
 #include <string.h>
 #include <unistd.h>
 
-#include <arpa/inet.h>
-#include <net/if.h>
-#include <sys/ioctl.h>
 #include <sys/socket.h>
-#include <sys/syscall.h>
 #include <sys/types.h>
-#include <sys/un.h>
 
+#include "big_number.h"
+#include "crypto_util.h"
 #include "diffie_hellman.h"
 
-#define CHANNEL "./unix_socket"
+/* The primes, from RFC 3526.  Each one is a safe prime: (p - 1) / 2 is prime
+ * too. */
+static const char diffie_hellman_p2048[] =
+	"0x"
+	"FFFFFFFFFFFFFFFFC90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74"
+	"020BBEA63B139B22514A08798E3404DDEF9519B3CD3A431B302B0A6DF25F1437"
+	"4FE1356D6D51C245E485B576625E7EC6F44C42E9A637ED6B0BFF5CB6F406B7ED"
+	"EE386BFB5A899FA5AE9F24117C4B1FE649286651ECE45B3DC2007CB8A163BF05"
+	"98DA48361C55D39A69163FA8FD24CF5F83655D23DCA3AD961C62F356208552BB"
+	"9ED529077096966D670C354E4ABC9804F1746C08CA18217C32905E462E36CE3B"
+	"E39E772C180E86039B2783A2EC07A28FB5C55DF06F4C52C9DE2BCBF695581718"
+	"3995497CEA956AE515D2261898FA051015728E5A8AACAA68FFFFFFFFFFFFFFFF";
+
+static const char diffie_hellman_p3072[] =
+	"0x"
+	"FFFFFFFFFFFFFFFFC90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74"
+	"020BBEA63B139B22514A08798E3404DDEF9519B3CD3A431B302B0A6DF25F1437"
+	"4FE1356D6D51C245E485B576625E7EC6F44C42E9A637ED6B0BFF5CB6F406B7ED"
+	"EE386BFB5A899FA5AE9F24117C4B1FE649286651ECE45B3DC2007CB8A163BF05"
+	"98DA48361C55D39A69163FA8FD24CF5F83655D23DCA3AD961C62F356208552BB"
+	"9ED529077096966D670C354E4ABC9804F1746C08CA18217C32905E462E36CE3B"
+	"E39E772C180E86039B2783A2EC07A28FB5C55DF06F4C52C9DE2BCBF695581718"
+	"3995497CEA956AE515D2261898FA051015728E5A8AAAC42DAD33170D04507A33"
+	"A85521ABDF1CBA64ECFB850458DBEF0A8AEA71575D060C7DB3970F85A6E1E4C7"
+	"ABF5AE8CDB0933D71E8C94E04A25619DCEE3D2261AD2EE6BF12FFA06D98A0864"
+	"D87602733EC86A64521F2B18177B200CBBE117577A615D6C770988C0BAD946E2"
+	"08E24FA074E5AB3143DB5BFCE0FD108E4B82D120A93AD2CAFFFFFFFFFFFFFFFF";
+
+static const char diffie_hellman_p4096[] =
+	"0x"
+	"FFFFFFFFFFFFFFFFC90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74"
+	"020BBEA63B139B22514A08798E3404DDEF9519B3CD3A431B302B0A6DF25F1437"
+	"4FE1356D6D51C245E485B576625E7EC6F44C42E9A637ED6B0BFF5CB6F406B7ED"
+	"EE386BFB5A899FA5AE9F24117C4B1FE649286651ECE45B3DC2007CB8A163BF05"
+	"98DA48361C55D39A69163FA8FD24CF5F83655D23DCA3AD961C62F356208552BB"
+	"9ED529077096966D670C354E4ABC9804F1746C08CA18217C32905E462E36CE3B"
+	"E39E772C180E86039B2783A2EC07A28FB5C55DF06F4C52C9DE2BCBF695581718"
+	"3995497CEA956AE515D2261898FA051015728E5A8AAAC42DAD33170D04507A33"
+	"A85521ABDF1CBA64ECFB850458DBEF0A8AEA71575D060C7DB3970F85A6E1E4C7"
+	"ABF5AE8CDB0933D71E8C94E04A25619DCEE3D2261AD2EE6BF12FFA06D98A0864"
+	"D87602733EC86A64521F2B18177B200CBBE117577A615D6C770988C0BAD946E2"
+	"08E24FA074E5AB3143DB5BFCE0FD108E4B82D120A92108011A723C12A787E6D7"
+	"88719A10BDBA5B2699C327186AF4E23C1A946834B6150BDA2583E9CA2AD44CE8"
+	"DBBBC2DB04DE8EF92E8EFC141FBECAA6287C59474E6BC05D99B2964FA090C3A2"
+	"233BA186515BE7ED1F612970CEE2D7AFB81BDD762170481CD0069127D5B05AA9"
+	"93B4EA988D8FDDC186FFB7DC90A6C08F4DF435C934063199FFFFFFFFFFFFFFFF";
+
+/* The groups that diffie_hellman_group_new() knows about.  exp_bits is the
+ * size of the private exponents (the top of the range in RFC 3526, section
+ * 8). */
+static const struct {
+	int bits;
+	int exp_bits;
+	const char *p;
+} diffie_hellman_modp[] = {
+	{ 2048, 320, diffie_hellman_p2048 },
+	{ 3072, 420, diffie_hellman_p3072 },
+	{ 4096, 480, diffie_hellman_p4096 }
+};
+
+/*******************************************************************************
+ ******************************* CLASS DEFINITION ******************************
+ ******************************************************************************/
+
+/* This is the diffie_hellman_group class.  mont and fixed are p and g prepared
+ * for exponentiation. */
+struct diffie_hellman_group {
+	big_number *p;
+	big_number *g;
 
-/* Used to synchronize activities between the client and server threads. */
-pthread_mutex_t mutex;
+	/* p - 1.  A public value has to be between 2 and (p - 2). */
+	big_number *p_minus_1;
+
+	/* Size of the private exponents in bits, and the size of p in bytes. */
+	int exp_bits;
+	int bytes;
+
+	big_number_mont *mont;
+	big_number_mont_fixed *fixed;
+};
+
+/********************************** PUBLIC API ********************************/
 
 /*******************************************************************************
+ * Create a diffie_hellman_group object from a prime and a generator.
  *
- * Do a really simple exponentiation.
+ * Input:
+ *   p        - The prime.  It should be a safe prime.
+ *   g        - The generator.  1 < g < (p - 1).
+ *   exp_bits - Size of the private exponents in bits.  Between 2 and the size
+ *              of p.
  *
+ * Output:
+ *   Success - Returns a pointer to the diffie_hellman_group object.
+ *   Failure - Returns 0.
  ******************************************************************************/
-static int64_t do_exponentiation(int64_t base, int64_t exp)
+diffie_hellman_group *diffie_hellman_group_new_custom(const big_number *p, const big_number *g, int exp_bits)
 {
-	int64_t result = 1;
+	diffie_hellman_group *this = (diffie_hellman_group *) 0;
 
-	while(exp-- > 0) {
-		result *= base;
+	if((p != (big_number *) 0) && (g != (big_number *) 0) &&
+	   (exp_bits >= 2) && (exp_bits <= big_number_bit_length(p))) {
+		this = (diffie_hellman_group *) calloc(1, sizeof(*this));
 	}
 
-	return result;
+	do {
+		if(this == (diffie_hellman_group *) 0) { break; }
+
+		this->p = big_number_new();
+		this->g = big_number_new();
+		this->p_minus_1 = big_number_new();
+		if(!this->p || !this->g || !this->p_minus_1) { break; }
+
+		big_number_copy(p, this->p);
+		big_number_copy(g, this->g);
+		big_number_subtract(p, big_number_1(), this->p_minus_1);
+		if((big_number_compare(g, big_number_1()) <= 0) || (big_number_compare(g, this->p_minus_1) >= 0)) { break; }
+
+		this->exp_bits = exp_bits;
+		this->bytes = (big_number_bit_length(p) + 7) / 8;
+
+		this->mont = big_number_mont_new(this->p);
+		if(this->mont == (big_number_mont *) 0) { break; }
+		this->fixed = big_number_mont_fixed_new(this->mont, this->g, exp_bits);
+		if(this->fixed == (big_number_mont_fixed *) 0) { break; }
+
+		return this;
+
+	} while(0);
+
+	diffie_hellman_group_delete(this);
+	return (diffie_hellman_group *) 0;
 }
 
 /*******************************************************************************
+ * Create a diffie_hellman_group object for one of the RFC 3526 groups.
  *
- * This is the Diffie Hellman server thread.
+ * Input:
+ *   bits - Size of the group: 2048, 3072, or 4096.
  *
+ * Output:
+ *   Success - Returns a pointer to the diffie_hellman_group object.
+ *   Failure - Returns 0 (unknown size, or out of memory).
  ******************************************************************************/
-static void *server_thread(void *arg)
+diffie_hellman_group *diffie_hellman_group_new(int bits)
 {
-	int retval = -1;
-	int sock = -1;
-	int clnt_sock = -1;
+	diffie_hellman_group *this = (diffie_hellman_group *) 0;
+
+	int i;
+	for(i = 0; i < (sizeof(diffie_hellman_modp) / sizeof(diffie_hellman_modp[0])); i++) {
+		if(diffie_hellman_modp[i].bits == bits) {
+			big_number *p = big_number_new();
+			if((p != (big_number *) 0) && (big_number_from_str(p, diffie_hellman_modp[i].p) == 0)) {
+				this = diffie_hellman_group_new_custom(p, big_number_2(), diffie_hellman_modp[i].exp_bits);
+			}
+			big_number_delete(p);
+			break;
+		}
+	}
 
-	//printf("%s(%p): This is the server thread.\n", __func__, arg);
+	return this;
+}
 
-	do
-	{
-		int ret;
+/*******************************************************************************
+ * Destroy a diffie_hellman_group object.
+ *
+ * Input:
+ *   this - A pointer to the object.
+ ******************************************************************************/
+void diffie_hellman_group_delete(diffie_hellman_group *this)
+{
+	if(this != (diffie_hellman_group *) 0) {
+		big_number_mont_fixed_delete(this->fixed);
+		big_number_mont_delete(this->mont);
+		big_number_delete(this->p_minus_1);
+		big_number_delete(this->g);
+		big_number_delete(this->p);
+		free(this);
+	}
+}
 
-		unlink(CHANNEL);
+/*******************************************************************************
+ * Get the prime of a group.
+ ******************************************************************************/
+const big_number *diffie_hellman_group_p(const diffie_hellman_group *this)
+{
+	return this->p;
+}
 
-		sock = socket(PF_UNIX, SOCK_STREAM, 0);
-		//printf("%s(): socket() returned %d.\n", __func__, sock);
-		if(sock < 0) break;
+/*******************************************************************************
+ * Generate a key pair.  The private key is a random number that is exactly
+ * exp_bits long, and the public key is (g ^ private_key) % p.
+ *
+ * Input:
+ *   group       - The group.
+ *   private_key - Receives the private key.
+ *   public_key  - Receives the public key.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1.
+ ******************************************************************************/
+int diffie_hellman_generate_key(const diffie_hellman_group *group, big_number *private_key, big_number *public_key)
+{
+	if((group == (diffie_hellman_group *) 0) || (private_key == (big_number *) 0) ||
+	   (public_key == (big_number *) 0)) {
+		return 1;
+	}
 
-		struct sockaddr_un address;
-		memset(&address, 0, sizeof(address));
+	int len = (group->exp_bits + 7) / 8;
+	uint8_t *buf = (uint8_t *) malloc(len);
+	if(buf == (uint8_t *) 0) {
+		return 1;
+	}
 
-		address.sun_family = PF_UNIX;
-		strncpy(address.sun_path, CHANNEL, sizeof(address.sun_path));
-		ret = bind(sock, (struct sockaddr *) &address, sizeof(address));
-		//printf("Called bind(): ret = %d.\n", ret);
-		if(ret != 0) break;
+	int rc = crypto_util_random_bytes(buf, len);
+	if(rc == 0) {
+		/* buf[0] is the most significant byte.  Trim it to size and set the
+		 * top bit. */
+		int top = group->exp_bits - ((len - 1) * 8);
+		buf[0] &= (uint8_t) ((1 << top) - 1);
+		buf[0] |= (uint8_t) (1 << (top - 1));
 
-		ret = listen(sock, 10);
-		//printf("Called listen().\n");
-		if(ret != 0) break;
+		rc = big_number_from_bytes(private_key, buf, len);
+	}
+	if(rc == 0) {
+		rc = big_number_mont_fixed_exp(group->fixed, private_key, public_key);
+	}
 
-		ret = pthread_mutex_unlock(&mutex);
-		//printf("%s(): pthread_mutex_unlock(%p) returned %d.\n", __func__, &mutex, ret);
-		if(ret != 0) { break; }
+	memset(buf, 0, len);
+	free(buf);
+	return rc;
+}
 
-		struct sockaddr clnt_addr;
-		socklen_t       clnt_addr_len = sizeof(clnt_addr);
-		clnt_sock = accept(sock, &clnt_addr, &clnt_addr_len);
-		//printf("%s(): accept() returned %d.\n", __func__, clnt_sock);
-		if(clnt_sock == -1) break;
+/*******************************************************************************
+ * Calculate the shared secret.  secret = (peer_public ^ private_key) % p.
+ *
+ * The peer's public value is checked first.  0, 1, and (p - 1) (and anything
+ * out of range) would force the secret into a tiny subgroup.
+ *
+ * Input:
+ *   group       - The group.
+ *   private_key - Our private key.
+ *   peer_public - The other side's public key.
+ *   secret      - Receives the secret.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (the peer's public value isn't valid).
+ ******************************************************************************/
+int diffie_hellman_compute_secret(const diffie_hellman_group *group, const big_number *private_key,
+                                  const big_number *peer_public, big_number *secret)
+{
+	if((group == (diffie_hellman_group *) 0) || (private_key == (big_number *) 0) ||
+	   (peer_public == (big_number *) 0) || (secret == (big_number *) 0)) {
+		return 1;
+	}
 
-		int64_t modulus;
-		if(read(clnt_sock, &modulus, sizeof(modulus)) != sizeof(modulus)) {
-			//printf("Can't read modulus..\n");
-		}
+	if((big_number_compare(peer_public, big_number_1()) <= 0) ||
+	   (big_number_compare(peer_public, group->p_minus_1) >= 0)) {
+		return 1;
+	}
 
-		int64_t generator;
-		if(read(clnt_sock, &generator, sizeof(generator)) != sizeof(generator)) {
-			//printf("Can't read generator..\n");
-		}
+	big_number_mont_exp(group->mont, peer_public, private_key, secret);
+	return 0;
+}
 
-		/* Create your own private prime number. */
-		int64_t pri = 5;
+/*******************************************************************************
+ * Send a value (e.g. a public key) over a socket.
+ *
+ * Input:
+ *   fd    - The socket.
+ *   group - The group.  The value is zero filled out to the size of p.
+ *   value - The value.  0 <= value < p.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1.
+ ******************************************************************************/
+int diffie_hellman_write_value(int fd, const diffie_hellman_group *group, const big_number *value)
+{
+	if((group == (diffie_hellman_group *) 0) || (value == (big_number *) 0)) {
+		return 1;
+	}
 
-		/* Perform step 1 and send to client. */
-		int64_t val1 = do_exponentiation(generator, pri) % modulus;
-		//printf("%s(): %jd = (%jd ^ %jd) mod %jd\n", __func__, val1, generator, pri, modulus);
-		if(write(clnt_sock, &val1, sizeof(val1)) != sizeof(val1)) break;
+	/* The length, then the value. */
+	int len = group->bytes;
+	uint8_t *buf = (uint8_t *) malloc(4 + len);
+	if(buf == (uint8_t *) 0) {
+		return 1;
+	}
 
-		/* Receive val from client, and perform step 2. */
-		int64_t val2;
-		read(clnt_sock, &val2, sizeof(val2));
-		//printf("SERVER: %jd.\n", (do_exponentiation(val2, pri) % modulus));
+	buf[0] = (uint8_t) (len >> 24);
+	buf[1] = (uint8_t) (len >> 16);
+	buf[2] = (uint8_t) (len >> 8);
+	buf[3] = (uint8_t) len;
 
-		/* Success. */
-		retval = val2;
+	int rc = big_number_to_bytes(value, buf + 4, len);
+	if(rc == 0) {
+		rc = crypto_util_write_full(fd, buf, 4 + len);
+	}
 
-	} while(0);
+	free(buf);
+	return rc;
+}
 
-	if(sock != -1) {
-		close(sock);
+/*******************************************************************************
+ * Receive a value that was sent by diffie_hellman_write_value().
+ *
+ * Input:
+ *   fd    - The socket.
+ *   group - The group.
+ *   value - Receives the value.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (error, or the length isn't the size of p).
+ ******************************************************************************/
+int diffie_hellman_read_value(int fd, const diffie_hellman_group *group, big_number *value)
+{
+	if((group == (diffie_hellman_group *) 0) || (value == (big_number *) 0)) {
+		return 1;
 	}
-	if(clnt_sock != -1) {
-		close(clnt_sock);
+
+	uint8_t hdr[4];
+	if(crypto_util_read_full(fd, hdr, sizeof(hdr)) != 0) {
+		return 1;
+	}
+
+	uint32_t len = ((uint32_t) hdr[0] << 24) | ((uint32_t) hdr[1] << 16) | ((uint32_t) hdr[2] << 8) | hdr[3];
+	if(len != (uint32_t) group->bytes) {
+		return 1;
+	}
+
+	uint8_t *buf = (uint8_t *) malloc(len);
+	if(buf == (uint8_t *) 0) {
+		return 1;
+	}
+
+	int rc = crypto_util_read_full(fd, buf, len);
+	if(rc == 0) {
+		rc = big_number_from_bytes(value, buf, len);
 	}
 
-	return (void *) retval;
+	free(buf);
+	return rc;
 }
 
 /*******************************************************************************
+ * Do one key agreement over a connected socket.  Generate a key pair, send the
+ * public key, receive the other side's public key, and calculate the secret.
+ *
+ * Both sides do the same thing.  They both send before they receive, but a
+ * public value is small enough to sit in the socket buffer, so neither side
+ * waits for the other one to read.
  *
- * This is the Diffie Hellman client thread.
+ * Input:
+ *   fd     - The socket.
+ *   group  - The group.  Both sides must use the same one.
+ *   secret - Receives the shared secret.
  *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1.
  ******************************************************************************/
-static void *client_thread(void *arg)
+int diffie_hellman_handshake(int fd, const diffie_hellman_group *group, big_number *secret)
 {
-	int retval = -1;
-	int sock = -1;
-
-	//printf("%s(%p): This is the client thread.\n", __func__, arg);
-
-	do
-	{
-		/* Wait for the server thread to create the server-side part
-		 * of the socket pair. */
-		int ret = pthread_mutex_lock(&mutex);
-		//printf("%s(): pthread_mutex_lock(%p) returned %d.\n", __func__, &mutex, ret);
-		if(ret != 0) { break; }
-
-		sock = socket(PF_UNIX, SOCK_STREAM, 0);
-		//printf("%s(): socket() returned %d.\n", __func__, sock);
-		if(sock < 0) break;
-
-		struct sockaddr_un srvr;
-		memset(&srvr, 0, sizeof(srvr));
-
-		srvr.sun_family = AF_UNIX;
-		strncpy(srvr.sun_path, CHANNEL, sizeof(srvr.sun_path));
-
-		/* Keep trying until we connect to the server.  If we come up before the
-		 * server thread we might get to this point before the server is ready.
-		 * So just keep trying until the server shows up. */
-		while(1) {
-			if(connect(sock, (struct sockaddr *) &srvr, sizeof(srvr)) == 0) {
-				break;
-			}
-			//printf("%s(): sleeping\n", __func__);
-			sleep(1);
-		}
-
-		int64_t   modulus = 17;
-		int64_t generator = 3;
-		if(write(sock,   &modulus, sizeof(  modulus)) != sizeof(  modulus)) break;
-		if(write(sock, &generator, sizeof(generator)) != sizeof(generator)) break;
+	int rc = 1;
 
-		/* Create your own private prime number. */
-		int64_t pri = 3;
+	int mark = big_number_scratch_mark();
+	big_number *private_key = big_number_scratch_get();
+	big_number *public_key = big_number_scratch_get();
 
-		/* Perform step 1 and send to server. */
-		int64_t val1 = do_exponentiation(generator, pri) % modulus;
-		//printf("%s(): %jd = (%jd ^ %jd) mod %jd\n", __func__, val1, generator, pri, modulus);
-		if(write(sock, &val1, sizeof(val1)) != sizeof(val1)) break;
+	if((private_key != (big_number *) 0) && (public_key != (big_number *) 0) &&
+	   (diffie_hellman_generate_key(group, private_key, public_key) == 0) &&
+	   (diffie_hellman_write_value(fd, group, public_key) == 0) &&
+	   (diffie_hellman_read_value(fd, group, public_key) == 0) &&
+	   (diffie_hellman_compute_secret(group, private_key, public_key, secret) == 0)) {
+		rc = 0;
+	}
 
-		/* Receive val from client, and perform step 2. */
-		int64_t val2;
-		read(sock, &val2, sizeof(val2));
-		//printf("CLIENT: %jd.\n", (do_exponentiation(val2, pri) % modulus));
+	/* Don't leave the private key lying around in the arena. */
+	if(private_key != (big_number *) 0) {
+		big_number_reset(private_key);
+	}
 
-		/* Success. */
-		retval = val2;
+	big_number_scratch_release(mark);
+	return rc;
+}
 
-	} while(0);
+/********** Test Methods */
 
-	/* Close the socket. */
-	if(sock != -1) {
-		//printf("%s(): Calling close(%d).\n", __func__, sock);
-		close(sock);
-	}
+#ifdef TEST
+/* One side of a test handshake. */
+typedef struct diffie_hellman_test_side {
+	int fd;
+	const diffie_hellman_group *group;
+	big_number *secret;
+	int rc;
+} diffie_hellman_test_side;
 
-	return (void *) retval;
+/*******************************************************************************
+ * The other side of a test handshake.
+ ******************************************************************************/
+static void *diffie_hellman_test_thread(void *arg)
+{
+	diffie_hellman_test_side *side = (diffie_hellman_test_side *) arg;
+	side->rc = diffie_hellman_handshake(side->fd, side->group, side->secret);
+	return (void *) 0;
 }
 
 /*******************************************************************************
+ * Run the diffie_hellman tests.
  *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1.
  ******************************************************************************/
 int diffie_hellman_test(void)
 {
 	printf("%s(): Starting\n", __func__);
 	int rc = 1;
 
+	diffie_hellman_group *group = (diffie_hellman_group *) 0;
+	big_number *x1 = big_number_new();
+	big_number *x2 = big_number_new();
+	big_number *y1 = big_number_new();
+	big_number *y2 = big_number_new();
+	int fds[2] = { -1, -1 };
+
 	do {
-		pthread_attr_t attr;
-		pthread_attr_init(&attr);
-
-		/* Initialize and lock the mutex now.  Then create the server
-		 * thread.  The thread will create a server-side socket, and
-		 * then it will release the mutex (thus allowing us to start
-		 * the client thread). */
-		pthread_mutex_init(&mutex, NULL);
-		rc = pthread_mutex_lock(&mutex);
-		//printf("%s(): pthread_mutex_lock(%p) returned %d.\n", __func__, &mutex, rc);
-		if(rc != 0) { break; }
-
-		pthread_t server;
-		rc = pthread_create(&server, &attr, server_thread, (void *) 1);
-		if(rc != 0) { break; }
-
-		pthread_t client;
-		rc = pthread_create(&client, &attr, client_thread, (void *) 1);
-		if(rc != 0) { break; }
-
-		void *server_thread_rc;
-		rc = pthread_join(server, &server_thread_rc);
-		int server_rc = (int) server_thread_rc;
-		//printf("%s(): pthread_join(server) returned %d: retcode = %d.\n", __func__, rc, server_rc);
-		if(rc != 0) { break; }
-
-		void *client_thread_rc;
-		rc = pthread_join(client, &client_thread_rc);
-		int client_rc = (int) client_thread_rc;
-		//printf("%s(): pthread_join(client) returned %d: retcode = %d.\n", __func__, rc, client_rc);
-		if(rc != 0) { break; }
-
-		/* Compare results (do they match?). */
-		if(server_rc != client_rc) { break; }
+		if(!x1 || !x2 || !y1 || !y2) { break; }
+
+		/* Only the RFC 3526 sizes are supported. */
+		if(diffie_hellman_group_new(1024) != (diffie_hellman_group *) 0) { break; }
+
+		/* The simulated big_number library only holds 63 bits, so it gets
+		 * a tiny group.  1,099,511,615,303 is a safe prime. */
+		big_number_reset(x1);
+		big_number_shift_left(big_number_1(), 64, x1);
+		if(big_number_is_zero(x1) == 1) {
+			big_number_from_str(x1, "1099511615303");
+			group = diffie_hellman_group_new_custom(x1, big_number_2(), 32);
+		}
+		else {
+			group = diffie_hellman_group_new(2048);
+		}
+		if(group == (diffie_hellman_group *) 0) { break; }
+
+		/* Agree on a secret without a socket.  ((g ^ x1) ^ x2) has to equal
+		 * ((g ^ x2) ^ x1). */
+		if(diffie_hellman_generate_key(group, x1, y1) != 0) { break; }
+		if(diffie_hellman_generate_key(group, x2, y2) != 0) { break; }
+		if(big_number_compare(y1, y2) == 0) { break; }
+		if(diffie_hellman_compute_secret(group, x1, y2, y2) != 0) { break; }
+		if(diffie_hellman_compute_secret(group, x2, y1, y1) != 0) { break; }
+		if(big_number_compare(y1, y2) != 0) { break; }
+
+		/* Public values that aren't allowed: 1, (p - 1), and p. */
+		if(diffie_hellman_compute_secret(group, x1, big_number_1(), y1) == 0) { break; }
+		big_number_subtract(diffie_hellman_group_p(group), big_number_1(), y2);
+		if(diffie_hellman_compute_secret(group, x1, y2, y1) == 0) { break; }
+		if(diffie_hellman_compute_secret(group, x1, diffie_hellman_group_p(group), y1) == 0) { break; }
+
+		if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) { break; }
+
+		/* The wire format.  A value survives the trip, and a value with
+		 * the wrong length is refused. */
+		if(diffie_hellman_write_value(fds[0], group, y2) != 0) { break; }
+		if(diffie_hellman_read_value(fds[1], group, y1) != 0) { break; }
+		if(big_number_compare(y1, y2) != 0) { break; }
+		{
+			const uint8_t bad[] = { 0, 0, 0, 1, 2 };
+			uint8_t rest;
+			if(write(fds[0], bad, sizeof(bad)) != sizeof(bad)) { break; }
+			if(diffie_hellman_read_value(fds[1], group, y1) == 0) { break; }
+			if(read(fds[1], &rest, 1) != 1) { break; }
+		}
+
+		/* A handshake between 2 threads.  Both sides get the same
+		 * secret. */
+		diffie_hellman_test_side side = { fds[1], group, y2, 1 };
+		pthread_t thread;
+		if(pthread_create(&thread, NULL, diffie_hellman_test_thread, &side) != 0) { break; }
+		int mine = diffie_hellman_handshake(fds[0], group, y1);
+		pthread_join(thread, (void **) 0);
+		if((mine != 0) || (side.rc != 0) || (big_number_compare(y1, y2) != 0)) { break; }
 
 		/* Success. */
 		rc = 0;
 
 	} while(0);
 
+	if(fds[0] != -1) {
+		close(fds[0]);
+		close(fds[1]);
+	}
+
+	big_number_delete(y2);
+	big_number_delete(y1);
+	big_number_delete(x2);
+	big_number_delete(x1);
+	diffie_hellman_group_delete(group);
+
 	printf("%s(): %s.\n", __func__, (rc == 0) ? "PASS" : "FAIL");
 	return rc;
 }
-
+#endif /* TEST */
@@ -6,8 +6,52 @@
  *
  ******************************************************************************/
 
+#include "big_number.h"
+
+typedef struct diffie_hellman_group diffie_hellman_group;
+
+/*******************************************************************************
+ * Create one of the RFC 3526 groups (bits = 2048, 3072, or 4096), or a group
+ * with any prime, generator, and private exponent size.  Both return 0 if
+ * failure.  A group is read-only, so threads can share it.
+ ******************************************************************************/
+diffie_hellman_group *diffie_hellman_group_new(int bits);
+diffie_hellman_group *diffie_hellman_group_new_custom(const big_number *p, const big_number *g, int exp_bits);
+
+/*******************************************************************************
+ * Delete a group.
+ ******************************************************************************/
+void diffie_hellman_group_delete(diffie_hellman_group *this);
+
+/*******************************************************************************
+ * Get the prime (p) of a group.
+ ******************************************************************************/
+const big_number *diffie_hellman_group_p(const diffie_hellman_group *this);
+
+/*******************************************************************************
+ * Generate a random private key and its public key ((g ^ private) % p), and
+ * calculate the shared secret ((peer_public ^ private) % p).  The peer's public
+ * key must be between 2 and (p - 2).  Both return 0 if success.
+ ******************************************************************************/
+int diffie_hellman_generate_key(const diffie_hellman_group *group, big_number *private_key, big_number *public_key);
+int diffie_hellman_compute_secret(const diffie_hellman_group *group, const big_number *private_key,
+                                  const big_number *peer_public, big_number *secret);
+
+/*******************************************************************************
+ * Send and receive a value over a socket.  The wire format is a 4-byte
+ * big-endian length, followed by the value, big-endian and zero filled to the
+ * size of p.  Both return 0 if success.
+ ******************************************************************************/
+int diffie_hellman_write_value(int fd, const diffie_hellman_group *group, const big_number *value);
+int diffie_hellman_read_value(int fd, const diffie_hellman_group *group, big_number *value);
+
+/*******************************************************************************
+ * Do one key agreement over a connected socket.  Both sides call this.  Returns
+ * 0 if success.
+ ******************************************************************************/
+int diffie_hellman_handshake(int fd, const diffie_hellman_group *group, big_number *secret);
+
 /*******************************************************************************
  * Test the diffie_hellman.c ADT.
  ******************************************************************************/
 int diffie_hellman_test(void);
-
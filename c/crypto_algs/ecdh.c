@@ -0,0 +1,1423 @@
+/*******************************************************************************
+ *
+ * This module does elliptic curve Diffie-Hellman key agreement over 2 curves:
+ *
+ * - X25519 (RFC 7748).  Curve25519 is a Montgomery curve over the prime
+ *   (2^255 - 19).  Only the x coordinates (called u) are used, with the
+ *   Montgomery ladder, so a public key is 32 bytes.  A field element is 5
+ *   limbs of 51 bits each, so the products of 2 limbs fit in 128 bits with
+ *   room to spare, and the adds and subtracts don't need to carry.  Because
+ *   2^255 is 19 (mod p), the top half of a product folds back in as
+ *   (19 * top).
+ *
+ * - P-256 (NIST, also called secp256r1).  The field is 4 limbs in Montgomery
+ *   form.  The low limb of p is (2^64 - 1), so the Montgomery constant is 1
+ *   and REDC doesn't need a multiply to find it.  Points are in Jacobian
+ *   coordinates (x = X / Z^2, y = Y / Z^3), so there's only one inversion,
+ *   at the end.  Scalar multiplication goes through the scalar 4 bits at a
+ *   time.  The generator has a table of all 64 digit positions, so key
+ *   generation is just 64 additions.  A public key is 65 bytes (0x04, x,
+ *   y).
+ *
+ * Both curves give about 128 bits of security, like a 3072-bit
+ * Diffie-Hellman group, with operands that are 12 times smaller.
+ *
+ * The scalar multiplications do the same steps for every scalar, and table
+ * entries are picked with masks instead of indexes, so the time they take
+ * doesn't depend on the private key.
+ *
+ * Public keys go over the wire the same way as diffie_hellman.c: a 4-byte
+ * length (most significant byte first), followed by the key.
+ *
+ ******************************************************************************/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include "big_number_limb.h"
+#include "crypto_util.h"
+#include "ecdh.h"
+
+/* A field element mod (2^255 - 19), and the mask for one of its limbs. */
+typedef limb_t ecdh_fe25519[5];
+#define ECDH_X25519_MASK ((1ULL << 51) - 1)
+
+/* (A - 2) / 4, where A is the Curve25519 constant 486662. */
+#define ECDH_X25519_A24 (121665)
+
+/* A field element mod the P-256 prime, in Montgomery form. */
+typedef limb_t ecdh_fe256[4];
+
+/* The P-256 prime, (2^256 - 2^224 + 2^192 + 2^96 - 1). */
+static const ecdh_fe256 ecdh_p256_p = {
+	0xFFFFFFFFFFFFFFFFULL, 0x00000000FFFFFFFFULL, 0x0000000000000000ULL, 0xFFFFFFFF00000001ULL
+};
+
+/* 2^256 % p (1 in Montgomery form), and 2^512 % p (to convert into
+ * Montgomery form). */
+static const ecdh_fe256 ecdh_p256_one = {
+	0x0000000000000001ULL, 0xFFFFFFFF00000000ULL, 0xFFFFFFFFFFFFFFFFULL, 0x00000000FFFFFFFEULL
+};
+static const ecdh_fe256 ecdh_p256_r2 = {
+	0x0000000000000003ULL, 0xFFFFFFFBFFFFFFFFULL, 0xFFFFFFFFFFFFFFFEULL, 0x00000004FFFFFFFDULL
+};
+
+/* p - 2.  An inverse is (a ^ (p - 2)). */
+static const ecdh_fe256 ecdh_p256_p_minus_2 = {
+	0xFFFFFFFFFFFFFFFDULL, 0x00000000FFFFFFFFULL, 0x0000000000000000ULL, 0xFFFFFFFF00000001ULL
+};
+
+/* The curve is y^2 = x^3 - 3x + b.  The generator is an uncompressed point,
+ * and n is its order.  They're big-endian, the way they're usually written. */
+static const uint8_t ecdh_p256_b[32] = {
+	0x5A, 0xC6, 0x35, 0xD8, 0xAA, 0x3A, 0x93, 0xE7, 0xB3, 0xEB, 0xBD, 0x55, 0x76, 0x98, 0x86, 0xBC,
+	0x65, 0x1D, 0x06, 0xB0, 0xCC, 0x53, 0xB0, 0xF6, 0x3B, 0xCE, 0x3C, 0x3E, 0x27, 0xD2, 0x60, 0x4B
+};
+
+static const uint8_t ecdh_p256_g[65] = {
+	0x04,
+	0x6B, 0x17, 0xD1, 0xF2, 0xE1, 0x2C, 0x42, 0x47, 0xF8, 0xBC, 0xE6, 0xE5, 0x63, 0xA4, 0x40, 0xF2,
+	0x77, 0x03, 0x7D, 0x81, 0x2D, 0xEB, 0x33, 0xA0, 0xF4, 0xA1, 0x39, 0x45, 0xD8, 0x98, 0xC2, 0x96,
+	0x4F, 0xE3, 0x42, 0xE2, 0xFE, 0x1A, 0x7F, 0x9B, 0x8E, 0xE7, 0xEB, 0x4A, 0x7C, 0x0F, 0x9E, 0x16,
+	0x2B, 0xCE, 0x33, 0x57, 0x6B, 0x31, 0x5E, 0xCE, 0xCB, 0xB6, 0x40, 0x68, 0x37, 0xBF, 0x51, 0xF5
+};
+
+static const uint8_t ecdh_p256_n[32] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xBC, 0xE6, 0xFA, 0xAD, 0xA7, 0x17, 0x9E, 0x84, 0xF3, 0xB9, 0xCA, 0xC2, 0xFC, 0x63, 0x25, 0x51
+};
+
+/* A scalar is 64 digits of 4 bits, and a window table holds every digit's
+ * multiple of a point. */
+#define ECDH_P256_DIGITS (64)
+#define ECDH_P256_WINDOW (16)
+
+/*******************************************************************************
+ ******************************* CLASS DEFINITION ******************************
+ ******************************************************************************/
+
+/* A P-256 point in Jacobian coordinates.  Z = 0 is the point at infinity. */
+typedef struct ecdh_p256_point {
+	ecdh_fe256 x;
+	ecdh_fe256 y;
+	ecdh_fe256 z;
+} ecdh_p256_point;
+
+#define ECDH_P256_POINT_LIMBS (sizeof(ecdh_p256_point) / sizeof(limb_t))
+
+/* This is the ecdh_curve class.  For P-256, b is the curve constant in
+ * Montgomery form, and table[(i * 16) + d] is (d * (16 ^ (63 - i)) * G). */
+struct ecdh_curve {
+	ecdh_curve_id id;
+	int public_bytes;
+
+	ecdh_fe256 b;
+	ecdh_p256_point *table;
+};
+
+/********************************* PRIVATE API ********************************/
+
+/********** X25519 Field Arithmetic */
+
+/*******************************************************************************
+ * Load and store 8 bytes, least significant first.
+ ******************************************************************************/
+static limb_t ecdh_load64_le(const uint8_t *s)
+{
+	limb_t v = 0;
+	int i;
+	for(i = 7; i >= 0; i--) {
+		v = (v << 8) | s[i];
+	}
+
+	return v;
+}
+
+static void ecdh_store64_le(uint8_t *s, limb_t v)
+{
+	int i;
+	for(i = 0; i < 8; i++) {
+		s[i] = (uint8_t) (v >> (8 * i));
+	}
+}
+
+/*******************************************************************************
+ * Unpack 32 bytes into a field element.  The top bit is ignored (RFC 7748,
+ * section 5).  The limbs start at bits 0, 51, 102, 153, and 204.
+ ******************************************************************************/
+static void ecdh_x25519_from_bytes(limb_t *h, const uint8_t *s)
+{
+	h[0] = ecdh_load64_le(s) & ECDH_X25519_MASK;
+	h[1] = (ecdh_load64_le(s + 6) >> 3) & ECDH_X25519_MASK;
+	h[2] = (ecdh_load64_le(s + 12) >> 6) & ECDH_X25519_MASK;
+	h[3] = (ecdh_load64_le(s + 19) >> 1) & ECDH_X25519_MASK;
+	h[4] = (ecdh_load64_le(s + 24) >> 12) & ECDH_X25519_MASK;
+}
+
+/*******************************************************************************
+ * Carry each limb into the next one, and the top one back into the bottom
+ * (times 19).
+ ******************************************************************************/
+static void ecdh_x25519_carry(limb_t *t)
+{
+	int i;
+	for(i = 0; i < 4; i++) {
+		t[i + 1] += t[i] >> 51;
+		t[i] &= ECDH_X25519_MASK;
+	}
+	t[0] += 19 * (t[4] >> 51);
+	t[4] &= ECDH_X25519_MASK;
+}
+
+/*******************************************************************************
+ * Pack a field element into 32 bytes.  This is the only place the value is
+ * fully reduced mod p.
+ ******************************************************************************/
+static void ecdh_x25519_to_bytes(uint8_t *s, const limb_t *f)
+{
+	limb_t t[5];
+	memcpy(t, f, sizeof(t));
+
+	/* Now t is less than (2^255 + a little). */
+	ecdh_x25519_carry(t);
+	ecdh_x25519_carry(t);
+
+	/* Adding 19 carries out of 2^255 (and wraps around as another 19) if t
+	 * is p or more.  Either way t is now ((t % p) + 19).  Adding
+	 * (2^255 - 19) and dropping 2^255 takes the 19 back off. */
+	t[0] += 19;
+	ecdh_x25519_carry(t);
+
+	t[0] += ECDH_X25519_MASK + 1 - 19;
+	int i;
+	for(i = 1; i < 5; i++) {
+		t[i] += ECDH_X25519_MASK;
+	}
+	for(i = 0; i < 4; i++) {
+		t[i + 1] += t[i] >> 51;
+		t[i] &= ECDH_X25519_MASK;
+	}
+	t[4] &= ECDH_X25519_MASK;
+
+	ecdh_store64_le(s, t[0] | (t[1] << 51));
+	ecdh_store64_le(s + 8, (t[1] >> 13) | (t[2] << 38));
+	ecdh_store64_le(s + 16, (t[2] >> 26) | (t[3] << 25));
+	ecdh_store64_le(s + 24, (t[3] >> 39) | (t[4] << 12));
+}
+
+/*******************************************************************************
+ * h = f + g, and h = f - g.  Neither one carries.  The subtract adds 2p first
+ * so no limb goes negative.  The inputs have to be multiply outputs (limbs
+ * just over 51 bits).
+ ******************************************************************************/
+static void ecdh_x25519_add(limb_t *h, const limb_t *f, const limb_t *g)
+{
+	int i;
+	for(i = 0; i < 5; i++) {
+		h[i] = f[i] + g[i];
+	}
+}
+
+static void ecdh_x25519_sub(limb_t *h, const limb_t *f, const limb_t *g)
+{
+	h[0] = (f[0] + 0xFFFFFFFFFFFDAULL) - g[0];
+	int i;
+	for(i = 1; i < 5; i++) {
+		h[i] = (f[i] + 0xFFFFFFFFFFFFEULL) - g[i];
+	}
+}
+
+/*******************************************************************************
+ * Carry 5 128-bit column sums down to 51-bit limbs.  The inputs to the
+ * multiply are under 2^54, so a column is under 2^111, and the carry out of
+ * the top (times 19) still fits in a limb.
+ ******************************************************************************/
+static void ecdh_x25519_reduce(limb_t *h, dlimb_t *t)
+{
+	t[1] += (limb_t) (t[0] >> 51);
+	t[2] += (limb_t) (t[1] >> 51);
+	t[3] += (limb_t) (t[2] >> 51);
+	t[4] += (limb_t) (t[3] >> 51);
+
+	h[0] = (limb_t) t[0] & ECDH_X25519_MASK;
+	h[1] = (limb_t) t[1] & ECDH_X25519_MASK;
+	h[2] = (limb_t) t[2] & ECDH_X25519_MASK;
+	h[3] = (limb_t) t[3] & ECDH_X25519_MASK;
+	h[4] = (limb_t) t[4] & ECDH_X25519_MASK;
+
+	h[0] += 19 * (limb_t) (t[4] >> 51);
+	h[1] += h[0] >> 51;
+	h[0] &= ECDH_X25519_MASK;
+}
+
+/*******************************************************************************
+ * h = f * g.  Column k gets every (f[i] * g[j]) with (i + j) == k, and
+ * (19 * f[i] * g[j]) with (i + j) == (k + 5).
+ ******************************************************************************/
+static void ecdh_x25519_mul(limb_t *h, const limb_t *f, const limb_t *g)
+{
+	limb_t g1_19 = 19 * g[1];
+	limb_t g2_19 = 19 * g[2];
+	limb_t g3_19 = 19 * g[3];
+	limb_t g4_19 = 19 * g[4];
+
+	dlimb_t t[5];
+	t[0] = ((dlimb_t) f[0] * g[0]) + ((dlimb_t) f[1] * g4_19) + ((dlimb_t) f[2] * g3_19) +
+	       ((dlimb_t) f[3] * g2_19) + ((dlimb_t) f[4] * g1_19);
+	t[1] = ((dlimb_t) f[0] * g[1]) + ((dlimb_t) f[1] * g[0]) + ((dlimb_t) f[2] * g4_19) +
+	       ((dlimb_t) f[3] * g3_19) + ((dlimb_t) f[4] * g2_19);
+	t[2] = ((dlimb_t) f[0] * g[2]) + ((dlimb_t) f[1] * g[1]) + ((dlimb_t) f[2] * g[0]) +
+	       ((dlimb_t) f[3] * g4_19) + ((dlimb_t) f[4] * g3_19);
+	t[3] = ((dlimb_t) f[0] * g[3]) + ((dlimb_t) f[1] * g[2]) + ((dlimb_t) f[2] * g[1]) +
+	       ((dlimb_t) f[3] * g[0]) + ((dlimb_t) f[4] * g4_19);
+	t[4] = ((dlimb_t) f[0] * g[4]) + ((dlimb_t) f[1] * g[3]) + ((dlimb_t) f[2] * g[2]) +
+	       ((dlimb_t) f[3] * g[1]) + ((dlimb_t) f[4] * g[0]);
+
+	ecdh_x25519_reduce(h, t);
+}
+
+/*******************************************************************************
+ * h = f * f.  The same columns as the multiply, but each cross product is
+ * only done once (and doubled).
+ ******************************************************************************/
+static void ecdh_x25519_sqr(limb_t *h, const limb_t *f)
+{
+	limb_t f0_2 = 2 * f[0];
+	limb_t f1_2 = 2 * f[1];
+	limb_t f3_19 = 19 * f[3];
+	limb_t f4_19 = 19 * f[4];
+
+	dlimb_t t[5];
+	t[0] = ((dlimb_t) f[0] * f[0]) + ((dlimb_t) f1_2 * f4_19) + ((dlimb_t) (2 * f[2]) * f3_19);
+	t[1] = ((dlimb_t) f0_2 * f[1]) + ((dlimb_t) (2 * f[2]) * f4_19) + ((dlimb_t) f[3] * f3_19);
+	t[2] = ((dlimb_t) f0_2 * f[2]) + ((dlimb_t) f[1] * f[1]) + ((dlimb_t) (2 * f[3]) * f4_19);
+	t[3] = ((dlimb_t) f0_2 * f[3]) + ((dlimb_t) f1_2 * f[2]) + ((dlimb_t) f[4] * f4_19);
+	t[4] = ((dlimb_t) f0_2 * f[4]) + ((dlimb_t) f1_2 * f[3]) + ((dlimb_t) f[2] * f[2]);
+
+	ecdh_x25519_reduce(h, t);
+}
+
+/*******************************************************************************
+ * h = f * (A - 2) / 4.
+ ******************************************************************************/
+static void ecdh_x25519_mul_a24(limb_t *h, const limb_t *f)
+{
+	dlimb_t t[5];
+	int i;
+	for(i = 0; i < 5; i++) {
+		t[i] = (dlimb_t) f[i] * ECDH_X25519_A24;
+	}
+
+	ecdh_x25519_reduce(h, t);
+}
+
+/*******************************************************************************
+ * h = z ^ -1 = z ^ (p - 2) = z ^ (2^255 - 21).  The chain builds
+ * z ^ (2^k - 1) for k = 5, 10, 20, 40, 50, 100, 200, 250, and then shifts
+ * in the last 5 bits (01011).
+ ******************************************************************************/
+static void ecdh_x25519_sqr_n(limb_t *h, const limb_t *f, int n)
+{
+	ecdh_x25519_sqr(h, f);
+	while(--n > 0) {
+		ecdh_x25519_sqr(h, h);
+	}
+}
+
+static void ecdh_x25519_invert(limb_t *h, const limb_t *z)
+{
+	ecdh_fe25519 z2, z9, z11, z_5, z_10, z_20, z_50, z_100, t;
+
+	ecdh_x25519_sqr(z2, z);			/* 2 */
+	ecdh_x25519_sqr_n(t, z2, 2);		/* 8 */
+	ecdh_x25519_mul(z9, t, z);		/* 9 */
+	ecdh_x25519_mul(z11, z9, z2);		/* 11 */
+	ecdh_x25519_sqr(t, z11);		/* 22 */
+	ecdh_x25519_mul(z_5, t, z9);		/* 2^5 - 1 */
+
+	ecdh_x25519_sqr_n(t, z_5, 5);
+	ecdh_x25519_mul(z_10, t, z_5);		/* 2^10 - 1 */
+	ecdh_x25519_sqr_n(t, z_10, 10);
+	ecdh_x25519_mul(z_20, t, z_10);		/* 2^20 - 1 */
+	ecdh_x25519_sqr_n(t, z_20, 20);
+	ecdh_x25519_mul(t, t, z_20);		/* 2^40 - 1 */
+	ecdh_x25519_sqr_n(t, t, 10);
+	ecdh_x25519_mul(z_50, t, z_10);		/* 2^50 - 1 */
+	ecdh_x25519_sqr_n(t, z_50, 50);
+	ecdh_x25519_mul(z_100, t, z_50);	/* 2^100 - 1 */
+	ecdh_x25519_sqr_n(t, z_100, 100);
+	ecdh_x25519_mul(t, t, z_100);		/* 2^200 - 1 */
+	ecdh_x25519_sqr_n(t, t, 50);
+	ecdh_x25519_mul(t, t, z_50);		/* 2^250 - 1 */
+	ecdh_x25519_sqr_n(t, t, 5);		/* 2^255 - 32 */
+	ecdh_x25519_mul(h, t, z11);		/* 2^255 - 21 */
+}
+
+/*******************************************************************************
+ * Swap f and g if swap is 1, and leave them alone if it's 0.
+ ******************************************************************************/
+static void ecdh_x25519_cswap(limb_t *f, limb_t *g, limb_t swap)
+{
+	limb_t mask = 0 - swap;
+	int i;
+	for(i = 0; i < 5; i++) {
+		limb_t x = mask & (f[i] ^ g[i]);
+		f[i] ^= x;
+		g[i] ^= x;
+	}
+}
+
+/********** P-256 Field Arithmetic */
+
+/*******************************************************************************
+ * r = t - p if t >= p, or t if not.  carry is a 257th bit of t.  t is less
+ * than 2p.
+ ******************************************************************************/
+static void ecdh_p256_reduce_once(limb_t *r, const limb_t *t, limb_t carry)
+{
+	ecdh_fe256 d;
+	limb_t borrow = 0;
+	int i;
+	for(i = 0; i < 4; i++) {
+		dlimb_t s = (dlimb_t) t[i] - ecdh_p256_p[i] - borrow;
+		d[i] = (limb_t) s;
+		borrow = (limb_t) (s >> LIMB_BITS) & 1;
+	}
+
+	/* Keep t if the subtract borrowed and there was no carry. */
+	limb_t mask = 0 - (borrow & (carry ^ 1));
+	for(i = 0; i < 4; i++) {
+		r[i] = (t[i] & mask) | (d[i] & ~mask);
+	}
+}
+
+/*******************************************************************************
+ * r = (a + b) % p, and r = (a - b) % p.
+ ******************************************************************************/
+static void ecdh_p256_add(limb_t *r, const limb_t *a, const limb_t *b)
+{
+	ecdh_fe256 t;
+	limb_t carry = 0;
+	int i;
+	for(i = 0; i < 4; i++) {
+		dlimb_t s = (dlimb_t) a[i] + b[i] + carry;
+		t[i] = (limb_t) s;
+		carry = (limb_t) (s >> LIMB_BITS);
+	}
+
+	ecdh_p256_reduce_once(r, t, carry);
+}
+
+static void ecdh_p256_sub(limb_t *r, const limb_t *a, const limb_t *b)
+{
+	limb_t borrow = 0;
+	int i;
+	for(i = 0; i < 4; i++) {
+		dlimb_t s = (dlimb_t) a[i] - b[i] - borrow;
+		r[i] = (limb_t) s;
+		borrow = (limb_t) (s >> LIMB_BITS) & 1;
+	}
+
+	/* Add p back if it went negative. */
+	limb_t mask = 0 - borrow;
+	limb_t carry = 0;
+	for(i = 0; i < 4; i++) {
+		dlimb_t s = (dlimb_t) r[i] + (ecdh_p256_p[i] & mask) + carry;
+		r[i] = (limb_t) s;
+		carry = (limb_t) (s >> LIMB_BITS);
+	}
+}
+
+/*******************************************************************************
+ * Montgomery multiplication.  r = (a * b / 2^256) % p.  The multiply and the
+ * reduction are interleaved a limb at a time (CIOS), so the running total is
+ * never more than 6 limbs.  r may be the same as a and/or b.
+ *
+ * Each reduction step adds (m * p) to clear the low limb, with m = the low
+ * limb (-(p ^ -1) is 1 mod 2^64).  The limbs of p are (2^64 - 1),
+ * (2^32 - 1), 0, and (2^64 - 2^32 + 1), so only the top one needs a
+ * multiply:
+ *
+ *   t[0] + (m * (2^64 - 1))          = m * 2^64, so t[0] becomes 0, carry m.
+ *   t[1] + (m * (2^32 - 1)) + m      = t[1] + (m * 2^32).
+ *   t[2] + 0
+ *   t[3] + (m * (2^64 - 2^32 + 1))
+ ******************************************************************************/
+static void ecdh_p256_mul(limb_t *r, const limb_t *a, const limb_t *b)
+{
+	limb_t t[5] = { 0, 0, 0, 0, 0 };
+
+	int i;
+	for(i = 0; i < 4; i++) {
+		/* t += a * b[i]. */
+		limb_t bi = b[i];
+		dlimb_t s;
+		s = (dlimb_t) a[0] * bi + t[0];
+		t[0] = (limb_t) s;
+		s = (dlimb_t) a[1] * bi + t[1] + (limb_t) (s >> LIMB_BITS);
+		t[1] = (limb_t) s;
+		s = (dlimb_t) a[2] * bi + t[2] + (limb_t) (s >> LIMB_BITS);
+		t[2] = (limb_t) s;
+		s = (dlimb_t) a[3] * bi + t[3] + (limb_t) (s >> LIMB_BITS);
+		t[3] = (limb_t) s;
+		s = (dlimb_t) t[4] + (limb_t) (s >> LIMB_BITS);
+		t[4] = (limb_t) s;
+		limb_t top = (limb_t) (s >> LIMB_BITS);
+
+		/* t = (t + (m * p)) / 2^64. */
+		limb_t m = t[0];
+		s = (dlimb_t) t[1] + ((dlimb_t) m << 32);
+		t[0] = (limb_t) s;
+		s = (dlimb_t) t[2] + (limb_t) (s >> LIMB_BITS);
+		t[1] = (limb_t) s;
+		s = (dlimb_t) m * ecdh_p256_p[3] + t[3] + (limb_t) (s >> LIMB_BITS);
+		t[2] = (limb_t) s;
+		s = (dlimb_t) t[4] + (limb_t) (s >> LIMB_BITS);
+		t[3] = (limb_t) s;
+		t[4] = top + (limb_t) (s >> LIMB_BITS);
+	}
+
+	ecdh_p256_reduce_once(r, t, t[4]);
+}
+
+static void ecdh_p256_sqr(limb_t *r, const limb_t *a)
+{
+	ecdh_p256_mul(r, a, a);
+}
+
+/*******************************************************************************
+ * r = a ^ -1 = a ^ (p - 2).  The exponent is public, so it's fine to branch on
+ * its bits.
+ ******************************************************************************/
+static void ecdh_p256_invert(limb_t *r, const limb_t *a)
+{
+	ecdh_fe256 x;
+	memcpy(x, ecdh_p256_one, sizeof(x));
+
+	int i;
+	for(i = 255; i >= 0; i--) {
+		ecdh_p256_sqr(x, x);
+		if((ecdh_p256_p_minus_2[i / 64] >> (i % 64)) & 1) {
+			ecdh_p256_mul(x, x, a);
+		}
+	}
+
+	memcpy(r, x, sizeof(x));
+}
+
+/*******************************************************************************
+ * Convert 32 big-endian bytes to a field element in Montgomery form, and back.
+ *
+ * Output (ecdh_p256_from_bytes()):
+ *   Success - 0.
+ *   Failure - 1 (the value is p or more).
+ ******************************************************************************/
+static int ecdh_p256_from_bytes(limb_t *r, const uint8_t *s)
+{
+	ecdh_fe256 t;
+	int i, j;
+	for(i = 0; i < 4; i++) {
+		t[i] = 0;
+		for(j = 0; j < 8; j++) {
+			t[i] = (t[i] << 8) | s[((3 - i) * 8) + j];
+		}
+	}
+
+	/* Is t less than p? */
+	limb_t borrow = 0;
+	for(i = 0; i < 4; i++) {
+		dlimb_t d = (dlimb_t) t[i] - ecdh_p256_p[i] - borrow;
+		borrow = (limb_t) (d >> LIMB_BITS) & 1;
+	}
+	if(borrow == 0) {
+		return 1;
+	}
+
+	ecdh_p256_mul(r, t, ecdh_p256_r2);
+	return 0;
+}
+
+static void ecdh_p256_to_bytes(uint8_t *s, const limb_t *a)
+{
+	static const ecdh_fe256 plain_one = { 1, 0, 0, 0 };
+	ecdh_fe256 t;
+	ecdh_p256_mul(t, a, plain_one);
+
+	int i, j;
+	for(i = 0; i < 4; i++) {
+		for(j = 0; j < 8; j++) {
+			s[((3 - i) * 8) + j] = (uint8_t) (t[i] >> (56 - (8 * j)));
+		}
+	}
+}
+
+/********** P-256 Point Arithmetic */
+
+/*******************************************************************************
+ * r = 2 * a.  This is "dbl-2001-b" from the Explicit-Formulas Database, which
+ * uses a = -3:
+ *
+ *   delta = Z1^2, gamma = Y1^2, beta = X1 * gamma
+ *   alpha = 3 * (X1 - delta) * (X1 + delta)
+ *   X3 = alpha^2 - 8 * beta
+ *   Z3 = (Y1 + Z1)^2 - gamma - delta
+ *   Y3 = alpha * (4 * beta - X3) - 8 * gamma^2
+ *
+ * The point at infinity (Z1 = 0) comes out as Z3 = 0.  r may be the same as a.
+ ******************************************************************************/
+static void ecdh_p256_point_double(ecdh_p256_point *r, const ecdh_p256_point *a)
+{
+	ecdh_fe256 delta, gamma, beta, alpha, t, u;
+
+	ecdh_p256_sqr(delta, a->z);
+	ecdh_p256_sqr(gamma, a->y);
+	ecdh_p256_mul(beta, a->x, gamma);
+
+	ecdh_p256_sub(t, a->x, delta);
+	ecdh_p256_add(u, a->x, delta);
+	ecdh_p256_mul(t, t, u);
+	ecdh_p256_add(alpha, t, t);
+	ecdh_p256_add(alpha, alpha, t);
+
+	ecdh_p256_add(t, a->y, a->z);
+	ecdh_p256_sqr(t, t);
+	ecdh_p256_sub(t, t, gamma);
+	ecdh_p256_sub(r->z, t, delta);
+
+	/* beta becomes 4 * beta. */
+	ecdh_p256_add(beta, beta, beta);
+	ecdh_p256_add(beta, beta, beta);
+	ecdh_p256_sqr(t, alpha);
+	ecdh_p256_sub(t, t, beta);
+	ecdh_p256_sub(r->x, t, beta);
+
+	/* gamma becomes 8 * gamma^2. */
+	ecdh_p256_sub(t, beta, r->x);
+	ecdh_p256_mul(t, alpha, t);
+	ecdh_p256_sqr(gamma, gamma);
+	ecdh_p256_add(gamma, gamma, gamma);
+	ecdh_p256_add(gamma, gamma, gamma);
+	ecdh_p256_add(gamma, gamma, gamma);
+	ecdh_p256_sub(r->y, t, gamma);
+}
+
+/*******************************************************************************
+ * r = a + b.  This is "add-2007-bl" from the Explicit-Formulas Database:
+ *
+ *   U1 = X1 * Z2^2, U2 = X2 * Z1^2, S1 = Y1 * Z2^3, S2 = Y2 * Z1^3
+ *   H = U2 - U1, I = (2 * H)^2, J = H * I, r = 2 * (S2 - S1), V = U1 * I
+ *   X3 = r^2 - J - 2 * V
+ *   Y3 = r * (V - X3) - 2 * S1 * J
+ *   Z3 = ((Z1 + Z2)^2 - Z1^2 - Z2^2) * H
+ *
+ * It doesn't work if a or b is the point at infinity, or if a = b.  The
+ * callers make sure neither one matters.  r may be the same as a or b.
+ ******************************************************************************/
+static void ecdh_p256_point_add(ecdh_p256_point *r, const ecdh_p256_point *a, const ecdh_p256_point *b)
+{
+	ecdh_fe256 z1z1, z2z2, u1, u2, s1, s2, h, i, j, rr, v, t;
+
+	ecdh_p256_sqr(z1z1, a->z);
+	ecdh_p256_sqr(z2z2, b->z);
+	ecdh_p256_mul(u1, a->x, z2z2);
+	ecdh_p256_mul(u2, b->x, z1z1);
+	ecdh_p256_mul(s1, a->y, b->z);
+	ecdh_p256_mul(s1, s1, z2z2);
+	ecdh_p256_mul(s2, b->y, a->z);
+	ecdh_p256_mul(s2, s2, z1z1);
+
+	ecdh_p256_sub(h, u2, u1);
+	ecdh_p256_add(i, h, h);
+	ecdh_p256_sqr(i, i);
+	ecdh_p256_mul(j, h, i);
+	ecdh_p256_sub(rr, s2, s1);
+	ecdh_p256_add(rr, rr, rr);
+	ecdh_p256_mul(v, u1, i);
+
+	ecdh_p256_add(t, a->z, b->z);
+	ecdh_p256_sqr(t, t);
+	ecdh_p256_sub(t, t, z1z1);
+	ecdh_p256_sub(t, t, z2z2);
+	ecdh_p256_mul(r->z, t, h);
+
+	ecdh_p256_sqr(t, rr);
+	ecdh_p256_sub(t, t, j);
+	ecdh_p256_sub(t, t, v);
+	ecdh_p256_sub(r->x, t, v);
+
+	ecdh_p256_sub(t, v, r->x);
+	ecdh_p256_mul(t, rr, t);
+	ecdh_p256_mul(s1, s1, j);
+	ecdh_p256_add(s1, s1, s1);
+	ecdh_p256_sub(r->y, t, s1);
+}
+
+/*******************************************************************************
+ * r = a if flag is 1, and leave r alone if it's 0.
+ ******************************************************************************/
+static void ecdh_p256_point_cmov(ecdh_p256_point *r, const ecdh_p256_point *a, limb_t flag)
+{
+	limb_t mask = 0 - flag;
+	limb_t *d = (limb_t *) r;
+	const limb_t *s = (const limb_t *) a;
+
+	int i;
+	for(i = 0; i < ECDH_P256_POINT_LIMBS; i++) {
+		d[i] = (s[i] & mask) | (d[i] & ~mask);
+	}
+}
+
+/*******************************************************************************
+ * r = table[index].  Every entry is read, so the memory access pattern doesn't
+ * give the index away.
+ ******************************************************************************/
+static void ecdh_p256_point_select(ecdh_p256_point *r, const ecdh_p256_point *table, int index)
+{
+	memset(r, 0, sizeof(*r));
+
+	int i;
+	for(i = 0; i < ECDH_P256_WINDOW; i++) {
+		ecdh_p256_point_cmov(r, &table[i], (limb_t) (i == index));
+	}
+}
+
+/*******************************************************************************
+ * Get digit i (0 is the most significant) of a 32-byte big-endian scalar.
+ ******************************************************************************/
+static int ecdh_p256_digit(const uint8_t *k, int i)
+{
+	return (k[i / 2] >> ((i & 1) ? 0 : 4)) & 0xF;
+}
+
+/*******************************************************************************
+ * Add a table entry into a running total.  acc is the point at infinity as
+ * long as *inf is 1.  A 0 digit leaves acc alone.  Every case does the same
+ * work.
+ ******************************************************************************/
+static void ecdh_p256_accumulate(ecdh_p256_point *acc, limb_t *inf, const ecdh_p256_point *table, int digit)
+{
+	ecdh_p256_point t, sum;
+	limb_t zero = (limb_t) (digit == 0);
+
+	ecdh_p256_point_select(&t, table, digit);
+	ecdh_p256_point_add(&sum, acc, &t);
+	ecdh_p256_point_cmov(&sum, &t, *inf);
+	ecdh_p256_point_cmov(acc, &sum, zero ^ 1);
+	*inf &= zero;
+}
+
+/*******************************************************************************
+ * r = k * a, with a 4-bit fixed window.  k is 32 bytes, big-endian, and
+ * 0 < k < n.
+ *
+ * The addition formula can't double, but it never has to.  The running total
+ * is a multiple of 16 that's less than n, and the table entry is between 1
+ * and 15 times a, so they're never the same point, or each other's negative.
+ ******************************************************************************/
+static void ecdh_p256_scalar_mul(ecdh_p256_point *r, const ecdh_p256_point *a, const uint8_t *k)
+{
+	/* table[d] = d * a.  table[0] is never used. */
+	ecdh_p256_point table[ECDH_P256_WINDOW];
+	memset(&table[0], 0, sizeof(table[0]));
+	table[1] = *a;
+	ecdh_p256_point_double(&table[2], a);
+
+	int i;
+	for(i = 3; i < ECDH_P256_WINDOW; i++) {
+		ecdh_p256_point_add(&table[i], &table[i - 1], a);
+	}
+
+	memset(r, 0, sizeof(*r));
+	limb_t inf = 1;
+	for(i = 0; i < ECDH_P256_DIGITS; i++) {
+		int j;
+		for(j = 0; j < 4; j++) {
+			ecdh_p256_point_double(r, r);
+		}
+		ecdh_p256_accumulate(r, &inf, table, ecdh_p256_digit(k, i));
+	}
+}
+
+/*******************************************************************************
+ * r = k * G, from the curve's table.  No doubling is needed.  Same as above,
+ * the total so far and the next table entry are never the same point.
+ ******************************************************************************/
+static void ecdh_p256_scalar_mul_base(const ecdh_curve *curve, ecdh_p256_point *r, const uint8_t *k)
+{
+	memset(r, 0, sizeof(*r));
+	limb_t inf = 1;
+
+	int i;
+	for(i = 0; i < ECDH_P256_DIGITS; i++) {
+		ecdh_p256_accumulate(r, &inf, curve->table + (i * ECDH_P256_WINDOW), ecdh_p256_digit(k, i));
+	}
+}
+
+/*******************************************************************************
+ * Load an uncompressed point (0x04, x, y) and make sure it's on the curve.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (not a valid point).
+ ******************************************************************************/
+static int ecdh_p256_point_from_bytes(const ecdh_curve *curve, ecdh_p256_point *r, const uint8_t *s)
+{
+	if((s[0] != 0x04) || (ecdh_p256_from_bytes(r->x, s + 1) != 0) || (ecdh_p256_from_bytes(r->y, s + 33) != 0)) {
+		return 1;
+	}
+	memcpy(r->z, ecdh_p256_one, sizeof(r->z));
+
+	/* y^2 = x^3 - 3x + b. */
+	ecdh_fe256 lhs, rhs, t;
+	ecdh_p256_sqr(lhs, r->y);
+	ecdh_p256_sqr(rhs, r->x);
+	ecdh_p256_mul(rhs, rhs, r->x);
+	ecdh_p256_add(t, r->x, r->x);
+	ecdh_p256_add(t, t, r->x);
+	ecdh_p256_sub(rhs, rhs, t);
+	ecdh_p256_add(rhs, rhs, curve->b);
+
+	return (memcmp(lhs, rhs, sizeof(lhs)) != 0);
+}
+
+/*******************************************************************************
+ * Convert a point to affine coordinates, and store the x coordinate (32 bytes)
+ * or the whole point (65 bytes).
+ ******************************************************************************/
+static void ecdh_p256_point_to_bytes(uint8_t *s, const ecdh_p256_point *a, int with_y)
+{
+	ecdh_fe256 zinv, zinv2, t;
+	ecdh_p256_invert(zinv, a->z);
+	ecdh_p256_sqr(zinv2, zinv);
+
+	ecdh_p256_mul(t, a->x, zinv2);
+	if(with_y == 0) {
+		ecdh_p256_to_bytes(s, t);
+		return;
+	}
+
+	s[0] = 0x04;
+	ecdh_p256_to_bytes(s + 1, t);
+	ecdh_p256_mul(zinv2, zinv2, zinv);
+	ecdh_p256_mul(t, a->y, zinv2);
+	ecdh_p256_to_bytes(s + 33, t);
+}
+
+/*******************************************************************************
+ * Check a P-256 private key.  It has to be between 1 and (n - 1).  The bytes
+ * are big-endian, so memcmp() compares them as numbers.
+ ******************************************************************************/
+static int ecdh_p256_private_ok(const uint8_t *k)
+{
+	static const uint8_t zero[32] = { 0 };
+	return (memcmp(k, zero, 32) != 0) && (memcmp(k, ecdh_p256_n, 32) < 0);
+}
+
+/*******************************************************************************
+ * Build the P-256 generator table.  Row i holds the multiples of
+ * (16 ^ (63 - i)) * G.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1.
+ ******************************************************************************/
+static int ecdh_p256_table_new(ecdh_curve *this)
+{
+	this->table = (ecdh_p256_point *) calloc(ECDH_P256_DIGITS * ECDH_P256_WINDOW, sizeof(ecdh_p256_point));
+	if(this->table == (ecdh_p256_point *) 0) {
+		return 1;
+	}
+
+	ecdh_p256_point base;
+	if(ecdh_p256_point_from_bytes(this, &base, ecdh_p256_g) != 0) {
+		return 1;
+	}
+
+	int i;
+	for(i = ECDH_P256_DIGITS - 1; i >= 0; i--) {
+		ecdh_p256_point *row = this->table + (i * ECDH_P256_WINDOW);
+		row[1] = base;
+		ecdh_p256_point_double(&row[2], &base);
+
+		int d;
+		for(d = 3; d < ECDH_P256_WINDOW; d++) {
+			ecdh_p256_point_add(&row[d], &row[d - 1], &base);
+		}
+
+		for(d = 0; d < 4; d++) {
+			ecdh_p256_point_double(&base, &base);
+		}
+	}
+
+	return 0;
+}
+
+/********************************** PUBLIC API ********************************/
+
+/*******************************************************************************
+ * The X25519 function (RFC 7748, section 5).  The Montgomery ladder keeps
+ * (x2 : z2) = k * u and (x3 : z3) = (k + 1) * u, for the bits of k seen so
+ * far.  Each bit does one combined double-and-add, with the 2 points swapped
+ * according to the bit, so every bit takes the same steps.
+ *
+ * Input:
+ *   out    - Receives the result.  32 bytes.
+ *   scalar - The scalar.  32 bytes.  It's clamped (bits 0, 1, 2, and 255
+ *            cleared, and bit 254 set) first.
+ *   u      - The u coordinate.  32 bytes.
+ ******************************************************************************/
+void ecdh_x25519(uint8_t *out, const uint8_t *scalar, const uint8_t *u)
+{
+	uint8_t k[32];
+	memcpy(k, scalar, sizeof(k));
+	k[0] &= 248;
+	k[31] &= 127;
+	k[31] |= 64;
+
+	ecdh_fe25519 x1, x2, z2, x3, z3;
+	ecdh_fe25519 a, aa, b, bb, e, c, d, da, cb;
+
+	ecdh_x25519_from_bytes(x1, u);
+	memset(x2, 0, sizeof(x2));
+	x2[0] = 1;
+	memset(z2, 0, sizeof(z2));
+	memcpy(x3, x1, sizeof(x3));
+	memset(z3, 0, sizeof(z3));
+	z3[0] = 1;
+
+	limb_t swap = 0;
+	int t;
+	for(t = 254; t >= 0; t--) {
+		limb_t bit = (k[t / 8] >> (t & 7)) & 1;
+		swap ^= bit;
+		ecdh_x25519_cswap(x2, x3, swap);
+		ecdh_x25519_cswap(z2, z3, swap);
+		swap = bit;
+
+		ecdh_x25519_add(a, x2, z2);
+		ecdh_x25519_sqr(aa, a);
+		ecdh_x25519_sub(b, x2, z2);
+		ecdh_x25519_sqr(bb, b);
+		ecdh_x25519_sub(e, aa, bb);
+		ecdh_x25519_add(c, x3, z3);
+		ecdh_x25519_sub(d, x3, z3);
+		ecdh_x25519_mul(da, d, a);
+		ecdh_x25519_mul(cb, c, b);
+
+		/* x3 = (DA + CB)^2, z3 = x1 * (DA - CB)^2. */
+		ecdh_x25519_add(x3, da, cb);
+		ecdh_x25519_sqr(x3, x3);
+		ecdh_x25519_sub(z3, da, cb);
+		ecdh_x25519_sqr(z3, z3);
+		ecdh_x25519_mul(z3, z3, x1);
+
+		/* x2 = AA * BB, z2 = E * (AA + a24 * E). */
+		ecdh_x25519_mul(x2, aa, bb);
+		ecdh_x25519_mul_a24(z2, e);
+		ecdh_x25519_add(z2, z2, aa);
+		ecdh_x25519_mul(z2, z2, e);
+	}
+	ecdh_x25519_cswap(x2, x3, swap);
+	ecdh_x25519_cswap(z2, z3, swap);
+
+	ecdh_x25519_invert(z2, z2);
+	ecdh_x25519_mul(x2, x2, z2);
+	ecdh_x25519_to_bytes(out, x2);
+
+	memset(k, 0, sizeof(k));
+}
+
+/*******************************************************************************
+ * Create an ecdh_curve object.
+ *
+ * Input:
+ *   id - ECDH_X25519 or ECDH_P256.
+ *
+ * Output:
+ *   Success - Returns a pointer to the ecdh_curve object.
+ *   Failure - Returns 0 (unknown curve, or out of memory).
+ ******************************************************************************/
+ecdh_curve *ecdh_curve_new(ecdh_curve_id id)
+{
+	ecdh_curve *this = (ecdh_curve *) 0;
+
+	if((id == ECDH_X25519) || (id == ECDH_P256)) {
+		this = (ecdh_curve *) calloc(1, sizeof(*this));
+	}
+
+	do {
+		if(this == (ecdh_curve *) 0) { break; }
+
+		this->id = id;
+		if(id == ECDH_X25519) {
+			this->public_bytes = 32;
+			return this;
+		}
+
+		this->public_bytes = 65;
+		if(ecdh_p256_from_bytes(this->b, ecdh_p256_b) != 0) { break; }
+		if(ecdh_p256_table_new(this) != 0) { break; }
+
+		return this;
+
+	} while(0);
+
+	ecdh_curve_delete(this);
+	return (ecdh_curve *) 0;
+}
+
+/*******************************************************************************
+ * Destroy an ecdh_curve object.
+ *
+ * Input:
+ *   this - A pointer to the object.
+ ******************************************************************************/
+void ecdh_curve_delete(ecdh_curve *this)
+{
+	if(this != (ecdh_curve *) 0) {
+		free(this->table);
+		free(this);
+	}
+}
+
+/*******************************************************************************
+ * Get the size of a public key for a curve.
+ ******************************************************************************/
+int ecdh_public_bytes(const ecdh_curve *this)
+{
+	return this->public_bytes;
+}
+
+/*******************************************************************************
+ * Calculate the public key for a private key.  For X25519 that's
+ * X25519(private_key, 9).  For P-256 it's (private_key * G), as an
+ * uncompressed point.
+ *
+ * Input:
+ *   curve       - The curve.
+ *   private_key - The private key.  ECDH_PRIVATE_BYTES long.  For P-256 it's
+ *                 big-endian, and it has to be between 1 and (n - 1).
+ *   public_key  - Receives the public key.  ecdh_public_bytes() long.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (the private key isn't valid).
+ ******************************************************************************/
+int ecdh_public_key(const ecdh_curve *curve, const uint8_t *private_key, uint8_t *public_key)
+{
+	if((curve == (ecdh_curve *) 0) || (private_key == (uint8_t *) 0) || (public_key == (uint8_t *) 0)) {
+		return 1;
+	}
+
+	if(curve->id == ECDH_X25519) {
+		static const uint8_t nine[32] = { 9 };
+		ecdh_x25519(public_key, private_key, nine);
+		return 0;
+	}
+
+	if(!ecdh_p256_private_ok(private_key)) {
+		return 1;
+	}
+
+	ecdh_p256_point r;
+	ecdh_p256_scalar_mul_base(curve, &r, private_key);
+	ecdh_p256_point_to_bytes(public_key, &r, 1);
+	return 0;
+}
+
+/*******************************************************************************
+ * Generate a key pair.  An X25519 private key is any 32 random bytes.  A P-256
+ * one is 32 random bytes that happen to be between 1 and (n - 1) (the first
+ * try almost always is).
+ *
+ * Input:
+ *   curve       - The curve.
+ *   private_key - Receives the private key.  ECDH_PRIVATE_BYTES long.
+ *   public_key  - Receives the public key.  ecdh_public_bytes() long.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1.
+ ******************************************************************************/
+int ecdh_generate_key(const ecdh_curve *curve, uint8_t *private_key, uint8_t *public_key)
+{
+	if((curve == (ecdh_curve *) 0) || (private_key == (uint8_t *) 0) || (public_key == (uint8_t *) 0)) {
+		return 1;
+	}
+
+	do {
+		if(crypto_util_random_bytes(private_key, ECDH_PRIVATE_BYTES) != 0) {
+			return 1;
+		}
+	} while((curve->id == ECDH_P256) && !ecdh_p256_private_ok(private_key));
+
+	return ecdh_public_key(curve, private_key, public_key);
+}
+
+/*******************************************************************************
+ * Calculate the shared secret.
+ *
+ * For X25519 the secret is X25519(private_key, peer_public).  A peer public
+ * key that is one of the few points of small order makes the secret 0, and
+ * that is refused (RFC 7748, section 6.1).
+ *
+ * For P-256 the peer's public key has to be a point on the curve, and the
+ * secret is the x coordinate of (private_key * peer_public), big-endian.
+ * Every point on the curve has order n, so there's no small subgroup to worry
+ * about once the point is known to be on it.
+ *
+ * Input:
+ *   curve       - The curve.
+ *   private_key - Our private key.
+ *   peer_public - The other side's public key.
+ *   secret      - Receives the secret.  ECDH_SECRET_BYTES long.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (a key isn't valid).
+ ******************************************************************************/
+int ecdh_compute_secret(const ecdh_curve *curve, const uint8_t *private_key, const uint8_t *peer_public,
+                        uint8_t *secret)
+{
+	if((curve == (ecdh_curve *) 0) || (private_key == (uint8_t *) 0) || (peer_public == (uint8_t *) 0) ||
+	   (secret == (uint8_t *) 0)) {
+		return 1;
+	}
+
+	if(curve->id == ECDH_X25519) {
+		ecdh_x25519(secret, private_key, peer_public);
+
+		uint8_t any = 0;
+		int i;
+		for(i = 0; i < ECDH_SECRET_BYTES; i++) {
+			any |= secret[i];
+		}
+		return (any == 0);
+	}
+
+	ecdh_p256_point peer, r;
+	if(!ecdh_p256_private_ok(private_key) || (ecdh_p256_point_from_bytes(curve, &peer, peer_public) != 0)) {
+		return 1;
+	}
+
+	ecdh_p256_scalar_mul(&r, &peer, private_key);
+	ecdh_p256_point_to_bytes(secret, &r, 0);
+	return 0;
+}
+
+/*******************************************************************************
+ * Send a public key over a socket.
+ *
+ * Input:
+ *   fd    - The socket.
+ *   curve - The curve.
+ *   value - The public key.  ecdh_public_bytes() long.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1.
+ ******************************************************************************/
+int ecdh_write_value(int fd, const ecdh_curve *curve, const uint8_t *value)
+{
+	if((curve == (ecdh_curve *) 0) || (value == (uint8_t *) 0)) {
+		return 1;
+	}
+
+	/* The length, then the value. */
+	uint8_t buf[4 + ECDH_MAX_PUBLIC_BYTES];
+	int len = curve->public_bytes;
+	buf[0] = (uint8_t) (len >> 24);
+	buf[1] = (uint8_t) (len >> 16);
+	buf[2] = (uint8_t) (len >> 8);
+	buf[3] = (uint8_t) len;
+	memcpy(buf + 4, value, len);
+
+	return crypto_util_write_full(fd, buf, 4 + len);
+}
+
+/*******************************************************************************
+ * Receive a public key that was sent by ecdh_write_value().
+ *
+ * Input:
+ *   fd    - The socket.
+ *   curve - The curve.
+ *   value - Receives the public key.  ecdh_public_bytes() long.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (error, or the length is wrong for the curve).
+ ******************************************************************************/
+int ecdh_read_value(int fd, const ecdh_curve *curve, uint8_t *value)
+{
+	if((curve == (ecdh_curve *) 0) || (value == (uint8_t *) 0)) {
+		return 1;
+	}
+
+	uint8_t hdr[4];
+	if(crypto_util_read_full(fd, hdr, sizeof(hdr)) != 0) {
+		return 1;
+	}
+
+	uint32_t len = ((uint32_t) hdr[0] << 24) | ((uint32_t) hdr[1] << 16) | ((uint32_t) hdr[2] << 8) | hdr[3];
+	if(len != (uint32_t) curve->public_bytes) {
+		return 1;
+	}
+
+	return crypto_util_read_full(fd, value, len);
+}
+
+/*******************************************************************************
+ * Do one key agreement over a connected socket.  Generate a key pair, send the
+ * public key, receive the other side's public key, and calculate the secret.
+ * Both sides send before they receive, the same as diffie_hellman_handshake().
+ *
+ * Input:
+ *   fd     - The socket.
+ *   curve  - The curve.  Both sides must use the same one.
+ *   secret - Receives the shared secret.  ECDH_SECRET_BYTES long.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1.
+ ******************************************************************************/
+int ecdh_handshake(int fd, const ecdh_curve *curve, uint8_t *secret)
+{
+	int rc = 1;
+
+	uint8_t private_key[ECDH_PRIVATE_BYTES];
+	uint8_t public_key[ECDH_MAX_PUBLIC_BYTES];
+
+	if((ecdh_generate_key(curve, private_key, public_key) == 0) &&
+	   (ecdh_write_value(fd, curve, public_key) == 0) &&
+	   (ecdh_read_value(fd, curve, public_key) == 0) &&
+	   (ecdh_compute_secret(curve, private_key, public_key, secret) == 0)) {
+		rc = 0;
+	}
+
+	/* Don't leave the private key lying around on the stack. */
+	memset(private_key, 0, sizeof(private_key));
+	return rc;
+}
+
+/********** Test Methods */
+
+#ifdef TEST
+/*******************************************************************************
+ * Convert a hex string to bytes.
+ ******************************************************************************/
+static void ecdh_test_hex(uint8_t *buf, const char *hex)
+{
+	int i;
+	for(i = 0; hex[2 * i] != 0; i++) {
+		unsigned int byte;
+		sscanf(hex + (2 * i), "%2x", &byte);
+		buf[i] = (uint8_t) byte;
+	}
+}
+
+/* One side of a test handshake. */
+typedef struct ecdh_test_side {
+	int fd;
+	const ecdh_curve *curve;
+	uint8_t secret[ECDH_SECRET_BYTES];
+	int rc;
+} ecdh_test_side;
+
+/*******************************************************************************
+ * The other side of a test handshake.
+ ******************************************************************************/
+static void *ecdh_test_thread(void *arg)
+{
+	ecdh_test_side *side = (ecdh_test_side *) arg;
+	side->rc = ecdh_handshake(side->fd, side->curve, side->secret);
+	return (void *) 0;
+}
+
+/*******************************************************************************
+ * Generate 2 key pairs and agree on a secret without a socket, then do it
+ * again with a handshake between 2 threads.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1.
+ ******************************************************************************/
+static int ecdh_test_agree(const ecdh_curve *curve)
+{
+	uint8_t x1[ECDH_PRIVATE_BYTES], x2[ECDH_PRIVATE_BYTES];
+	uint8_t y1[ECDH_MAX_PUBLIC_BYTES], y2[ECDH_MAX_PUBLIC_BYTES];
+	uint8_t s1[ECDH_SECRET_BYTES], s2[ECDH_SECRET_BYTES];
+	int bytes = ecdh_public_bytes(curve);
+
+	if(ecdh_generate_key(curve, x1, y1) != 0) { return 1; }
+	if(ecdh_generate_key(curve, x2, y2) != 0) { return 1; }
+	if(memcmp(y1, y2, bytes) == 0) { return 1; }
+	if(ecdh_compute_secret(curve, x1, y2, s1) != 0) { return 1; }
+	if(ecdh_compute_secret(curve, x2, y1, s2) != 0) { return 1; }
+	if(memcmp(s1, s2, sizeof(s1)) != 0) { return 1; }
+
+	int rc = 1;
+	int fds[2];
+	if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) { return 1; }
+
+	do {
+		/* The wire format.  A key survives the trip, and a key with the
+		 * wrong length is refused. */
+		if(ecdh_write_value(fds[0], curve, y1) != 0) { break; }
+		if(ecdh_read_value(fds[1], curve, y2) != 0) { break; }
+		if(memcmp(y1, y2, bytes) != 0) { break; }
+		{
+			const uint8_t bad[] = { 0, 0, 0, 1, 2 };
+			uint8_t rest;
+			if(write(fds[0], bad, sizeof(bad)) != sizeof(bad)) { break; }
+			if(ecdh_read_value(fds[1], curve, y2) == 0) { break; }
+			if(read(fds[1], &rest, 1) != 1) { break; }
+		}
+
+		ecdh_test_side side = { fds[1], curve, { 0 }, 1 };
+		pthread_t thread;
+		if(pthread_create(&thread, NULL, ecdh_test_thread, &side) != 0) { break; }
+		int mine = ecdh_handshake(fds[0], curve, s1);
+		pthread_join(thread, (void **) 0);
+		if((mine != 0) || (side.rc != 0) || (memcmp(s1, side.secret, sizeof(s1)) != 0)) { break; }
+
+		rc = 0;
+
+	} while(0);
+
+	close(fds[0]);
+	close(fds[1]);
+	return rc;
+}
+
+/*******************************************************************************
+ * Run the ecdh tests.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1.
+ ******************************************************************************/
+int ecdh_test(void)
+{
+	printf("%s(): Starting\n", __func__);
+	int rc = 1;
+
+	ecdh_curve *x25519 = (ecdh_curve *) 0;
+	ecdh_curve *p256 = (ecdh_curve *) 0;
+
+	do {
+		uint8_t k[32], u[32], out[32], expect[65], pub[65];
+
+		/* The test vectors from RFC 7748, section 5.2. */
+		ecdh_test_hex(k, "a546e36bf0527c9d3b16154b82465edd62144c0ac1fc5a18506a2244ba449ac4");
+		ecdh_test_hex(u, "e6db6867583030db3594c1a424b15f7c726624ec26b3353b10a903a6d0ab1c4c");
+		ecdh_test_hex(expect, "c3da55379de9c6908e94ea4df28d084f32eccf03491c71f754b4075577a28552");
+		ecdh_x25519(out, k, u);
+		if(memcmp(out, expect, 32) != 0) { break; }
+
+		ecdh_test_hex(k, "4b66e9d4d1b4673c5ad22691957d6af5c11b6421e0ea01d42ca4169e7918ba0d");
+		ecdh_test_hex(u, "e5210f12786811d3f4b7959d0538ae2c31dbe7106fc03c3efc4cd549c715a493");
+		ecdh_test_hex(expect, "95cbde9476e8907d7aade45cb4b873f88b595a68799fa152e6f8f7647aac7957");
+		ecdh_x25519(out, k, u);
+		if(memcmp(out, expect, 32) != 0) { break; }
+
+		/* The iterated one.  Start with k = u = 9, then k = X25519(k, u)
+		 * and u = the old k, 1000 times. */
+		memset(k, 0, sizeof(k));
+		k[0] = 9;
+		memcpy(u, k, sizeof(u));
+		int i;
+		for(i = 1; i <= 1000; i++) {
+			ecdh_x25519(out, k, u);
+			memcpy(u, k, sizeof(u));
+			memcpy(k, out, sizeof(k));
+			if(i == 1) {
+				ecdh_test_hex(expect, "422c8e7a6227d7bca1350b3e2bb7279f7897b87bb6854b783c60e80311ae3079");
+				if(memcmp(k, expect, 32) != 0) { break; }
+			}
+		}
+		ecdh_test_hex(expect, "684cf59ba83309552800ef566f2f4d3c1c3887c49360e3875f2eb94d99532c51");
+		if(memcmp(k, expect, 32) != 0) { break; }
+
+		/* The key agreement from RFC 7748, section 6.1. */
+		x25519 = ecdh_curve_new(ECDH_X25519);
+		if(x25519 == (ecdh_curve *) 0) { break; }
+		ecdh_test_hex(k, "77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a");
+		ecdh_test_hex(expect, "8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a");
+		if(ecdh_public_key(x25519, k, pub) != 0) { break; }
+		if(memcmp(pub, expect, 32) != 0) { break; }
+		ecdh_test_hex(u, "de9edb7d7b7dc1b4d35b61c2ece435373f8343c85b78674dadfc7e146f882b4f");
+		ecdh_test_hex(expect, "4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742");
+		if(ecdh_compute_secret(x25519, k, u, out) != 0) { break; }
+		if(memcmp(out, expect, 32) != 0) { break; }
+
+		/* A point of small order (0) is refused. */
+		memset(u, 0, sizeof(u));
+		if(ecdh_compute_secret(x25519, k, u, out) == 0) { break; }
+
+		if(ecdh_test_agree(x25519) != 0) { break; }
+
+		/* P-256, from the NIST ECC CDH primitive test vectors (count 0). */
+		p256 = ecdh_curve_new(ECDH_P256);
+		if(p256 == (ecdh_curve *) 0) { break; }
+		uint8_t peer[65];
+		ecdh_test_hex(k, "7d7dc5f71eb29ddaf80d6214632eeae03d9058af1fb6d22ed80badb62bc1a534");
+		ecdh_test_hex(expect, "04"
+		              "ead218590119e8876b29146ff89ca61770c4edbbf97d38ce385ed281d8a6b230"
+		              "28af61281fd35e2fa7002523acc85a429cb06ee6648325389f59edfce1405141");
+		if(ecdh_public_key(p256, k, pub) != 0) { break; }
+		if(memcmp(pub, expect, 65) != 0) { break; }
+		ecdh_test_hex(peer, "04"
+		              "700c48f77f56584c5cc632ca65640db91b6bacce3a4df6b42ce7cc838833d287"
+		              "db71e509e3fd9b060ddb20ba5c51dcc5948d46fbf640dfe0441782cab85fa4ac");
+		ecdh_test_hex(expect, "46fc62106420ff012e54a434fbdd2d25ccc5852060561e68040dd7778997bd7b");
+		if(ecdh_compute_secret(p256, k, peer, out) != 0) { break; }
+		if(memcmp(out, expect, 32) != 0) { break; }
+
+		/* The fixed-base and variable-base multiplies agree on G. */
+		if(ecdh_compute_secret(p256, k, ecdh_p256_g, out) != 0) { break; }
+		if(memcmp(out, pub + 1, 32) != 0) { break; }
+
+		/* Points that aren't on the curve, a bad format byte, and a
+		 * coordinate that is p or more are refused. */
+		peer[64] ^= 1;
+		if(ecdh_compute_secret(p256, k, peer, out) == 0) { break; }
+		peer[64] ^= 1;
+		peer[0] = 0x02;
+		if(ecdh_compute_secret(p256, k, peer, out) == 0) { break; }
+		peer[0] = 0x04;
+		memset(peer + 1, 0xFF, 32);
+		if(ecdh_compute_secret(p256, k, peer, out) == 0) { break; }
+
+		/* Private keys of 0 and n are refused. */
+		memset(k, 0, sizeof(k));
+		if(ecdh_public_key(p256, k, pub) == 0) { break; }
+		memcpy(k, ecdh_p256_n, sizeof(k));
+		if(ecdh_public_key(p256, k, pub) == 0) { break; }
+
+		/* (n - 1) * G = -G, which has the same x as G. */
+		k[31]--;
+		if(ecdh_public_key(p256, k, pub) != 0) { break; }
+		if(memcmp(pub + 1, ecdh_p256_g + 1, 32) != 0) { break; }
+		if(memcmp(pub + 33, ecdh_p256_g + 33, 32) == 0) { break; }
+
+		if(ecdh_test_agree(p256) != 0) { break; }
+
+		/* Success. */
+		rc = 0;
+
+	} while(0);
+
+	ecdh_curve_delete(p256);
+	ecdh_curve_delete(x25519);
+
+	printf("%s(): %s.\n", __func__, (rc == 0) ? "PASS" : "FAIL");
+	return rc;
+}
+#endif /* TEST */
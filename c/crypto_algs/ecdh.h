@@ -0,0 +1,73 @@
+#pragma once
+
+/*******************************************************************************
+ *
+ * External definition of ecdh.c.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+
+/* The curves. */
+typedef enum {
+	ECDH_X25519,
+	ECDH_P256
+} ecdh_curve_id;
+
+/* Sizes (in bytes) of a private key, a shared secret, and the biggest public
+ * key.  An X25519 public key is 32 bytes, and a P-256 one is 65. */
+#define ECDH_PRIVATE_BYTES (32)
+#define ECDH_SECRET_BYTES (32)
+#define ECDH_MAX_PUBLIC_BYTES (65)
+
+typedef struct ecdh_curve ecdh_curve;
+
+/*******************************************************************************
+ * Create a curve.  Returns 0 if failure.  A curve is read-only, so threads can
+ * share it.
+ ******************************************************************************/
+ecdh_curve *ecdh_curve_new(ecdh_curve_id id);
+
+/*******************************************************************************
+ * Delete a curve.
+ ******************************************************************************/
+void ecdh_curve_delete(ecdh_curve *this);
+
+/*******************************************************************************
+ * Get the size of a public key (in bytes).
+ ******************************************************************************/
+int ecdh_public_bytes(const ecdh_curve *this);
+
+/*******************************************************************************
+ * Generate a random private key and its public key, calculate the public key
+ * for a private key, and calculate the shared secret from our private key and
+ * the peer's public key.  All of them return 0 if success.
+ ******************************************************************************/
+int ecdh_generate_key(const ecdh_curve *curve, uint8_t *private_key, uint8_t *public_key);
+int ecdh_public_key(const ecdh_curve *curve, const uint8_t *private_key, uint8_t *public_key);
+int ecdh_compute_secret(const ecdh_curve *curve, const uint8_t *private_key, const uint8_t *peer_public,
+                        uint8_t *secret);
+
+/*******************************************************************************
+ * The X25519 function from RFC 7748.  out = scalar * u.  All 3 are 32 bytes,
+ * least significant byte first.
+ ******************************************************************************/
+void ecdh_x25519(uint8_t *out, const uint8_t *scalar, const uint8_t *u);
+
+/*******************************************************************************
+ * Send and receive a public key over a socket.  The wire format is a 4-byte
+ * big-endian length, followed by the key.  Both return 0 if success.
+ ******************************************************************************/
+int ecdh_write_value(int fd, const ecdh_curve *curve, const uint8_t *value);
+int ecdh_read_value(int fd, const ecdh_curve *curve, uint8_t *value);
+
+/*******************************************************************************
+ * Do one key agreement over a connected socket.  Both sides call this.  Returns
+ * 0 if success.
+ ******************************************************************************/
+int ecdh_handshake(int fd, const ecdh_curve *curve, uint8_t *secret);
+
+/*******************************************************************************
+ * Test the ecdh.c ADT.
+ ******************************************************************************/
+int ecdh_test(void);
@@ -1,12 +1,26 @@
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "mod_gen.h"
 #include "prime_factors.h"
 
+/* "test -batch [threads] [curves]" factors the numbers on stdin.  Anything
+ * else runs the tests. */
 int main(int argc, char **argv)
 {
-	mod_gen_test();
-	prime_factors_test();
+	if((argc > 1) && (strcmp(argv[1], "-batch") == 0)) {
+		int nthreads = (argc > 2) ? atoi(argv[2]) : 4;
+		int curves = (argc > 3) ? atoi(argv[3]) : 200;
+		return prime_factors_batch(stdin, stdout, nthreads, curves);
+	}
+
+	int rc = mod_gen_test();
+	if(rc == 0) {
+		rc = prime_factors_test();
+	}
+
+	return rc;
 }
 
@@ -1,124 +1,560 @@
+
 /*******************************************************************************
  *
  * This module tests a generator and modulus to see how well they will work
  * together in a Diffie Hellman exchange.  Each ((gen ^ x) % mod) must result
  * in a different value between 0 and (mod - 1).
  *
+ * That's true exactly when gen is a primitive root of the (prime) modulus,
+ * and there's a fast way to check for that.  The order of gen divides
+ * (mod - 1), so if it isn't (mod - 1), it divides ((mod - 1) / q) for one of
+ * the prime factors q of (mod - 1).  So gen is a generator if
+ * (gen ^ ((mod - 1) / q)) != 1 for every q.
+ *
+ * - mod_gen_new() factors (mod - 1) once (prime_factors.c), and keeps the
+ *   exponents.
+ *
+ * - mod_gen_is_generator() is then one modular exponentiation per distinct
+ *   prime factor, with 128-bit products.  A safe prime (2q + 1) needs 2.
+ *
+ * - mod_gen_search() checks a range of candidates over a pool of threads.
+ *
+ * - mod_gen_is_generator_big() does the same for big_number moduli, like the
+ *   RFC 3526 groups.
+ *
+ * The old test (raise gen to every power, and check that no value repeats) is
+ * still here (mod_gen_brute_force()) to check the fast one against.
+ *
  ******************************************************************************/
 
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "mod_gen.h"
+#include "prime_factors.h"
+#include "prime_numbers.h"
+
+/* The number of candidates a search thread takes at a time. */
+#define SEARCH_CHUNK 1024
+
+/*******************************************************************************
+ ******************************* CLASS DEFINITION ******************************
+ ******************************************************************************/
+
+struct mod_gen {
+	uint64_t p;
+
+	/* ((p - 1) / q) for each distinct prime factor q of (p - 1).  A 64-bit
+	 * number never has more than 15. */
+	int count;
+	uint64_t exp[15];
+};
+
+/* The state shared by the mod_gen_search() threads.  next_chunk is taken with
+ * the atomic builtins.  found and count are protected by mutex. */
+typedef struct mod_gen_search_state {
+	const mod_gen *mod;
+
+	/* The range, [start, end), in chunks of SEARCH_CHUNK. */
+	uint64_t start;
+	uint64_t end;
+	uint64_t chunks;
+	uint64_t next_chunk;
+
+	pthread_mutex_t mutex;
+	uint64_t *found;
+	int count;
+	int max;
+} mod_gen_search_state;
+
+/********************************* PRIVATE API ********************************/
+
+/*******************************************************************************
+ * Modular exponentiation.  result = (base ^ exp) % mod.  The products are 128
+ * bits, so nothing overflows.
+ ******************************************************************************/
+static uint64_t mod_gen_pow(uint64_t base, uint64_t exp, uint64_t mod)
+{
+	uint64_t result = 1 % mod;
+
+	base %= mod;
+	while(exp != 0) {
+		if(exp & 1) {
+			result = (uint64_t) (((unsigned __int128) result * base) % mod);
+		}
+		base = (uint64_t) (((unsigned __int128) base * base) % mod);
+		exp >>= 1;
+	}
 
-typedef uint64_t mod_t;
-typedef uint64_t gen_t;
-typedef uint64_t exp_t;
-typedef uint64_t res_t;
+	return result;
+}
 
 /*******************************************************************************
+ * A search thread.  Take chunks of candidates until the range runs out, or
+ * until the next chunk starts past the largest generator that's still wanted.
+ ******************************************************************************/
+static void *mod_gen_search_thread(void *arg)
+{
+	mod_gen_search_state *this = (mod_gen_search_state *) arg;
+	uint64_t local[SEARCH_CHUNK];
+
+	while(1) {
+		uint64_t chunk = __atomic_fetch_add(&this->next_chunk, 1, __ATOMIC_RELAXED);
+		if(chunk >= this->chunks) {
+			break;
+		}
+		uint64_t lo = this->start + (chunk * SEARCH_CHUNK);
+		uint64_t hi = ((this->end - lo) < SEARCH_CHUNK) ? this->end : lo + SEARCH_CHUNK;
+
+		/* The chunks are taken in order, so once this one is too far out,
+		 * so is every one after it. */
+		pthread_mutex_lock(&this->mutex);
+		int done = (this->count == this->max) && (lo > this->found[this->max - 1]);
+		pthread_mutex_unlock(&this->mutex);
+		if(done) {
+			break;
+		}
+
+		/* Only the smallest max in a chunk can make the list. */
+		int n = 0;
+		uint64_t g;
+		for(g = lo; (g < hi) && (n < this->max); g++) {
+			if(mod_gen_is_generator(this->mod, g)) {
+				local[n++] = g;
+			}
+		}
+
+		/* Merge them in, keeping the smallest max. */
+		pthread_mutex_lock(&this->mutex);
+		int i;
+		for(i = 0; i < n; i++) {
+			if((this->count == this->max) && (local[i] > this->found[this->max - 1])) {
+				break;
+			}
+
+			int pos = this->count;
+			while((pos > 0) && (this->found[pos - 1] > local[i])) {
+				pos--;
+			}
+			int move = ((this->count == this->max) ? this->max - 1 : this->count) - pos;
+			memmove(&this->found[pos + 1], &this->found[pos], move * sizeof(this->found[0]));
+			this->found[pos] = local[i];
+			if(this->count < this->max) {
+				this->count++;
+			}
+		}
+		pthread_mutex_unlock(&this->mutex);
+	}
+
+	return (void *) 0;
+}
+
+/*******************************************************************************
+ * The original test.  Raise g to every power from 0 to (p - 2), and check that
+ * no value repeats.  It's O(p), so it's only used to check the fast one.
  *
- * Do a really simple exponentiation.
+ * Output:
+ *   Returns 1 if g is a generator, 0 if it isn't, and -1 if error.
+ ******************************************************************************/
+static int mod_gen_brute_force(uint64_t p, uint64_t g)
+{
+	uint8_t *list = (uint8_t *) calloc(p, 1);
+	if(list == (uint8_t *) 0) {
+		printf("Unable to allocate buffer.\n");
+		return -1;
+	}
+
+	int rc = 1;
+	uint64_t res = 1;
+	uint64_t i;
+	for(i = 0; (rc == 1) && (i < (p - 1)); i++) {
+		if((res == 0) || (list[res] != 0)) {
+			rc = 0;
+		}
+		list[res] = 1;
+		res = (uint64_t) (((unsigned __int128) res * g) % p);
+	}
+
+	free(list);
+	return rc;
+}
+
+/********************************** PUBLIC API ********************************/
+
+/*******************************************************************************
+ * Prepare a prime modulus.
+ *
+ * Input:
+ *   p - The modulus.  It has to be a prime >= 3.
  *
+ * Output:
+ *   Success - A pointer to the object.  Delete it with mod_gen_delete().
+ *   Failure - 0 (p isn't an odd prime, or out of memory).
  ******************************************************************************/
-static res_t do_exponentiation(gen_t base, exp_t exp)
+mod_gen *mod_gen_new(uint64_t p)
 {
-	res_t result = 1;
+	prime_factors_u64 factors;
+	if((p < 3) || (prime_factors_factor_u64(p, &factors) != 0) || (factors.count != 1) || (factors.power[0] != 1)) {
+		return (mod_gen *) 0;
+	}
+	if(prime_factors_factor_u64(p - 1, &factors) != 0) {
+		return (mod_gen *) 0;
+	}
 
-	//printf("%jd ^ %jd = ", base, exp);
-	while(exp-- > 0)
-	{
-		result *= base;
+	mod_gen *this = (mod_gen *) malloc(sizeof(*this));
+	if(this != (mod_gen *) 0) {
+		this->p = p;
+		this->count = factors.count;
+		int i;
+		for(i = 0; i < factors.count; i++) {
+			this->exp[i] = (p - 1) / factors.prime[i];
+		}
 	}
-	//printf("%ju\n", result);
 
-	return result;
+	return this;
+}
+
+/*******************************************************************************
+ * Delete a mod_gen object.
+ ******************************************************************************/
+void mod_gen_delete(mod_gen *this)
+{
+	free(this);
 }
 
 /*******************************************************************************
+ * Check a generator.
+ *
+ * Input:
+ *   this - The modulus, from mod_gen_new().
+ *   g    - The generator.  It's taken mod p.
  *
+ * Output:
+ *   Returns 1 if ((g ^ x) % p) is different for every x from 0 to (p - 2).
+ *   Returns 0 if it isn't (or this is 0).
  ******************************************************************************/
-int mod_gen_test(void)
+int mod_gen_is_generator(const mod_gen *this, uint64_t g)
+{
+	if((this == (mod_gen *) 0) || ((g % this->p) == 0)) {
+		return 0;
+	}
+
+	int i;
+	for(i = 0; i < this->count; i++) {
+		if(mod_gen_pow(g, this->exp[i], this->p) == 1) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*******************************************************************************
+ * Find the smallest generators in a range.  The range is split into chunks,
+ * and the threads take them in order from a shared counter.  A thread stops
+ * once the range runs out, or once max generators have been found that are
+ * all below its next chunk.
+ *
+ * Input:
+ *   this       - The modulus, from mod_gen_new().
+ *   start      - The first candidate.
+ *   end        - The end of the range (not included).  It's cut down to p.
+ *   nthreads   - Number of threads.
+ *   generators - Receives the generators, in increasing order.
+ *   max        - The most generators to find.
+ *
+ * Output:
+ *   Success - The number of generators found (0 to max).
+ *   Failure - -1 (bad arguments, or out of memory).
+ ******************************************************************************/
+int mod_gen_search(const mod_gen *this, uint64_t start, uint64_t end, int nthreads, uint64_t *generators, int max)
 {
-	printf("Testing generator and modulus.\n");
+	if((this == (mod_gen *) 0) || (nthreads < 1) || (generators == (uint64_t *) 0) || (max < 1)) {
+		return -1;
+	}
 
-	int rc = 0;
+	if(start < 2) {
+		start = 2;
+	}
+	if(end > this->p) {
+		end = this->p;
+	}
+	if(start >= end) {
+		return 0;
+	}
+
+	mod_gen_search_state state;
+	memset(&state, 0, sizeof(state));
+	state.mod = this;
+	state.start = start;
+	state.end = end;
+	state.chunks = ((end - start) / SEARCH_CHUNK) + (((end - start) % SEARCH_CHUNK) != 0);
+	state.found = generators;
+	state.max = max;
 
-	typedef struct test_data {
-		mod_t mod;
-		gen_t gen;
-	} test_data;
-	test_data tests[] = {
-		{ 19,  3 },
-		{ 11,  7 },
-		{ 23, 13 }
-	};
-	int num_tests = sizeof(tests) / sizeof(test_data);
+	if(nthreads > state.chunks) {
+		nthreads = (int) state.chunks;
+	}
+	pthread_t *threads = (pthread_t *) malloc(nthreads * sizeof(*threads));
+	if(threads == (pthread_t *) 0) {
+		return -1;
+	}
 
+	pthread_mutex_init(&state.mutex, NULL);
+
+	/* The calling thread is one of the threads. */
+	int started;
+	for(started = 1; started < nthreads; started++) {
+		if(pthread_create(&threads[started], NULL, mod_gen_search_thread, &state) != 0) {
+			break;
+		}
+	}
+	mod_gen_search_thread(&state);
 	int i;
-	for(i = 0; i < num_tests; i++)
-	{
-		mod_t mod = tests[i].mod;
-		gen_t gen = tests[i].gen;
-		printf("Testing Mod %jd and gen %jd.\n", mod, gen);
-
-		int list_size = (sizeof(gen) * mod);
-		res_t *list = (res_t *) malloc(list_size);
-		if(list == (res_t *) 0)
-		{
-			printf("Unable to allocate buffer.\n");
-			rc = 1;
-		}
-		memset(list, 0, list_size);
-
-		if(rc == 0)
-		{
-			exp_t i;
-			for(i = 0; (rc == 0) && (i < mod); i++)
-			{
-				res_t res = do_exponentiation(gen, i) % mod;
-				//printf("%jd ^ %jd mod %jd = %jd\n", gen, i, mod, res);
-				if(res >= mod)
-				{
-					printf("Result looks weird.\n");
-					rc = 2;
-				}
-				else if(list[res] != 0)
-				{
-					printf("Multiple exponents got the same result (%jd vs %jd).\n", list[res], i);
-					rc = 3;
-				}
-				else
-				{
-					list[res] = i;
-				}
+	for(i = 1; i < started; i++) {
+		pthread_join(threads[i], (void **) 0);
+	}
+
+	pthread_mutex_destroy(&state.mutex);
+	free(threads);
+	return state.count;
+}
+
+/*******************************************************************************
+ * Check a generator for a big prime modulus.
+ *
+ * Input:
+ *   p          - The modulus.  It has to be an odd prime.
+ *   g          - The generator.  It's taken mod p.
+ *   ecm_curves - Passed to prime_factors_factor_big() to factor (p - 1).
+ *                For a safe prime, 0 is enough.
+ *
+ * Output:
+ *   Returns 1 if g is a generator.
+ *   Returns 0 if it isn't.
+ *   Returns -1 if p isn't an odd prime, (p - 1) couldn't be factored, or out
+ *   of memory.
+ ******************************************************************************/
+int mod_gen_is_generator_big(const big_number *p, const big_number *g, int ecm_curves)
+{
+	if((p == (big_number *) 0) || (g == (big_number *) 0) || (big_number_modulus_u64(p, 2) == 0) ||
+	   (prime_numbers_is_probable_prime(p) != 1)) {
+		return -1;
+	}
+
+	big_number *p_1 = big_number_new();
+	big_number *base = big_number_new();
+	big_number *exp = big_number_new();
+	big_number *result = big_number_new();
+	big_number_mont *mont = big_number_mont_new(p);
+	prime_factors_big *factors = (prime_factors_big *) 0;
+
+	int rc = -1;
+	if((p_1 != (big_number *) 0) && (base != (big_number *) 0) && (exp != (big_number *) 0) &&
+	   (result != (big_number *) 0) && (mont != (big_number_mont *) 0)) {
+		big_number_subtract(p, big_number_1(), p_1);
+		factors = prime_factors_factor_big(p_1, ecm_curves);
+		big_number_modulus(g, p, base);
+		if(big_number_is_negative(base)) {
+			big_number_add_to(base, p);
+		}
+
+		if(factors != (prime_factors_big *) 0) {
+			rc = big_number_is_zero(base) ? 0 : 1;
+		}
+
+		int i;
+		for(i = 0; (rc == 1) && (i < prime_factors_big_count(factors)); i++) {
+			int is_prime;
+			const big_number *q = prime_factors_big_factor(factors, i, (int *) 0, &is_prime);
+			if(is_prime == 0) {
+				rc = -1;
+				break;
 			}
+
+			big_number_divide(p_1, q, exp);
+			big_number_mont_exp(mont, base, exp, result);
+			if(big_number_compare(result, big_number_1()) == 0) {
+				rc = 0;
+			}
+		}
+	}
+
+	prime_factors_big_delete(factors);
+	big_number_mont_delete(mont);
+	big_number_delete(result);
+	big_number_delete(exp);
+	big_number_delete(base);
+	big_number_delete(p_1);
+	return rc;
+}
+
+/*******************************************************************************
+ * Run the mod_gen tests.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1.
+ ******************************************************************************/
+int mod_gen_test(void)
+{
+	printf("%s(): Starting\n", __func__);
+	int rc = 1;
+
+	mod_gen *mod = (mod_gen *) 0;
+	big_number *p = big_number_new();
+	big_number *g = big_number_new();
+
+	do {
+		if((p == (big_number *) 0) || (g == (big_number *) 0)) {
+			break;
+		}
+
+		/* The original tests.  13 has order 11 mod 23. */
+		typedef struct test_data {
+			uint64_t mod;
+			uint64_t gen;
+			int is_generator;
+		} test_data;
+		test_data tests[] = {
+			{ 19,  3, 1 },
+			{ 11,  7, 1 },
+			{ 23, 13, 0 }
+		};
+		int num_tests = sizeof(tests) / sizeof(test_data);
+
+		int i;
+		for(i = 0; i < num_tests; i++) {
+			mod = mod_gen_new(tests[i].mod);
+			if((mod == (mod_gen *) 0) || (mod_gen_is_generator(mod, tests[i].gen) != tests[i].is_generator)) {
+				break;
+			}
+			mod_gen_delete(mod);
+			mod = (mod_gen *) 0;
+		}
+		if(i != num_tests) {
+			printf("%s(): Mod %ju and gen %ju failed.\n", __func__, tests[i].mod, tests[i].gen);
+			break;
 		}
 
-		if(rc == 0)
-		{
-			int i;
-			for(i = 0; i < mod; i++)
-			{
-				int x;
-				for(x = 0; x < mod; x++)
-				{
-					if(list[x] == i)
-					{
-						break;
-					}
+		/* Only odd primes are allowed. */
+		if((mod_gen_new(0) != (mod_gen *) 0) || (mod_gen_new(2) != (mod_gen *) 0) ||
+		   (mod_gen_new(91) != (mod_gen *) 0)) {
+			break;
+		}
+
+		/* Every generator of every prime below 500 agrees with the brute
+		 * force test. */
+		uint64_t m;
+		int failed = 0;
+		for(m = 3; (m < 500) && (failed == 0); m += 2) {
+			mod = mod_gen_new(m);
+			if(mod == (mod_gen *) 0) {
+				continue;
+			}
+			uint64_t gen;
+			for(gen = 0; (gen < m) && (failed == 0); gen++) {
+				if(mod_gen_is_generator(mod, gen) != mod_gen_brute_force(m, gen)) {
+					printf("%s(): Mod %ju and gen %ju disagree.\n", __func__, m, gen);
+					failed = 1;
 				}
+			}
+			mod_gen_delete(mod);
+			mod = (mod_gen *) 0;
+		}
+		if(failed != 0) { break; }
 
-				printf("%3d = (%3jd ^ %3jd) mod %3jd :: %3d = (%3jd ^ %3jd) mod %3jd\n",
-				       i, gen, list[i], mod,
-				       x, gen, list[x], mod);
+		/* The largest 64-bit safe prime.  Its smallest generators are 2, 5,
+		 * 6, 8, 14, 15, ... */
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		mod = mod_gen_new(18446744073709550147ULL);
+		uint64_t found[4096];
+		int count = mod_gen_search(mod, 0, 16, 1, found, 6);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		static const uint64_t expected[] = { 2, 5, 6, 8, 14, 15 };
+		if((count != 6) || (memcmp(found, expected, sizeof(expected)) != 0)) {
+			printf("%s(): Safe prime search failed.\n", __func__);
+			break;
+		}
+		printf("%s(): 64-bit safe prime, first 6 generators: %.1f usec.\n", __func__,
+		       (((end.tv_sec - start.tv_sec) * 1e9) + (end.tv_nsec - start.tv_nsec)) / 1000.0);
+
+		/* The threads find the same ones.  The range doesn't line up with the
+		 * chunks, and the list fills up partway through. */
+		uint64_t found4[4096];
+		count = mod_gen_search(mod, 1000, 100000, 1, found, 4096);
+		if((count != 4096) || (mod_gen_search(mod, 1000, 100000, 4, found4, 4096) != 4096) ||
+		   (memcmp(found, found4, sizeof(found)) != 0)) {
+			printf("%s(): Threaded search failed.\n", __func__);
+			break;
+		}
+		for(i = 0; i < count; i++) {
+			if((found[i] < 1000) || ((i > 0) && (found[i] <= found[i - 1])) || !mod_gen_is_generator(mod, found[i])) {
+				break;
 			}
 		}
-	}
+		if(i != count) { break; }
+		mod_gen_delete(mod);
+		mod = (mod_gen *) 0;
+
+		/* A whole (small) group, with more room than there are generators.
+		 * 10007 - 1 = 2 * 5003, so there are 5002 generators. */
+		mod = mod_gen_new(10007);
+		if((mod_gen_search(mod, 0, UINT64_MAX, 3, found, 4096) != 4096) ||
+		   (mod_gen_search(mod, 5000, UINT64_MAX, 3, found4, 4096) != 2541)) {
+			break;
+		}
+		mod_gen_delete(mod);
+		mod = (mod_gen *) 0;
+
+		/* The RFC 3526 2048-bit group.  2 is a square mod p, so it only
+		 * generates the subgroup of order (p - 1) / 2 (which is what DH
+		 * uses).  11 generates the whole group. */
+		if(big_number_from_str(p,
+			"0x"
+			"FFFFFFFFFFFFFFFFC90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74"
+			"020BBEA63B139B22514A08798E3404DDEF9519B3CD3A431B302B0A6DF25F1437"
+			"4FE1356D6D51C245E485B576625E7EC6F44C42E9A637ED6B0BFF5CB6F406B7ED"
+			"EE386BFB5A899FA5AE9F24117C4B1FE649286651ECE45B3DC2007CB8A163BF05"
+			"98DA48361C55D39A69163FA8FD24CF5F83655D23DCA3AD961C62F356208552BB"
+			"9ED529077096966D670C354E4ABC9804F1746C08CA18217C32905E462E36CE3B"
+			"E39E772C180E86039B2783A2EC07A28FB5C55DF06F4C52C9DE2BCBF695581718"
+			"3995497CEA956AE515D2261898FA051015728E5A8AACAA68FFFFFFFFFFFFFFFF") != 0) {
+			break;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		big_number_from_u64(g, 2);
+		int two = mod_gen_is_generator_big(p, g, 0);
+		big_number_from_u64(g, 11);
+		int eleven = mod_gen_is_generator_big(p, g, 0);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		if((two != 0) || (eleven != 1)) {
+			printf("%s(): RFC 3526 group failed (%d, %d).\n", __func__, two, eleven);
+			break;
+		}
+		printf("%s(): RFC 3526 2048-bit group, 2 checks: %.1f msec.\n", __func__,
+		       (((end.tv_sec - start.tv_sec) * 1e9) + (end.tv_nsec - start.tv_nsec)) / 1e6);
+
+		/* A composite modulus is an error. */
+		big_number_from_u64(p, 91);
+		if(mod_gen_is_generator_big(p, g, 0) != -1) { break; }
+
+		/* Complete.  Pass. */
+		rc = 0;
+
+	} while(0);
+
+	mod_gen_delete(mod);
+	big_number_delete(g);
+	big_number_delete(p);
 
+	printf("%s(): %s.\n", __func__, (rc == 0) ? "PASS" : "FAIL");
 	return rc;
 }
 
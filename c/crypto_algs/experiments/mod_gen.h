@@ -6,6 +6,42 @@
  *
  ******************************************************************************/
 
+#include <stdint.h>
+
+#include "big_number.h"
+
+/******************************* CLASS DEFINITION *****************************/
+
+/* A prime modulus, with the factors of (p - 1) worked out. */
+typedef struct mod_gen mod_gen;
+
+/********************************** PUBLIC API ********************************/
+
+/*******************************************************************************
+ * Prepare a prime modulus.  Returns 0 if p isn't a prime >= 3.
+ ******************************************************************************/
+mod_gen *mod_gen_new(uint64_t p);
+void mod_gen_delete(mod_gen *this);
+
+/*******************************************************************************
+ * Check a generator.  Returns 1 if g generates every value from 1 to (p - 1),
+ * 0 if it doesn't.
+ ******************************************************************************/
+int mod_gen_is_generator(const mod_gen *this, uint64_t g);
+
+/*******************************************************************************
+ * Find the smallest max generators in [start, end), spread over nthreads
+ * threads.  Returns the number found (in increasing order), or -1 if error.
+ ******************************************************************************/
+int mod_gen_search(const mod_gen *this, uint64_t start, uint64_t end, int nthreads, uint64_t *generators, int max);
+
+/*******************************************************************************
+ * Check a generator for a big prime modulus.  (p - 1) is factored with
+ * prime_factors_factor_big(), with up to ecm_curves ECM curves.  Returns 1 if
+ * g is a generator, 0 if it isn't, and -1 if (p - 1) couldn't be factored.
+ ******************************************************************************/
+int mod_gen_is_generator_big(const big_number *p, const big_number *g, int ecm_curves);
+
 /*******************************************************************************
  * Test the mod_gen.c ADT.
  ******************************************************************************/
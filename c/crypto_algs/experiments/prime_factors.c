@@ -1,125 +1,1592 @@
 /*******************************************************************************
  *
- * This module does a brute force attempt to find the prime factors for a
- * number.  Note that it's only used against small numbers.  It's a brute force
- * test.
+ * This module finds the prime factors of a number.
+ *
+ * 64-bit numbers:
+ *
+ * 1. Trial division by the primes below 1,024.  Each one is a multiply by the
+ *    inverse of the prime (mod 2^64) and a compare, not a divide.
+ *
+ * 2. Whatever is left is tested with Miller-Rabin, using a set of 7 bases
+ *    that has no strong pseudoprimes below 2^64, so the answer is exact.
+ *
+ * 3. Composites are split with Pollard-Brent rho.  The arithmetic is done in
+ *    Montgomery form with 128-bit products, and the gcd is taken once per 128
+ *    steps instead of once per step.  A 64-bit number never needs more than a
+ *    few thousand steps, so it takes microseconds.
+ *
+ * big_numbers:
+ *
+ * 1. Trial division by the same primes.
+ *
+ * 2. Cofactors that fit in 64 bits go through the code above.  Bigger ones
+ *    are tested with prime_numbers_is_probable_prime().
+ *
+ * 3. Composites get the elliptic curve method (Montgomery curves, Suyama's
+ *    parameters, a baby-step giant-step stage 2).  The bounds go up with the
+ *    curve count, the way GMP-ECM's table does: 25 curves at B1 = 2,000 for
+ *    factors up to about 15 digits, then 90 at 11,000 (20 digits), then
+ *    50,000 (25 digits).  A factor that doesn't split is reported as
+ *    composite.
+ *
+ * prime_factors_batch() factors a stream of numbers (one per line), spread
+ * over a number of threads.
+ *
+ * The old brute force search is still here (prime_factors_brute_force()) to
+ * check the fast one against.
  *
  ******************************************************************************/
 
+#include <errno.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "prime_factors.h"
+#include "prime_numbers.h"
+
+/* Trial division goes up to (but not including) this. */
+#define TRIAL_LIMIT 1024
+
+/* Pollard-Brent takes the gcd once per this many steps. */
+#define RHO_BATCH 128
+
+/* The ECM schedule.  {curves, B1}.  B2 is (100 * B1).  The last entry is used
+ * for every curve after the others run out. */
+static const int ecm_schedule[][2] = {
+	{  25,  2000 },
+	{  90, 11000 },
+	{   0, 50000 },
+};
+#define ECM_B2_MAX (100 * 50000)
+
+/* The giant step for ECM stage 2. */
+#define ECM_D 210
+
+/* The number of lines prime_factors_batch() reads at a time. */
+#define BATCH_LINES 4096
+
+/* The primes below TRIAL_LIMIT (not including 2), with their inverses mod
+ * 2^64.  p divides n if ((n * inv) <= ((2^64 - 1) / p)), and then (n * inv)
+ * is the quotient. */
+static int trial_count;
+static uint64_t trial_prime[TRIAL_LIMIT / 2];
+static uint64_t trial_inv[TRIAL_LIMIT / 2];
+static uint64_t trial_max[TRIAL_LIMIT / 2];
+static pthread_once_t trial_once = PTHREAD_ONCE_INIT;
+
+/* One bit per number, set if the number is prime.  Used by ECM. */
+static uint8_t *ecm_primes;
+static pthread_once_t ecm_once = PTHREAD_ONCE_INIT;
+
+/*******************************************************************************
+ ******************************* CLASS DEFINITION ******************************
+ ******************************************************************************/
+
+struct prime_factors_big {
+	int count;
+	int size;
+	big_number **factor;
+	int *power;
+	int *is_prime;
+};
+
+/* A 64-bit odd modulus prepared for Montgomery multiplication.  Values in
+ * Montgomery form are (x * 2^64) % n. */
+typedef struct mont64 {
+	uint64_t n;
+	uint64_t inv;		/* n ^ -1 (mod 2^64). */
+	uint64_t one;		/* 2^64 % n. */
+	uint64_t r2;		/* 2^128 % n. */
+} mont64;
+
+/* A point on a Montgomery curve, in (X : Z) form. */
+typedef struct ecm_point {
+	big_number *x;
+	big_number *z;
+} ecm_point;
+
+/* The number of points in an ecm object.  P, the 2 ladder points, the ladder
+ * base, the stage 2 baby steps (the odd multiples up to ECM_D / 2), and the 4
+ * stage 2 giant steps. */
+#define ECM_BABY ((ECM_D / 4) + 1)
+#define ECM_POINTS (4 + ECM_BABY + 4)
+
+/* The state for running ECM against one number. */
+typedef struct ecm {
+	const big_number *n;
+	big_number_reducer *reducer;
+
+	big_number *a24;
+	big_number *prod;
+	big_number *t[4];
+	big_number *acc;
+
+	ecm_point p;
+	ecm_point l0, l1, base;
+	ecm_point baby[ECM_BABY];
+	ecm_point giant[4];
+
+	/* Everything above, so it can be created and deleted in a loop. */
+	big_number *all[7 + (2 * ECM_POINTS)];
+} ecm;
+
+/* The state shared by the prime_factors_batch() threads.  next is taken with
+ * the atomic builtins. */
+typedef struct prime_factors_batch_state {
+	char **lines;
+	char **results;
+	int count;
+	int next;
+	int ecm_curves;
+} prime_factors_batch_state;
+
+/********************************* PRIVATE API ********************************/
 
-/* Styles of testing. */
-#undef FIXED_DATA_TEST
-#undef TIMES_TWO_TEST
-#define DISPLAY_ONLY_PRIMES
+/*******************************************************************************
+ * The prime_numbers_enumerate() callback that fills in the trial division
+ * table.
+ ******************************************************************************/
+static int prime_factors_trial_callback(uint64_t prime, void *arg)
+{
+	if(prime > 2) {
+		/* Newton's method.  Every odd number is its own inverse mod 8, and
+		 * each step doubles the number of good bits. */
+		uint64_t inv = prime;
+		int i;
+		for(i = 0; i < 5; i++) {
+			inv *= 2 - (prime * inv);
+		}
+
+		trial_prime[trial_count] = prime;
+		trial_inv[trial_count] = inv;
+		trial_max[trial_count] = UINT64_MAX / prime;
+		trial_count++;
+	}
+
+	return 0;
+}
+
+/*******************************************************************************
+ * Build the trial division table.  Called once.
+ ******************************************************************************/
+static void prime_factors_trial_init(void)
+{
+	prime_numbers_enumerate(0, TRIAL_LIMIT, 1, prime_factors_trial_callback, (void *) 0);
+}
+
+/*******************************************************************************
+ * The prime_numbers_enumerate() callback that fills in the ECM prime bitmap.
+ ******************************************************************************/
+static int prime_factors_ecm_callback(uint64_t prime, void *arg)
+{
+	ecm_primes[prime / 8] |= (uint8_t) (1 << (prime % 8));
+	return 0;
+}
+
+/*******************************************************************************
+ * Build the ECM prime bitmap.  Called once.  If it fails, ecm_primes is left
+ * at 0 and ECM isn't run.
+ ******************************************************************************/
+static void prime_factors_ecm_init(void)
+{
+	uint8_t *bitmap = (uint8_t *) calloc((ECM_B2_MAX / 8) + 1, 1);
+	if(bitmap != (uint8_t *) 0) {
+		ecm_primes = bitmap;
+		if(prime_numbers_enumerate(0, ECM_B2_MAX + 1, 1, prime_factors_ecm_callback, (void *) 0) != 0) {
+			ecm_primes = (uint8_t *) 0;
+			free(bitmap);
+		}
+	}
+}
+
+/*******************************************************************************
+ * Check the ECM prime bitmap.
+ ******************************************************************************/
+static inline int prime_factors_ecm_is_prime(uint64_t n)
+{
+	return (ecm_primes[n / 8] >> (n % 8)) & 1;
+}
 
-typedef uint64_t num_t;
+/********** 64-bit Methods */
 
 /*******************************************************************************
+ * Greatest common divisor of 2 64-bit numbers (binary gcd).
+ ******************************************************************************/
+static uint64_t prime_factors_gcd(uint64_t a, uint64_t b)
+{
+	if((a == 0) || (b == 0)) {
+		return a | b;
+	}
+
+	int shift = __builtin_ctzll(a | b);
+	a >>= __builtin_ctzll(a);
+	do {
+		b >>= __builtin_ctzll(b);
+		if(a > b) {
+			uint64_t t = a;
+			a = b;
+			b = t;
+		}
+		b -= a;
+	} while(b != 0);
+
+	return a << shift;
+}
+
+/*******************************************************************************
+ * Prepare an odd modulus for Montgomery multiplication.
+ ******************************************************************************/
+static void prime_factors_mont_init(mont64 *this, uint64_t n)
+{
+	uint64_t inv = n;
+	int i;
+	for(i = 0; i < 5; i++) {
+		inv *= 2 - (n * inv);
+	}
+
+	this->n = n;
+	this->inv = inv;
+	this->one = (0 - n) % n;
+	this->r2 = (uint64_t) (((unsigned __int128) this->one * this->one) % n);
+}
+
+/*******************************************************************************
+ * Montgomery reduction.  Returns (t / 2^64) % n, for t < (n * 2^64).  The low
+ * half of (t - (m * n)) is 0 by the choice of m, so only the high halves have
+ * to be subtracted, and nothing overflows.
+ ******************************************************************************/
+static inline uint64_t prime_factors_mont_redc(const mont64 *this, unsigned __int128 t)
+{
+	uint64_t m = (uint64_t) t * this->inv;
+	uint64_t t_hi = (uint64_t) (t >> 64);
+	uint64_t mn_hi = (uint64_t) (((unsigned __int128) m * this->n) >> 64);
+	uint64_t r = t_hi - mn_hi;
+	return (t_hi < mn_hi) ? r + this->n : r;
+}
+
+static inline uint64_t prime_factors_mont_mul(const mont64 *this, uint64_t a, uint64_t b)
+{
+	return prime_factors_mont_redc(this, (unsigned __int128) a * b);
+}
+
+static inline uint64_t prime_factors_mont_to(const mont64 *this, uint64_t a)
+{
+	return prime_factors_mont_mul(this, a % this->n, this->r2);
+}
+
+/*******************************************************************************
+ * (a + b) % n, for a and b < n.  When n > 2^63, (a + b) can overflow 64 bits,
+ * so compare a against (n - b) instead of adding first.
+ ******************************************************************************/
+static inline uint64_t prime_factors_mont_add(const mont64 *this, uint64_t a, uint64_t b)
+{
+	return (a >= (this->n - b)) ? a - (this->n - b) : a + b;
+}
+
+/*******************************************************************************
+ * Miller-Rabin for a 64-bit number.  These bases (Jim Sinclair's) have no
+ * strong pseudoprimes below 2^64, so the answer is exact.
  *
- * Look for the prime factors for the specified number.
+ * Output:
+ *   Returns 1 if n is prime, 0 if it isn't.
+ ******************************************************************************/
+static int prime_factors_is_prime_u64(uint64_t n)
+{
+	static const uint64_t bases[] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+
+	if(n < 4) {
+		return (n >= 2);
+	}
+	if((n % 2) == 0) {
+		return 0;
+	}
+
+	mont64 mont;
+	prime_factors_mont_init(&mont, n);
+	uint64_t minus_one = mont.n - mont.one;
+
+	/* n - 1 = d * 2^s. */
+	int s = __builtin_ctzll(n - 1);
+	uint64_t d = (n - 1) >> s;
+
+	int i;
+	for(i = 0; i < (sizeof(bases) / sizeof(bases[0])); i++) {
+		if((bases[i] % n) == 0) {
+			continue;
+		}
+
+		/* x = base ^ d. */
+		uint64_t base = prime_factors_mont_to(&mont, bases[i]);
+		uint64_t x = mont.one;
+		uint64_t e = d;
+		while(e != 0) {
+			if(e & 1) {
+				x = prime_factors_mont_mul(&mont, x, base);
+			}
+			base = prime_factors_mont_mul(&mont, base, base);
+			e >>= 1;
+		}
+
+		if((x == mont.one) || (x == minus_one)) {
+			continue;
+		}
+
+		int r;
+		for(r = 1; r < s; r++) {
+			x = prime_factors_mont_mul(&mont, x, x);
+			if(x == minus_one) {
+				break;
+			}
+		}
+		if(r == s) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*******************************************************************************
+ * Pollard-Brent rho, with f(y) = (y^2 + c).  n must be odd and composite.
  *
+ * Output:
+ *   Returns a factor of n.  It's n if this c didn't work.
  ******************************************************************************/
-static void prime_factors(num_t num)
+static uint64_t prime_factors_rho(uint64_t n, uint64_t c)
 {
-	num_t n = num;
-	num_t factor = 1;
-	num_t count = 0;
-	char buf[2048] = { 0 }, *b = buf;
-	size_t b_size = sizeof(buf);
+	mont64 mont;
+	prime_factors_mont_init(&mont, n);
+	c = prime_factors_mont_to(&mont, c);
+
+	uint64_t x = 0, y = mont.one, ys = y, q = mont.one;
+	uint64_t g = 1;
+	uint64_t r;
+	for(r = 1; g == 1; r *= 2) {
+		x = y;
+		uint64_t i;
+		for(i = 0; i < r; i++) {
+			y = prime_factors_mont_add(&mont, prime_factors_mont_mul(&mont, y, y), c);
+		}
+
+		/* Multiply RHO_BATCH differences together, and take one gcd.
+		 * Remember where the batch started in case it has to be redone one
+		 * step at a time. */
+		uint64_t k;
+		for(k = 0; (k < r) && (g == 1); k += RHO_BATCH) {
+			ys = y;
+			uint64_t steps = ((r - k) < RHO_BATCH) ? (r - k) : RHO_BATCH;
+			for(i = 0; i < steps; i++) {
+				y = prime_factors_mont_add(&mont, prime_factors_mont_mul(&mont, y, y), c);
+				q = prime_factors_mont_mul(&mont, q, (x > y) ? x - y : y - x);
+			}
+			g = prime_factors_gcd(q, n);
+		}
+
+		/* Give up on this c.  A 64-bit number never gets close. */
+		if(r > (1ULL << 32)) {
+			return n;
+		}
+	}
+
+	/* The batch went past the factor (or q hit 0).  Redo it one step at a
+	 * time. */
+	if(g == n) {
+		do {
+			ys = prime_factors_mont_add(&mont, prime_factors_mont_mul(&mont, ys, ys), c);
+			g = prime_factors_gcd((x > ys) ? x - ys : ys - x, n);
+		} while(g == 1);
+	}
+
+	return g;
+}
+
+/*******************************************************************************
+ * Add a prime to a prime_factors_u64, keeping them sorted.
+ ******************************************************************************/
+static void prime_factors_u64_add(prime_factors_u64 *this, uint64_t prime, int power)
+{
+	int i;
+	for(i = 0; (i < this->count) && (this->prime[i] < prime); i++) {
+	}
+
+	if((i < this->count) && (this->prime[i] == prime)) {
+		this->power[i] += power;
+		return;
+	}
+
+	memmove(&this->prime[i + 1], &this->prime[i], (this->count - i) * sizeof(this->prime[0]));
+	memmove(&this->power[i + 1], &this->power[i], (this->count - i) * sizeof(this->power[0]));
+	this->prime[i] = prime;
+	this->power[i] = power;
+	this->count++;
+}
+
+/*******************************************************************************
+ * Integer square root of a 64-bit number (floor).
+ ******************************************************************************/
+static uint64_t prime_factors_isqrt(uint64_t n)
+{
+	/* Start too high so Newton's method comes down. */
+	uint64_t x = (n < 2) ? n : (1ULL << ((65 - __builtin_clzll(n)) / 2));
+	while(1) {
+		uint64_t next = (x + (n / x)) / 2;
+		if(next >= x) {
+			return x;
+		}
+		x = next;
+	}
+}
+
+/********** big_number Methods */
+
+/*******************************************************************************
+ * Get the value of a big_number that fits in 64 bits.
+ ******************************************************************************/
+static uint64_t prime_factors_to_u64(const big_number *n)
+{
+	uint8_t buf[8];
+	uint64_t value = 0;
+
+	if(big_number_to_bytes(n, buf, sizeof(buf)) == 0) {
+		int i;
+		for(i = 0; i < sizeof(buf); i++) {
+			value = (value << 8) | buf[i];
+		}
+	}
+
+	return value;
+}
+
+/*******************************************************************************
+ * Add a factor to a prime_factors_big.  Equal factors are combined.  Takes a
+ * copy of the factor.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (out of memory).
+ ******************************************************************************/
+static int prime_factors_big_add(prime_factors_big *this, const big_number *factor, int power, int is_prime)
+{
+	int i;
+	for(i = 0; i < this->count; i++) {
+		if(big_number_compare(this->factor[i], factor) == 0) {
+			this->power[i] += power;
+			return 0;
+		}
+	}
+
+	if(this->count == this->size) {
+		int size = (this->size == 0) ? 8 : this->size * 2;
+		big_number **f = (big_number **) realloc(this->factor, size * sizeof(*f));
+		if(f != (big_number **) 0) {
+			this->factor = f;
+		}
+		int *p = (int *) realloc(this->power, size * sizeof(*p));
+		if(p != (int *) 0) {
+			this->power = p;
+		}
+		int *ip = (int *) realloc(this->is_prime, size * sizeof(*ip));
+		if(ip != (int *) 0) {
+			this->is_prime = ip;
+		}
+		if((f == (big_number **) 0) || (p == (int *) 0) || (ip == (int *) 0)) {
+			return 1;
+		}
+		this->size = size;
+	}
+
+	big_number *copy = big_number_new();
+	if(copy == (big_number *) 0) {
+		return 1;
+	}
+	big_number_copy(factor, copy);
+
+	this->factor[this->count] = copy;
+	this->power[this->count] = power;
+	this->is_prime[this->count] = is_prime;
+	this->count++;
+	return 0;
+}
+
+/*******************************************************************************
+ * Sort the factors of a prime_factors_big, smallest first.  There are never
+ * many, so it's an insertion sort.
+ ******************************************************************************/
+static void prime_factors_big_sort(prime_factors_big *this)
+{
+	int i;
+	for(i = 1; i < this->count; i++) {
+		big_number *f = this->factor[i];
+		int power = this->power[i];
+		int is_prime = this->is_prime[i];
+
+		int j;
+		for(j = i; (j > 0) && (big_number_compare(this->factor[j - 1], f) > 0); j--) {
+			this->factor[j] = this->factor[j - 1];
+			this->power[j] = this->power[j - 1];
+			this->is_prime[j] = this->is_prime[j - 1];
+		}
+		this->factor[j] = f;
+		this->power[j] = power;
+		this->is_prime[j] = is_prime;
+	}
+}
+
+/********** ECM Methods */
+
+/*******************************************************************************
+ * Modular arithmetic for ECM.  The inputs are all in [0, n).  The result can
+ * be one of the inputs.
+ ******************************************************************************/
+static void prime_factors_ecm_mul(ecm *this, const big_number *a, const big_number *b, big_number *result)
+{
+	big_number_multiply(a, b, this->prod);
+	big_number_reduce(this->reducer, this->prod, result);
+}
+
+static void prime_factors_ecm_add(ecm *this, const big_number *a, const big_number *b, big_number *result)
+{
+	big_number_add(a, b, result);
+	if(big_number_compare(result, this->n) >= 0) {
+		big_number_sub_from(result, this->n);
+	}
+}
+
+static void prime_factors_ecm_sub(ecm *this, const big_number *a, const big_number *b, big_number *result)
+{
+	big_number_subtract(a, b, result);
+	if(big_number_is_negative(result)) {
+		big_number_add_to(result, this->n);
+	}
+}
+
+/*******************************************************************************
+ * Point doubling.  result = 2 * p.  result can be p.
+ *
+ *   X2 = (X + Z)^2 * (X - Z)^2
+ *   Z2 = 4XZ * ((X - Z)^2 + a24 * 4XZ), where 4XZ = (X + Z)^2 - (X - Z)^2
+ ******************************************************************************/
+static void prime_factors_ecm_dbl(ecm *this, const ecm_point *p, ecm_point *result)
+{
+	big_number **t = this->t;
+
+	prime_factors_ecm_add(this, p->x, p->z, t[0]);
+	big_number_square(t[0], this->prod);
+	big_number_reduce(this->reducer, this->prod, t[0]);
+	prime_factors_ecm_sub(this, p->x, p->z, t[1]);
+	big_number_square(t[1], this->prod);
+	big_number_reduce(this->reducer, this->prod, t[1]);
+	prime_factors_ecm_sub(this, t[0], t[1], t[2]);
+
+	prime_factors_ecm_mul(this, t[0], t[1], result->x);
+	prime_factors_ecm_mul(this, this->a24, t[2], t[3]);
+	prime_factors_ecm_add(this, t[3], t[1], t[3]);
+	prime_factors_ecm_mul(this, t[2], t[3], result->z);
+}
+
+/*******************************************************************************
+ * Differential point addition.  result = p + q, given diff = p - q.  result
+ * can be p or q, but not diff.
+ *
+ *   U = (Xp - Zp) * (Xq + Zq)
+ *   V = (Xp + Zp) * (Xq - Zq)
+ *   X = Zdiff * (U + V)^2
+ *   Z = Xdiff * (U - V)^2
+ ******************************************************************************/
+static void prime_factors_ecm_add_points(ecm *this, const ecm_point *p, const ecm_point *q, const ecm_point *diff,
+                                         ecm_point *result)
+{
+	big_number **t = this->t;
+
+	prime_factors_ecm_sub(this, p->x, p->z, t[0]);
+	prime_factors_ecm_add(this, q->x, q->z, t[1]);
+	prime_factors_ecm_mul(this, t[0], t[1], t[0]);
+	prime_factors_ecm_add(this, p->x, p->z, t[1]);
+	prime_factors_ecm_sub(this, q->x, q->z, t[2]);
+	prime_factors_ecm_mul(this, t[1], t[2], t[1]);
+
+	prime_factors_ecm_add(this, t[0], t[1], t[2]);
+	prime_factors_ecm_sub(this, t[0], t[1], t[3]);
+	big_number_square(t[2], this->prod);
+	big_number_reduce(this->reducer, this->prod, t[2]);
+	big_number_square(t[3], this->prod);
+	big_number_reduce(this->reducer, this->prod, t[3]);
+
+	prime_factors_ecm_mul(this, diff->z, t[2], result->x);
+	prime_factors_ecm_mul(this, diff->x, t[3], result->z);
+}
+
+/*******************************************************************************
+ * Montgomery ladder.  result = k * p, for k >= 1.  result can be p.
+ ******************************************************************************/
+static void prime_factors_ecm_ladder(ecm *this, const ecm_point *p, uint64_t k, ecm_point *result)
+{
+	big_number_copy(p->x, this->base.x);
+	big_number_copy(p->z, this->base.z);
+
+	/* l1 - l0 is always base. */
+	big_number_copy(p->x, this->l0.x);
+	big_number_copy(p->z, this->l0.z);
+	prime_factors_ecm_dbl(this, &this->base, &this->l1);
+
+	int bit;
+	for(bit = 62 - __builtin_clzll(k); bit >= 0; bit--) {
+		if((k >> bit) & 1) {
+			prime_factors_ecm_add_points(this, &this->l0, &this->l1, &this->base, &this->l0);
+			prime_factors_ecm_dbl(this, &this->l1, &this->l1);
+		}
+		else {
+			prime_factors_ecm_add_points(this, &this->l0, &this->l1, &this->base, &this->l1);
+			prime_factors_ecm_dbl(this, &this->l0, &this->l0);
+		}
+	}
+
+	big_number_copy(this->l0.x, result->x);
+	big_number_copy(this->l0.z, result->z);
+}
+
+/*******************************************************************************
+ * Check a value for a factor of n.
+ *
+ * Output:
+ *   Returns 1 (and the factor) if (1 < gcd(value, n) < n).  Otherwise 0.
+ ******************************************************************************/
+static int prime_factors_ecm_check(ecm *this, const big_number *value, big_number *factor)
+{
+	big_number_gcd(value, this->n, factor);
+	return (big_number_compare(factor, big_number_1()) > 0) && (big_number_compare(factor, this->n) < 0);
+}
+
+/*******************************************************************************
+ * Set up a curve and its starting point from Suyama's parameterization:
+ *
+ *   u = sigma^2 - 5, v = 4 * sigma
+ *   P = (u^3 : v^3)
+ *   a24 = (v - u)^3 * (3u + v) / (16 * u^3 * v)
+ *
+ * Output:
+ *   Returns 0 if the curve is ready, 1 if the inverse doesn't exist (and the
+ *   gcd found a factor), and 2 if it doesn't exist and there's no factor.
+ ******************************************************************************/
+static int prime_factors_ecm_curve(ecm *this, uint64_t sigma, big_number *factor)
+{
+	big_number **t = this->t;
+	big_number *u = this->acc;
+	big_number *v = this->p.x;
+
+	/* t[3] is a small constant. */
+	big_number_from_u64(t[3], sigma);
+	prime_factors_ecm_mul(this, t[3], t[3], u);
+	big_number_from_u64(t[3], 5);
+	prime_factors_ecm_sub(this, u, t[3], u);
+	big_number_from_u64(t[3], 4 * sigma);
+	big_number_modulus(t[3], this->n, v);
+
+	/* t[0] = u^3, t[1] = (v - u)^3, t[2] = (3u + v). */
+	prime_factors_ecm_mul(this, u, u, t[0]);
+	prime_factors_ecm_mul(this, t[0], u, t[0]);
+	prime_factors_ecm_sub(this, v, u, t[1]);
+	prime_factors_ecm_mul(this, t[1], t[1], t[2]);
+	prime_factors_ecm_mul(this, t[1], t[2], t[1]);
+	prime_factors_ecm_add(this, u, u, t[2]);
+	prime_factors_ecm_add(this, t[2], u, t[2]);
+	prime_factors_ecm_add(this, t[2], v, t[2]);
 
-	snprintf(b, b_size, "%20jd:", num); b_size -= strlen(b); b += strlen(b);
-	clock_t start_time = clock();
+	/* a24 = t[1] * t[2] / (16 * t[0] * v). */
+	prime_factors_ecm_mul(this, t[1], t[2], this->a24);
+	prime_factors_ecm_mul(this, t[0], v, t[1]);
+	big_number_from_u64(t[3], 16);
+	prime_factors_ecm_mul(this, t[1], t[3], t[1]);
+	if(big_number_mod_inverse(t[1], this->n, t[2]) != 0) {
+		return prime_factors_ecm_check(this, t[1], factor) ? 1 : 2;
+	}
+	prime_factors_ecm_mul(this, this->a24, t[2], this->a24);
+
+	/* P = (u^3 : v^3).  v is p.x, so do z first. */
+	prime_factors_ecm_mul(this, v, v, this->p.z);
+	prime_factors_ecm_mul(this, this->p.z, v, this->p.z);
+	big_number_copy(t[0], this->p.x);
+
+	return 0;
+}
+
+/*******************************************************************************
+ * Stage 2.  Look for a prime q in (B1, B2] with q * P = O (mod a factor).
+ * Write q as (m * ECM_D) +/- j, with j relatively prime to ECM_D.  Then q * P
+ * = O means (m * D) * P = (+/-j) * P, and both have the same X / Z, so
+ * (Xm * Zj - Xj * Zm) has the factor.  All of those get multiplied together
+ * and checked with one gcd.
+ ******************************************************************************/
+static int prime_factors_ecm_stage2(ecm *this, uint64_t b1, uint64_t b2, big_number *factor)
+{
+	big_number **t = this->t;
+	ecm_point *baby = this->baby;
+
+	/* baby[i] = (2i + 1) * P. */
+	big_number_copy(this->p.x, baby[0].x);
+	big_number_copy(this->p.z, baby[0].z);
+	prime_factors_ecm_dbl(this, &this->p, &this->giant[3]);
+	prime_factors_ecm_add_points(this, &this->giant[3], &baby[0], &baby[0], &baby[1]);
+	int i;
+	for(i = 2; i < ECM_BABY; i++) {
+		prime_factors_ecm_add_points(this, &baby[i - 1], &this->giant[3], &baby[i - 2], &baby[i]);
+	}
+
+	/* giant[2] = D * P, giant[0] = m * D * P, giant[1] = (m + 1) * D * P. */
+	uint64_t m = b1 / ECM_D;
+	if(m == 0) {
+		m = 1;
+	}
+	ecm_point *step = &this->giant[2];
+	ecm_point *cur = &this->giant[0];
+	ecm_point *next = &this->giant[1];
+	ecm_point *spare = &this->giant[3];
+	prime_factors_ecm_ladder(this, &this->p, ECM_D, step);
+	prime_factors_ecm_ladder(this, step, m, cur);
+	prime_factors_ecm_ladder(this, step, m + 1, next);
+
+	big_number_copy(big_number_1(), this->acc);
+	for(; ((m * ECM_D) - (ECM_D / 2)) <= b2; m++) {
+		uint64_t center = m * ECM_D;
+		for(i = 0; i < ECM_BABY; i++) {
+			uint64_t j = (2 * i) + 1;
+			if(prime_factors_gcd(j, ECM_D) != 1) {
+				continue;
+			}
+
+			uint64_t lo = center - j, hi = center + j;
+			if(!(((lo > b1) && (lo <= b2) && prime_factors_ecm_is_prime(lo)) ||
+			     ((hi > b1) && (hi <= b2) && prime_factors_ecm_is_prime(hi)))) {
+				continue;
+			}
+
+			prime_factors_ecm_mul(this, cur->x, baby[i].z, t[0]);
+			prime_factors_ecm_mul(this, baby[i].x, cur->z, t[1]);
+			prime_factors_ecm_sub(this, t[0], t[1], t[0]);
+			prime_factors_ecm_mul(this, this->acc, t[0], this->acc);
+		}
+
+		/* (m + 2) * D * P = next + step, and next - step = cur. */
+		prime_factors_ecm_add_points(this, next, step, cur, spare);
+		ecm_point *old = cur;
+		cur = next;
+		next = spare;
+		spare = old;
+	}
+
+	return prime_factors_ecm_check(this, this->acc, factor);
+}
+
+/*******************************************************************************
+ * Look for a factor of n with ECM.  n must be odd and composite, with no
+ * factors below TRIAL_LIMIT.
+ *
+ * Output:
+ *   Success - 0 (factor receives a factor of n, 1 < factor < n).
+ *   Failure - 1 (no factor was found, or out of memory).
+ ******************************************************************************/
+static int prime_factors_ecm(const big_number *n, int curves, big_number *factor)
+{
+	pthread_once(&ecm_once, prime_factors_ecm_init);
+	if((curves <= 0) || (ecm_primes == (uint8_t *) 0)) {
+		return 1;
+	}
+
+	ecm this;
+	memset(&this, 0, sizeof(this));
+	this.n = n;
+	this.reducer = big_number_reducer_new(n);
+
+	int count = sizeof(this.all) / sizeof(this.all[0]);
+	int i;
+	for(i = 0; i < count; i++) {
+		this.all[i] = big_number_new();
+		if(this.all[i] == (big_number *) 0) {
+			break;
+		}
+	}
+
+	int rc = 1;
+	if((this.reducer != (big_number_reducer *) 0) && (i == count)) {
+		big_number **all = this.all;
+		this.a24 = *(all++);
+		this.prod = *(all++);
+		this.acc = *(all++);
+		for(i = 0; i < 4; i++) {
+			this.t[i] = *(all++);
+		}
+		ecm_point *points[ECM_POINTS] = { &this.p, &this.l0, &this.l1, &this.base };
+		for(i = 0; i < ECM_BABY; i++) {
+			points[4 + i] = &this.baby[i];
+		}
+		for(i = 0; i < 4; i++) {
+			points[4 + ECM_BABY + i] = &this.giant[i];
+		}
+		for(i = 0; i < ECM_POINTS; i++) {
+			points[i]->x = *(all++);
+			points[i]->z = *(all++);
+		}
+
+		/* Curve c gets sigma (c + 6).  Suyama's parameterization needs
+		 * sigma > 5. */
+		int schedule = 0;
+		int left = ecm_schedule[0][0];
+		int curve;
+		for(curve = 0; (curve < curves) && (rc != 0); curve++) {
+			if((left == 0) && (ecm_schedule[schedule][0] != 0)) {
+				schedule++;
+				left = ecm_schedule[schedule][0];
+			}
+			left--;
+			uint64_t b1 = ecm_schedule[schedule][1];
+			uint64_t b2 = 100 * b1;
+
+			int setup = prime_factors_ecm_curve(&this, (uint64_t) curve + 6, factor);
+			if(setup != 0) {
+				rc = (setup == 1) ? 0 : 1;
+				continue;
+			}
+
+			/* Stage 1.  Multiply P by every prime power up to B1. */
+			uint64_t p;
+			for(p = 2; p <= b1; p++) {
+				if(prime_factors_ecm_is_prime(p)) {
+					uint64_t q = p;
+					while((q * p) <= b1) {
+						q *= p;
+					}
+					prime_factors_ecm_ladder(&this, &this.p, q, &this.p);
+				}
+			}
+			if(prime_factors_ecm_check(&this, this.p.z, factor)) {
+				rc = 0;
+				continue;
+			}
+
+			/* If Z is 0 mod n, the order of P divided everything for
+			 * every factor at once.  Try the next curve. */
+			if(big_number_is_zero(this.p.z)) {
+				continue;
+			}
+
+			if(prime_factors_ecm_stage2(&this, b1, b2, factor)) {
+				rc = 0;
+			}
+		}
+	}
+
+	for(i = 0; i < count; i++) {
+		big_number_delete(this.all[i]);
+	}
+	big_number_reducer_delete(this.reducer);
+	return rc;
+}
+
+/********** Batch Methods */
+
+/*******************************************************************************
+ * Write a big_number in decimal, without the commas.
+ ******************************************************************************/
+static void prime_factors_print_big(FILE *out, big_number *n)
+{
+	const char *str = big_number_to_dec_str(n);
+	if(str != (const char *) 0) {
+		for(; *str != 0; str++) {
+			if(*str != ',') {
+				fputc(*str, out);
+			}
+		}
+	}
+}
+
+/*******************************************************************************
+ * Factor one line of batch input, and format the result as
+ * "n: (p ^ e) (p ^ e) ...".  A factor that couldn't be split is written as
+ * "(c ^ e composite)".
+ *
+ * Output:
+ *   Returns the result.  The caller frees it.  Returns 0 if out of memory.
+ ******************************************************************************/
+static char *prime_factors_format(const char *line, int ecm_curves)
+{
+	char *result = (char *) 0;
+	size_t size = 0;
+	FILE *out = open_memstream(&result, &size);
+	if(out == (FILE *) 0) {
+		return (char *) 0;
+	}
+
+	/* Small enough for 64 bits?  20 digits or fewer, and strtoull() doesn't
+	 * overflow. */
+	int digits = strspn(line, "0123456789");
+	uint64_t value = 0;
+	int small = 0;
+	if((digits > 0) && (digits <= 20) && (line[digits] == 0)) {
+		errno = 0;
+		value = strtoull(line, (char **) 0, 10);
+		small = (errno == 0);
+	}
+
+	prime_factors_u64 factors;
+	big_number *n = big_number_new();
+	prime_factors_big *big = (prime_factors_big *) 0;
+
+	if(small && (prime_factors_factor_u64(value, &factors) == 0)) {
+		fprintf(out, "%ju:", value);
+		int i;
+		for(i = 0; i < factors.count; i++) {
+			fprintf(out, " (%ju ^ %d)", factors.prime[i], factors.power[i]);
+		}
+	}
+	else if((n != (big_number *) 0) && (digits > 0) && (line[digits] == 0) && (big_number_from_str(n, line) == 0) &&
+	        ((big = prime_factors_factor_big(n, ecm_curves)) != (prime_factors_big *) 0)) {
+		prime_factors_print_big(out, n);
+		fputc(':', out);
+		int i;
+		for(i = 0; i < prime_factors_big_count(big); i++) {
+			int power, is_prime;
+			big_number_copy(prime_factors_big_factor(big, i, &power, &is_prime), n);
+			fputs(" (", out);
+			prime_factors_print_big(out, n);
+			fprintf(out, " ^ %d%s)", power, is_prime ? "" : " composite");
+		}
+	}
+	else {
+		fprintf(out, "%s: invalid", line);
+	}
+
+	prime_factors_big_delete(big);
+	big_number_delete(n);
+	fclose(out);
+	return result;
+}
+
+/*******************************************************************************
+ * A batch thread.  Factor lines until there aren't any left.
+ ******************************************************************************/
+static void *prime_factors_batch_thread(void *arg)
+{
+	prime_factors_batch_state *this = (prime_factors_batch_state *) arg;
+
+	int i;
+	while((i = __atomic_fetch_add(&this->next, 1, __ATOMIC_RELAXED)) < this->count) {
+		this->results[i] = prime_factors_format(this->lines[i], this->ecm_curves);
+	}
+
+	return (void *) 0;
+}
+
+/*******************************************************************************
+ * Brute force search for the prime factors of a number.  This is the original
+ * algorithm.  It tries every number from 2 up, so it's O(n) for a prime.  It's
+ * only used to check the fast one.
+ ******************************************************************************/
+static void prime_factors_brute_force(uint64_t num, prime_factors_u64 *result)
+{
+	uint64_t n = num;
+	uint64_t factor = 1;
+
+	result->count = 0;
 	while(factor < n) {
-		num_t mod;
+		int count = 0;
 
 		factor++;
-		count = 0;
-
-		while((mod = (n % factor)) == 0) {
+		while((n % factor) == 0) {
 			count++;
 			n /= factor;
 		}
 		if(count > 0) {
-			snprintf(b, b_size, " (%jd ^ %jd)", factor, count); b_size -= strlen(b); b += strlen(b);
+			result->prime[result->count] = factor;
+			result->power[result->count] = count;
+			result->count++;
 		}
 	}
-	clock_t elapsed_time = clock() - start_time;
+}
 
-#ifdef DISPLAY_ONLY_PRIMES
-	if(factor == num) {
-		printf("%10d: %jd\n", elapsed_time, num);
+/********************************** PUBLIC API ********************************/
+
+/*******************************************************************************
+ * Factor a 64-bit number.
+ *
+ * Input:
+ *   n      - The number to factor.
+ *   result - Receives the prime factors, smallest first.  1 has none.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (n is 0, or result is 0).
+ ******************************************************************************/
+int prime_factors_factor_u64(uint64_t n, prime_factors_u64 *result)
+{
+	if((n == 0) || (result == (prime_factors_u64 *) 0)) {
+		return 1;
+	}
+
+	pthread_once(&trial_once, prime_factors_trial_init);
+	result->count = 0;
+
+	/* 2. */
+	int twos = __builtin_ctzll(n);
+	if(twos > 0) {
+		prime_factors_u64_add(result, 2, twos);
+		n >>= twos;
+	}
+
+	/* The odd primes below TRIAL_LIMIT. */
+	int i;
+	for(i = 0; (i < trial_count) && ((trial_prime[i] * trial_prime[i]) <= n); i++) {
+		int power = 0;
+		while((n * trial_inv[i]) <= trial_max[i]) {
+			n *= trial_inv[i];
+			power++;
+		}
+		if(power > 0) {
+			prime_factors_u64_add(result, trial_prime[i], power);
+		}
+	}
+	if(n == 1) {
+		return 0;
 	}
-#else
-	printf("%10d: %s %s\n", elapsed_time, buf, (factor == num) ? " PRIME" : "");
-#endif
+
+	/* Split the rest.  Every composite makes 2 smaller ones, so there's
+	 * never more than 64 on the stack. */
+	uint64_t stack[64];
+	int top = 0;
+	stack[top++] = n;
+	while(top > 0) {
+		uint64_t m = stack[--top];
+
+		if((m < ((uint64_t) TRIAL_LIMIT * TRIAL_LIMIT)) || prime_factors_is_prime_u64(m)) {
+			prime_factors_u64_add(result, m, 1);
+			continue;
+		}
+
+		/* rho finds the factor of a square slowly.  Check for one. */
+		uint64_t root = prime_factors_isqrt(m);
+		uint64_t f = m;
+		if((root * root) == m) {
+			f = root;
+		}
+
+		uint64_t c;
+		for(c = 1; f == m; c++) {
+			f = prime_factors_rho(m, c);
+		}
+		stack[top++] = f;
+		stack[top++] = m / f;
+	}
+
+	return 0;
 }
 
 /*******************************************************************************
+ * Factor a big_number.
  *
+ * Input:
+ *   n          - The number to factor.  It must be > 0.
+ *   ecm_curves - The most ECM curves to try against each composite factor
+ *                that's bigger than 64 bits.  0 skips ECM.
+ *
+ * Output:
+ *   Success - A pointer to the factors.  Delete it with
+ *             prime_factors_big_delete().
+ *   Failure - 0 (n isn't positive, or out of memory).
  ******************************************************************************/
-int prime_factors_test(void)
+prime_factors_big *prime_factors_factor_big(const big_number *n, int ecm_curves)
 {
-	printf("Testing prime factors brute force.\n");
+	if((n == (big_number *) 0) || big_number_is_zero(n) || big_number_is_negative(n)) {
+		return (prime_factors_big *) 0;
+	}
 
-	int rc = 0;
+	pthread_once(&trial_once, prime_factors_trial_init);
 
-#ifdef FIXED_DATA_TEST
-	typedef struct test_data {
-		num_t num;
-	} test_data;
-	test_data tests[] = {
-		{                   3ULL },
-		{                   8ULL },
-		{                  30ULL },
-		{                  60ULL },
-		{                 900ULL },
-		{                  99ULL },
-		{            20394401ULL }, // PRIME
-                {    2251799813685248ULL }, // (2 ^ 51)
-                {    2251799813685247ULL }, // (2 ^ 51) - 1
-                {    9007199254740992ULL }, // (2 ^ 53)
-                {    9007199254740991ULL }, // (2 ^ 53) - 1
-                {   90071992547409912ULL }, // Big
-                {  900719925474099123ULL }, // Bigger
-                { 9007199254740991234ULL }, // Biggest
-	};
-	int num_tests = sizeof(tests) / sizeof(test_data);
+	prime_factors_big *this = (prime_factors_big *) calloc(1, sizeof(*this));
+	big_number *m = big_number_new();
+	big_number *p = big_number_new();
+	big_number *q = big_number_new();
+	big_number *f = big_number_new();
+	if((this == (prime_factors_big *) 0) || (m == (big_number *) 0) || (p == (big_number *) 0) ||
+	   (q == (big_number *) 0) || (f == (big_number *) 0)) {
+		prime_factors_big_delete(this);
+		big_number_delete(m);
+		big_number_delete(p);
+		big_number_delete(q);
+		big_number_delete(f);
+		return (prime_factors_big *) 0;
+	}
 
+	/* Trial division. */
+	int error = 0;
+	big_number_copy(n, m);
 	int i;
-	for(i = 0; i < num_tests; i++)
-	{
-		num_t num = tests[i].num;
-		prime_factors(num);
-	}
-#elif defined(TIMES_TWO_TEST)
-	num_t i = 1;
-	num_t j = 0;
-	while(1) {
-		/* Calculate the prime factors (brute force). */
-		prime_factors(i);
-
-		/* Alternate adjusting i as follows:
-		 * 1. i = (i * 2).
-		 * 2. i = ((i * 2) - 1).
-		 */
-		i = (i * 2) - j;
-		j ^= 1;
-	}
-#else
-	num_t i = 1;
-	while(1) {
-		/* Calculate the prime factors (brute force). */
-		prime_factors(i++);
+	for(i = -1; (i < trial_count) && (error == 0); i++) {
+		uint64_t prime = (i < 0) ? 2 : trial_prime[i];
+		int power = 0;
+		while(big_number_modulus_u64(m, prime) == 0) {
+			big_number_from_u64(p, prime);
+			big_number_divide(m, p, q);
+			big_number_copy(q, m);
+			power++;
+		}
+		if(power > 0) {
+			big_number_from_u64(p, prime);
+			error = prime_factors_big_add(this, p, power, 1);
+		}
+	}
+
+	/* Split the rest.  The stack holds composites (or numbers that haven't
+	 * been tested yet). */
+	int stack_size = 0, top = 0;
+	big_number **stack = (big_number **) 0;
+	if(big_number_compare(m, big_number_1()) > 0) {
+		stack = (big_number **) malloc(sizeof(*stack));
+		if(stack == (big_number **) 0) {
+			error = 1;
+		}
+		else {
+			stack_size = 1;
+			stack[top++] = m;
+			m = (big_number *) 0;
+		}
+	}
+
+	while((top > 0) && (error == 0)) {
+		big_number *c = stack[--top];
+
+		if(big_number_bit_length(c) <= 64) {
+			prime_factors_u64 factors;
+			prime_factors_factor_u64(prime_factors_to_u64(c), &factors);
+			for(i = 0; (i < factors.count) && (error == 0); i++) {
+				big_number_from_u64(p, factors.prime[i]);
+				error = prime_factors_big_add(this, p, factors.power[i], 1);
+			}
+		}
+		else if(prime_numbers_is_probable_prime(c)) {
+			error = prime_factors_big_add(this, c, 1, 1);
+		}
+		else if(prime_factors_ecm(c, ecm_curves, f) != 0) {
+			error = prime_factors_big_add(this, c, 1, 0);
+		}
+		else {
+			/* Both halves go back on the stack. */
+			big_number *other = big_number_new();
+			big_number **s = stack;
+			if((top + 2) > stack_size) {
+				s = (big_number **) realloc(stack, (top + 2) * sizeof(*stack));
+			}
+			if((other == (big_number *) 0) || (s == (big_number **) 0)) {
+				big_number_delete(other);
+				error = 1;
+			}
+			else {
+				stack = s;
+				stack_size = (top + 2 > stack_size) ? top + 2 : stack_size;
+				big_number_divide(c, f, other);
+				big_number_copy(f, c);
+				stack[top++] = c;
+				stack[top++] = other;
+				c = (big_number *) 0;
+			}
+		}
+
+		big_number_delete(c);
+	}
+
+	while(top > 0) {
+		big_number_delete(stack[--top]);
+	}
+	free(stack);
+	big_number_delete(m);
+	big_number_delete(p);
+	big_number_delete(q);
+	big_number_delete(f);
+
+	if(error != 0) {
+		prime_factors_big_delete(this);
+		return (prime_factors_big *) 0;
+	}
+
+	prime_factors_big_sort(this);
+	return this;
+}
+
+/*******************************************************************************
+ * Delete a prime_factors_big.
+ ******************************************************************************/
+void prime_factors_big_delete(prime_factors_big *this)
+{
+	if(this != (prime_factors_big *) 0) {
+		int i;
+		for(i = 0; i < this->count; i++) {
+			big_number_delete(this->factor[i]);
+		}
+		free(this->factor);
+		free(this->power);
+		free(this->is_prime);
+		free(this);
+	}
+}
+
+/*******************************************************************************
+ * The number of distinct factors in a prime_factors_big.
+ ******************************************************************************/
+int prime_factors_big_count(const prime_factors_big *this)
+{
+	return (this == (prime_factors_big *) 0) ? 0 : this->count;
+}
+
+/*******************************************************************************
+ * Get one of the factors from a prime_factors_big.  They're sorted, smallest
+ * first.
+ *
+ * Input:
+ *   this     - The factors.
+ *   i        - Which one (0 through count - 1).
+ *   power    - Receives the power of the factor.
+ *   is_prime - Receives 1 if the factor is prime, 0 if ECM couldn't split it.
+ *
+ * Output:
+ *   Returns the factor.  It belongs to this.  Returns 0 if i is out of range.
+ ******************************************************************************/
+const big_number *prime_factors_big_factor(const prime_factors_big *this, int i, int *power, int *is_prime)
+{
+	if((this == (prime_factors_big *) 0) || (i < 0) || (i >= this->count)) {
+		return (const big_number *) 0;
+	}
+
+	if(power != (int *) 0) {
+		*power = this->power[i];
+	}
+	if(is_prime != (int *) 0) {
+		*is_prime = this->is_prime[i];
+	}
+	return this->factor[i];
+}
+
+/*******************************************************************************
+ * Factor a stream of numbers.  The input is read BATCH_LINES lines at a time.
+ * The threads take the lines from a shared counter, and the results are
+ * written in the same order as the input.  Blank lines are skipped.
+ *
+ * Input:
+ *   in         - One decimal number per line.
+ *   out        - Receives one "n: (p ^ e) ..." line per number.
+ *   nthreads   - Number of threads.
+ *   ecm_curves - Passed to prime_factors_factor_big() for big numbers.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (bad arguments, or out of memory).
+ ******************************************************************************/
+int prime_factors_batch(FILE *in, FILE *out, int nthreads, int ecm_curves)
+{
+	if((in == (FILE *) 0) || (out == (FILE *) 0) || (nthreads < 1)) {
+		return 1;
+	}
+
+	prime_factors_batch_state this;
+	memset(&this, 0, sizeof(this));
+	this.lines = (char **) calloc(BATCH_LINES, sizeof(char *));
+	this.results = (char **) calloc(BATCH_LINES, sizeof(char *));
+	this.ecm_curves = ecm_curves;
+	pthread_t *threads = (pthread_t *) malloc(nthreads * sizeof(*threads));
+
+	int rc = 0;
+	if((this.lines == (char **) 0) || (this.results == (char **) 0) || (threads == (pthread_t *) 0)) {
+		rc = 1;
+	}
+
+	char *buf = (char *) 0;
+	size_t buf_size = 0;
+	int eof = 0;
+	while((rc == 0) && (eof == 0)) {
+		/* Read a batch.  Trim the whitespace from both ends. */
+		this.count = 0;
+		this.next = 0;
+		while(this.count < BATCH_LINES) {
+			if(getline(&buf, &buf_size, in) < 0) {
+				eof = 1;
+				break;
+			}
+
+			char *start = buf + strspn(buf, " \t");
+			char *end = start + strlen(start);
+			while((end > start) && ((end[-1] == '\n') || (end[-1] == '\r') || (end[-1] == ' ') || (end[-1] == '\t'))) {
+				*(--end) = 0;
+			}
+			if(*start == 0) {
+				continue;
+			}
+
+			this.lines[this.count] = strdup(start);
+			if(this.lines[this.count] == (char *) 0) {
+				rc = 1;
+				break;
+			}
+			this.count++;
+		}
+
+		/* The calling thread is one of the threads. */
+		int started;
+		for(started = 1; (started < nthreads) && (started < this.count); started++) {
+			if(pthread_create(&threads[started], NULL, prime_factors_batch_thread, &this) != 0) {
+				break;
+			}
+		}
+		prime_factors_batch_thread(&this);
+		int i;
+		for(i = 1; i < started; i++) {
+			pthread_join(threads[i], (void **) 0);
+		}
+
+		for(i = 0; i < this.count; i++) {
+			if(this.results[i] == (char *) 0) {
+				rc = 1;
+			}
+			else if(rc == 0) {
+				fprintf(out, "%s\n", this.results[i]);
+			}
+			free(this.results[i]);
+			free(this.lines[i]);
+			this.results[i] = (char *) 0;
+			this.lines[i] = (char *) 0;
+		}
 	}
-#endif
 
+	fflush(out);
+	free(buf);
+	free(threads);
+	free(this.results);
+	free(this.lines);
 	return rc;
 }
 
+/********** Test Methods */
+
+/*******************************************************************************
+ * Check a prime_factors_u64: the factors have to be prime, in increasing
+ * order, and multiply out to n.
+ ******************************************************************************/
+static int prime_factors_test_check(uint64_t n, const prime_factors_u64 *factors)
+{
+	unsigned __int128 product = 1;
+	int i;
+	for(i = 0; i < factors->count; i++) {
+		if(((i > 0) && (factors->prime[i] <= factors->prime[i - 1])) || (factors->power[i] < 1) ||
+		   (prime_factors_is_prime_u64(factors->prime[i]) == 0)) {
+			return 1;
+		}
+		int j;
+		for(j = 0; j < factors->power[i]; j++) {
+			product *= factors->prime[i];
+			if(product > n) {
+				return 1;
+			}
+		}
+	}
+
+	return (product == n) ? 0 : 1;
+}
+
+/*******************************************************************************
+ * A random 64-bit number (xorshift64).
+ ******************************************************************************/
+static uint64_t prime_factors_test_random(uint64_t *state)
+{
+	uint64_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+	return x;
+}
+
+/*******************************************************************************
+ * Run the prime_factors tests.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1.
+ ******************************************************************************/
+int prime_factors_test(void)
+{
+	printf("%s(): Starting\n", __func__);
+	int rc = 1;
+
+	big_number *n = big_number_new();
+	big_number *tmp = big_number_new();
+	prime_factors_big *big = (prime_factors_big *) 0;
+	FILE *in = tmpfile();
+	FILE *out = tmpfile();
+
+	do {
+		if((n == (big_number *) 0) || (tmp == (big_number *) 0) || (in == (FILE *) 0) || (out == (FILE *) 0)) {
+			break;
+		}
+
+		/* The brute force search agrees for the small numbers. */
+		prime_factors_u64 factors, expected;
+		uint64_t i;
+		for(i = 1; i <= 30000; i++) {
+			prime_factors_brute_force(i, &expected);
+			if((prime_factors_factor_u64(i, &factors) != 0) || (factors.count != expected.count) ||
+			   (memcmp(factors.prime, expected.prime, factors.count * sizeof(factors.prime[0])) != 0) ||
+			   (memcmp(factors.power, expected.power, factors.count * sizeof(factors.power[0])) != 0)) {
+				break;
+			}
+		}
+		if(i <= 30000) {
+			printf("%s(): %ju doesn't match the brute force search.\n", __func__, i);
+			break;
+		}
+		if(prime_factors_factor_u64(0, &factors) == 0) { break; }
+
+		/* Some hard ones.  {n, number of distinct factors}. */
+		static const uint64_t tests[][2] = {
+			{                    20394401ULL, 1 }, // PRIME
+			{            2251799813685248ULL, 1 }, // (2 ^ 51)
+			{            2251799813685247ULL, 5 }, // (2 ^ 51) - 1
+			{            9007199254740991ULL, 3 }, // (2 ^ 53) - 1
+			{           90071992547409912ULL, 7 },
+			{          900719925474099123ULL, 3 },
+			{         9007199254740991234ULL, 5 },
+			{        18446744073709551615ULL, 7 }, // (2 ^ 64) - 1
+			{        18446744073709551557ULL, 1 }, // Largest 64-bit prime
+			{        18446744030759878681ULL, 1 }, // 4294967291 ^ 2
+			{        18446743979220271189ULL, 2 }, // 4294967291 * 4294967279
+			{ 1099511627689ULL * 16777213ULL, 2 }, // 40-bit * 24-bit
+			{ 1099511627689ULL * 1021ULL * 3, 3 },
+		};
+		int t;
+		for(t = 0; t < (sizeof(tests) / sizeof(tests[0])); t++) {
+			if((prime_factors_factor_u64(tests[t][0], &factors) != 0) ||
+			   (prime_factors_test_check(tests[t][0], &factors) != 0) || (factors.count != tests[t][1])) {
+				break;
+			}
+		}
+		if(t != (sizeof(tests) / sizeof(tests[0]))) {
+			printf("%s(): %ju failed.\n", __func__, tests[t][0]);
+			break;
+		}
+
+		/* Random numbers, and products of 2 random 32-bit primes. */
+		uint64_t state = 88172645463325252ULL;
+		int count = 20000;
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for(t = 0; t < count; t++) {
+			uint64_t r = prime_factors_test_random(&state);
+			if((prime_factors_factor_u64(r, &factors) != 0) || (prime_factors_test_check(r, &factors) != 0)) {
+				break;
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		if(t != count) { break; }
+		printf("%s(): Random 64-bit numbers: %.2f usec each.\n", __func__,
+		       (((end.tv_sec - start.tv_sec) * 1e9) + (end.tv_nsec - start.tv_nsec)) / 1000.0 / count);
+
+		uint64_t semiprimes[1000];
+		for(t = 0; t < 1000; t++) {
+			uint64_t p, q;
+			do { p = (prime_factors_test_random(&state) >> 32) | 0x80000001; } while(!prime_factors_is_prime_u64(p));
+			do { q = (prime_factors_test_random(&state) >> 32) | 0x80000001; } while(!prime_factors_is_prime_u64(q));
+			semiprimes[t] = p * q;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for(t = 0; t < 1000; t++) {
+			if((prime_factors_factor_u64(semiprimes[t], &factors) != 0) ||
+			   (prime_factors_test_check(semiprimes[t], &factors) != 0)) {
+				break;
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		if(t != 1000) { break; }
+		printf("%s(): 32-bit * 32-bit semiprimes: %.2f usec each.\n", __func__,
+		       (((end.tv_sec - start.tv_sec) * 1e9) + (end.tv_nsec - start.tv_nsec)) / 1000.0 / 1000);
+
+		/* big_numbers.  (2 ^ 3) * 3 * (2 ^ 89 - 1) is trial division and a
+		 * prime.  The product of 3 40-bit primes needs ECM. */
+		if(big_number_from_str(n, "14855280471424563298789490664") != 0) { break; }
+		big = prime_factors_factor_big(n, 0);
+		int power, is_prime;
+		if((prime_factors_big_count(big) != 3) ||
+		   (big_number_from_str(tmp, "618970019642690137449562111") != 0) ||
+		   (big_number_compare(prime_factors_big_factor(big, 2, &power, &is_prime), tmp) != 0) ||
+		   (power != 1) || (is_prime != 1) ||
+		   (prime_factors_big_factor(big, 0, &power, &is_prime) == (const big_number *) 0) || (power != 3)) {
+			printf("%s(): Trial division failed.\n", __func__);
+			break;
+		}
+		prime_factors_big_delete(big);
+
+		if(big_number_from_str(n, "1329224368844033571231535879434342473") != 0) { break; }
+		big = prime_factors_factor_big(n, 0);
+		if((prime_factors_big_count(big) != 1) || (prime_factors_big_factor(big, 0, &power, &is_prime) == 0) ||
+		   (is_prime != 0)) {
+			printf("%s(): No ECM failed.\n", __func__);
+			break;
+		}
+		prime_factors_big_delete(big);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		big = prime_factors_factor_big(n, 100);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		static const char *ecm_factors[] = { "1099509627739", "1099510627763", "1099511627689" };
+		for(t = 0; t < 3; t++) {
+			if((prime_factors_big_count(big) != 3) || (big_number_from_str(tmp, ecm_factors[t]) != 0) ||
+			   (big_number_compare(prime_factors_big_factor(big, t, &power, &is_prime), tmp) != 0) ||
+			   (power != 1) || (is_prime != 1)) {
+				break;
+			}
+		}
+		if(t != 3) {
+			printf("%s(): ECM failed.\n", __func__);
+			break;
+		}
+		printf("%s(): ECM on 3 40-bit primes: %.1f msec.\n", __func__,
+		       (((end.tv_sec - start.tv_sec) * 1e9) + (end.tv_nsec - start.tv_nsec)) / 1e6);
+		prime_factors_big_delete(big);
+		big = (prime_factors_big *) 0;
+
+		/* Batch mode.  The results come back in order. */
+		fputs("12\n\n  18446744073709551615\r\n7\n1\nabc\n1329224368844033571231535879434342473\n", in);
+		rewind(in);
+		if(prime_factors_batch(in, out, 3, 100) != 0) { break; }
+		static const char *batch_expected =
+			"12: (2 ^ 2) (3 ^ 1)\n"
+			"18446744073709551615: (3 ^ 1) (5 ^ 1) (17 ^ 1) (257 ^ 1) (641 ^ 1) (65537 ^ 1) (6700417 ^ 1)\n"
+			"7: (7 ^ 1)\n"
+			"1:\n"
+			"abc: invalid\n"
+			"1329224368844033571231535879434342473: (1099509627739 ^ 1) (1099510627763 ^ 1) (1099511627689 ^ 1)\n";
+		char result[512] = { 0 };
+		rewind(out);
+		size_t len = fread(result, 1, sizeof(result) - 1, out);
+		if((len != strlen(batch_expected)) || (strcmp(result, batch_expected) != 0)) {
+			printf("%s(): Batch failed:\n%s", __func__, result);
+			break;
+		}
+
+		/* Complete.  Pass. */
+		rc = 0;
+
+	} while(0);
+
+	prime_factors_big_delete(big);
+	if(out != (FILE *) 0) {
+		fclose(out);
+	}
+	if(in != (FILE *) 0) {
+		fclose(in);
+	}
+	big_number_delete(tmp);
+	big_number_delete(n);
+
+	printf("%s(): %s.\n", __func__, (rc == 0) ? "PASS" : "FAIL");
+	return rc;
+}
@@ -2,12 +2,52 @@
 
 /*******************************************************************************
  *
- * External definition of mod_gen.c.
+ * External definition of prime_factors.c.
  *
  ******************************************************************************/
 
+#include <stdint.h>
+#include <stdio.h>
+
+#include "big_number.h"
+
+/********************************** DATA TYPES ********************************/
+
+/* The prime factors of a 64-bit number, smallest first.  The product of the
+ * first 16 primes doesn't fit in 64 bits, so there are never more than 15. */
+typedef struct prime_factors_u64 {
+	int count;
+	uint64_t prime[15];
+	int power[15];
+} prime_factors_u64;
+
+/* The factors of a big_number.  A factor that couldn't be split is marked as
+ * not prime. */
+typedef struct prime_factors_big prime_factors_big;
+
+/********************************** PUBLIC API ********************************/
+
+/*******************************************************************************
+ * Factor a 64-bit number.  Returns 0 if success.
+ ******************************************************************************/
+int prime_factors_factor_u64(uint64_t n, prime_factors_u64 *result);
+
 /*******************************************************************************
- * Test the mod_gen.c ADT.
+ * Factor a big_number.  Cofactors that fit in 64 bits are always split.  Bigger
+ * ones get ecm_curves tries of the elliptic curve method (0 skips it).
  ******************************************************************************/
-int mod_gen_test(void);
+prime_factors_big *prime_factors_factor_big(const big_number *n, int ecm_curves);
+void prime_factors_big_delete(prime_factors_big *this);
+int prime_factors_big_count(const prime_factors_big *this);
+const big_number *prime_factors_big_factor(const prime_factors_big *this, int i, int *power, int *is_prime);
 
+/*******************************************************************************
+ * Factor each number (one per line) in the input, spread over nthreads
+ * threads.  The results are written in the same order.  Returns 0 if success.
+ ******************************************************************************/
+int prime_factors_batch(FILE *in, FILE *out, int nthreads, int ecm_curves);
+
+/*******************************************************************************
+ * Test the prime_factors.c ADT.
+ ******************************************************************************/
+int prime_factors_test(void);
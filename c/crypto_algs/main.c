@@ -4,6 +4,7 @@
 #include "big_number.h"
 #include "big_number_base.h"
 #include "diffie_hellman.h"
+#include "ecdh.h"
 #include "prime_numbers.h"
 #include "rsa.h"
 
@@ -26,6 +27,10 @@ static int test(void)
 			rc = diffie_hellman_test();
 		}
 
+		if(rc == 0) {
+			rc = ecdh_test();
+		}
+
 		if(rc == 0) {
 			rc = prime_numbers_test();
 		}
@@ -1,12 +1,28 @@
 /*******************************************************************************
  *
- * This module calculates some prime numbers.  Nothing fancy here.  It just
- * tries every possible factor to see if it can find a prime number.  So don't
- * try to discover large primes with this program.
+ * This module tests numbers for primality.
+ *
+ * prime_numbers_is_probable_prime() is the one to use.  It does:
+ *
+ * 1. Trial division by the primes below 1,000.  That weeds out about 90% of
+ *    random odd numbers for very little work.
+ *
+ * 2. Numbers up to 64 bits get Miller-Rabin with the first 12 primes as bases.
+ *    That set of bases has no strong pseudoprimes below 3.3 * 10^24, so the
+ *    answer is exact.
+ *
+ * 3. Larger numbers get Baillie-PSW.  That's a Miller-Rabin test to base 2
+ *    and a strong Lucas test.  No number is known to pass both and still be
+ *    composite.
+ *
+ * The old brute force test is still here (in the TEST build) to check the
+ * fast one against.
  *
  ******************************************************************************/
 
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 
 #include "big_number.h"
@@ -14,18 +30,558 @@
 
 /* Styles of testing. */
 #ifdef TEST_REGRESSION
-#undef DISPLAY_ONLY_PRIMES
 #undef TEST_ALL_INTEGERS
 #else /* TEST_REGRESSION */
-#define DISPLAY_ONLY_PRIMES
 #define TEST_ALL_INTEGERS
 #endif /* TEST_REGRESSION */
 
-#ifdef TEST
+/* The primes below 1,000. */
+static const uint16_t small_primes[] = {
+	  2,   3,   5,   7,  11,  13,  17,  19,  23,  29,  31,  37,
+	 41,  43,  47,  53,  59,  61,  67,  71,  73,  79,  83,  89,
+	 97, 101, 103, 107, 109, 113, 127, 131, 137, 139, 149, 151,
+	157, 163, 167, 173, 179, 181, 191, 193, 197, 199, 211, 223,
+	227, 229, 233, 239, 241, 251, 257, 263, 269, 271, 277, 281,
+	283, 293, 307, 311, 313, 317, 331, 337, 347, 349, 353, 359,
+	367, 373, 379, 383, 389, 397, 401, 409, 419, 421, 431, 433,
+	439, 443, 449, 457, 461, 463, 467, 479, 487, 491, 499, 503,
+	509, 521, 523, 541, 547, 557, 563, 569, 571, 577, 587, 593,
+	599, 601, 607, 613, 617, 619, 631, 641, 643, 647, 653, 659,
+	661, 673, 677, 683, 691, 701, 709, 719, 727, 733, 739, 743,
+	751, 757, 761, 769, 773, 787, 797, 809, 811, 821, 823, 827,
+	829, 839, 853, 857, 859, 863, 877, 881, 883, 887, 907, 911,
+	919, 929, 937, 941, 947, 953, 967, 971, 977, 983, 991, 997
+};
+
+#define SMALL_PRIMES_COUNT (sizeof(small_primes) / sizeof(small_primes[0]))
+
+/* The Miller-Rabin bases that make the test exact for 64-bit numbers. */
+static const uint64_t mr_bases_64[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+
+/********************************* PRIVATE API ********************************/
+
+/*******************************************************************************
+ * Trial division by the primes below 1,000.  The primes are multiplied
+ * together into groups that fit in 64 bits, so it takes one pass over p for
+ * each group instead of one pass for each prime.
+ *
+ * Input:
+ *   p - The number to test.  Must be >= 2.
+ *
+ * Output:
+ *   Returns 0 if p is composite.
+ *   Returns 1 if p is prime.
+ *   Returns 2 if p has no small factors, but it's too big to know for sure.
+ ******************************************************************************/
+static int prime_numbers_trial_division(const big_number *p)
+{
+	/* If p is small, we need its value to tell whether a small factor
+	 * is p itself. */
+	uint64_t small = (big_number_bit_length(p) <= 32) ? big_number_modulus_u64(p, UINT64_MAX) : 0;
+
+	int i = 0;
+	while(i < SMALL_PRIMES_COUNT) {
+		/* Group as many primes as fit in 64 bits. */
+		uint64_t product = small_primes[i];
+		int end = i + 1;
+		while((end < SMALL_PRIMES_COUNT) && (product <= (UINT64_MAX / small_primes[end]))) {
+			product *= small_primes[end++];
+		}
+
+		uint64_t rem = big_number_modulus_u64(p, product);
+		for(; i < end; i++) {
+			if((rem % small_primes[i]) == 0) {
+				return (small == small_primes[i]) ? 1 : 0;
+			}
+		}
+	}
+
+	/* No factors below 1,000.  If p < 1,000^2, then it's prime. */
+	return ((small != 0) && (small < (1000 * 1000))) ? 1 : 2;
+}
+
+/*******************************************************************************
+ * One round of Miller-Rabin.  Write (p - 1) as (d * 2^s), with d odd.  Then p
+ * is a strong probable prime to base a if (a^d % p) == 1, or if
+ * (a^(d * 2^r) % p) == (p - 1) for some 0 <= r < s.
+ *
+ * Input:
+ *   mont      - p, prepared for modular exponentiation.
+ *   reducer   - p, prepared for Barrett reduction.
+ *   p_minus_1 - (p - 1).
+ *   d         - The odd part of (p - 1).
+ *   s         - The number of trailing zero bits in (p - 1).
+ *   a         - The base.
+ *
+ * Output:
+ *   Returns 1 if p is a strong probable prime to base a.
+ *   Returns 0 if p is composite.
+ ******************************************************************************/
+static int prime_numbers_miller_rabin(const big_number_mont *mont, const big_number_reducer *reducer,
+                                      const big_number *p_minus_1, const big_number *d, int s, uint64_t a)
+{
+	int rc = 0;
+
+	int mark = big_number_scratch_mark();
+	big_number *x = big_number_scratch_get();
+	big_number *t = big_number_scratch_get();
+	if((x == (big_number *) 0) || (t == (big_number *) 0)) {
+		big_number_scratch_release(mark);
+		return 0;
+	}
+
+	big_number_from_u64(x, a);
+	big_number_mont_exp(mont, x, d, x);
+
+	if((big_number_compare(x, big_number_1()) == 0) || (big_number_compare(x, p_minus_1) == 0)) {
+		rc = 1;
+	}
+
+	int r;
+	for(r = 1; (r < s) && (rc == 0); r++) {
+		big_number_mul_into(x, x, x, t);
+		big_number_reduce(reducer, x, x);
+
+		if(big_number_compare(x, p_minus_1) == 0) {
+			rc = 1;
+		}
+
+		/* Once it hits 1, it will never get to (p - 1). */
+		else if(big_number_compare(x, big_number_1()) == 0) {
+			break;
+		}
+	}
+
+	big_number_scratch_release(mark);
+	return rc;
+}
+
+/*******************************************************************************
+ * Calculate the Jacobi symbol (a / n) for small values.
+ *
+ * Input:
+ *   a - The top.
+ *   n - The bottom.  Must be odd.
+ *
+ * Output:
+ *   Returns -1, 0 or 1.
+ ******************************************************************************/
+static int prime_numbers_jacobi_u64(uint64_t a, uint64_t n)
+{
+	int rc = 1;
+
+	a %= n;
+	while(a != 0) {
+		while((a & 1) == 0) {
+			a >>= 1;
+			if(((n & 7) == 3) || ((n & 7) == 5)) {
+				rc = -rc;
+			}
+		}
+
+		uint64_t t = a; a = n; n = t;
+		if(((a & 3) == 3) && ((n & 3) == 3)) {
+			rc = -rc;
+		}
+		a %= n;
+	}
+
+	return (n == 1) ? rc : 0;
+}
+
+/*******************************************************************************
+ * Calculate the Jacobi symbol (D / p), where D is small and p is a large odd
+ * number.  Quadratic reciprocity turns it into (p % |D| / |D|).
+ *
+ * Input:
+ *   d - The top.  Odd, and |d| < p.
+ *   p - The bottom.  Odd.
+ *
+ * Output:
+ *   Returns -1, 0 or 1.
+ ******************************************************************************/
+static int prime_numbers_jacobi(int64_t d, const big_number *p)
+{
+	int rc = 1;
+	uint64_t p_mod_4 = big_number_modulus_u64(p, 4);
+
+	/* (-1 / p) = -1 if p = 3 (mod 4). */
+	uint64_t a = (d < 0) ? -d : d;
+	if((d < 0) && (p_mod_4 == 3)) {
+		rc = -rc;
+	}
+
+	/* (a / p) = (p / a), unless both are 3 (mod 4). */
+	if(((a & 3) == 3) && (p_mod_4 == 3)) {
+		rc = -rc;
+	}
+
+	return rc * prime_numbers_jacobi_u64(big_number_modulus_u64(p, a), a);
+}
+
+/*******************************************************************************
+ * Check to see if a number is a perfect square.  This uses Newton's method to
+ * find floor(sqrt(p)).
+ *
+ * Input:
+ *   p - The number to check.  Must be > 0.
+ *
+ * Output:
+ *   Returns 1 if p is a perfect square.
+ *   Returns 0 if it isn't.
+ ******************************************************************************/
+static int prime_numbers_is_square(const big_number *p)
+{
+	int mark = big_number_scratch_mark();
+	big_number *x = big_number_scratch_get();
+	big_number *y = big_number_scratch_get();
+	if((x == (big_number *) 0) || (y == (big_number *) 0)) {
+		big_number_scratch_release(mark);
+		return 0;
+	}
+
+	/* Start above the root, and come down until it stops moving. */
+	big_number_shift_left(big_number_1(), (big_number_bit_length(p) + 1) / 2, x);
+	while(1) {
+		big_number_divide(p, x, y);
+		big_number_add(y, x, y);
+		big_number_shift_right(y, 1, y);
+		if(big_number_compare(y, x) >= 0) {
+			break;
+		}
+		big_number_copy(y, x);
+	}
+
+	big_number_square(x, y);
+	int rc = (big_number_compare(y, p) == 0);
+
+	big_number_scratch_release(mark);
+	return rc;
+}
+
+/*******************************************************************************
+ * Calculate (x / 2) % p.  x must be in the range [0, p), and p must be odd.
+ ******************************************************************************/
+static void prime_numbers_half_mod(big_number *x, const big_number *p)
+{
+	if(big_number_test_bit(x, 0) == 1) {
+		big_number_add(x, p, x);
+	}
+	big_number_shift_right(x, 1, x);
+}
+
+/*******************************************************************************
+ * Calculate (a - b) % p.  a and b must be in the range [0, p).
+ ******************************************************************************/
+static void prime_numbers_sub_mod(const big_number *a, const big_number *b, const big_number *p, big_number *result)
+{
+	big_number_subtract(a, b, result);
+	if(big_number_is_negative(result) == 1) {
+		big_number_add(result, p, result);
+	}
+}
+
+/*******************************************************************************
+ * The strong Lucas probable prime test, with the parameters picked by
+ * Selfridge's method: D is the first of 5, -7, 9, -11, ... with (D / p) = -1,
+ * P = 1 and Q = (1 - D) / 4.
+ *
+ * Write (p + 1) as (d * 2^s), with d odd.  p is a strong Lucas probable prime
+ * if U(d) % p == 0, or if V(d * 2^r) % p == 0 for some 0 <= r < s.
+ *
+ * Input:
+ *   p       - The number to test.  Odd, with no factors below 1,000.
+ *   reducer - p, prepared for Barrett reduction.
+ *
+ * Output:
+ *   Returns 1 if p is a strong Lucas probable prime.
+ *   Returns 0 if p is composite.
+ ******************************************************************************/
+static int prime_numbers_strong_lucas(const big_number *p, const big_number_reducer *reducer)
+{
+	int rc = 0;
+
+	/* Find D.  If p is a perfect square, there isn't one, so check for
+	 * that if the search takes a while. */
+	int64_t d_value = 5;
+	int tries = 0;
+	while(1) {
+		int j = prime_numbers_jacobi(d_value, p);
+		if(j == -1) {
+			break;
+		}
+		if(j == 0) {
+			/* |D| < 1,000 shares a factor with p.  Trial division
+			 * should already have caught that. */
+			return 0;
+		}
+		if((++tries == 10) && (prime_numbers_is_square(p) == 1)) {
+			return 0;
+		}
+		d_value = (d_value > 0) ? -(d_value + 2) : -(d_value - 2);
+	}
+	int64_t q_value = (1 - d_value) / 4;
+
+	int mark = big_number_scratch_mark();
+	big_number *D    = big_number_scratch_get();
+	big_number *Q    = big_number_scratch_get();
+	big_number *d    = big_number_scratch_get();
+	big_number *U    = big_number_scratch_get();
+	big_number *V    = big_number_scratch_get();
+	big_number *Qk   = big_number_scratch_get();
+	big_number *tmp1 = big_number_scratch_get();
+	big_number *tmp2 = big_number_scratch_get();
+
+	do {
+		if(!D || !Q || !d || !U || !V || !Qk || !tmp1 || !tmp2) { break; }
+
+		/* D and Q, as values in the range [0, p). */
+		big_number_from_u64(D, (d_value < 0) ? -d_value : d_value);
+		if(d_value < 0) {
+			big_number_subtract(p, D, D);
+		}
+		big_number_from_u64(Q, (q_value < 0) ? -q_value : q_value);
+		if(q_value < 0) {
+			big_number_subtract(p, Q, Q);
+		}
+
+		/* p + 1 = d * 2^s. */
+		big_number_add(p, big_number_1(), d);
+		int s = 0;
+		while(big_number_test_bit(d, s) == 0) {
+			s++;
+		}
+		big_number_shift_right(d, s, d);
+
+		/* Start with k = 1.  U(1) = 1, V(1) = P = 1, Q^k = Q. */
+		big_number_copy(big_number_1(), U);
+		big_number_copy(big_number_1(), V);
+		big_number_copy(Q, Qk);
+
+		int bit;
+		for(bit = (big_number_bit_length(d) - 2); bit >= 0; bit--) {
+			/* k = 2k.  U(2k) = U(k) * V(k), V(2k) = V(k)^2 - 2Q^k. */
+			big_number_mul_into(U, V, U, tmp2);
+			big_number_reduce(reducer, U, U);
+			big_number_mul_into(V, V, V, tmp2);
+			big_number_reduce(reducer, V, V);
+			big_number_add(Qk, Qk, tmp1);
+			big_number_reduce(reducer, tmp1, tmp1);
+			prime_numbers_sub_mod(V, tmp1, p, V);
+			big_number_mul_into(Qk, Qk, Qk, tmp2);
+			big_number_reduce(reducer, Qk, Qk);
+
+			/* k = k + 1.  U(k+1) = (P * U(k) + V(k)) / 2,
+			 * V(k+1) = (D * U(k) + P * V(k)) / 2. */
+			if(big_number_test_bit(d, bit) == 1) {
+				big_number_multiply(D, U, tmp1);
+				big_number_add(tmp1, V, tmp1);
+				big_number_reduce(reducer, tmp1, tmp1);
+
+				big_number_add(U, V, tmp2);
+				big_number_reduce(reducer, tmp2, U);
+				prime_numbers_half_mod(U, p);
+
+				big_number_copy(tmp1, V);
+				prime_numbers_half_mod(V, p);
+
+				big_number_mul_into(Qk, Q, Qk, tmp2);
+				big_number_reduce(reducer, Qk, Qk);
+			}
+		}
+
+		if((big_number_is_zero(U) == 1) || (big_number_is_zero(V) == 1)) {
+			rc = 1;
+		}
+
+		int r;
+		for(r = 1; (r < s) && (rc == 0); r++) {
+			big_number_mul_into(V, V, V, tmp2);
+			big_number_reduce(reducer, V, V);
+			big_number_add(Qk, Qk, tmp1);
+			big_number_reduce(reducer, tmp1, tmp1);
+			prime_numbers_sub_mod(V, tmp1, p, V);
+			big_number_mul_into(Qk, Qk, Qk, tmp2);
+			big_number_reduce(reducer, Qk, Qk);
+
+			if(big_number_is_zero(V) == 1) {
+				rc = 1;
+			}
+		}
+
+	} while(0);
+
+	big_number_scratch_release(mark);
+	return rc;
+}
+
+/*******************************************************************************
+ * The expensive part of prime_numbers_is_probable_prime().  Call it once p is
+ * known to have no factors below 1,000.
+ *
+ * Input:
+ *   p - The number to test.  Must be odd and > 1,000.
+ *
+ * Output:
+ *   Returns 1 if p is prime (or passed Baillie-PSW).
+ *   Returns 0 if p is composite.
+ ******************************************************************************/
+static int prime_numbers_strong_test(const big_number *p)
+{
+	int rc = 0;
+
+	big_number_mont *mont = big_number_mont_new(p);
+	big_number_reducer *reducer = big_number_reducer_new(p);
+	int mark = big_number_scratch_mark();
+	big_number *p_minus_1 = big_number_scratch_get();
+	big_number *d = big_number_scratch_get();
+
+	do {
+		if(!mont || !reducer || !p_minus_1 || !d) { break; }
+
+		/* p - 1 = d * 2^s. */
+		big_number_subtract(p, big_number_1(), p_minus_1);
+		int s = 1;
+		while(big_number_test_bit(p_minus_1, s) == 0) {
+			s++;
+		}
+		big_number_shift_right(p_minus_1, s, d);
+
+		/* 64 bits or less.  Miller-Rabin is exact with these bases. */
+		if(big_number_bit_length(p) <= 64) {
+			int i;
+			for(i = 0; i < (sizeof(mr_bases_64) / sizeof(mr_bases_64[0])); i++) {
+				if(prime_numbers_miller_rabin(mont, reducer, p_minus_1, d, s, mr_bases_64[i]) == 0) {
+					break;
+				}
+			}
+			rc = (i == (sizeof(mr_bases_64) / sizeof(mr_bases_64[0])));
+		}
+
+		/* Baillie-PSW. */
+		else if(prime_numbers_miller_rabin(mont, reducer, p_minus_1, d, s, 2) == 1) {
+			rc = prime_numbers_strong_lucas(p, reducer);
+		}
+
+	} while(0);
+
+	big_number_scratch_release(mark);
+	big_number_reducer_delete(reducer);
+	big_number_mont_delete(mont);
+	return rc;
+}
+
+/********************************** PUBLIC API ********************************/
+
+/*******************************************************************************
+ * Test a number for primality.  See the top of this file for the details.
+ *
+ * Input:
+ *   p - The number to test.
+ *
+ * Output:
+ *   Returns 1 if p is prime.  For numbers over 64 bits, that means p passed
+ *   the Baillie-PSW test.
+ *   Returns 0 if p is not prime (including p < 2).
+ ******************************************************************************/
+int prime_numbers_is_probable_prime(const big_number *p)
+{
+	if((p == (big_number *) 0) || (big_number_is_negative(p) == 1) || (big_number_bit_length(p) < 2)) {
+		return 0;
+	}
+
+	int rc = prime_numbers_trial_division(p);
+	if(rc != 2) {
+		return rc;
+	}
+
+	return prime_numbers_strong_test(p);
+}
+
+/*******************************************************************************
+ * Search for a probable prime at or after start.
+ *
+ * The candidates are start, start + 2, start + 4, ...  The remainder of start
+ * mod each prime below 1,000 is calculated once.  After that, stepping to the
+ * next candidate only has to add 2 to each remainder, and a remainder of 0
+ * rules the candidate out without touching the big number.  Only the
+ * candidates that make it through the sieve get the expensive test.
+ *
+ * Input:
+ *   start     - Where to start looking.  Must be odd and > 1,000.
+ *   max_steps - Number of candidates to look at before giving up.
+ *   stop      - Optional (may be 0).  The search gives up as soon as another
+ *               thread sets *stop to non-zero.
+ *   result    - Receives the prime.
+ *
+ * Output:
+ *   Success - 0 (result contains a probable prime).
+ *   Failure - 1 (no prime found, or the search was stopped).
+ ******************************************************************************/
+int prime_numbers_next_probable_prime(const big_number *start, int max_steps, const int *stop, big_number *result)
+{
+	int rc = 1;
+
+	if((start == (big_number *) 0) || (result == (big_number *) 0) ||
+	   (big_number_test_bit(start, 0) == 0) || (big_number_bit_length(start) <= 10)) {
+		return rc;
+	}
+
+	/* The remainders, calculated in groups like prime_numbers_trial_division()
+	 * does. */
+	uint16_t rem[SMALL_PRIMES_COUNT];
+	int i = 0;
+	while(i < SMALL_PRIMES_COUNT) {
+		uint64_t product = small_primes[i];
+		int end = i + 1;
+		while((end < SMALL_PRIMES_COUNT) && (product <= (UINT64_MAX / small_primes[end]))) {
+			product *= small_primes[end++];
+		}
+
+		uint64_t r = big_number_modulus_u64(start, product);
+		for(; i < end; i++) {
+			rem[i] = r % small_primes[i];
+		}
+	}
+
+	int step;
+	int offset = 0;
+	for(step = 0; step < max_steps; step++, offset += 2) {
+		if((stop != (int *) 0) && (__atomic_load_n(stop, __ATOMIC_RELAXED) != 0)) {
+			break;
+		}
+
+		/* Sieve.  Skip 2, the candidates are always odd. */
+		int composite = 0;
+		for(i = 1; i < SMALL_PRIMES_COUNT; i++) {
+			if(rem[i] == 0) {
+				composite = 1;
+			}
+			rem[i] += 2;
+			if(rem[i] >= small_primes[i]) {
+				rem[i] -= small_primes[i];
+			}
+		}
+		if(composite == 1) {
+			continue;
+		}
+
+		big_number_from_u64(result, offset);
+		big_number_add(start, result, result);
+		if(prime_numbers_strong_test(result) == 1) {
+			rc = 0;
+			break;
+		}
+	}
+
+	return rc;
+}
+
+#if defined(TEST) && defined(TEST_REGRESSION)
 /*******************************************************************************
  * Given p, try to determine if it's prime by trying all possible factors.  This
  * is essentially a brute force test.  We'll test up to (p / 2) to see if we can
- * find a factor.
+ * find a factor.  It is only used to check prime_numbers_is_probable_prime().
  *
  * Returns 1 if p is prime.
  * Returns 0 if p is NOT prime.
@@ -62,12 +618,25 @@ prime_numbers_is_prime(big_number *p, clock_t *elapsed_time)
 	big_number_delete(limit);
 	return rc;
 }
-#endif /* TEST */
+#endif /* TEST && TEST_REGRESSION */
+
+#if defined(TEST) && defined(TEST_ALL_INTEGERS)
+/*******************************************************************************
+ * Count a prime from prime_numbers_enumerate().
+ ******************************************************************************/
+static int prime_numbers_test_count(uint64_t prime, void *arg)
+{
+	(*(uint64_t *) arg)++;
+	return 0;
+}
+#endif /* TEST && TEST_ALL_INTEGERS */
 
 #ifdef TEST
 /*******************************************************************************
  *
- * Spin in a loop and look for prime numbers.  Print the ones that are prime.
+ * Test the primality functions.  The regression build checks them against the
+ * brute force test.  Otherwise, the sieve walks every prime below 10^9 and
+ * checks the count.  Both run the sieve tests.
  *
  ******************************************************************************/
 int prime_numbers_test(void)
@@ -87,33 +656,107 @@ int prime_numbers_test(void)
 		big_number_add(p, big_number_1(), p);
 		if(prime_numbers_is_prime(p, &elapsed_time) != 1) { break; }
 
-#elif defined(TEST_ALL_INTEGERS)
-		/* Start with 1. */
-		big_number_copy(big_number_1(), p);
-
-		/* Test up to 1,000,000,000. */
-		big_number *p_end = big_number_new();
-		big_number_copy(big_number_1(), p_end);
-		big_number_multiply(p_end, big_number_1000(), p_end);
-		big_number_multiply(p_end, big_number_1000(), p_end);
-		big_number_multiply(p_end, big_number_1000(), p_end);
-
-		while(big_number_compare(p, p_end) < 0) {
-			int is_prime = prime_numbers_is_prime(p, &elapsed_time);
-
-#ifdef DISPLAY_ONLY_PRIMES
-			if(is_prime) {
-				printf("%10d ticks: %s.\n", (int) elapsed_time, big_number_to_str(p));
+		/* Check the fast test against the brute force test. */
+		uint64_t i;
+		for(i = 0; i < 600; i++) {
+			big_number_from_u64(p, i);
+			int expected = (i >= 2) ? prime_numbers_is_prime(p, &elapsed_time) : 0;
+			if(prime_numbers_is_probable_prime(p) != expected) { break; }
+		}
+		if(i != 600) { break; }
+
+		/* Some composites that fool the weaker tests, and some primes.
+		 * 1 == prime, 0 == composite. */
+		static const struct {
+			const char *p;
+			int is_prime;
+		} tests[] = {
+			{ "561",                   0 },  // Carmichael number.
+			{ "1022117",               0 },  // 1009 * 1013.
+			{ "1018081",               0 },  // 1009 ^ 2.
+			{ "2047",                  0 },  // Strong pseudoprime to base 2.
+			{ "3215031751",            0 },  // Strong pseudoprime to bases 2, 3, 5, 7.
+			{ "3825123056546413051",   0 },  // Strong pseudoprime to bases 2 - 23.
+			{ "1000003",               1 },
+			{ "2305843009213693951",   1 },  // 2^61 - 1.
+			{ "18446744073709551557",  1 },  // Largest 64-bit prime.
+			{ "618970019642690137449562111", 1 },          // 2^89 - 1.
+			{ "618970019642690137449562113", 0 },          // 2^89 + 1.
+			{ "1000000000000000000000000000057", 1 },
+			{ "1000000000000000000000000000059", 0 },
+			{ "1000000016000000063", 0 },                  // 1000000007 * 1000000009.
+			{ "1000000000000000012000000000000000027", 0 }, // (10^18 + 3) * (10^18 + 9).
+			{ "1000000000000000018000000000000000081", 0 }, // (10^18 + 9) ^ 2.
+			{ "3317044064679887385961981", 0 },            // Strong pseudoprime to bases 2 - 37.
+			{ "170141183460469231731687303715884105727", 1 }, // 2^127 - 1.
+		};
+
+		/* The simulated big_number library only holds 63 bits.  Skip the
+		 * numbers that don't fit. */
+		big_number_reset(p);
+		big_number_shift_left(big_number_1(), 64, p);
+		int small_only = big_number_is_zero(p);
+
+		int t;
+		for(t = 0; t < (sizeof(tests) / sizeof(tests[0])); t++) {
+			if((small_only == 1) && (strlen(tests[t].p) > 18)) {
+				continue;
+			}
+			big_number_from_str(p, tests[t].p);
+			if(prime_numbers_is_probable_prime(p) != tests[t].is_prime) {
+				printf("%s(): %s is%s prime.\n", __func__, tests[t].p, tests[t].is_prime ? "" : " not");
+				break;
+			}
+		}
+		if(t != (sizeof(tests) / sizeof(tests[0]))) { break; }
+
+		/* Search for primes.  {start, first prime >= start}. */
+		static const struct {
+			const char *start;
+			const char *prime;
+		} searches[] = {
+			{ "1000001",             "1000003"             },
+			{ "2305843009213693851", "2305843009213693907" },
+			{ "1000000000000000000000000000001", "1000000000000000000000000000057" },
+		};
+
+		big_number *expected = big_number_new();
+		big_number *start = big_number_new();
+		if((expected == (big_number *) 0) || (start == (big_number *) 0)) {
+			big_number_delete(start);
+			big_number_delete(expected);
+			break;
+		}
+		for(t = 0; t < (sizeof(searches) / sizeof(searches[0])); t++) {
+			if((small_only == 1) && (strlen(searches[t].prime) > 18)) {
+				continue;
+			}
+			big_number_from_str(start, searches[t].start);
+			big_number_from_str(expected, searches[t].prime);
+			if((prime_numbers_next_probable_prime(start, 1000, (int *) 0, p) != 0) ||
+			   (big_number_compare(p, expected) != 0)) {
+				printf("%s(): Search from %s failed.\n", __func__, searches[t].start);
+				break;
 			}
-#else
-			printf("%10d ticks: %s %s prime.\n", (int) elapsed_time, big_number_to_str(p), (is_prime) ? "is" : "is not");
-#endif
-			big_number_increment(p);
 		}
+		big_number_delete(start);
+		big_number_delete(expected);
+		if(t != (sizeof(searches) / sizeof(searches[0]))) { break; }
 
-		big_number_delete(p_end);
+#elif defined(TEST_ALL_INTEGERS)
+		/* Walk the primes below 1,000,000,000 with the sieve.  There are
+		 * pi(10^9) = 50,847,534 of them. */
+		uint64_t count = 0;
+		clock_t start_time = clock();
+		if(prime_numbers_enumerate(0, 1000000000, 4, prime_numbers_test_count, &count) != 0) { break; }
+		elapsed_time = clock() - start_time;
+		printf("%s(): %ju primes below 1,000,000,000 in %d ticks.\n", __func__, count, (int) elapsed_time);
+		if(count != 50847534) { break; }
 #endif /* TEST_ALL_INTEGERS */
 
+		/* The sieve. */
+		if(prime_sieve_test() != 0) { break; }
+
 		big_number_delete(p);
 
 		/* Complete.  Pass. */
@@ -125,4 +768,3 @@ int prime_numbers_test(void)
 	return rc;
 }
 #endif /* TEST */
-
@@ -2,12 +2,43 @@
 
 /*******************************************************************************
  *
- * External definition of prime_numbers.c.
+ * External definition of prime_numbers.c and prime_sieve.c.
  *
  ******************************************************************************/
 
+#include <stdint.h>
+
+#include "big_number.h"
+
+/*******************************************************************************
+ * Test a number for primality.  Returns 1 if it is prime, 0 if it is not.
+ ******************************************************************************/
+int prime_numbers_is_probable_prime(const big_number *p);
+
+/*******************************************************************************
+ * Find the first probable prime in start, start + 2, ..., giving up after
+ * max_steps candidates or when *stop goes non-zero.  Returns 0 if success.
+ ******************************************************************************/
+int prime_numbers_next_probable_prime(const big_number *start, int max_steps, const int *stop, big_number *result);
+
+/*******************************************************************************
+ * Called by prime_numbers_enumerate() with each prime.  Return non-zero to
+ * stop the listing.
+ ******************************************************************************/
+typedef int (*prime_numbers_callback)(uint64_t prime, void *arg);
+
+/*******************************************************************************
+ * List (or count) the primes in [low, high), with a segmented sieve spread over
+ * nthreads threads (prime_sieve.c).  high can be up to 2^48.  The callback sees
+ * the primes in increasing order, one call at a time.  Both return 0 if
+ * success.
+ ******************************************************************************/
+int prime_numbers_enumerate(uint64_t low, uint64_t high, int nthreads, prime_numbers_callback callback, void *arg);
+int prime_numbers_count(uint64_t low, uint64_t high, int nthreads, uint64_t *count);
+
 /*******************************************************************************
- * Test the prime_numbers.c ADT.
+ * Test the prime_numbers.c and prime_sieve.c ADTs.
  ******************************************************************************/
 int prime_numbers_test(void);
+int prime_sieve_test(void);
 
@@ -0,0 +1,636 @@
+/*******************************************************************************
+ *
+ * This module lists the primes in a range of 64-bit numbers with a segmented
+ * Sieve of Eratosthenes.
+ *
+ * - The sieve is wheel factorised mod 30.  Only the 8 residues that are
+ *   relatively prime to 30 (1, 7, 11, 13, 17, 19, 23, 29) can be prime, so
+ *   each byte of the sieve holds 30 numbers, one bit per residue.  2, 3, and 5
+ *   are handled on their own.
+ *
+ * - The range is cut into segments that fit in half of the L2 cache.  The
+ *   multiples of a prime p that are in one residue class (k % 30 fixed, for
+ *   multiples p * k) are 30 * p apart, so they're p bytes apart, and they all
+ *   land on the same bit.  That makes crossing them off a strided AND.  Each
+ *   segment has to find the first multiple of every sieving prime, so L1
+ *   sized segments spend most of their time doing that once the range gets
+ *   past about 10^11.
+ *
+ * - The multiples of 7, 11, 13, and 17 repeat every (7 * 11 * 13 * 17) bytes.
+ *   They're crossed off once into a pattern, and each segment starts as a copy
+ *   of the pattern instead of all ones.
+ *
+ * - A segment doesn't depend on any other segment.  The threads take the next
+ *   segment from a shared counter and sieve it on their own.  The primes are
+ *   handed to the callback one segment at a time, in order, so the callback
+ *   sees them in increasing order and is never called from 2 threads at once.
+ *
+ ******************************************************************************/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "prime_numbers.h"
+
+/* The residues mod 30 that can be prime.  Bit b of a sieve byte is
+ * wheel[b]. */
+static const uint8_t wheel[8] = { 1, 7, 11, 13, 17, 19, 23, 29 };
+
+/* The bit for each residue mod 30, or 0xFF if the residue has a factor of 2,
+ * 3, or 5. */
+static const uint8_t wheel_bit[30] = {
+	0xFF,    0, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,    1, 0xFF, 0xFF,
+	0xFF,    2, 0xFF,    3, 0xFF, 0xFF, 0xFF,    4, 0xFF,    5,
+	0xFF, 0xFF, 0xFF,    6, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,    7
+};
+
+/* The primes in the pattern, and its size in bytes (their product). */
+static const uint32_t pattern_primes[] = { 7, 11, 13, 17 };
+#define PATTERN_BYTES (7 * 11 * 13 * 17)
+
+/* The largest range that can be sieved.  The sieving primes go up to
+ * sqrt(PRIME_SIEVE_MAX), and they're all kept in memory. */
+#define PRIME_SIEVE_MAX (1ULL << 48)
+
+/* The segment size when the L2 cache size isn't known. */
+#define SEGMENT_BYTES_DEFAULT (256 * 1024)
+
+/*******************************************************************************
+ ******************************* CLASS DEFINITION ******************************
+ ******************************************************************************/
+
+/* State shared by the sieve threads.  next_segment is taken with the atomic
+ * builtins.  next_delivery and stop are protected by mutex. */
+typedef struct prime_sieve {
+	/* The range, [low, high). */
+	uint64_t low;
+	uint64_t high;
+
+	/* Segment i starts at the number (base + (i * 30 * segment_bytes)). */
+	uint64_t base;
+	int segment_bytes;
+	int segments;
+
+	/* The sieving primes, 19 and up, through sqrt(high). */
+	uint32_t *primes;
+	int nprimes;
+
+	uint8_t *pattern;
+
+	prime_numbers_callback callback;
+	void *arg;
+
+	int next_segment;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int next_delivery;
+	int stop;
+
+	/* Number of primes found.  Only used when there's no callback. */
+	uint64_t count;
+
+	/* Set if a thread ran out of memory. */
+	int error;
+} prime_sieve;
+
+/********************************* PRIVATE API ********************************/
+
+/*******************************************************************************
+ * Cross off the multiples of p in a block of sieve bytes.  The block starts at
+ * the number low, which is a multiple of 30.
+ *
+ * Input:
+ *   block - The sieve bytes.
+ *   bytes - Number of bytes in the block.
+ *   low   - The number that block[0] starts at.
+ *   p     - The prime.  It must be > 5.
+ *   kmin  - Only cross off (p * k) for k >= kmin.
+ ******************************************************************************/
+static void prime_sieve_cross_off(uint8_t *block, int bytes, uint64_t low, uint32_t p, uint64_t kmin)
+{
+	/* The first multiple in the block. */
+	uint64_t k = (low + p - 1) / p;
+	if(k < kmin) {
+		k = kmin;
+	}
+
+	/* One pass for each residue class of k.  Every multiple in a class is
+	 * p bytes from the next one, and on the same bit. */
+	int j;
+	for(j = 0; j < 8; j++) {
+		uint64_t kj = k + ((wheel[j] + 30 - (k % 30)) % 30);
+		uint64_t n = (uint64_t) p * kj;
+		uint64_t i = (n - low) / 30;
+		uint8_t mask = (uint8_t) ~(1 << wheel_bit[n % 30]);
+
+		for(; i < (uint64_t) bytes; i += p) {
+			block[i] &= mask;
+		}
+	}
+}
+
+/*******************************************************************************
+ * Find the primes from 7 through limit with a plain sieve of the odd numbers.
+ *
+ * Input:
+ *   limit  - The largest number to check.
+ *   primes - Receives the primes.  The caller must free() it.
+ *
+ * Output:
+ *   Success - Returns the number of primes.
+ *   Failure - Returns -1 (out of memory).
+ ******************************************************************************/
+static int prime_sieve_small_primes(uint32_t limit, uint32_t **primes)
+{
+	/* odd[i] is 1 if (2 * i + 1) is composite. */
+	uint32_t size = (limit / 2) + 1;
+	uint8_t *odd = (uint8_t *) calloc(size, 1);
+	if(odd == (uint8_t *) 0) {
+		return -1;
+	}
+
+	uint32_t i;
+	uint64_t j;
+	int count = 0;
+	for(i = 1; i < size; i++) {
+		if(odd[i] == 0) {
+			uint32_t p = (2 * i) + 1;
+			count += (p >= 7);
+			for(j = ((uint64_t) p * p) / 2; j < size; j += p) {
+				odd[j] = 1;
+			}
+		}
+	}
+
+	*primes = (uint32_t *) malloc((count + 1) * sizeof(uint32_t));
+	if(*primes == (uint32_t *) 0) {
+		free(odd);
+		return -1;
+	}
+
+	count = 0;
+	for(i = 3; i < size; i++) {
+		if(odd[i] == 0) {
+			(*primes)[count++] = (2 * i) + 1;
+		}
+	}
+
+	free(odd);
+	return count;
+}
+
+/*******************************************************************************
+ * Sieve one segment.
+ *
+ * Input:
+ *   this    - The sieve.
+ *   segment - The segment number.
+ *   block   - Receives the sieve bytes.  segment_bytes long.
+ *
+ * Output:
+ *   Returns the number of bytes in the segment.  Only the last segment is
+ *   short.
+ ******************************************************************************/
+static int prime_sieve_segment(const prime_sieve *this, int segment, uint8_t *block)
+{
+	uint64_t low = this->base + ((uint64_t) segment * 30 * this->segment_bytes);
+	uint64_t bytes = this->segment_bytes;
+	if((low + (bytes * 30)) > this->high) {
+		bytes = ((this->high - low) + 29) / 30;
+	}
+
+	/* Start from the pattern.  It already has 7, 11, 13, and 17 crossed
+	 * off. */
+	uint64_t offset = (low / 30) % PATTERN_BYTES;
+	uint64_t done = 0;
+	while(done < bytes) {
+		uint64_t len = PATTERN_BYTES - offset;
+		if(len > (bytes - done)) {
+			len = bytes - done;
+		}
+		memcpy(block + done, this->pattern + offset, len);
+		done += len;
+		offset = 0;
+	}
+
+	/* 1 isn't prime, but the pattern primes (bits 1 - 4) are. */
+	if(low == 0) {
+		block[0] = (block[0] & ~1) | 0x1E;
+	}
+
+	/* The rest of the sieving primes.  Start at p^2, the smaller multiples
+	 * have a smaller factor. */
+	uint64_t end = low + (bytes * 30);
+	int i;
+	for(i = 0; i < this->nprimes; i++) {
+		uint32_t p = this->primes[i];
+		if(((uint64_t) p * p) >= end) {
+			break;
+		}
+		prime_sieve_cross_off(block, (int) bytes, low, p, p);
+	}
+
+	/* Clear the numbers that are outside of [low, high). */
+	uint64_t b;
+	for(b = 0; (b < bytes) && ((low + (b * 30)) < this->low); b++) {
+		int bit;
+		for(bit = 0; bit < 8; bit++) {
+			if((low + (b * 30) + wheel[bit]) < this->low) {
+				block[b] &= ~(1 << bit);
+			}
+		}
+	}
+	for(b = bytes; (b > 0) && ((low + (b * 30) - 1) >= this->high); b--) {
+		int bit;
+		for(bit = 0; bit < 8; bit++) {
+			if((low + ((b - 1) * 30) + wheel[bit]) >= this->high) {
+				block[b - 1] &= ~(1 << bit);
+			}
+		}
+	}
+
+	return (int) bytes;
+}
+
+/*******************************************************************************
+ * Hand the primes in a segment to the callback.
+ *
+ * Output:
+ *   Returns the callback's return code.  Non-zero means stop.
+ ******************************************************************************/
+static int prime_sieve_deliver(const prime_sieve *this, int segment, const uint8_t *block, int bytes)
+{
+	uint64_t low = this->base + ((uint64_t) segment * 30 * this->segment_bytes);
+
+	int i;
+	for(i = 0; i < bytes; i++) {
+		unsigned bits = block[i];
+		while(bits != 0) {
+			int bit = __builtin_ctz(bits);
+			bits &= bits - 1;
+			if(this->callback(low + ((uint64_t) i * 30) + wheel[bit], this->arg) != 0) {
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*******************************************************************************
+ * A sieve thread.  Sieve segments until there are none left.
+ *
+ * Input:
+ *   arg - The shared prime_sieve object.
+ *
+ * Output:
+ *   Returns 0.  Failures are reported in prime_sieve.error.
+ ******************************************************************************/
+static void *prime_sieve_thread(void *arg)
+{
+	prime_sieve *this = (prime_sieve *) arg;
+	uint64_t count = 0;
+
+	uint8_t *block = (uint8_t *) malloc(this->segment_bytes + 8);
+	if(block == (uint8_t *) 0) {
+		pthread_mutex_lock(&this->mutex);
+		this->error = 1;
+		this->stop = 1;
+		pthread_cond_broadcast(&this->cond);
+		pthread_mutex_unlock(&this->mutex);
+		return (void *) 0;
+	}
+
+	while(__atomic_load_n(&this->stop, __ATOMIC_RELAXED) == 0) {
+		int segment = __atomic_fetch_add(&this->next_segment, 1, __ATOMIC_RELAXED);
+		if(segment >= this->segments) {
+			break;
+		}
+
+		int bytes = prime_sieve_segment(this, segment, block);
+
+		if(this->callback == (prime_numbers_callback) 0) {
+			/* Just count them.  Pad to a whole number of words. */
+			memset(block + bytes, 0, 8);
+			int i;
+			for(i = 0; i < bytes; i += 8) {
+				uint64_t w;
+				memcpy(&w, block + i, sizeof(w));
+				count += __builtin_popcountll(w);
+			}
+			continue;
+		}
+
+		/* Wait for this segment's turn. */
+		pthread_mutex_lock(&this->mutex);
+		while((this->next_delivery != segment) && (this->stop == 0)) {
+			pthread_cond_wait(&this->cond, &this->mutex);
+		}
+		int stop = this->stop;
+		pthread_mutex_unlock(&this->mutex);
+
+		if(stop == 0) {
+			stop = prime_sieve_deliver(this, segment, block, bytes);
+		}
+
+		pthread_mutex_lock(&this->mutex);
+		this->next_delivery++;
+		if(stop != 0) {
+			this->stop = 1;
+		}
+		pthread_cond_broadcast(&this->cond);
+		pthread_mutex_unlock(&this->mutex);
+	}
+
+	__atomic_fetch_add(&this->count, count, __ATOMIC_RELAXED);
+	free(block);
+	return (void *) 0;
+}
+
+/*******************************************************************************
+ * Pick the segment size.  It's half of the L2 cache, if its size is known.
+ ******************************************************************************/
+static int prime_sieve_segment_bytes(void)
+{
+	long l2 = -1;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+	l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+	if((l2 < (64 * 1024)) || (l2 > (16 * 1024 * 1024))) {
+		return SEGMENT_BYTES_DEFAULT;
+	}
+
+	return (int) (l2 / 2);
+}
+
+/*******************************************************************************
+ * Run the sieve over [low, high).
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (bad arguments, or out of memory).
+ ******************************************************************************/
+static int prime_sieve_run(uint64_t low, uint64_t high, int nthreads, prime_numbers_callback callback,
+                           void *arg, uint64_t *count)
+{
+	if((low >= high) || (high > PRIME_SIEVE_MAX) || (nthreads < 1)) {
+		return (low >= high) ? 0 : 1;
+	}
+
+	/* 2, 3, and 5 aren't on the wheel. */
+	static const uint64_t first[] = { 2, 3, 5 };
+	int i;
+	for(i = 0; i < 3; i++) {
+		if((first[i] >= low) && (first[i] < high)) {
+			if(callback != (prime_numbers_callback) 0) {
+				if(callback(first[i], arg) != 0) {
+					return 0;
+				}
+			}
+			else {
+				(*count)++;
+			}
+		}
+	}
+
+	prime_sieve this;
+	memset(&this, 0, sizeof(this));
+	this.low = low;
+	this.high = high;
+	this.base = (low / 30) * 30;
+	this.segment_bytes = prime_sieve_segment_bytes();
+	uint64_t span = (uint64_t) this.segment_bytes * 30;
+	this.segments = (int) (((high - this.base) + span - 1) / span);
+	this.callback = callback;
+	this.arg = arg;
+
+	if(nthreads > this.segments) {
+		nthreads = this.segments;
+	}
+
+	/* The sieving primes, up to sqrt(high).  Newton's method. */
+	uint64_t limit = high;
+	uint64_t next = (limit + 1) / 2;
+	while(next < limit) {
+		limit = next;
+		next = (limit + (high / limit)) / 2;
+	}
+	this.nprimes = prime_sieve_small_primes((uint32_t) limit, &this.primes);
+	if(this.nprimes < 0) {
+		return 1;
+	}
+
+	/* The pattern.  Every multiple of each pattern prime is crossed off,
+	 * including the prime itself. */
+	this.pattern = (uint8_t *) malloc(PATTERN_BYTES);
+	pthread_t *threads = (pthread_t *) malloc(nthreads * sizeof(*threads));
+	if((this.pattern == (uint8_t *) 0) || (threads == (pthread_t *) 0)) {
+		free(threads);
+		free(this.pattern);
+		free(this.primes);
+		return 1;
+	}
+	memset(this.pattern, 0xFF, PATTERN_BYTES);
+	for(i = 0; i < (sizeof(pattern_primes) / sizeof(pattern_primes[0])); i++) {
+		prime_sieve_cross_off(this.pattern, PATTERN_BYTES, 0, pattern_primes[i], 1);
+	}
+
+	/* The sieving primes after the pattern ones. */
+	int skip = 0;
+	while((skip < this.nprimes) && (this.primes[skip] <= pattern_primes[3])) {
+		skip++;
+	}
+	uint32_t *primes = this.primes;
+	this.primes += skip;
+	this.nprimes -= skip;
+
+	pthread_mutex_init(&this.mutex, NULL);
+	pthread_cond_init(&this.cond, NULL);
+
+	/* The calling thread is one of the threads. */
+	int started;
+	for(started = 1; started < nthreads; started++) {
+		if(pthread_create(&threads[started], NULL, prime_sieve_thread, &this) != 0) {
+			break;
+		}
+	}
+	prime_sieve_thread(&this);
+	for(i = 1; i < started; i++) {
+		pthread_join(threads[i], (void **) 0);
+	}
+
+	pthread_cond_destroy(&this.cond);
+	pthread_mutex_destroy(&this.mutex);
+
+	if(count != (uint64_t *) 0) {
+		*count += this.count;
+	}
+
+	free(threads);
+	free(this.pattern);
+	free(primes);
+	return this.error;
+}
+
+/********************************** PUBLIC API ********************************/
+
+/*******************************************************************************
+ * List the primes in [low, high).
+ *
+ * Input:
+ *   low      - The start of the range.
+ *   high     - The end of the range (not included).  Up to 2^48.
+ *   nthreads - Number of threads to sieve with.
+ *   callback - Called with each prime, in increasing order.  It's never
+ *              called from 2 threads at once, but it may be called from any
+ *              of the threads.  If it returns non-zero, the listing stops.
+ *   arg      - Passed to the callback.
+ *
+ * Output:
+ *   Success - 0 (all of the primes were listed, or the callback stopped it).
+ *   Failure - 1 (bad arguments, or out of memory).
+ ******************************************************************************/
+int prime_numbers_enumerate(uint64_t low, uint64_t high, int nthreads, prime_numbers_callback callback, void *arg)
+{
+	if(callback == (prime_numbers_callback) 0) {
+		return 1;
+	}
+
+	return prime_sieve_run(low, high, nthreads, callback, arg, (uint64_t *) 0);
+}
+
+/*******************************************************************************
+ * Count the primes in [low, high).  This is faster than listing them.
+ *
+ * Input:
+ *   low      - The start of the range.
+ *   high     - The end of the range (not included).  Up to 2^48.
+ *   nthreads - Number of threads to sieve with.
+ *   count    - Receives the number of primes.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (bad arguments, or out of memory).
+ ******************************************************************************/
+int prime_numbers_count(uint64_t low, uint64_t high, int nthreads, uint64_t *count)
+{
+	if(count == (uint64_t *) 0) {
+		return 1;
+	}
+
+	*count = 0;
+	return prime_sieve_run(low, high, nthreads, (prime_numbers_callback) 0, (void *) 0, count);
+}
+
+/********** Test Methods */
+
+#ifdef TEST
+/* What the test callback checks. */
+typedef struct prime_sieve_test_state {
+	uint64_t last;
+	uint64_t count;
+	uint64_t stop_after;
+	int errors;
+} prime_sieve_test_state;
+
+/*******************************************************************************
+ * The test callback.  The primes have to come in increasing order, and each
+ * one has to pass prime_numbers_is_probable_prime().
+ ******************************************************************************/
+static int prime_sieve_test_callback(uint64_t prime, void *arg)
+{
+	prime_sieve_test_state *state = (prime_sieve_test_state *) arg;
+
+	if((state->count > 0) && (prime <= state->last)) {
+		state->errors++;
+	}
+
+	big_number *p = big_number_new();
+	big_number_from_u64(p, prime);
+	if(prime_numbers_is_probable_prime(p) != 1) {
+		state->errors++;
+	}
+	big_number_delete(p);
+
+	state->last = prime;
+	state->count++;
+	return (state->count == state->stop_after);
+}
+
+/*******************************************************************************
+ * Run the sieve tests.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1.
+ ******************************************************************************/
+int prime_sieve_test(void)
+{
+	printf("%s(): Starting\n", __func__);
+	int rc = 1;
+
+	do {
+		/* pi(10^k) for k = 0 ... 8. */
+		static const uint64_t pi[] = { 0, 4, 25, 168, 1229, 9592, 78498, 664579, 5761455 };
+		uint64_t n = 1;
+		uint64_t count = 0;
+		int k;
+		for(k = 0; k < (sizeof(pi) / sizeof(pi[0])); k++, n *= 10) {
+			if((prime_numbers_count(0, n, 1, &count) != 0) || (count != pi[k])) { break; }
+			if((prime_numbers_count(0, n, 4, &count) != 0) || (count != pi[k])) { break; }
+		}
+		if(k != (sizeof(pi) / sizeof(pi[0]))) {
+			printf("%s(): pi(10^%d) = %ju.\n", __func__, k, count);
+			break;
+		}
+
+		/* Ranges that don't start at 0.  Every count has to add up. */
+		uint64_t a, b;
+		if((prime_numbers_count(0, 1000000, 2, &a) != 0) || (prime_numbers_count(1000000, 2000000, 3, &b) != 0) ||
+		   (prime_numbers_count(0, 2000000, 2, &count) != 0) || ((a + b) != count) || (count != 148933)) { break; }
+		if((prime_numbers_count(7, 8, 1, &count) != 0) || (count != 1)) { break; }
+		if((prime_numbers_count(8, 11, 1, &count) != 0) || (count != 0)) { break; }
+		if((prime_numbers_count(5, 5, 1, &count) != 0) || (count != 0)) { break; }
+		if(prime_numbers_count(0, (1ULL << 48) + 1, 1, &count) == 0) { break; }
+
+		/* List the 200,000 numbers just below 2^40 with 3 threads, and
+		 * check each prime.  The simulated big_number library can't test
+		 * numbers that big, so it gets the ones below 2^31.  {top, number of
+		 * primes, largest prime}. */
+		static const uint64_t ranges[2][3] = {
+			{ 1ULL << 40, 7184, 1099511627689ULL },
+			{ 1ULL << 31, 9316, 2147483647ULL }
+		};
+		big_number *tmp = big_number_new();
+		if(tmp == (big_number *) 0) { break; }
+		big_number_shift_left(big_number_1(), 64, tmp);
+		const uint64_t *range = ranges[big_number_is_zero(tmp)];
+		big_number_delete(tmp);
+
+		prime_sieve_test_state state = { 0, 0, 0, 0 };
+		uint64_t low = range[0] - 200000;
+		if(prime_numbers_enumerate(low, range[0], 3, prime_sieve_test_callback, &state) != 0) { break; }
+		if((prime_numbers_count(low, range[0], 2, &count) != 0) || (count != range[1]) ||
+		   (state.count != count) || (state.errors != 0) || (state.last != range[2])) { break; }
+
+		/* The callback can stop the listing.  The 1,000th prime is
+		 * 7,919. */
+		memset(&state, 0, sizeof(state));
+		state.stop_after = 1000;
+		if((prime_numbers_enumerate(0, 100000000, 4, prime_sieve_test_callback, &state) != 0) ||
+		   (state.count != 1000) || (state.last != 7919) || (state.errors != 0)) { break; }
+
+		/* Complete.  Pass. */
+		rc = 0;
+
+	} while(0);
+
+	printf("%s(): %s.\n", __func__, (rc == 0) ? "PASS" : "FAIL");
+	return rc;
+}
+#endif /* TEST */
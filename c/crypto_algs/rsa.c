@@ -2,16 +2,252 @@
  *
  * This module calculates an RSA Public and Private key pair.
  *
+ * rsa_generate_keypair() finds p and q with a pool of worker threads.  Each
+ * worker picks a random starting point and walks forward through the odd
+ * numbers with prime_numbers_next_probable_prime(), which sieves out the
+ * multiples of the small primes before it runs any expensive test.  The first
+ * 2 acceptable primes win, and a shared stop flag tells the other workers to
+ * give up.
+ *
+ * rsa_decrypt() uses the Chinese Remainder Theorem.  Instead of one
+ * exponentiation mod n, it does one mod p and one mod q, with exponents
+ * (d mod (p - 1)) and (d mod (q - 1)), and then puts the 2 halves back
+ * together:
+ *
+ *   m1 = (c ^ dP) % p
+ *   m2 = (c ^ dQ) % q
+ *   h  = (qInv * (m1 - m2)) % p
+ *   m  = m2 + (h * q)
+ *
+ * Each half has half the limbs and half the exponent bits, so it costs about
+ * 1/8 of the full exponentiation.  Both halves together are about 4x faster.
+ *
  ******************************************************************************/
 
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 #include "big_number.h"
+#include "crypto_util.h"
+#include "prime_numbers.h"
 #include "rsa.h"
 
 #define PRINTF printf
 
+/* The public exponent.  It's prime, so (p - 1) only has to avoid being a
+ * multiple of it. */
+#define RSA_E 65537
+
+/* Number of candidates a worker looks at from one random starting point
+ * before it picks a new one.  The average gap between primes near 2^1024 is
+ * about 710, so this is plenty. */
+#define RSA_SEARCH_STEPS 4096
+
+/*******************************************************************************
+ ******************************* CLASS DEFINITION ******************************
+ ******************************************************************************/
+
+/* This is the rsa_keypair class.  dp, dq, and qinv are the CRT values
+ * (d % (p - 1), d % (q - 1), and (1 / q) % p).  The moduli are kept prepared
+ * for exponentiation, so encrypting and decrypting don't have to redo it. */
+struct rsa_keypair {
+	big_number *n;
+	big_number *e;
+	big_number *d;
+	big_number *p;
+	big_number *q;
+	big_number *dp;
+	big_number *dq;
+	big_number *qinv;
+	big_number_mont *mont_n;
+	big_number_mont *mont_p;
+	big_number_mont *mont_q;
+	big_number_reducer *reducer_p;
+};
+
+/* State shared by the key generation threads.  found, primes, and error are
+ * protected by mutex.  stop is read without the mutex, so it's accessed with
+ * the atomic builtins. */
+typedef struct rsa_keygen {
+	pthread_mutex_t mutex;
+	int bits;
+	int stop;
+	int error;
+	int found;
+	big_number *primes[2];
+} rsa_keygen;
+
+/********************************* PRIVATE API ********************************/
+
+/*******************************************************************************
+ * Generate a random odd number that is exactly bits long and has its top 2
+ * bits set.  The product of 2 such numbers is exactly (2 * bits) long.
+ *
+ * Input:
+ *   bits   - Size of the number.  Must be >= 2.
+ *   result - Receives the number.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1.
+ ******************************************************************************/
+static int rsa_random_odd(int bits, big_number *result)
+{
+	int words = (bits + 31) / 32;
+	uint32_t *w = (uint32_t *) malloc(words * sizeof(*w));
+	if(w == (uint32_t *) 0) {
+		return 1;
+	}
+
+	int rc = crypto_util_random_bytes(w, words * sizeof(*w));
+	if(rc == 0) {
+		/* w[0] is the most significant word.  Trim it to size and set the
+		 * top 2 bits.  The top 2 bits may straddle 2 words. */
+		int top = bits - ((words - 1) * 32);
+		if(top < 32) {
+			w[0] &= (((uint32_t) 1) << top) - 1;
+		}
+		w[0] |= ((uint32_t) 1) << (top - 1);
+		if(top >= 2) {
+			w[0] |= ((uint32_t) 1) << (top - 2);
+		}
+		else {
+			w[1] |= ((uint32_t) 1) << 31;
+		}
+		w[words - 1] |= 1;
+
+		/* 32 bits at a time, so the simulated big_number library can
+		 * handle it too. */
+		int mark = big_number_scratch_mark();
+		big_number *tmp = big_number_scratch_get();
+		if(tmp == (big_number *) 0) {
+			rc = 1;
+		}
+		else {
+			big_number_reset(result);
+			int i;
+			for(i = 0; i < words; i++) {
+				big_number_shift_left(result, 32, result);
+				big_number_from_u64(tmp, w[i]);
+				big_number_add(result, tmp, result);
+			}
+		}
+		big_number_scratch_release(mark);
+	}
+
+	free(w);
+	return rc;
+}
+
+/*******************************************************************************
+ * A key generation thread.  Search for primes until 2 have been found.
+ *
+ * Input:
+ *   arg - The shared rsa_keygen object.
+ *
+ * Output:
+ *   Returns 0.  Failures are reported in rsa_keygen.error.
+ ******************************************************************************/
+static void *rsa_keygen_thread(void *arg)
+{
+	rsa_keygen *keygen = (rsa_keygen *) arg;
+
+	big_number *start = big_number_new();
+	big_number *prime = big_number_new();
+	int error = (start == (big_number *) 0) || (prime == (big_number *) 0);
+
+	while((error == 0) && (__atomic_load_n(&keygen->stop, __ATOMIC_RELAXED) == 0)) {
+		if(rsa_random_odd(keygen->bits, start) != 0) {
+			error = 1;
+			break;
+		}
+
+		if(prime_numbers_next_probable_prime(start, RSA_SEARCH_STEPS, &keygen->stop, prime) != 0) {
+			continue;
+		}
+
+		/* Walking forward may have carried into a new bit.  And e has to be
+		 * relatively prime to (p - 1). */
+		if((big_number_bit_length(prime) != keygen->bits) || (big_number_modulus_u64(prime, RSA_E) == 1)) {
+			continue;
+		}
+
+		pthread_mutex_lock(&keygen->mutex);
+		if((keygen->found < 2) &&
+		   ((keygen->found == 0) || (big_number_compare(prime, keygen->primes[0]) != 0))) {
+			big_number_copy(prime, keygen->primes[keygen->found++]);
+			if(keygen->found == 2) {
+				__atomic_store_n(&keygen->stop, 1, __ATOMIC_RELAXED);
+			}
+		}
+		pthread_mutex_unlock(&keygen->mutex);
+	}
+
+	if(error != 0) {
+		pthread_mutex_lock(&keygen->mutex);
+		keygen->error = 1;
+		__atomic_store_n(&keygen->stop, 1, __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&keygen->mutex);
+	}
+
+	big_number_delete(prime);
+	big_number_delete(start);
+	return (void *) 0;
+}
+
+/*******************************************************************************
+ * Calculate the CRT values and prepare the moduli of a key pair.  n, e, d, p,
+ * and q must already be filled in.
+ *
+ * Input:
+ *   this - The key pair.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1.
+ ******************************************************************************/
+static int rsa_keypair_prepare(rsa_keypair *this)
+{
+	int rc = 1;
+
+	int mark = big_number_scratch_mark();
+	big_number *tmp = big_number_scratch_get();
+
+	do {
+		this->dp = big_number_new();
+		this->dq = big_number_new();
+		this->qinv = big_number_new();
+		this->mont_n = big_number_mont_new(this->n);
+		this->mont_p = big_number_mont_new(this->p);
+		this->mont_q = big_number_mont_new(this->q);
+		this->reducer_p = big_number_reducer_new(this->p);
+		if(!tmp || !this->dp || !this->dq || !this->qinv || !this->mont_n || !this->mont_p ||
+		   !this->mont_q || !this->reducer_p) {
+			break;
+		}
+
+		/* dP = d % (p - 1).  dQ = d % (q - 1). */
+		big_number_subtract(this->p, big_number_1(), tmp);
+		big_number_modulus(this->d, tmp, this->dp);
+		big_number_subtract(this->q, big_number_1(), tmp);
+		big_number_modulus(this->d, tmp, this->dq);
+
+		/* qInv = (1 / q) % p. */
+		if(big_number_mod_inverse(this->q, this->p, this->qinv) != 0) {
+			break;
+		}
+
+		rc = 0;
+
+	} while(0);
+
+	big_number_scratch_release(mark);
+	return rc;
+}
+
 /*******************************************************************************
  * Given 2 numbers (assumed to be prime), calcuate phi ((p - 1 * (q - 1)).
  ******************************************************************************/
@@ -20,23 +256,24 @@ calculate_phi(big_number *p,
               big_number *q,
               big_number *phi)
 {
-	big_number *p_temp = big_number_new();
+	int mark = big_number_scratch_mark();
+
+	big_number *p_temp = big_number_scratch_get();
 	big_number_copy(p, p_temp);
 	big_number_decrement(p_temp);
 
-	big_number *q_temp = big_number_new();
+	big_number *q_temp = big_number_scratch_get();
 	big_number_copy(q, q_temp);
 	big_number_decrement(q_temp);
 
 	big_number_copy(p_temp, phi);
 	big_number_multiply(phi, q_temp, phi);
 
-	big_number_delete(p_temp);
-	big_number_delete(q_temp);
+	big_number_scratch_release(mark);
 }
 
 /*******************************************************************************
- * Given p, q, and e, calculate d.
+ * Given p, q, and e, calculate d.  d is the inverse of e, mod phi.
  *
  * Returns 0 if success.
  * Returns 1 if failure.
@@ -54,72 +291,29 @@ calculate_d(big_number *p,
 
 	/* FYI: n = (p * q). */
 
-	big_number *phi   = 0;
-	big_number *tmp   = 0;
-	big_number *zero  = 0;
-	big_number *val1a = 0;
-	big_number *val1b = 0;
-	big_number *val2a = 0;
-	big_number *val2b = 0;
-	big_number *x     = 0;
-	big_number *val1c = 0;
-	big_number *val2c = 0;
+	int mark = big_number_scratch_mark();
+	big_number *phi = big_number_scratch_get();
+	big_number *tmp = big_number_scratch_get();
 
 	do {
-		/* Calculate phi (p - 1) * (q - 1). */
-		phi   = big_number_new();
-		tmp   = big_number_new();
-		zero  = big_number_new();
-		val1a = big_number_new();
-		val1b = big_number_new();
-		val1c = big_number_new();
-		val2a = big_number_new();
-		val2b = big_number_new();
-		val2c = big_number_new();
-		x     = big_number_new();
-		if(!phi || !tmp || !zero || !val1a || !val1b || !val1c || !val2a || !val2b || !val2c || !x) {
+		if(!phi || !tmp) {
 			break;
 		}
 
+		/* Calculate phi (p - 1) * (q - 1). */
 		calculate_phi(p, q, phi);
 		//PRINTF("          phi = %s.\n", big_number_to_dec_str(phi));
 
 		/* Make sure e doesn't share a factor with phi. */
-		if(big_number_modulus_is_zero(phi, e) == 1) {
-			//PRINTF("e won't work (%s mod %s != 0).\n", big_number_to_dec_str(phi), big_number_to_dec_str(e));
+		big_number_gcd(e, phi, tmp);
+		if(big_number_compare(tmp, big_number_1()) != 0) {
+			//PRINTF("e won't work (gcd(%s, %s) != 1).\n", big_number_to_dec_str(e), big_number_to_dec_str(phi));
 			break;
 		}
 
-		big_number_copy(phi, val1a);
-		big_number_copy(e, val1b);
-		big_number_copy(phi, val2a);
-		big_number_copy(big_number_1(), val2b);
-
-		/* Calculate d using the Extended Euclidian Algorithm. */
-		do {
-			big_number_divide(val1a, val1b, x);
-
-			big_number_multiply(x, val1b, tmp);
-			big_number_subtract(val1a, tmp, val1c);
-
-			big_number_multiply(x, val2b, tmp);
-			big_number_subtract(val2a, tmp, val2c);
-
-			while(big_number_compare(val1c, zero) < 0) {
-				big_number_add(val1c, phi, val1c);
-			}
-			while(big_number_compare(val2c, zero) < 0) {
-				big_number_add(val2c, phi, val2c);
-			}
-
-			big_number_copy(val1b, val1a);
-			big_number_copy(val1c, val1b);
-
-			big_number_copy(val2b, val2a);
-			big_number_copy(val2c, val2b);
-		} while(big_number_compare(val1b, big_number_1()) != 0);
-
-		big_number_copy(val2b, d);
+		if(big_number_mod_inverse(e, phi, d) != 0) {
+			break;
+		}
 		//PRINTF("          d = %s.\n", big_number_to_dec_str(d));
 
 		/* Test e and d.  (e * d) mod phi = 1. */
@@ -139,16 +333,7 @@ calculate_d(big_number *p,
 	} while(0);
 
 	/* Clean up. */
-	big_number_delete(val2c);
-	big_number_delete(val1c);
-	big_number_delete(x);
-	big_number_delete(val2b);
-	big_number_delete(val2a);
-	big_number_delete(val1b);
-	big_number_delete(val1a);
-	big_number_delete(zero);
-	big_number_delete(tmp);
-	big_number_delete(phi);
+	big_number_scratch_release(mark);
 
 	return retcode;
 }
@@ -167,6 +352,230 @@ int rsa_calculate_d(big_number *p,
 	return calculate_d(p, q, e, d);
 }
 
+/********************************** PUBLIC API ********************************/
+
+/*******************************************************************************
+ * Generate an RSA key pair.  e is 65,537.
+ *
+ * Input:
+ *   bits     - Size of the modulus (n).  Must be even and >= 32.
+ *   nthreads - Number of threads to search for p and q with.
+ *
+ * Output:
+ *   Success - A pointer to the new rsa_keypair object.
+ *   Failure - 0.
+ ******************************************************************************/
+rsa_keypair *rsa_generate_keypair(int bits, int nthreads)
+{
+	if((bits < 32) || ((bits & 1) != 0) || (nthreads < 1)) {
+		return (rsa_keypair *) 0;
+	}
+
+	rsa_keypair *this = (rsa_keypair *) calloc(1, sizeof(*this));
+	if(this == (rsa_keypair *) 0) {
+		return this;
+	}
+
+	rsa_keygen keygen;
+	keygen.bits = bits / 2;
+	keygen.stop = 0;
+	keygen.error = 0;
+	keygen.found = 0;
+	pthread_mutex_init(&keygen.mutex, NULL);
+
+	pthread_t *threads = (pthread_t *) malloc(nthreads * sizeof(*threads));
+	int started = 0;
+	int rc = 1;
+
+	do {
+		this->n = big_number_new();
+		this->e = big_number_new();
+		this->d = big_number_new();
+		this->p = big_number_new();
+		this->q = big_number_new();
+		if(!this->n || !this->e || !this->d || !this->p || !this->q || !threads) {
+			break;
+		}
+		keygen.primes[0] = this->p;
+		keygen.primes[1] = this->q;
+
+		for(started = 0; started < nthreads; started++) {
+			if(pthread_create(&threads[started], NULL, rsa_keygen_thread, &keygen) != 0) {
+				break;
+			}
+		}
+
+		/* If no thread started, there's nobody to do the work.  Otherwise
+		 * the ones that did start will get there eventually. */
+		if(started == 0) {
+			break;
+		}
+
+		int i;
+		for(i = 0; i < started; i++) {
+			pthread_join(threads[i], (void **) 0);
+		}
+		started = 0;
+
+		if((keygen.error != 0) || (keygen.found != 2)) {
+			break;
+		}
+
+		big_number_multiply(this->p, this->q, this->n);
+		big_number_from_u64(this->e, RSA_E);
+		if(calculate_d(this->p, this->q, this->e, this->d) != 0) {
+			break;
+		}
+		if(rsa_keypair_prepare(this) != 0) {
+			break;
+		}
+
+		rc = 0;
+
+	} while(0);
+
+	/* Only get here with running threads if something went wrong. */
+	if(started != 0) {
+		__atomic_store_n(&keygen.stop, 1, __ATOMIC_RELAXED);
+		int i;
+		for(i = 0; i < started; i++) {
+			pthread_join(threads[i], (void **) 0);
+		}
+	}
+
+	free(threads);
+	pthread_mutex_destroy(&keygen.mutex);
+
+	if(rc != 0) {
+		rsa_keypair_delete(this);
+		this = (rsa_keypair *) 0;
+	}
+
+	return this;
+}
+
+/*******************************************************************************
+ * Delete an rsa_keypair object.
+ *
+ * Input:
+ *   this - The object to delete.
+ ******************************************************************************/
+void rsa_keypair_delete(rsa_keypair *this)
+{
+	if(this != (rsa_keypair *) 0) {
+		big_number_reducer_delete(this->reducer_p);
+		big_number_mont_delete(this->mont_q);
+		big_number_mont_delete(this->mont_p);
+		big_number_mont_delete(this->mont_n);
+		big_number_delete(this->qinv);
+		big_number_delete(this->dq);
+		big_number_delete(this->dp);
+		big_number_delete(this->q);
+		big_number_delete(this->p);
+		big_number_delete(this->d);
+		big_number_delete(this->e);
+		big_number_delete(this->n);
+		free(this);
+	}
+}
+
+/*******************************************************************************
+ * Accessors for the public modulus (n), the public exponent (e), and the
+ * private exponent (d).
+ ******************************************************************************/
+const big_number *rsa_keypair_n(const rsa_keypair *this)
+{
+	return (this != (rsa_keypair *) 0) ? this->n : (big_number *) 0;
+}
+
+const big_number *rsa_keypair_e(const rsa_keypair *this)
+{
+	return (this != (rsa_keypair *) 0) ? this->e : (big_number *) 0;
+}
+
+const big_number *rsa_keypair_d(const rsa_keypair *this)
+{
+	return (this != (rsa_keypair *) 0) ? this->d : (big_number *) 0;
+}
+
+/*******************************************************************************
+ * Encrypt a message with the public key.  c = (m ^ e) % n.
+ *
+ * Input:
+ *   this - The key pair.
+ *   m    - The message.  0 <= m < n.
+ *   c    - Receives the ciphertext.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (bad parameter, or m out of range).
+ ******************************************************************************/
+int rsa_encrypt(const rsa_keypair *this, const big_number *m, big_number *c)
+{
+	if((this == (rsa_keypair *) 0) || (m == (big_number *) 0) || (c == (big_number *) 0) ||
+	   (big_number_is_negative(m) == 1) || (big_number_compare(m, this->n) >= 0)) {
+		return 1;
+	}
+
+	big_number_mont_exp(this->mont_n, m, this->e, c);
+	return 0;
+}
+
+/*******************************************************************************
+ * Decrypt (or sign) with the private key.  m = (c ^ d) % n, calculated with the
+ * Chinese Remainder Theorem.  See the top of this file.
+ *
+ * Input:
+ *   this - The key pair.
+ *   c    - The ciphertext.  0 <= c < n.
+ *   m    - Receives the message.
+ *
+ * Output:
+ *   Success - 0.
+ *   Failure - 1 (bad parameter, c out of range, or out of memory).
+ ******************************************************************************/
+int rsa_decrypt(const rsa_keypair *this, const big_number *c, big_number *m)
+{
+	if((this == (rsa_keypair *) 0) || (c == (big_number *) 0) || (m == (big_number *) 0) ||
+	   (big_number_is_negative(c) == 1) || (big_number_compare(c, this->n) >= 0)) {
+		return 1;
+	}
+
+	int rc = 1;
+
+	int mark = big_number_scratch_mark();
+	big_number *m1 = big_number_scratch_get();
+	big_number *m2 = big_number_scratch_get();
+	big_number *h = big_number_scratch_get();
+
+	do {
+		if(!m1 || !m2 || !h) { break; }
+
+		big_number_mont_exp(this->mont_p, c, this->dp, m1);
+		big_number_mont_exp(this->mont_q, c, this->dq, m2);
+
+		/* h = (qInv * (m1 - m2)) % p.  m2 can be bigger than p, so reduce
+		 * it first. */
+		big_number_reduce(this->reducer_p, m2, h);
+		big_number_subtract(m1, h, h);
+		if(big_number_is_negative(h) == 1) {
+			big_number_add_to(h, this->p);
+		}
+		big_number_mul_into(h, this->qinv, h, m1);
+		big_number_reduce(this->reducer_p, h, h);
+
+		/* m = m2 + (h * q). */
+		big_number_mul_into(h, this->q, h, m1);
+		big_number_add(m2, h, m);
+
+		rc = 0;
+
+	} while(0);
+
+	big_number_scratch_release(mark);
+	return rc;
+}
+
 #ifdef TEST
 /*******************************************************************************
  *
@@ -220,6 +629,41 @@ int rsa_test(void)
 				}
 			}
 
+			/* Generate a key pair and make sure a message survives the
+			 * round trip.  The simulated big_number library only holds 63
+			 * bits, so it gets a tiny key. */
+			big_number_reset(d);
+			big_number_shift_left(big_number_1(), 64, d);
+			int bits = (big_number_is_zero(d) == 1) ? 40 : 512;
+
+			rsa_keypair *key = (rc == 0) ? rsa_generate_keypair(bits, 4) : (rsa_keypair *) 0;
+			if(key != (rsa_keypair *) 0) {
+				/* m -> c -> m.  The CRT answer has to match the plain
+				 * (c ^ d) % n too. */
+				big_number_from_u64(p, 123456789);
+				if((big_number_bit_length(rsa_keypair_n(key)) != bits) ||
+				   (rsa_encrypt(key, p, q) != 0) || (big_number_compare(p, q) == 0) ||
+				   (rsa_decrypt(key, q, e) != 0) || (big_number_compare(p, e) != 0)) {
+					rc = 1;
+				}
+				big_number_mod_exp(q, rsa_keypair_d(key), rsa_keypair_n(key), e);
+				if(big_number_compare(p, e) != 0) {
+					rc = 1;
+				}
+
+				/* c = n - 1 is the biggest ciphertext, and it's its own
+				 * inverse under any odd exponent. */
+				big_number_subtract(rsa_keypair_n(key), big_number_1(), q);
+				if((rsa_decrypt(key, q, e) != 0) || (big_number_compare(q, e) != 0) ||
+				   (rsa_decrypt(key, rsa_keypair_n(key), e) == 0)) {
+					rc = 1;
+				}
+				rsa_keypair_delete(key);
+			}
+			else {
+				rc = 1;
+			}
+
 			big_number_delete(p);
 			big_number_delete(q);
 			big_number_delete(e);
@@ -6,6 +6,35 @@
  *
  ******************************************************************************/
 
+#include "big_number.h"
+
+typedef struct rsa_keypair rsa_keypair;
+
+/*******************************************************************************
+ * Generate a key pair with a bits-long modulus, searching for the primes with
+ * nthreads threads.  Returns 0 if failure.
+ ******************************************************************************/
+rsa_keypair *rsa_generate_keypair(int bits, int nthreads);
+
+/*******************************************************************************
+ * Delete a key pair.
+ ******************************************************************************/
+void rsa_keypair_delete(rsa_keypair *this);
+
+/*******************************************************************************
+ * Get the modulus (n), public exponent (e), and private exponent (d).
+ ******************************************************************************/
+const big_number *rsa_keypair_n(const rsa_keypair *this);
+const big_number *rsa_keypair_e(const rsa_keypair *this);
+const big_number *rsa_keypair_d(const rsa_keypair *this);
+
+/*******************************************************************************
+ * Encrypt (c = (m ^ e) % n) and decrypt (m = (c ^ d) % n).  Decryption uses the
+ * Chinese Remainder Theorem.  Both return 0 if success.
+ ******************************************************************************/
+int rsa_encrypt(const rsa_keypair *this, const big_number *m, big_number *c);
+int rsa_decrypt(const rsa_keypair *this, const big_number *c, big_number *m);
+
 /*******************************************************************************
  * Test the rsa.c ADT.
  ******************************************************************************/